@@ -26,8 +26,12 @@ typedef struct chidb_stmt chidb_stmt;
  *
  * If the file does not exist, it will be created
  *
+ * If the file name is ":memory:", a new, empty database is created
+ * in memory instead, without touching the disk. It is private to the
+ * returned chidb struct, and is lost when the database is closed.
+ *
  * Parameters
- * - file: Filename of the chidb file to open/create
+ * - file: Filename of the chidb file to open/create, or ":memory:"
  * - db: Out parameter. Returns a pointer to a chidb struct. The chidb
  *       struct is an opaque type representing a chidb database. In
  *       other words, an API user should not be concerned with what
@@ -44,6 +48,35 @@ typedef struct chidb_stmt chidb_stmt;
  */
 int chidb_open(const char *file, chidb **db); 
 
+/* Opens a chidb file with a given VFS
+ *
+ * Same as chidb_open, but the file (and its journal or WAL) is accessed
+ * through the named VFS:
+ *
+ * - "posix": pread/pwrite (the default)
+ * - "uring": batches of pages are read and written through io_uring
+ * - "direct": the database file is opened with O_DIRECT, so that its
+ *   pages are not cached by the operating system as well
+ * - "memory": the file is kept in memory until it is closed
+ * - "compress": every page of the database file is compressed, for
+ *   large tables that are mostly read (such as archives). Files of this
+ *   VFS can only be opened with it.
+ *
+ * Parameters
+ * - file: Filename of the chidb file to open/create
+ * - vfs: Name of the VFS
+ * - db: Out parameter. Returns a pointer to a chidb struct.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_ECANTOPEN: Unable to open the database file, or there is
+ *                    no VFS with that name
+ * - CHIDB_ECORRUPT: The database file is not well formed
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_open_vfs(const char *file, const char *vfs, chidb **db);
+
 /* Loads schema into memory in the schema_table entry
  * of the chidb object.
  *
@@ -51,6 +84,11 @@ int chidb_open(const char *file, chidb **db);
 void chidb_print_schema(chidb * db);
 int chidb_load_schema(chidb * db);
 
+/* Adds a row to the schema table, and loads the schema again
+ * (used by CREATE INDEX, see chidb_add_schema in main.c)
+ */
+int chidb_add_schema(chidb *db, const char *type, const char *name, const char *table, int root_page, const char *sql);
+
 /* Prepares a SQL statement for execution
  *
  * Parameters
@@ -82,6 +120,11 @@ int chidb_prepare(chidb *db, const char *sql, chidb_stmt **stmt);
  * results, then CHIDB_DONE is returned (note that this function does
  * not return CHIDB_OK).
  *
+ * Unless a transaction is active (see chidb_begin), a statement that
+ * modifies the database runs in a transaction of its own: all of its
+ * changes are committed together once it finishes, and are rolled back
+ * if it fails.
+ *
  * Parameters
  * - stmt: Prepared SQL statement
  *
@@ -155,6 +198,21 @@ const char *chidb_column_name(chidb_stmt* stmt, int col);
 int chidb_column_int(chidb_stmt *stmt, int col);
 
 
+/* Returns the value of a column of integer type, as a 64-bit integer
+ *
+ * chidb_column_int only returns the low 32 bits of values of type
+ * SQL_INTEGER_8BYTE.
+ *
+ * Parameters
+ * - stmt: Prepared SQL statement
+ * - col: Column (columns are numbered from 0)
+ *
+ * Return
+ * - Integer value
+ */
+int64_t chidb_column_int64(chidb_stmt *stmt, int col);
+
+
 /* Returns the value of a column of string type
  *
  * Parameters
@@ -170,6 +228,189 @@ int chidb_column_int(chidb_stmt *stmt, int col);
 const char *chidb_column_text(chidb_stmt *stmt, int col);
 
 
+/* Begins a transaction
+ *
+ * By default, every statement that modifies the database is committed
+ * as soon as it is executed. After chidb_begin (or a BEGIN statement),
+ * the pages modified by all the statements that follow are kept in
+ * memory, and are only written to the file, together, by chidb_commit
+ * (or COMMIT). chidb_rollback (or ROLLBACK) discards them instead.
+ *
+ * Parameters
+ * - db: chidb database
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: A transaction is already active
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_begin(chidb *db);
+
+
+/* Commits the active transaction
+ *
+ * Parameters
+ * - db: chidb database
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: There is no active transaction
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file. The
+ *              transaction has been rolled back.
+ */
+int chidb_commit(chidb *db);
+
+
+/* Rolls back the active transaction
+ *
+ * Parameters
+ * - db: chidb database
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: There is no active transaction
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_rollback(chidb *db);
+
+
+/* Sets the journal mode of a chidb database
+ *
+ * In CHIDB_JOURNAL_DELETE mode (the default), a transaction saves the
+ * original contents of the pages it modifies in a rollback journal, and
+ * writes the new contents to the database file when it commits. In
+ * CHIDB_JOURNAL_WAL mode, committed pages are appended to a write-ahead
+ * log instead, and are copied into the database file by checkpoints.
+ * The mode is stored in the database file, so it persists after the
+ * database is closed.
+ *
+ * Parameters
+ * - db: chidb database
+ * - mode: CHIDB_JOURNAL_DELETE or CHIDB_JOURNAL_WAL
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: A transaction is active, or the mode is not valid
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_journal_mode(chidb *db, int mode);
+
+
+/* Sets when a chidb database is flushed to disk
+ *
+ * - CHIDB_SYNC_FULL (the default): Every commit is flushed to disk, so
+ *   committed transactions survive a power loss.
+ * - CHIDB_SYNC_NORMAL: In WAL mode, the WAL is only flushed before its
+ *   pages are copied back into the database file, so a power loss can
+ *   lose the last commits (but not corrupt the file). In rollback
+ *   journal mode, this is the same as CHIDB_SYNC_FULL.
+ * - CHIDB_SYNC_OFF: Nothing is flushed. A power loss can corrupt the
+ *   file, which is only acceptable for scratch data.
+ *
+ * The setting only applies to this connection, and can also be changed
+ * with "PRAGMA synchronous = OFF | NORMAL | FULL;". Similarly, the
+ * journal mode can be changed with "PRAGMA journal_mode = DELETE | WAL;".
+ *
+ * Parameters
+ * - db: chidb database
+ * - mode: CHIDB_SYNC_OFF, CHIDB_SYNC_NORMAL or CHIDB_SYNC_FULL
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: Invalid mode
+ */
+int chidb_synchronous(chidb *db, int mode);
+
+
+/* Sets how commits share their flush to disk in WAL mode
+ *
+ * In WAL mode, threads that commit at about the same time (each using
+ * its own chidb connection to the same database) can share a single
+ * flush of the WAL to disk (group commit). The first of them waits up
+ * to max_wait microseconds for other commits to join it, or until
+ * batch_size commits are waiting, before flushing the WAL on behalf of
+ * all of them.
+ *
+ * Parameters
+ * - db: chidb database
+ * - max_wait: Maximum time to wait for other commits, in microseconds
+ *             (0, the default, flushes right away)
+ * - batch_size: Number of commits to wait for
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: Invalid max_wait or batch_size
+ */
+int chidb_group_commit(chidb *db, int max_wait, int batch_size);
+
+
+/* Sets the page cache of a chidb database
+ *
+ * The cache keeps recently read pages in memory. With CHIDB_CACHE_2Q
+ * (the default, with room for 2000 pages), pages that are read only once,
+ * such as the pages of a full table scan, go through a small part of the
+ * cache, so that a scan does not evict the pages that other statements
+ * keep using. CHIDB_CACHE_LRU evicts the least recently used page
+ * instead, and CHIDB_CACHE_NONE turns the cache off. Changing the cache
+ * empties it and resets its statistics.
+ *
+ * Parameters
+ * - db: chidb database
+ * - policy: CHIDB_CACHE_NONE, CHIDB_CACHE_LRU or CHIDB_CACHE_2Q
+ * - npages: Maximum number of pages in the cache
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: Invalid policy or number of pages
+ * - CHIDB_ENOMEM: Could not allocate memory
+ */
+int chidb_cache(chidb *db, int policy, int npages);
+
+
+/* Gets the statistics of the page cache of a chidb database
+ *
+ * The hit ratio of the cache is hits / (hits + misses).
+ *
+ * Parameters
+ * - db: chidb database
+ * - hits: Out parameter. Number of page reads served by the cache.
+ * - misses: Out parameter. Number of page reads that were not.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ */
+int chidb_cache_stats(chidb *db, uint64_t *hits, uint64_t *misses);
+
+
+/* Turns page checksums on or off for a chidb database
+ *
+ * With checksums, every page of the database file ends with a CRC32C
+ * checksum of its contents, which is checked whenever the page is read
+ * from disk. A page that has been corrupted on disk then makes
+ * statements fail with CHIDB_ECORRUPT instead of returning wrong
+ * results. The checksum is computed with the crc32 instruction of
+ * SSE4.2 where the CPU has it.
+ *
+ * The setting is stored in the database file. Changing it rewrites the
+ * whole file, as VACUUM does.
+ *
+ * Parameters
+ * - db: chidb database
+ * - on: Whether pages have checksums (non-zero) or not (zero)
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ECORRUPT: The database file is not well formed
+ * - CHIDB_EMISUSE: A transaction is active
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_checksums(chidb *db, int on);
+
+
 /* Closes a chidb database
  *
  * Parameters
@@ -31,6 +31,20 @@
 #define CHIDB_ROW (100)
 #define CHIDB_DONE (101)
 
+// Journal modes (see chidb_journal_mode)
+#define CHIDB_JOURNAL_DELETE (0)
+#define CHIDB_JOURNAL_WAL (1)
+
+// Synchronous settings (see chidb_synchronous)
+#define CHIDB_SYNC_OFF (0)
+#define CHIDB_SYNC_NORMAL (1)
+#define CHIDB_SYNC_FULL (2)
+
+// Page cache policies (see chidb_cache)
+#define CHIDB_CACHE_NONE (0)
+#define CHIDB_CACHE_LRU (1)
+#define CHIDB_CACHE_2Q (2)
+
 // Private codes (shouldn't be used by API users)
 #define CHIDB_NOHEADER (1)
 #define CHIDB_EFULLDB (3)
@@ -39,6 +53,9 @@
 #define CHIDB_ECORRUPTHEADER (6)
 #define CHIDB_ENOTFOUND (9)
 #define CHIDB_EDUPLICATE (8)
+#define CHIDB_ESHORTREAD (10)
+#define CHIDB_EBUSY (11)
+#define CHIDB_ECHECKSUM (12)    // A page does not match its checksum (see chidb_Pager_setChecksums)
 
 
 #define DEFAULT_PAGE_SIZE (1024)
@@ -48,11 +65,12 @@
 #define SQL_INTEGER_1BYTE (1)
 #define SQL_INTEGER_2BYTE (2)
 #define SQL_INTEGER_4BYTE (4)
+#define SQL_INTEGER_8BYTE (6)
 #define SQL_TEXT (13)
 
 typedef uint16_t ncell_t;
 typedef uint32_t npage_t;
-typedef uint32_t key_t;
+typedef uint64_t key_t;
 
 /* Forward declaration */
 typedef struct BTree BTree;
@@ -29,13 +29,13 @@ void SHOW_ALL_KEYS_AT_NODE(BTreeNode *node)
     chidb_Btree_getCell(node,i,&c);
     //if (c.type != 0x05)
     //	return;
-    fprintf(stdout,"%i: KEY %i  ",i,c.key);
+    fprintf(stdout,"%i: KEY %llu  ",i,(unsigned long long) c.key);
     if (c.type == 0x05)
     	fprintf(stdout,"Child %i",c.fields.tableInternal.child_page);
 	if (c.type == 0x02)
-		fprintf(stdout,"Child %i   Key2 %i",c.fields.indexInternal.child_page,c.fields.indexInternal.keyPk);
+		fprintf(stdout,"Child %i   Key2 %llu",c.fields.indexInternal.child_page,(unsigned long long) c.fields.indexInternal.keyPk);
 	if (c.type == 0x0a)
-		fprintf(stdout,"Key2 %i",c.fields.indexLeaf.keyPk);
+		fprintf(stdout,"Key2 %llu",(unsigned long long) c.fields.indexLeaf.keyPk);
     fprintf(stdout,"\n");
   }
 }
@@ -79,12 +79,38 @@ void SHOW_ALL_KEYS(BTree *bt)
  * - CHIDB_EIO: An I/O error has occurred when accessing the file
  */
 int chidb_Btree_open(const char *filename, chidb *db, BTree **bt)
+{
+    return chidb_Btree_openVfs(filename, NULL, db, bt);
+}
+
+
+/* Open a B-Tree file with a given VFS
+ *
+ * Same as chidb_Btree_open, but the file is opened with the given VFS
+ * (see vfs.c) instead of the default one.
+ *
+ * Parameters
+ * - filename: Database file (might not exist)
+ * - vfs: VFS to open the file with, or NULL to choose it from the
+ *        filename (see chidb_Pager_open)
+ * - db: A chidb struct. Its bt field must be set to the newly
+ *			 created BTree.
+ * - bt: An out parameter. Used to return a pointer to the
+ *			 newly created BTree.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ECORRUPTHEADER: Database file contains an invalid header
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_openVfs(const char *filename, Vfs *vfs, chidb *db, BTree **bt)
 {
     *bt = malloc(sizeof(BTree));
     Pager *pager;
 
     /* Open the file */
-    int file_open = chidb_Pager_open(&pager, filename);
+    int file_open = (vfs == NULL) ? chidb_Pager_open(&pager, filename) : chidb_Pager_openVfs(&pager, vfs, filename);
     if(file_open == CHIDB_ENOMEM) {
         return CHIDB_ENOMEM;
     } else if(file_open == CHIDB_EIO) {
@@ -92,6 +118,9 @@ int chidb_Btree_open(const char *filename, chidb *db, BTree **bt)
     }
 
     (*bt)->pager = pager;
+    (*bt)->n_node_pool = 0;
+    (*bt)->schema_table = NULL;
+    (*bt)->schema_table_size = 0;
     pager->n_pages = 0;
 
     /* Set page size */
@@ -144,10 +173,14 @@ int chidb_Btree_open(const char *filename, chidb *db, BTree **bt)
         if(strcmp(hdr->format_str, "SQLite format 3")) {
             is_valid = 0;
         }
-        if(hdr->f1[0] != 0x01 || hdr->f1[1] != 0x01 || hdr->f1[2] != 0x00 || hdr->f1[3] != 0x40 || hdr->f1[4] != 0x20 || hdr->f1[5] != 0x20) {
+        if(hdr->f1[0] != hdr->f1[1] || (hdr->f1[0] != HEADER_VERSION_LEGACY && hdr->f1[0] != HEADER_VERSION_WAL)) {
+            is_valid = 0;
+        }
+        if((hdr->f1[2] != 0x00 && hdr->f1[2] != PAGE_CHECKSUM_SIZE) || hdr->f1[3] != 0x40 || hdr->f1[4] != 0x20 || hdr->f1[5] != 0x20) {
             is_valid = 0;
         }
-        if(hdr->f2[0] != 0 || hdr->f2[1] != 0) {
+        /* f2[1] and f2[2] hold the freelist, and are managed by the pager */
+        if(hdr->f2[0] != 0) {
             is_valid = 0;
         }
         if(get4byte((const uint8_t *) &(hdr->f3)) != 1) {
@@ -166,6 +199,11 @@ int chidb_Btree_open(const char *filename, chidb *db, BTree **bt)
         if(!is_valid) {
             return CHIDB_ECORRUPTHEADER;
         }
+        if(hdr->f1[0] == HEADER_VERSION_WAL) {
+            int err = chidb_Pager_setJournalMode(pager, CHIDB_JOURNAL_WAL);
+            if(err != CHIDB_OK)
+                return err;
+        }
         free(buf);
 
         db->bt = *bt;
@@ -175,6 +213,17 @@ int chidb_Btree_open(const char *filename, chidb *db, BTree **bt)
 }
 
 
+/* Free the nodes kept for reuse by chidb_Btree_freeMemNode */
+static void chidb_Btree_freeNodePool(BTree *bt)
+{
+    while(bt->n_node_pool > 0) {
+        BTreeNode *btn = bt->node_pool[--bt->n_node_pool];
+        free(btn->keys);
+        free(btn);
+    }
+}
+
+
 /* Close a B-Tree file
  * 
  * This function closes a database file, freeing any resource
@@ -190,12 +239,371 @@ int chidb_Btree_open(const char *filename, chidb *db, BTree **bt)
 int chidb_Btree_close(BTree *bt)
 {
     int result = chidb_Pager_close(bt->pager);
+    chidb_Btree_freeNodePool(bt);
     free(bt);
 
     return result;
 }
 
 
+/* Allocate a BTreeNode, reusing a freed one if possible */
+static BTreeNode *chidb_Btree_allocNode(BTree *bt)
+{
+    BTreeNode *btn;
+
+    if(bt->n_node_pool > 0) {
+        btn = bt->node_pool[--bt->n_node_pool];
+        key_t *keys = btn->keys;
+        ncell_t keys_size = btn->keys_size;
+        memset(btn, 0, sizeof(BTreeNode));
+        btn->keys = keys;
+        btn->keys_size = keys_size;
+    } else {
+        btn = calloc(1, sizeof(BTreeNode));
+    }
+
+    return btn;
+}
+
+
+/* Position right after the varint at pos, or 0 if the varint does
+ * not end before limit */
+static uint32_t chidb_Btree_skipVarint(const uint8_t *data, uint32_t pos, uint32_t limit)
+{
+    // The ninth byte of a varint is always its last
+    for(int i = 0; i < VARINT_MAXSIZE && pos < limit; i++)
+        if(!(data[pos++] & 0x80) || i == VARINT_MAXSIZE - 1)
+            return pos;
+
+    return 0;
+}
+
+
+/* Type of an integer in an index cell: the smallest that holds it */
+static uint8_t chidb_Btree_indexIntType(key_t v)
+{
+    if(v <= UINT8_MAX)
+        return SQL_INTEGER_1BYTE;
+    if(v <= UINT16_MAX)
+        return SQL_INTEGER_2BYTE;
+    return (v > UINT32_MAX) ? SQL_INTEGER_8BYTE : SQL_INTEGER_4BYTE;
+}
+
+
+static key_t chidb_Btree_getIndexInt(const uint8_t *p, uint8_t type)
+{
+    if(type == SQL_NULL || INDEXCELL_ISTEXT(type))
+        return 0;
+    switch(type) {
+        case SQL_INTEGER_1BYTE:
+            return p[0];
+        case SQL_INTEGER_2BYTE:
+            return get2byte(p);
+        case SQL_INTEGER_8BYTE:
+            return get8byte(p);
+        default:
+            return get4byte(p);
+    }
+}
+
+
+/* Write an integer of an index cell, and return its size */
+static int chidb_Btree_putIndexInt(uint8_t *p, key_t v, uint8_t type)
+{
+    switch(type) {
+        case SQL_INTEGER_1BYTE:
+            p[0] = (uint8_t)v;
+            break;
+        case SQL_INTEGER_2BYTE:
+            put2byte(p, (uint16_t)v);
+            break;
+        case SQL_INTEGER_8BYTE:
+            put8byte(p, v);
+            break;
+        default:
+            put4byte(p, (uint32_t)v);
+            break;
+    }
+
+    return INDEXCELL_INTSIZE(type);
+}
+
+
+/* Record type of a column of the indexed key of an index cell */
+static uint8_t chidb_Btree_indexColType(BTreeKeyCol *col)
+{
+    if(col->type == INDEXKEY_TEXT)
+        return SQL_TEXT + 2 * col->len;
+    if(col->type == INDEXKEY_NULL)
+        return SQL_NULL;
+    return chidb_Btree_indexIntType(col->value);
+}
+
+
+/* Number of bytes of a prefix that the first column of an index cell
+ * is stored without (see chidb_Btree_putIndexRecord). That is, the bytes
+ * its string shares with the prefix, or 0 if there are too few of them
+ * to save any space, or if the column is not a string. */
+static int chidb_Btree_sharedPrefix(BTreeCell *cell, const uint8_t *prefix, int len)
+{
+    int shared = 0;
+
+    if(cell->key_ncols == 0 || cell->key_cols[0].type != INDEXKEY_TEXT)
+        return 0;
+    if(len > cell->key_cols[0].len)
+        len = cell->key_cols[0].len;
+    while(shared < len && cell->key_str[cell->key_cols[0].off + shared] == prefix[shared])
+        shared++;
+
+    return (shared >= INDEXCELL_MINSHARED) ? shared : 0;
+}
+
+
+/* Size of the record of an index cell, without the byte with its size.
+ * shared is the number of bytes of the first column that are left out
+ * (see chidb_Btree_sharedPrefix). */
+static int chidb_Btree_indexRecordSize(BTreeCell *cell, key_t keyPk, int shared)
+{
+    int size = INDEXCELL_HEADER_SIZE(cell->key_ncols) + INDEXCELL_INTSIZE(chidb_Btree_indexIntType(keyPk));
+
+    for(int i = 0; i < cell->key_ncols; i++)
+        size += INDEXCELL_FIELDSIZE(chidb_Btree_indexColType(&cell->key_cols[i]));
+
+    return (shared > 0) ? size + 1 - shared : size;
+}
+
+
+/* Write the record of an index cell (starting with its size, which
+ * is always a one-byte varint), and return its size. If shared is not
+ * 0, the first column is written without its first shared bytes, which
+ * are in the prefix of the page (see chidb_Btree_sharedPrefix). */
+static int chidb_Btree_putIndexRecord(uint8_t *p, BTreeCell *cell, key_t keyPk, int shared)
+{
+    uint8_t typePk = chidb_Btree_indexIntType(keyPk);
+    uint8_t *data = p + 1 + INDEXCELL_HEADER_SIZE(cell->key_ncols);
+
+    p[1] = INDEXCELL_HEADER_SIZE(cell->key_ncols);
+    for(int i = 0; i < cell->key_ncols; i++) {
+        BTreeKeyCol *col = &cell->key_cols[i];
+        uint8_t type = chidb_Btree_indexColType(col);
+        if(i == 0 && shared > 0) {
+            type = INDEXCELL_SHAREDTEXT + 2 * (1 + col->len - shared);
+            data[0] = shared;
+            memcpy(data + 1, cell->key_str + col->off + shared, col->len - shared);
+        } else if(col->type == INDEXKEY_TEXT) {
+            memcpy(data, cell->key_str + col->off, col->len);
+        } else if(col->type == INDEXKEY_INT) {
+            chidb_Btree_putIndexInt(data, col->value, type);
+        }
+        p[2 + i] = type;
+        data += INDEXCELL_FIELDSIZE(type);
+    }
+    p[2 + cell->key_ncols] = typePk;
+    data += chidb_Btree_putIndexInt(data, keyPk, typePk);
+    p[0] = data - p - 1;
+
+    return data - p;
+}
+
+
+/* Read the fields of the record of an index cell (see
+ * chidb_Btree_putIndexRecord), starting at its header size, given the
+ * prefix of its page. Fields that do not fit in a BTreeCell (only in a
+ * corrupt cell) are skipped */
+static void chidb_Btree_getIndexRecord(const uint8_t *p, BTreeCell *cell, key_t *keyPk,
+                                       const uint8_t *prefix, int prefix_len)
+{
+    int ncols = (p[0] > INDEXCELL_HEADER_SIZE(0)) ? p[0] - INDEXCELL_HEADER_SIZE(0) : 0;
+    const uint8_t *data = p + p[0];
+    int used = 0;
+
+    cell->key = 0;
+    cell->key_ncols = 0;
+    for(int i = 0; i < ncols; i++) {
+        uint8_t type = p[1 + i];
+        int size = INDEXCELL_FIELDSIZE(type);
+        // A string that shares a prefix starts with the number of bytes
+        // it takes from the prefix
+        bool prefixed = INDEXCELL_ISSHARED(type) && size > 0;
+        int shared = prefixed ? ((data[0] < prefix_len) ? data[0] : prefix_len) : 0;
+        int len = prefixed ? shared + size - 1 : size;
+        if(i < INDEXCELL_MAXCOLS && used + (INDEXCELL_ISTEXT(type) ? len : 0) <= INDEXCELL_MAXTEXT) {
+            BTreeKeyCol *col = &cell->key_cols[cell->key_ncols++];
+            if(INDEXCELL_ISTEXT(type)) {
+                col->type = INDEXKEY_TEXT;
+                col->off = used;
+                col->len = len;
+                if(prefixed) {
+                    if(shared > 0)
+                        memcpy(cell->key_str + used, prefix, shared);
+                    memcpy(cell->key_str + used + shared, data + 1, size - 1);
+                } else {
+                    memcpy(cell->key_str + used, data, size);
+                }
+                used += len;
+            } else {
+                col->type = (type == SQL_NULL) ? INDEXKEY_NULL : INDEXKEY_INT;
+                col->value = chidb_Btree_getIndexInt(data, type);
+            }
+        }
+        data += size;
+    }
+    if(cell->key_ncols > 0 && cell->key_cols[0].type == INDEXKEY_INT)
+        cell->key = cell->key_cols[0].value;
+    *keyPk = chidb_Btree_getIndexInt(data, p[1 + ncols]);
+}
+
+
+/* Primary key of an index cell */
+static key_t chidb_Btree_indexPk(BTreeCell *cell)
+{
+    if(cell->type == PGTYPE_INDEX_INTERNAL)
+        return cell->fields.indexInternal.keyPk;
+    return cell->fields.indexLeaf.keyPk;
+}
+
+
+/* Key of a cell, without loading the rest of the cell */
+static key_t chidb_Btree_cellKey(BTreeNode *btn, ncell_t ncell)
+{
+    if(btn->has_keys)
+        return btn->keys[ncell];
+
+    uint8_t *cell_ptr = btn->page->data + get2byte(btn->celloffset_array + (2 * ncell));
+    key_t key;
+    switch(btn->type) {
+        case 0x05:
+            getVarint64(cell_ptr + TABLEINTCELL_KEY_OFFSET, &key);
+            break;
+        case 0x0d:
+        {
+            uint32_t size;
+            getVarint64(cell_ptr + GETVARINT32(cell_ptr, size), &key);
+            break;
+        }
+        default:
+        {
+            // The first field of the record, which starts at the type
+            // after its header size
+            uint8_t *types = cell_ptr + ((btn->type == 0x02) ? INDEXINTCELL_TYPEIDX_OFFSET : INDEXLEAFCELL_TYPEIDX_OFFSET);
+            key = chidb_Btree_getIndexInt(types - 1 + types[-1], types[0]);
+            break;
+        }
+    }
+
+    return key;
+}
+
+
+/* Find the first cell with a key >= key (or > key, if strict), or
+ * n_cells if there is none. The cells of a node are sorted by key, so
+ * this is a binary search. */
+static ncell_t chidb_Btree_searchCell(BTreeNode *btn, key_t key, bool strict)
+{
+    ncell_t lo = 0, hi = btn->n_cells;
+
+    while(lo < hi) {
+        ncell_t mid = lo + (hi - lo) / 2;
+        key_t k = chidb_Btree_cellKey(btn, mid);
+        if(k < key || (strict && k == key))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+
+/* Find the first cell of an index node that comes after key in index
+ * order (see chidb_Btree_compareIndex), or that is equal to it if not
+ * strict, or n_cells if there is none. If pk is false, only the
+ * indexed keys are compared. This is a binary search, which reads the
+ * keys from the page itself (the keys of a node are not kept for index
+ * nodes, since they may be strings). */
+static ncell_t chidb_Btree_searchIndexCell(BTreeNode *btn, BTreeCell *key, bool pk, bool strict)
+{
+    ncell_t lo = 0, hi = btn->n_cells;
+    BTreeCell cell;
+
+    while(lo < hi) {
+        ncell_t mid = lo + (hi - lo) / 2;
+        chidb_Btree_getCell(btn, mid, &cell);
+        int cmp = chidb_Btree_compareIndex(&cell, key, pk);
+        if(cmp < 0 || (strict && cmp == 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+
+/* Fill in the keys of a node that was just loaded
+ *
+ * The keys are copied from the decoded node kept by the pager, or
+ * read from the cells, in which case a new decoded node is handed to
+ * the pager. Nodes whose cells do not fit in their page (i.e., pages
+ * that are not B-Tree nodes) are left without keys.
+ */
+static void chidb_Btree_decodeKeys(BTree *bt, BTreeNode *btn, BTreeNodeDecoded *dec)
+{
+    uint16_t page_size = bt->pager->page_size;
+    uint16_t type_offset = (btn->type == 0x02) ? INDEXINTCELL_TYPEIDX_OFFSET : INDEXLEAFCELL_TYPEIDX_OFFSET;
+
+    if(btn->type != 0x05 && btn->type != 0x0d && btn->type != 0x02 && btn->type != 0x0a)
+        return;
+    if(btn->celloffset_array + 2 * btn->n_cells > btn->page->data + page_size)
+        return;
+    if(btn->keys_size < btn->n_cells) {
+        key_t *keys = realloc(btn->keys, btn->n_cells * sizeof(key_t));
+        if(keys == NULL)
+            return;
+        btn->keys = keys;
+        btn->keys_size = btn->n_cells;
+    }
+
+    if(dec != NULL) {
+        if(btn->n_cells > 0)
+            memcpy(btn->keys, dec->keys, btn->n_cells * sizeof(key_t));
+        btn->has_keys = true;
+        return;
+    }
+
+    for(ncell_t i = 0; i < btn->n_cells; i++) {
+        uint32_t start = get2byte(btn->celloffset_array + (2 * i));
+        uint32_t end = start + type_offset;
+        // The key of an index cell is the first field after its header,
+        // and is as long as its type says. The key of a table cell is the
+        // varint after the child page or the data size, and ends wherever
+        // that varint does
+        if((btn->type == 0x02 || btn->type == 0x0a) && end < page_size)
+            end += btn->page->data[end - 1] - 1 + INDEXCELL_FIELDSIZE(btn->page->data[end]);
+        else if(btn->type == 0x05)
+            end = chidb_Btree_skipVarint(btn->page->data, start + TABLEINTCELL_KEY_OFFSET, page_size);
+        else if(btn->type == 0x0d && (end = chidb_Btree_skipVarint(btn->page->data, start, page_size)) != 0)
+            end = chidb_Btree_skipVarint(btn->page->data, end, page_size);
+        if(end == 0 || end > page_size)
+            return;
+        btn->keys[i] = chidb_Btree_cellKey(btn, i);
+    }
+    btn->has_keys = true;
+
+    dec = malloc(sizeof(BTreeNodeDecoded) + btn->n_cells * sizeof(key_t));
+    if(dec == NULL)
+        return;
+    dec->type = btn->type;
+    dec->free_offset = btn->free_offset;
+    dec->n_cells = btn->n_cells;
+    dec->cells_offset = btn->cells_offset;
+    dec->right_page = btn->right_page;
+    if(btn->n_cells > 0)
+        memcpy(dec->keys, btn->keys, btn->n_cells * sizeof(key_t));
+    chidb_Pager_setDecoded(bt->pager, btn->page->npage, dec);
+}
+
+
 /* Loads a B-Tree node from disk
  * 
  * Reads a B-Tree node from a page in the disk. All the information regarding
@@ -206,6 +614,10 @@ int chidb_Btree_close(BTree *bt)
  * Any changes made to a BTreeNode variable will not be effective in the database
  * until chidb_Btree_writeNode is called on that BTreeNode.
  * 
+ * The header and the keys of a node whose page is in the page cache are
+ * decoded only once, and kept by the pager next to the page (see
+ * chidb_Pager_getDecoded) until the page is written.
+ * 
  * Parameters
  * - bt: B-Tree file
  * - npage: Page of node to load
@@ -216,26 +628,38 @@ int chidb_Btree_close(BTree *bt)
  * - CHIDB_EPAGENO: The provided page number is not valid
  * - CHIDB_ENOMEM: Could not allocate memory
  * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ * - CHIDB_ECHECKSUM: The page does not match its checksum
  */
 int chidb_Btree_getNodeByPage(BTree *bt, npage_t npage, BTreeNode **btn)
 {
     // Read page from memory
-    *btn = calloc(1, sizeof(BTreeNode));
+    *btn = chidb_Btree_allocNode(bt);
     if (*btn == NULL)
         return CHIDB_ENOMEM;
     MemPage *page;
     int err = chidb_Pager_readPage(bt->pager, npage, &page);
-    if (err == CHIDB_EPAGENO || err == CHIDB_ENOMEM)
+    if (err == CHIDB_EPAGENO || err == CHIDB_ENOMEM || err == CHIDB_ECHECKSUM)
         return err;
 
-    // Determine offset and load fields
+    // Load fields, from the decoded node if the pager has one
+    BTreeNodeDecoded *dec;
+    bool cached = chidb_Pager_getDecoded(bt->pager, npage, (void **) &dec) == CHIDB_OK;
     int offset = (page->npage == 1) ? 100 : 0;
-    (*btn)->type = *(page->data + offset);
-    (*btn)->free_offset = get2byte(page->data + 1 + offset);
-    (*btn)->n_cells = get2byte(page->data + 3 + offset);
-    (*btn)->cells_offset = get2byte(page->data + 5 + offset);
+    if (dec != NULL) {
+        (*btn)->type = dec->type;
+        (*btn)->free_offset = dec->free_offset;
+        (*btn)->n_cells = dec->n_cells;
+        (*btn)->cells_offset = dec->cells_offset;
+        (*btn)->right_page = dec->right_page;
+    } else {
+        (*btn)->type = *(page->data + offset);
+        (*btn)->free_offset = get2byte(page->data + 1 + offset);
+        (*btn)->n_cells = get2byte(page->data + 3 + offset);
+        (*btn)->cells_offset = get2byte(page->data + 5 + offset);
+        if((*btn)->type == 0x05 || (*btn)->type == 0x02)
+            (*btn)->right_page = get4byte(page->data + 8 + offset);
+    }
     if((*btn)->type == 0x05 || (*btn)->type == 0x02) {
-        (*btn)->right_page = get4byte(page->data + 8 + offset);
         (*btn)->celloffset_array = page->data + 12 + offset;
     } else {
         (*btn)->celloffset_array = page->data + 8 + offset;
@@ -243,6 +667,18 @@ int chidb_Btree_getNodeByPage(BTree *bt, npage_t npage, BTreeNode **btn)
 
     (*btn)->page = page;
 
+    // Only index leaves have a prefix, above their cells
+    uint8_t prefix_len = page->data[offset + PGHEADER_PREFIX_OFFSET];
+    if((*btn)->type != PGTYPE_INDEX_LEAF || prefix_len > INDEXCELL_MAXTEXT || (*btn)->cells_offset + prefix_len > bt->pager->usable_size)
+        prefix_len = 0;
+    (*btn)->prefix = page->data + bt->pager->usable_size - prefix_len;
+    (*btn)->prefix_len = prefix_len;
+
+	// Pages modified by the current transaction are not decoded, since
+	// they are likely to be modified again
+	if (cached)
+		chidb_Btree_decodeKeys(bt, *btn, dec);
+
 	return CHIDB_OK;
 }
 
@@ -262,8 +698,15 @@ int chidb_Btree_getNodeByPage(BTree *bt, npage_t npage, BTreeNode **btn)
  */
 int chidb_Btree_freeMemNode(BTree *bt, BTreeNode *btn)
 {
-    chidb_Pager_releaseMemPage(bt->pager, btn->page);
-    free(btn);
+    // A node whose page could not be read has no page
+    if(btn->page != NULL)
+        chidb_Pager_releaseMemPage(bt->pager, btn->page);
+    if(bt->n_node_pool < NODE_POOL_SIZE) {
+        bt->node_pool[bt->n_node_pool++] = btn;
+    } else {
+        free(btn->keys);
+        free(btn);
+    }
 	return CHIDB_OK;
 }
 
@@ -312,13 +755,15 @@ int chidb_Btree_newNode(BTree *bt, npage_t *npage, uint8_t type)
 int chidb_Btree_initEmptyNode(BTree *bt, npage_t npage, uint8_t type)
 {
    // Allocate new node and page
-   struct BTreeNode *node = calloc(1, sizeof(struct BTreeNode));
-   if(node == NULL)
-       return CHIDB_ENOMEM;
    MemPage *page;
    int err = chidb_Pager_readPage(bt->pager, npage, &page);
-   if (err == CHIDB_EPAGENO || err == CHIDB_ENOMEM)
+   if (err == CHIDB_EPAGENO || err == CHIDB_ENOMEM || err == CHIDB_ECHECKSUM)
         return err;
+   struct BTreeNode *node = chidb_Btree_allocNode(bt);
+   if(node == NULL) {
+       chidb_Pager_releaseMemPage(bt->pager, page);
+       return CHIDB_ENOMEM;
+   }
    node->page = page;
    node->type = type;
 
@@ -335,7 +780,7 @@ int chidb_Btree_initEmptyNode(BTree *bt, npage_t npage, uint8_t type)
            break;
    }
    node->n_cells = (uint16_t) 0;
-   node->cells_offset = (uint16_t) DEFAULT_PAGE_SIZE;
+   node->cells_offset = (uint16_t) bt->pager->usable_size;
 
   if (type == 0x02 || type == 0x05) {
        node->celloffset_array = (uint8_t *) node + 12; 
@@ -344,10 +789,9 @@ int chidb_Btree_initEmptyNode(BTree *bt, npage_t npage, uint8_t type)
    }
 
    err = chidb_Btree_writeNode(bt, node);
-   if(err != CHIDB_OK)
-       return err;
+   chidb_Btree_freeMemNode(bt, node);
 
-   return CHIDB_OK;
+   return err;
 }
 
 
@@ -376,7 +820,7 @@ int chidb_Btree_writeNode(BTree *bt, BTreeNode *btn)
     put2byte(btn->page->data + offset + 1, btn->free_offset);
     put2byte(btn->page->data + offset + 3, btn->n_cells);
     put2byte(btn->page->data + offset + 5, btn->cells_offset);
-    *(btn->page->data + offset + 7) = 0;
+    *(btn->page->data + offset + PGHEADER_PREFIX_OFFSET) = btn->prefix_len;
     if(btn->type == 0x02 || btn->type == 0x05)
         put4byte(btn->page->data + offset + 8, btn->right_page);
 
@@ -386,6 +830,22 @@ int chidb_Btree_writeNode(BTree *bt, BTreeNode *btn)
 }
 
 
+/* Number of bytes of data that a table leaf cell keeps in its page (see
+ * TABLELEAFCELL_MAXLOCAL). Nodes do not know the size of their page, but
+ * B-Tree files always use DEFAULT_PAGE_SIZE. */
+static uint32_t chidb_Btree_localSize(uint32_t size)
+{
+    uint32_t maxlocal = TABLELEAFCELL_MAXLOCAL(DEFAULT_PAGE_SIZE);
+    uint32_t minlocal = TABLELEAFCELL_MINLOCAL(DEFAULT_PAGE_SIZE);
+    uint32_t local;
+
+    if(size <= maxlocal)
+        return size;
+    local = minlocal + (size - minlocal) % (DEFAULT_PAGE_SIZE - OVERFLOWPG_DATA_OFFSET);
+    return (local <= maxlocal) ? local : minlocal;
+}
+
+
 /* Read the contents of a cell
  * 
  * Reads the contents of a cell from a BTreeNode and stores them in a BTreeCell.
@@ -415,24 +875,27 @@ int chidb_Btree_getCell(BTreeNode *btn, ncell_t ncell, BTreeCell *cell)
 
     // Load fields
 	cell->type = btn->type;
+	cell->key_ncols = 0;
 	switch(cell->type) {
 		case 0x05: // Internal Table Page
-            getVarint32((const uint8_t *)(cell_ptr + 4), (uint32_t *)&(cell->key));
+            getVarint64((const uint8_t *)(cell_ptr + TABLEINTCELL_KEY_OFFSET), &(cell->key));
             cell->fields.tableInternal.child_page = get4byte(cell_ptr);
 			break;
 		case 0x0d: // Leaf Table Page
-            getVarint32((const uint8_t *)(cell_ptr + 4), (uint32_t *)&(cell->key));
-            getVarint32((const uint8_t *)(cell_ptr), (uint32_t *)&(cell->fields.tableLeaf.data_size));
-			cell->fields.tableLeaf.data = cell_ptr + 8;
+        {
+            int header_size = GETVARINT32(cell_ptr, cell->fields.tableLeaf.data_size);
+            header_size += getVarint64((const uint8_t *)(cell_ptr + header_size), &(cell->key));
+			cell->fields.tableLeaf.data = cell_ptr + header_size;
+            uint32_t local = chidb_Btree_localSize(cell->fields.tableLeaf.data_size);
+            cell->fields.tableLeaf.overflow_page = (local < cell->fields.tableLeaf.data_size) ? get4byte(cell->fields.tableLeaf.data + local) : 0;
 			break;
+        }
 		case 0x02: // Internal Index Page
-            cell->key = get4byte(cell_ptr + 8);
-			cell->fields.indexInternal.keyPk = get4byte(cell_ptr + 12);
+            chidb_Btree_getIndexRecord(cell_ptr + INDEXINTCELL_TYPEIDX_OFFSET - 1, cell, &(cell->fields.indexInternal.keyPk), NULL, 0);
             cell->fields.indexInternal.child_page = get4byte(cell_ptr);
 			break;
 		case 0x0a: // Leaf Index Page
-            cell->key = get4byte(cell_ptr + 4);
-			cell->fields.indexLeaf.keyPk = get4byte(cell_ptr + 8);
+            chidb_Btree_getIndexRecord(cell_ptr + INDEXLEAFCELL_TYPEIDX_OFFSET - 1, cell, &(cell->fields.indexLeaf.keyPk), btn->prefix, btn->prefix_len);
 			break;
 	}
 
@@ -440,6 +903,42 @@ int chidb_Btree_getCell(BTreeNode *btn, ncell_t ncell, BTreeCell *cell)
 }
 
 
+/* Prefetch the children of an internal node
+ *
+ * Tells the pager that the child pages starting at cell number first
+ * will be read soon (see chidb_Pager_prefetch). The right page counts
+ * as cell number n_cells. At most READAHEAD_PAGES children are
+ * prefetched, so a scan should call this again every READAHEAD_PAGES
+ * children. Does nothing on a leaf node.
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - btn: BTreeNode of an internal node
+ * - first: Number of the first cell whose child is needed
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_prefetchChildren(BTree *bt, BTreeNode *btn, ncell_t first)
+{
+    npage_t pages[READAHEAD_PAGES];
+    int n = 0;
+
+    if(btn->type != PGTYPE_TABLE_INTERNAL && btn->type != PGTYPE_INDEX_INTERNAL)
+        return CHIDB_OK;
+
+    // Both kinds of internal cell start with the child page number
+    for(ncell_t i = first; i < btn->n_cells && n < READAHEAD_PAGES; i++)
+        pages[n++] = get4byte(btn->page->data + get2byte(btn->celloffset_array + (2 * i)));
+    if(n < READAHEAD_PAGES && first <= btn->n_cells && btn->right_page != 0)
+        pages[n++] = btn->right_page;
+
+    return chidb_Pager_prefetch(bt->pager, pages, n);
+}
+
+
 /* Insert a new cell into a B-Tree node
  * 
  * Inserts a new cell into a B-Tree node at a specified position ncell.
@@ -452,7 +951,11 @@ int chidb_Btree_getCell(BTreeNode *btn, ncell_t ncell, BTreeCell *cell)
  *		 are shifted one position forward in the array. Then, set the value of
  *		 position ncell to be the offset of the newly added cell.
  *
- * This function assumes that there is enough space for this cell in this node.
+ * In an index leaf, the first column of the key is stored without the
+ * bytes it shares with the prefix of the leaf, if any.
+ *
+ * This function assumes that there is enough space for this cell in this node
+ * (chidb_Btree_cellSize bytes, plus its entry in the cell offset array).
  *	
  * Parameters
  * - btn: BTreeNode to insert cell in
@@ -466,45 +969,40 @@ int chidb_Btree_getCell(BTreeNode *btn, ncell_t ncell, BTreeCell *cell)
 int chidb_Btree_insertCell(BTreeNode *btn, ncell_t ncell, BTreeCell *cell)
 {
     // Create a data array and assemble the new cell there
-	int cellsize;
-	uint8_t data[16];
+	int cellsize = chidb_Btree_cellSize(cell);
+	int header_size = 0;
+	uint8_t data[INDEXINTCELL_MAXSIZE];
+	uint32_t local = 0;
 	switch(cell->type) {
 		case 0x05: // Internal Table Page
-			cellsize = 8;
             put4byte(data, cell->fields.tableInternal.child_page);
-            putVarint32(data + 4, cell->key);
+            putVarint64(data + TABLEINTCELL_KEY_OFFSET, cell->key);
 			break;
 		case 0x0d: // Leaf Table Page
-			cellsize = 8 + cell->fields.tableLeaf.data_size;
-            putVarint32(data, cell->fields.tableLeaf.data_size);
-            putVarint32(data + 4, cell->key);
+			local = chidb_Btree_localSize(cell->fields.tableLeaf.data_size);
+            header_size = putVarint32(data, cell->fields.tableLeaf.data_size);
+            header_size += putVarint64(data + header_size, cell->key);
 			break;
 		case 0x02: // Internal Index Page
-			cellsize = 16;
             put4byte(data, cell->fields.indexInternal.child_page);
-			data[4] = 0x0b;
-			data[5] = 0x03;
-			data[6] = 0x04;
-			data[7] = 0x04;
-            put4byte(data + 8, cell->key);
-            put4byte(data + 12, cell->fields.indexInternal.keyPk);
+            chidb_Btree_putIndexRecord(data + 4, cell, cell->fields.indexInternal.keyPk, 0);
 			break;
 		case 0x0a: // Leaf Index Page
-			cellsize = 12;
-			data[0] = 0x0b;
-			data[1] = 0x03;
-			data[2] = 0x04;
-			data[3] = 0x04;
-            put4byte(data + 4, cell->key);
-            put4byte(data + 8, cell->fields.indexLeaf.keyPk);
+            // The cell shrinks if it shares the prefix of the leaf
+            cellsize = chidb_Btree_putIndexRecord(data, cell, cell->fields.indexLeaf.keyPk,
+                                                  chidb_Btree_sharedPrefix(cell, btn->prefix, btn->prefix_len));
 			break;
 	}
 
     // Store the new cell in the actual mempage
     uint16_t cell_start = btn->cells_offset - cellsize;
-    memcpy(btn->page->data + cell_start, data, cellsize);
     if(cell->type == 0x0d) {
-        memcpy(btn->page->data + cell_start + 8, cell->fields.tableLeaf.data, cell->fields.tableLeaf.data_size);
+        memcpy(btn->page->data + cell_start, data, header_size);
+        memcpy(btn->page->data + cell_start + header_size, cell->fields.tableLeaf.data, local);
+        if(local < cell->fields.tableLeaf.data_size)
+            put4byte(btn->page->data + cell_start + header_size + local, cell->fields.tableLeaf.overflow_page);
+    } else {
+        memcpy(btn->page->data + cell_start, data, cellsize);
     }
 
     // Update other necessary data
@@ -516,138 +1014,583 @@ int chidb_Btree_insertCell(BTreeNode *btn, ncell_t ncell, BTreeCell *cell)
     btn->free_offset += sizeof(uint16_t);
     put2byte(&(btn->celloffset_array[ncell*2]), btn->cells_offset);
     btn->n_cells++;
+    btn->has_keys = false;
 
 	return CHIDB_OK;
 }
 
 
-/* Find an entry in a table B-Tree
- * 
- * Finds the data associated for a given key in a table B-Tree
- * 
+/* Size of a cell
+ *
+ * Returns the number of bytes that a cell takes up in the cell area
+ * of a page (not including its entry in the cell offset array). An
+ * index leaf cell may take up less, if it shares the prefix of its
+ * leaf (see chidb_Btree_insertCell).
+ *
  * Parameters
- * - bt: B-Tree file
- * - nroot: Page number of the root node of the B-Tree we want search in
- * - key: Entry key
- * - data: Out-parameter where a copy of the data must be stored
- * - size: Number of bytes of data
- * 
+ * - cell: BTreeCell
+ *
  * Return
- * - CHIDB_OK: Operation successful
- * - CHIDB_ENOTFOUND: No entry with the given key was found
- * - CHIDB_ENOMEM: Could not allocate memory
- * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ * - Size of the cell in bytes
  */
-int chidb_Btree_find(BTree *bt, npage_t nroot, key_t key, 
-		     uint8_t **data, uint16_t *size) {
-	// Get root node
-	BTreeNode *btn;
-	int err;
-	err = chidb_Btree_getNodeByPage(bt, nroot, &btn);
-	if(err != CHIDB_OK)
-		return err;
+uint16_t chidb_Btree_cellSize(BTreeCell *cell)
+{
+    switch(cell->type) {
+        case PGTYPE_TABLE_INTERNAL:
+            return TABLEINTCELL_KEY_OFFSET + varintLen64(cell->key);
+        case PGTYPE_TABLE_LEAF:
+        {
+            uint32_t local = chidb_Btree_localSize(cell->fields.tableLeaf.data_size);
+            return varintLen64(cell->fields.tableLeaf.data_size) + varintLen64(cell->key) + local +
+                   ((local < cell->fields.tableLeaf.data_size) ? TABLELEAFCELL_OVERFLOW_SIZE : 0);
+        }
+        case PGTYPE_INDEX_INTERNAL:
+            return INDEXINTCELL_SIZE_OFFSET + 1 + chidb_Btree_indexRecordSize(cell, cell->fields.indexInternal.keyPk, 0);
+        case PGTYPE_INDEX_LEAF:
+            return INDEXLEAFCELL_SIZE_OFFSET + 1 + chidb_Btree_indexRecordSize(cell, cell->fields.indexLeaf.keyPk, 0);
+    }
+    return 0;
+}
 
-	// Recursively search through the tree
-	BTreeCell *cell = malloc(sizeof(BTreeCell));
-    err = CHIDB_ENOTFOUND;
-	for(int i = 0; i <= btn->n_cells; i++) {
-		chidb_Btree_getCell(btn, (ncell_t) i, cell);
-		switch(cell->type) {
-			case 0x05: // Table internal
-                if(i != btn->n_cells) {
-			    	if(cell->key >= key) {
-                        err = chidb_Btree_find(bt, cell->fields.tableInternal.child_page, key, data, size);
-			    	}
-                } else {
-    				// Go to right table page if all other child pages have been exhausted
-    				err = chidb_Btree_find(bt, btn->right_page, key, data, size);
-                }
-				break;
-			case 0x0d: // Table leaf
-				if(cell->key == key) {
-                    *data = calloc(cell->fields.tableLeaf.data_size, sizeof(char));
-                    memcpy(*data, cell->fields.tableLeaf.data, cell->fields.tableLeaf.data_size);
-                    memcpy(size, &(cell->fields.tableLeaf.data_size), sizeof(uint16_t));
-                    err = CHIDB_OK;
-				}
-				break;
-			case 0x02: // Index internal
-			case 0x0a: // Index leaf
-                // Code is implemented in testing suite, not needed as part of Project 1
-				break;
-		}
-        if (!err)
-            break;
-	}
-    free(cell);
-    chidb_Btree_freeMemNode(bt, btn);
 
-	// Return result
-	return err;
+/* Number of bytes that a cell of a node takes up in its page. This is
+ * chidb_Btree_cellSize of the cell, unless its fields were written with
+ * more bytes than needed (as in files written when varints were always
+ * padded to four bytes, and index keys always took four bytes) */
+static uint16_t chidb_Btree_storedCellSize(BTreeNode *btn, ncell_t ncell)
+{
+    uint8_t *cell_ptr = btn->page->data + get2byte(btn->celloffset_array + (2 * ncell));
+    BTreeCell cell;
+    key_t key;
+
+    chidb_Btree_getCell(btn, ncell, &cell);
+    if(cell.type == PGTYPE_TABLE_INTERNAL)
+        return TABLEINTCELL_KEY_OFFSET + getVarint64(cell_ptr + TABLEINTCELL_KEY_OFFSET, &key);
+    if(cell.type == PGTYPE_TABLE_LEAF)
+        return (cell.fields.tableLeaf.data - cell_ptr) + chidb_Btree_cellSize(&cell) -
+               varintLen64(cell.fields.tableLeaf.data_size) - varintLen64(cell.key);
+    if(cell.type == PGTYPE_INDEX_INTERNAL)
+        return INDEXINTCELL_SIZE_OFFSET + 1 + cell_ptr[INDEXINTCELL_SIZE_OFFSET];
+
+    return 1 + cell_ptr[INDEXLEAFCELL_SIZE_OFFSET];
 }
 
 
-	
-/* Insert an entry into a table B-Tree
+/* Remove a cell from a B-Tree node
  *
- * This is a convenience function that wraps around chidb_Btree_insert.
- * It takes a key and data, and creates a BTreeCell that can be passed
- * along to chidb_Btree_insert.
+ * Removes the cell at position ncell from a B-Tree node. This is the
+ * inverse of chidb_Btree_insertCell:
+ *	1. The cells stored above the removed cell in the cell area are
+ *		 moved down to fill the hole, and cells_offset is updated. This
+ *		 keeps the free space in the node contiguous.
+ *	2. The cell offset array is updated to reflect the moved cells, and
+ *		 all values in positions > ncell are shifted one position back.
  *
  * Parameters
- * - bt: B-Tree file
- * - nroot: Page number of the root node of the B-Tree we want to insert
- *					this entry in.
- * - key: Entry key
- * - data: Pointer to data we want to insert
- * - size: Number of bytes of data
+ * - btn: BTreeNode to remove the cell from
+ * - ncell: Cell number
  *
  * Return
  * - CHIDB_OK: Operation successful
- * - CHIDB_EDUPLICATE: An entry with that key already exists
- * - CHIDB_ENOMEM: Could not allocate memory
- * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ * - CHIDB_ECELLNO: The provided cell number is invalid
  */
-int chidb_Btree_insertInTable(BTree *bt, npage_t nroot, key_t key, 
-			      uint8_t *data, uint16_t size)
+int chidb_Btree_removeCell(BTreeNode *btn, ncell_t ncell)
 {
-	BTreeCell *cell = malloc(sizeof(BTreeCell));
-	cell->type = 0x0d;
-	cell->key = key;
-	cell->fields.tableLeaf.data_size = size;
-	cell->fields.tableLeaf.data = data;
-	
-    int err = chidb_Btree_insert(bt, nroot, cell);
-    free(cell);
+    if(ncell >= btn->n_cells)
+        return CHIDB_ECELLNO;
 
-    return err;
+    uint16_t cellsize = chidb_Btree_storedCellSize(btn, ncell);
+    uint16_t cell_offset = get2byte(btn->celloffset_array + (2 * ncell));
+
+    // Close the hole left by the cell
+    memmove(btn->page->data + btn->cells_offset + cellsize,
+            btn->page->data + btn->cells_offset,
+            cell_offset - btn->cells_offset);
+    btn->cells_offset += cellsize;
+
+    // Fix the offsets of the cells that were moved, and drop the removed one
+    for(int i = 0; i < btn->n_cells; i++) {
+        uint16_t offset = get2byte(btn->celloffset_array + (2 * i));
+        if(offset < cell_offset)
+            put2byte(btn->celloffset_array + (2 * i), offset + cellsize);
+    }
+    memmove(btn->celloffset_array + (2 * ncell),
+            btn->celloffset_array + (2 * (ncell + 1)),
+            2 * (btn->n_cells - ncell - 1));
+    btn->free_offset -= sizeof(uint16_t);
+    btn->n_cells--;
+    btn->has_keys = false;
+
+    return CHIDB_OK;
 }
 
 
-/* Insert an entry into an index B-Tree
+/* Write the data of a table leaf cell that does not fit in the cell
  *
- * This is a convenience function that wraps around chidb_Btree_insert.
- * It takes a KeyIdx and a KeyPk, and creates a BTreeCell that can be passed
- * along to chidb_Btree_insert.
+ * Stores the part of the data that follows the local prefix (see
+ * TABLELEAFCELL_MAXLOCAL) in a chain of newly allocated overflow pages.
  *
  * Parameters
  * - bt: B-Tree file
- * - nroot: Page number of the root node of the B-Tree we want to insert
- *					this entry in.
- * - keyIdx: See The chidb File Format.
- * - keyPk: See The chidb File Format.
+ * - data: Data of the cell
+ * - size: Number of bytes of data (must be larger than TABLELEAFCELL_MAXLOCAL)
+ * - npage: Out parameter. Used to return the first overflow page.
  *
  * Return
  * - CHIDB_OK: Operation successful
- * - CHIDB_EDUPLICATE: An entry with that key already exists
  * - CHIDB_ENOMEM: Could not allocate memory
  * - CHIDB_EIO: An I/O error has occurred when accessing the file
  */
-int chidb_Btree_insertInIndex(BTree *bt, npage_t nroot, key_t keyIdx, key_t keyPk)
+static int chidb_Btree_writeOverflow(BTree *bt, uint8_t *data, uint32_t size, npage_t *npage)
 {
-	BTreeCell *cell = malloc(sizeof(BTreeCell));
-	cell->type = 0x0a;
-	cell->key = keyIdx;
+    int err;
+    MemPage *page;
+    uint32_t offset = chidb_Btree_localSize(size);
+    uint32_t capacity = bt->pager->usable_size - OVERFLOWPG_DATA_OFFSET;
+    npage_t current, next;
+
+    err = chidb_Pager_allocatePage(bt->pager, &current);
+    if(err != CHIDB_OK)
+        return err;
+    *npage = current;
+
+    while(offset < size) {
+        uint32_t len = (size - offset < capacity) ? size - offset : capacity;
+        next = 0;
+        if(offset + len < size) {
+            err = chidb_Pager_allocatePage(bt->pager, &next);
+            if(err != CHIDB_OK)
+                return err;
+        }
+        err = chidb_Pager_readPage(bt->pager, current, &page);
+        if(err != CHIDB_OK)
+            return err;
+        put4byte(page->data + OVERFLOWPG_NEXT_OFFSET, next);
+        memcpy(page->data + OVERFLOWPG_DATA_OFFSET, data + offset, len);
+        err = chidb_Pager_writePage(bt->pager, page);
+        chidb_Pager_releaseMemPage(bt->pager, page);
+        if(err != CHIDB_OK)
+            return err;
+        offset += len;
+        current = next;
+    }
+
+    return CHIDB_OK;
+}
+
+/* Return a chain of overflow pages to the freelist */
+static int chidb_Btree_freeOverflow(BTree *bt, npage_t npage)
+{
+    int err;
+    uint8_t buf[4];
+
+    while(npage != 0) {
+        MemPage *page;
+        err = chidb_Pager_readPage(bt->pager, npage, &page);
+        if(err != CHIDB_OK)
+            return err;
+        memcpy(buf, page->data + OVERFLOWPG_NEXT_OFFSET, sizeof(buf));
+        chidb_Pager_releaseMemPage(bt->pager, page);
+        err = chidb_Btree_freePage(bt, npage);
+        if(err != CHIDB_OK)
+            return err;
+        npage = get4byte(buf);
+    }
+
+    return CHIDB_OK;
+}
+
+
+/* Read all the data of a table leaf cell
+ *
+ * Returns a copy of the data of a table leaf cell: the local prefix
+ * stored in the cell and, if the data overflows, the rest of the data
+ * read from its overflow pages.
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - cell: Table leaf cell (as returned by chidb_Btree_getCell)
+ * - data: Out parameter. Used to return a newly allocated copy of the
+ *         data (with cell->fields.tableLeaf.data_size bytes)
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ECORRUPT: The overflow chain is shorter than the data
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_readPayload(BTree *bt, BTreeCell *cell, uint8_t **data)
+{
+    int err;
+    uint32_t size = cell->fields.tableLeaf.data_size;
+    uint32_t offset = chidb_Btree_localSize(size);
+    uint32_t capacity = bt->pager->usable_size - OVERFLOWPG_DATA_OFFSET;
+    npage_t npage = cell->fields.tableLeaf.overflow_page;
+    uint8_t *local = cell->fields.tableLeaf.data;
+
+    /* data may point to the cell's own data field */
+    *data = malloc(size ? size : 1);
+    if(*data == NULL)
+        return CHIDB_ENOMEM;
+    memcpy(*data, local, offset);
+
+    while(offset < size) {
+        MemPage *page;
+        uint32_t len = (size - offset < capacity) ? size - offset : capacity;
+        if(npage == 0) {
+            free(*data);
+            return CHIDB_ECORRUPT;
+        }
+        err = chidb_Pager_readPage(bt->pager, npage, &page);
+        if(err != CHIDB_OK) {
+            free(*data);
+            return err;
+        }
+        memcpy(*data + offset, page->data + OVERFLOWPG_DATA_OFFSET, len);
+        npage = get4byte(page->data + OVERFLOWPG_NEXT_OFFSET);
+        chidb_Pager_releaseMemPage(bt->pager, page);
+        offset += len;
+    }
+
+    return CHIDB_OK;
+}
+
+
+/* Set the indexed key of an index cell to an integer
+ *
+ * Parameters
+ * - cell: BTreeCell of an index B-Tree
+ * - v: Indexed key
+ */
+void chidb_Btree_setIntKey(BTreeCell *cell, key_t v)
+{
+    cell->key_ncols = 0;
+    chidb_Btree_appendIntKey(cell, v);
+}
+
+
+/* Set the indexed key of an index cell to a string
+ *
+ * Only the first INDEXCELL_MAXTEXT bytes of the string are kept (see
+ * btree.h), which is all that an index stores.
+ *
+ * Parameters
+ * - cell: BTreeCell of an index B-Tree
+ * - str: Indexed key (a NUL-terminated string)
+ */
+void chidb_Btree_setTextKey(BTreeCell *cell, const char *str)
+{
+    cell->key_ncols = 0;
+    chidb_Btree_appendTextKey(cell, str);
+}
+
+
+/* Add a column to the indexed key of an index cell
+ *
+ * The key of an index on several columns is built one column at a
+ * time, starting from a cell whose key_ncols is 0. A cell holds at most
+ * INDEXCELL_MAXCOLS columns; any more are ignored. The strings of all
+ * the columns share INDEXCELL_MAXTEXT bytes, so a string only keeps as
+ * much of its start as still fits (see btree.h).
+ *
+ * Parameters
+ * - cell: BTreeCell of an index B-Tree
+ * - v, str: Value of the new column (a NUL-terminated string, for
+ *           chidb_Btree_appendTextKey)
+ */
+void chidb_Btree_appendIntKey(BTreeCell *cell, key_t v)
+{
+    if(cell->key_ncols >= INDEXCELL_MAXCOLS)
+        return;
+    if(cell->key_ncols == 0)
+        cell->key = v;
+    cell->key_cols[cell->key_ncols].type = INDEXKEY_INT;
+    cell->key_cols[cell->key_ncols].value = v;
+    cell->key_ncols++;
+}
+
+void chidb_Btree_appendTextKey(BTreeCell *cell, const char *str)
+{
+    size_t len = strlen(str);
+    uint8_t used = 0;
+
+    if(cell->key_ncols >= INDEXCELL_MAXCOLS)
+        return;
+    for(int i = 0; i < cell->key_ncols; i++)
+        if(cell->key_cols[i].type == INDEXKEY_TEXT)
+            used = cell->key_cols[i].off + cell->key_cols[i].len;
+    if(len > INDEXCELL_MAXTEXT - used)
+        len = INDEXCELL_MAXTEXT - used;
+
+    if(cell->key_ncols == 0)
+        cell->key = 0;
+    cell->key_cols[cell->key_ncols].type = INDEXKEY_TEXT;
+    cell->key_cols[cell->key_ncols].off = used;
+    cell->key_cols[cell->key_ncols].len = len;
+    memcpy(cell->key_str + used, str, len);
+    cell->key_ncols++;
+}
+
+void chidb_Btree_appendNullKey(BTreeCell *cell)
+{
+    if(cell->key_ncols >= INDEXCELL_MAXCOLS)
+        return;
+    if(cell->key_ncols == 0)
+        cell->key = 0;
+    cell->key_cols[cell->key_ncols].type = INDEXKEY_NULL;
+    cell->key_ncols++;
+}
+
+
+/* Compare two entries of an index B-Tree
+ *
+ * Entries are sorted by their indexed key, column by column: NULL goes
+ * first, then integers, in numerical order, and then strings, in memcmp
+ * order (a string that is a prefix of another one goes first). Only the
+ * columns that both keys have are compared, so a key with fewer columns
+ * is equal to all the entries that start with the same columns. Entries
+ * with the same indexed key are sorted by primary key.
+ *
+ * Parameters
+ * - a, b: Index cells (internal or leaf)
+ * - pk: Compare the primary keys too, if the indexed keys are equal
+ *
+ * Return
+ * - A negative number, zero, or a positive number, if a goes before,
+ *   is equal to, or goes after b
+ */
+int chidb_Btree_compareIndex(BTreeCell *a, BTreeCell *b, bool pk)
+{
+    int ncols = (a->key_ncols < b->key_ncols) ? a->key_ncols : b->key_ncols;
+
+    for(int i = 0; i < ncols; i++) {
+        BTreeKeyCol *ca = &a->key_cols[i], *cb = &b->key_cols[i];
+        if(ca->type != cb->type)
+            return (ca->type < cb->type) ? -1 : 1;
+        if(ca->type == INDEXKEY_TEXT) {
+            int cmp = memcmp(a->key_str + ca->off, b->key_str + cb->off, (ca->len < cb->len) ? ca->len : cb->len);
+            if(cmp != 0)
+                return cmp;
+            if(ca->len != cb->len)
+                return (ca->len < cb->len) ? -1 : 1;
+        } else if(ca->type == INDEXKEY_INT && ca->value != cb->value) {
+            return (ca->value < cb->value) ? -1 : 1;
+        }
+    }
+
+    if(!pk || chidb_Btree_indexPk(a) == chidb_Btree_indexPk(b))
+        return 0;
+    return (chidb_Btree_indexPk(a) < chidb_Btree_indexPk(b)) ? -1 : 1;
+}
+
+
+/* Find an entry in an index B-Tree
+ *
+ * Finds the first entry that goes after key in index order (see
+ * chidb_Btree_compareIndex), or the last one that goes before it:
+ * - INDEXSEEK_GE: First entry >= key
+ * - INDEXSEEK_GT: First entry > key
+ * - INDEXSEEK_LE: Last entry <= key
+ * - INDEXSEEK_LT: Last entry < key
+ *
+ * Entries are also stored in the internal nodes of an index B-Tree, so
+ * the closest entry seen in an internal node is kept while going down
+ * the tree, and replaced by any closer one found further down. Each
+ * node is searched with a binary search.
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - nroot: Page number of the root node of the index B-Tree
+ * - key: Index cell to compare the entries with
+ * - pk: Compare the primary keys too (otherwise, only the indexed
+ *       keys are compared, and key->fields are ignored)
+ * - op: One of the INDEXSEEK_* comparisons
+ * - cell: Out parameter. Used to return the entry that was found.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOTFOUND: There is no such entry
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+static npage_t chidb_Btree_childPage(BTreeNode *btn, ncell_t pos);
+
+int chidb_Btree_seekIndex(BTree *bt, npage_t nroot, BTreeCell *key, bool pk, int op, BTreeCell *cell)
+{
+    bool forward = (op == INDEXSEEK_GE || op == INDEXSEEK_GT);
+    bool strict = (op == INDEXSEEK_GT || op == INDEXSEEK_LE);
+    bool found = false;
+    npage_t npage = nroot;
+    int err;
+
+    while(npage != 0) {
+        BTreeNode *btn;
+        err = chidb_Btree_getNodeByPage(bt, npage, &btn);
+        if(err != CHIDB_OK)
+            return err;
+        if(btn->type != PGTYPE_INDEX_INTERNAL && btn->type != PGTYPE_INDEX_LEAF) {
+            chidb_Btree_freeMemNode(bt, btn);
+            return CHIDB_ECORRUPT;
+        }
+
+        // Cells before i go before key (or are equal to it, if strict).
+        // The child page at position i holds the entries in between.
+        ncell_t i = chidb_Btree_searchIndexCell(btn, key, pk, strict);
+        if(forward && i < btn->n_cells) {
+            chidb_Btree_getCell(btn, i, cell);
+            found = true;
+        } else if(!forward && i > 0) {
+            chidb_Btree_getCell(btn, i - 1, cell);
+            found = true;
+        }
+        npage = (btn->type == PGTYPE_INDEX_INTERNAL) ? chidb_Btree_childPage(btn, i) : 0;
+        chidb_Btree_freeMemNode(bt, btn);
+    }
+
+    return found ? CHIDB_OK : CHIDB_ENOTFOUND;
+}
+
+
+/* Find an entry in a table B-Tree
+ * 
+ * Finds the data associated for a given key in a table B-Tree
+ * 
+ * Parameters
+ * - bt: B-Tree file
+ * - nroot: Page number of the root node of the B-Tree we want search in
+ * - key: Entry key
+ * - data: Out-parameter where a copy of the data must be stored
+ * - size: Number of bytes of data
+ * 
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOTFOUND: No entry with the given key was found
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_find(BTree *bt, npage_t nroot, key_t key, 
+		     uint8_t **data, uint32_t *size) {
+	// Get root node
+	BTreeNode *btn;
+	BTreeCell cell;
+	int err;
+	err = chidb_Btree_getNodeByPage(bt, nroot, &btn);
+	if(err != CHIDB_OK)
+		return err;
+
+	// Only internal nodes have a right page. Past the last cell, the
+	// offset array may contain stale offsets left behind by deletions.
+	ncell_t i = chidb_Btree_searchCell(btn, key, false);
+	npage_t child = 0;
+	err = CHIDB_ENOTFOUND;
+	switch(btn->type) {
+		case 0x05: // Table internal
+			// Go to the right page if all other child pages have been exhausted
+			child = btn->right_page;
+			if(i < btn->n_cells) {
+				chidb_Btree_getCell(btn, i, &cell);
+				child = cell.fields.tableInternal.child_page;
+			}
+			break;
+		case 0x0d: // Table leaf
+			if(i < btn->n_cells && chidb_Btree_cellKey(btn, i) == key) {
+				chidb_Btree_getCell(btn, i, &cell);
+				*size = cell.fields.tableLeaf.data_size;
+				err = chidb_Btree_readPayload(bt, &cell, data);
+			}
+			break;
+		case 0x02: // Index internal
+		case 0x0a: // Index leaf
+			// Code is implemented in testing suite, not needed as part of Project 1
+			break;
+	}
+	chidb_Btree_freeMemNode(bt, btn);
+
+	// Recursively search through the tree
+	if(child != 0)
+		err = chidb_Btree_find(bt, child, key, data, size);
+
+	// Return result
+	return err;
+}
+
+
+	
+/* Insert an entry into a table B-Tree
+ *
+ * This is a convenience function that wraps around chidb_Btree_insert.
+ * It takes a key and data, and creates a BTreeCell that can be passed
+ * along to chidb_Btree_insert. If the data is too large to be stored
+ * in a cell, the data after the local prefix is written to overflow
+ * pages first (see TABLELEAFCELL_MAXLOCAL).
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - nroot: Page number of the root node of the B-Tree we want to insert
+ *					this entry in.
+ * - key: Entry key
+ * - data: Pointer to data we want to insert
+ * - size: Number of bytes of data
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EDUPLICATE: An entry with that key already exists
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_insertInTable(BTree *bt, npage_t nroot, key_t key, 
+			      uint8_t *data, uint32_t size)
+{
+	int err;
+	BTreeCell *cell = malloc(sizeof(BTreeCell));
+	cell->type = 0x0d;
+	cell->key = key;
+	cell->fields.tableLeaf.data_size = size;
+	cell->fields.tableLeaf.data = data;
+	cell->fields.tableLeaf.overflow_page = 0;
+
+	// Data that does not fit in the cell goes to overflow pages first
+	if(chidb_Btree_localSize(size) < size) {
+		err = chidb_Btree_writeOverflow(bt, data, size, &cell->fields.tableLeaf.overflow_page);
+		if(err != CHIDB_OK) {
+			free(cell);
+			return err;
+		}
+	}
+	
+	err = chidb_Btree_insert(bt, nroot, cell);
+	if(err != CHIDB_OK && cell->fields.tableLeaf.overflow_page != 0)
+		chidb_Btree_freeOverflow(bt, cell->fields.tableLeaf.overflow_page);
+	free(cell);
+
+	return err;
+}
+
+
+/* Insert an entry into an index B-Tree
+ *
+ * This is a convenience function that wraps around chidb_Btree_insert.
+ * It takes a KeyIdx and a KeyPk, and creates a BTreeCell that can be passed
+ * along to chidb_Btree_insert.
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - nroot: Page number of the root node of the B-Tree we want to insert
+ *					this entry in.
+ * - keyIdx: See The chidb File Format.
+ * - keyPk: See The chidb File Format.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EDUPLICATE: An entry with that key already exists
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_insertInIndex(BTree *bt, npage_t nroot, key_t keyIdx, key_t keyPk)
+{
+	BTreeCell *cell = malloc(sizeof(BTreeCell));
+	cell->type = 0x0a;
+	chidb_Btree_setIntKey(cell, keyIdx);
 	cell->fields.indexLeaf.keyPk = keyPk;
 
 	int err = chidb_Btree_insert(bt, nroot, cell);
@@ -657,6 +1600,47 @@ int chidb_Btree_insertInIndex(BTree *bt, npage_t nroot, key_t keyIdx, key_t keyP
 }
 
 
+/* Insert an entry with a string key into an index B-Tree
+ *
+ * Same as chidb_Btree_insertInIndex, but the indexed key is a string.
+ * Only its first INDEXCELL_MAXTEXT bytes are stored (see btree.h).
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - nroot: Page number of the root node of the B-Tree we want to insert
+ *					this entry in.
+ * - keyIdx: Indexed key (a NUL-terminated string)
+ * - keyPk: See The chidb File Format.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EDUPLICATE: An entry with that key already exists
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_insertInTextIndex(BTree *bt, npage_t nroot, const char *keyIdx, key_t keyPk)
+{
+	BTreeCell cell;
+	cell.type = PGTYPE_INDEX_LEAF;
+	chidb_Btree_setTextKey(&cell, keyIdx);
+	cell.fields.indexLeaf.keyPk = keyPk;
+
+	return chidb_Btree_insert(bt, nroot, &cell);
+}
+
+
+/* Free space (including the entry in the cell offset array) that a node
+ * must have before a cell is inserted into its subtree: room for the new
+ * cell, or, in an internal index node (which may receive any separator
+ * from a child that is split), room for the largest index cell. */
+static uint32_t chidb_Btree_insertSpace(BTreeCell *btc, uint8_t type)
+{
+    if(type == PGTYPE_INDEX_INTERNAL)
+        return sizeof(uint16_t) + INDEXINTCELL_MAXSIZE;
+    return sizeof(uint16_t) + chidb_Btree_cellSize(btc);
+}
+
+
 /* Insert a BTreeCell into a B-Tree
  *
  * The chidb_Btree_insert and chidb_Btree_insertNonFull functions
@@ -665,7 +1649,9 @@ int chidb_Btree_insertInIndex(BTree *bt, npage_t nroot, key_t keyIdx, key_t keyP
  * insertion. chidb_Btree_insert, however, first checks if the root
  * has to be split (a splitting operation that is different from
  * splitting any other node). If so, chidb_Btree_split is called
- * before calling chidb_Btree_insertNonFull.
+ * before calling chidb_Btree_insertNonFull. Inside a transaction (see
+ * chidb_Pager_begin), all the pages written by an insertion are
+ * committed or rolled back together.
  *
  * Parameters
  * - bt: B-Tree file
@@ -689,21 +1675,7 @@ int chidb_Btree_insert(BTree *bt, npage_t nroot, BTreeCell *btc)
     if(err != CHIDB_OK)
         return err;
     uint32_t sizeOfFreeSpace = btn->cells_offset - btn->free_offset;
-    uint32_t sizeOfNewCell;
-    switch(btc->type) {
-        case 0x05: // Table internal
-            sizeOfNewCell = 10; // 8 bytes for cell, 2 for cell offset array entry
-            break;
-        case 0x0d: // Table leaf
-            sizeOfNewCell = 10 + btc->fields.tableLeaf.data_size;
-            break;
-        case 0x02: // Index internal
-            sizeOfNewCell = 18;
-            break;
-        case 0x0a: // Index leaf
-            sizeOfNewCell = 14;
-            break;
-    }
+    uint32_t sizeOfNewCell = chidb_Btree_insertSpace(btc, btn->type);
     
     if((int32_t)sizeOfFreeSpace - (int32_t)sizeOfNewCell >= 0) {
         err = chidb_Btree_insertNonFull(bt, nroot, btc);
@@ -722,8 +1694,10 @@ int chidb_Btree_insert(BTree *bt, npage_t nroot, BTreeCell *btc)
 	BTreeNode *newRootNode;
 	err = chidb_Btree_getNodeByPage(bt, nroot, &newRootNode);
 	newRootNode->free_offset -= (newRootNode->n_cells * 2);
-	newRootNode->cells_offset = DEFAULT_PAGE_SIZE;
+	newRootNode->cells_offset = bt->pager->usable_size;
+	newRootNode->prefix_len = 0;
 	newRootNode->n_cells = 0;
+	newRootNode->has_keys = false;
     if (newRootNode->type == 0x0d) {
         newRootNode->type = 0x05;
         newRootNode->free_offset += 4;
@@ -784,35 +1758,18 @@ int chidb_Btree_insert(BTree *bt, npage_t nroot, BTreeCell *btc)
 int chidb_Btree_insertNonFull(BTree *bt, npage_t npage, BTreeCell *btc)
 {
     // Find the page of the node where the cell is to be inserted
-    BTreeNode *btn = malloc(sizeof(BTreeNode));
+    BTreeNode *btn;
     BTreeCell *cell = malloc(sizeof(BTreeCell));
     int err;
     chidb_Btree_getNodeByPage(bt, npage, &btn);
 
-    // Get the cell size
-    uint32_t btcSize;
-    switch(btc->type) {
-        case 0x05:
-            btcSize = 10;
-            break;
-        case 0x0d:
-            btcSize = 10 + btc->fields.tableLeaf.data_size;
-            break;
-        case 0x02:
-            btcSize = 18;
-            break;
-        case 0x0a:
-            btcSize = 14;
-            break;
-    }
-
     switch(btn->type) {
         case 0x05: // Table internal
         {
             int found = 0;
 
             // Search through all of the children other than the right page
-            for(int i = 0; i < btn->n_cells; i++) {
+            for(int i = chidb_Btree_searchCell(btn, btc->key, false); i < btn->n_cells; i++) {
                 chidb_Btree_getCell(btn, (ncell_t) i, cell);
 
                 // If the cell can be inserted here...
@@ -820,13 +1777,16 @@ int chidb_Btree_insertNonFull(BTree *bt, npage_t npage, BTreeCell *btc)
                     found = 1;
                     BTreeNode *childNode;
                     chidb_Btree_getNodeByPage(bt, cell->fields.tableInternal.child_page, &childNode);
+                    bool full = (int16_t)childNode->cells_offset - (int16_t)childNode->free_offset - (int16_t)chidb_Btree_insertSpace(btc, childNode->type) < 0;
+                    chidb_Btree_freeMemNode(bt, childNode);
 
                     // Determine whether the child node has to be split
-                    if((int16_t)childNode->cells_offset - (int16_t)childNode->free_offset - (int16_t)btcSize < 0) {
+                    if(full) {
                         npage_t childPage;
                         err = chidb_Btree_split(bt, npage, cell->fields.tableInternal.child_page, (ncell_t)i, &childPage);
 
                         // Fix the child page of the old cell
+                        chidb_Btree_freeMemNode(bt, btn);
                         chidb_Btree_getNodeByPage(bt, npage, &btn);
                         uint16_t cell_offset = get2byte(btn->celloffset_array + (2 * (i+1)));
                         uint8_t *cell_ptr = (uint8_t *)(btn->page->data) + cell_offset;
@@ -855,14 +1815,17 @@ int chidb_Btree_insertNonFull(BTree *bt, npage_t npage, BTreeCell *btc)
             if(!found) {
                 BTreeNode *childNode;
                 chidb_Btree_getNodeByPage(bt, btn->right_page, &childNode);
+                bool full = (int16_t)childNode->cells_offset - (int16_t)childNode->free_offset - (int16_t)chidb_Btree_insertSpace(btc, childNode->type) < 0;
+                chidb_Btree_freeMemNode(bt, childNode);
 
                 // Determine whether the child node has to be split
-                if((int16_t)childNode->cells_offset - (int16_t)childNode->free_offset - (int16_t)btcSize < 0) {
+                if(full) {
                     npage_t childPage;
 					npage_t tempRightPage = btn->right_page;
                     err = chidb_Btree_split(bt, npage, btn->right_page, btn->n_cells, &childPage);
 
                     // Fix the child page of the new cell
+                    chidb_Btree_freeMemNode(bt, btn);
                     chidb_Btree_getNodeByPage(bt, npage, &btn);
                     btn->right_page = childPage;
                     err = chidb_Btree_writeNode(bt, btn);
@@ -887,42 +1850,65 @@ int chidb_Btree_insertNonFull(BTree *bt, npage_t npage, BTreeCell *btc)
         case 0x0d: // Table leaf
 		case 0x0a: // Index leaf
         {
-			int i;
-
-            // Find the position where the cell should be inserted
-            for(i = 0; i < btn->n_cells; i++) {
-                chidb_Btree_getCell(btn, (ncell_t) i, cell);
-                if(cell->key > btc->key) {
-                    // Stop searching when found
-                    break;
-                } else if(cell->key == btc->key) {
-                    return CHIDB_EDUPLICATE;
+            // Find the position where the cell should be inserted. Index
+            // entries are only duplicates if their primary keys are equal too
+            ncell_t i;
+            bool duplicate;
+            if(btn->type == 0x0a) {
+                i = chidb_Btree_searchIndexCell(btn, btc, true, false);
+                if((duplicate = (i < btn->n_cells))) {
+                    chidb_Btree_getCell(btn, i, cell);
+                    duplicate = (chidb_Btree_compareIndex(cell, btc, true) == 0);
                 }
-	    	}
-            // Insert the cell
-	    	err = chidb_Btree_insertCell(btn, (ncell_t) i, btc);
+            } else {
+                i = chidb_Btree_searchCell(btn, btc->key, false);
+                duplicate = (i < btn->n_cells && chidb_Btree_cellKey(btn, i) == btc->key);
+            }
+            if(duplicate) {
+                chidb_Btree_freeMemNode(bt, btn);
+                free(cell);
+                return CHIDB_EDUPLICATE;
+            }
+            // Insert the cell. Internal nodes are only written when a
+            // child is split, so that their decoded form stays cached
+	    	err = chidb_Btree_insertCell(btn, i, btc);
+            err = chidb_Btree_writeNode(bt, btn);
            break;
         }
         case 0x02: // Index internal
         {
             int found = 0;
 
+            // The entry may already be in this node
+            ncell_t first = chidb_Btree_searchIndexCell(btn, btc, true, true);
+            if(first > 0) {
+                chidb_Btree_getCell(btn, first - 1, cell);
+                if(chidb_Btree_compareIndex(cell, btc, true) == 0) {
+                    chidb_Btree_freeMemNode(bt, btn);
+                    free(cell);
+                    return CHIDB_EDUPLICATE;
+                }
+            }
+
             // Search through all the children other than the right page
-            for(int i = 0; i < btn->n_cells; i++) {
+            for(int i = first; i < btn->n_cells; i++) {
                 chidb_Btree_getCell(btn, (ncell_t) i, cell);
 
                 // If the cell can be inserted here...
-                if(cell->key > btc->key) {
+                if(chidb_Btree_compareIndex(cell, btc, true) > 0) {
                     found = 1;
                     BTreeNode *childNode;
                     chidb_Btree_getNodeByPage(bt, cell->fields.indexInternal.child_page, &childNode);
+                    bool full = (int16_t)childNode->cells_offset - (int16_t)childNode->free_offset - (int16_t)chidb_Btree_insertSpace(btc, childNode->type) < 0;
+                    chidb_Btree_freeMemNode(bt, childNode);
 
                     // Determine whether the child node has to be split
-                    if((int16_t)childNode->cells_offset - (int16_t)childNode->free_offset - (int16_t)btcSize < 0) {
+                    if(full) {
                         npage_t childPage;
                         err = chidb_Btree_split(bt, npage, cell->fields.indexInternal.child_page, (ncell_t)i, &childPage);
 
                         // Fix the child page of the old cell
+                        chidb_Btree_freeMemNode(bt, btn);
                         chidb_Btree_getNodeByPage(bt, npage, &btn);
                         uint16_t cell_offset = get2byte(btn->celloffset_array + (2 * (i+1)));
                         uint8_t *cell_ptr = (uint8_t *)(btn->page->data) + cell_offset;
@@ -932,7 +1918,7 @@ int chidb_Btree_insertNonFull(BTree *bt, npage_t npage, BTreeCell *btc)
                         chidb_Btree_getCell(btn, i, newCell);
 
                         // Continue with insertion
-                        if(newCell->key > btc->key)
+                        if(chidb_Btree_compareIndex(newCell, btc, true) > 0)
                         	err = chidb_Btree_insertNonFull(bt, cell->fields.indexInternal.child_page, btc);
                         else
                         	err = chidb_Btree_insertNonFull(bt, childPage, btc);
@@ -951,14 +1937,17 @@ int chidb_Btree_insertNonFull(BTree *bt, npage_t npage, BTreeCell *btc)
             if(!found) {
                 BTreeNode *childNode;
                 chidb_Btree_getNodeByPage(bt, btn->right_page, &childNode);
+                bool full = (int16_t)childNode->cells_offset - (int16_t)childNode->free_offset - (int16_t)chidb_Btree_insertSpace(btc, childNode->type) < 0;
+                chidb_Btree_freeMemNode(bt, childNode);
 
                 // Determine whether the child node has to be split
-                if((int16_t)childNode->cells_offset - (int16_t)childNode->free_offset - (int16_t)btcSize < 0) {
+                if(full) {
                     npage_t childPage;
 					npage_t tempRightPage = btn->right_page;
                     err = chidb_Btree_split(bt, npage, btn->right_page, btn->n_cells, &childPage);
 
                     // Fix the child page of the new cell
+                    chidb_Btree_freeMemNode(bt, btn);
                     chidb_Btree_getNodeByPage(bt, npage, &btn);
                     btn->right_page = childPage;
                     err = chidb_Btree_writeNode(bt, btn);
@@ -966,7 +1955,7 @@ int chidb_Btree_insertNonFull(BTree *bt, npage_t npage, BTreeCell *btc)
 					chidb_Btree_getCell(btn, btn->n_cells - 1, newCell);
 
                     // Continue with insertion
-                    if(newCell->key > btc->key)
+                    if(chidb_Btree_compareIndex(newCell, btc, true) > 0)
                       	err = chidb_Btree_insertNonFull(bt, tempRightPage, btc);
                     else
                       	err = chidb_Btree_insertNonFull(bt, childPage, btc);
@@ -981,8 +1970,6 @@ int chidb_Btree_insertNonFull(BTree *bt, npage_t npage, BTreeCell *btc)
         }
 	}
 
-    err = chidb_Btree_writeNode(bt, btn);
-
     chidb_Btree_freeMemNode(bt, btn);
     free(cell);
 
@@ -990,6 +1977,10 @@ int chidb_Btree_insertNonFull(BTree *bt, npage_t npage, BTreeCell *btc)
 }
 
 
+static void chidb_Btree_collectCells(BTreeNode *btn, BTreeCell *cells, int *ncells);
+static uint8_t chidb_Btree_choosePrefix(BTreeCell *cells, int ncells, const uint8_t *old, int old_len, uint8_t *prefix);
+static void chidb_Btree_setPrefix(BTree *bt, BTreeNode *btn, const uint8_t *prefix, uint8_t len);
+
 /* Split a B-Tree node
  *
  * Splits a B-Tree node N. This involves the following:
@@ -1035,8 +2026,8 @@ int chidb_Btree_split(BTree *bt, npage_t npage_parent, npage_t npage_child,
 	leftPage = npage_child;
 	err = chidb_Btree_getNodeByPage(bt, leftPage, &leftNode);
         leftNode->free_offset -= (leftNode->n_cells * 2);
-        leftNode->cells_offset = DEFAULT_PAGE_SIZE;
         leftNode->n_cells = 0;
+        leftNode->has_keys = false;
     
     // Create the new right node
 	npage_t rightPage;
@@ -1049,34 +2040,39 @@ int chidb_Btree_split(BTree *bt, npage_t npage_parent, npage_t npage_child,
     
     *npage_child2 = rightPage;
 
-	// Move cells to new nodes
+	// Move cells to new nodes. Index leaves keep the prefix of the node
+	// being split, unless their cells share a better one, so that the
+	// cells of each half still fit.
+	BTreeCell *cells = malloc(nodeToSplit->n_cells * sizeof(BTreeCell));
+	int ncells = 0;
+	uint8_t prefix[INDEXCELL_MAXTEXT];
+	if(cells == NULL)
+		return CHIDB_ENOMEM;
+	chidb_Btree_collectCells(nodeToSplit, cells, &ncells);
 	int numCellsToMove = (nodeToSplit->type == 0x0d) ? (int)median + 1 : (int)median;
-    BTreeCell *cellToMove = malloc(sizeof(BTreeCell));
+	chidb_Btree_setPrefix(bt, leftNode, prefix, chidb_Btree_choosePrefix(cells, numCellsToMove,
+	                      nodeToSplit->prefix, nodeToSplit->prefix_len, prefix));
 	for(int i = 0; i < numCellsToMove; i++) {
-		err = chidb_Btree_getCell(nodeToSplit, (ncell_t)i, cellToMove);
+		err = chidb_Btree_insertCell(leftNode, (ncell_t)i, &cells[i]);
 		if(err != CHIDB_OK)
 			return err;
-		err = chidb_Btree_insertCell(leftNode, (ncell_t)i, cellToMove);
+	}
+	numCellsToMove += ((nodeToSplit->type == 0x0d) ? 0 : 1);
+	chidb_Btree_setPrefix(bt, rightNode, prefix, chidb_Btree_choosePrefix(cells + numCellsToMove, ncells - numCellsToMove,
+	                      nodeToSplit->prefix, nodeToSplit->prefix_len, prefix));
+	for(int i = numCellsToMove; i < ncells; i++) {
+		err = chidb_Btree_insertCell(rightNode, (ncell_t)(i - numCellsToMove), &cells[i]);
 		if(err != CHIDB_OK)
 			return err;
 	}
-    numCellsToMove += ((nodeToSplit->type == 0x0d) ? 0 : 1);
-    for(int i = numCellsToMove; i < nodeToSplit->n_cells; i++) {
-    	err = chidb_Btree_getCell(nodeToSplit, (ncell_t)i, cellToMove);
-        if(err != CHIDB_OK)
-            return err;
-        err = chidb_Btree_insertCell(rightNode, (ncell_t)(i - numCellsToMove), cellToMove);
-        if(err != CHIDB_OK)
-            return err;
-    }
-    free(cellToMove);
+	free(cells);
 
 	// Add a new cell to the parent
     BTreeNode *parentNode;
     err = chidb_Btree_getNodeByPage(bt, npage_parent, &parentNode);
 
 	BTreeCell *newcell = malloc(sizeof(BTreeCell));
-	newcell->key = middleCell->key;
+	*newcell = *middleCell;
 	newcell->type = parentNode->type;
 	
 	if(parentNode->type == 0x05)
@@ -1119,6 +2115,1247 @@ int chidb_Btree_split(BTree *bt, npage_t npage_parent, npage_t npage_child,
 }
 
 
+/* Size of the page header of a B-Tree node of a given type */
+static uint16_t chidb_Btree_headerSize(uint8_t type)
+{
+    if(type == PGTYPE_TABLE_INTERNAL || type == PGTYPE_INDEX_INTERNAL)
+        return INTPG_CELLSOFFSET_OFFSET;
+    else
+        return LEAFPG_CELLSOFFSET_OFFSET;
+}
+
+/* Space taken up by a list of cells, including the cell offset array */
+static uint32_t chidb_Btree_cellListSize(BTreeCell *cells, int ncells)
+{
+    uint32_t size = 0;
+    for(int i = 0; i < ncells; i++)
+        size += chidb_Btree_cellSize(&cells[i]) + sizeof(uint16_t);
+    return size;
+}
+
+/* Bytes that a list of index leaf cells saves by sharing a prefix (see
+ * chidb_Btree_sharedPrefix), less the bytes of the prefix itself */
+static int32_t chidb_Btree_prefixSavings(BTreeCell *cells, int ncells, const uint8_t *prefix, int len)
+{
+    int32_t saved = -len;
+    for(int i = 0; i < ncells; i++) {
+        int shared = chidb_Btree_sharedPrefix(&cells[i], prefix, len);
+        if(shared > 0)
+            saved += shared - 1;
+    }
+    return saved;
+}
+
+/* Chooses the prefix of an index leaf for a list of cells, and copies it
+ * to prefix. The candidates are the longest prefix of the first columns
+ * of all the cells, and as much of old (the prefix of the leaf the cells
+ * come from, if any) as they use. The one that saves the most space is
+ * returned, so the cells never take more space with the prefix than
+ * without it. Returns its length, or 0 if there is no prefix worth
+ * keeping (or the cells are not index leaf cells). */
+static uint8_t chidb_Btree_choosePrefix(BTreeCell *cells, int ncells, const uint8_t *old, int old_len, uint8_t *prefix)
+{
+    const uint8_t *common = NULL;
+    int common_len = 0, used_len = 0;
+    const uint8_t *best = NULL;
+    int best_len = 0;
+    int32_t best_saved = 0, saved;
+
+    if(ncells == 0 || cells[0].type != PGTYPE_INDEX_LEAF)
+        return 0;
+    if(cells[0].key_ncols > 0 && cells[0].key_cols[0].type == INDEXKEY_TEXT) {
+        common = cells[0].key_str + cells[0].key_cols[0].off;
+        common_len = cells[0].key_cols[0].len;
+    }
+    for(int i = 0; i < ncells; i++) {
+        if(common_len > 0)
+            common_len = chidb_Btree_sharedPrefix(&cells[i], common, common_len);
+        if(old_len > 0) {
+            int shared = chidb_Btree_sharedPrefix(&cells[i], old, old_len);
+            used_len = (shared > used_len) ? shared : used_len;
+        }
+    }
+
+    if(common_len > 0 && (saved = chidb_Btree_prefixSavings(cells, ncells, common, common_len)) > best_saved) {
+        best = common;
+        best_len = common_len;
+        best_saved = saved;
+    }
+    if(used_len > 0 && (saved = chidb_Btree_prefixSavings(cells, ncells, old, used_len)) > best_saved) {
+        best = old;
+        best_len = used_len;
+        best_saved = saved;
+    }
+    if(best_len > 0)
+        memcpy(prefix, best, best_len);
+
+    return best_len;
+}
+
+/* Space taken up by a list of cells in a node written by
+ * chidb_Btree_fillNode, i.e., chidb_Btree_cellListSize less what an
+ * index leaf saves with its prefix */
+static uint32_t chidb_Btree_packedListSize(BTreeCell *cells, int ncells)
+{
+    uint8_t prefix[INDEXCELL_MAXTEXT];
+    uint8_t len = chidb_Btree_choosePrefix(cells, ncells, NULL, 0, prefix);
+    uint32_t size = chidb_Btree_cellListSize(cells, ncells);
+
+    return (len > 0) ? size - chidb_Btree_prefixSavings(cells, ncells, prefix, len) : size;
+}
+
+/* Gives a node without cells a prefix (of len bytes, which may be 0) at
+ * the end of its page. The prefix may not point into this same node. */
+static void chidb_Btree_setPrefix(BTree *bt, BTreeNode *btn, const uint8_t *prefix, uint8_t len)
+{
+    btn->cells_offset = bt->pager->usable_size - len;
+    btn->prefix = btn->page->data + btn->cells_offset;
+    btn->prefix_len = len;
+    if(len > 0)
+        memcpy(btn->prefix, prefix, len);
+}
+
+/* Page number of the child at position pos of an internal node
+ * (position n_cells is the right page) */
+static npage_t chidb_Btree_childPage(BTreeNode *btn, ncell_t pos)
+{
+    BTreeCell cell;
+
+    if(pos >= btn->n_cells)
+        return btn->right_page;
+    chidb_Btree_getCell(btn, pos, &cell);
+    if(btn->type == PGTYPE_TABLE_INTERNAL)
+        return cell.fields.tableInternal.child_page;
+    else
+        return cell.fields.indexInternal.child_page;
+}
+
+/* Appends the cells of a node to a list of cells. For table leaf cells,
+ * the data pointers point into the node's in-memory page, so the node
+ * must not be freed while the list is in use. */
+static void chidb_Btree_collectCells(BTreeNode *btn, BTreeCell *cells, int *ncells)
+{
+    for(int i = 0; i < btn->n_cells; i++)
+        chidb_Btree_getCell(btn, (ncell_t) i, &cells[(*ncells)++]);
+}
+
+/* Replaces the contents of a node with a list of cells (which must be
+ * cells of the given type, and must not point into this same node). An
+ * index leaf gets the prefix that suits its cells best, so the cells
+ * take chidb_Btree_packedListSize bytes. */
+static int chidb_Btree_fillNode(BTree *bt, BTreeNode *btn, uint8_t type,
+                                BTreeCell *cells, int ncells, npage_t right_page)
+{
+    int err;
+    int offset = (btn->page->npage == 1) ? 100 : 0;
+    uint8_t prefix[INDEXCELL_MAXTEXT];
+
+    btn->type = type;
+    btn->free_offset = offset + chidb_Btree_headerSize(type);
+    btn->celloffset_array = btn->page->data + btn->free_offset;
+    chidb_Btree_setPrefix(bt, btn, prefix, chidb_Btree_choosePrefix(cells, ncells, NULL, 0, prefix));
+    btn->n_cells = 0;
+    btn->has_keys = false;
+    btn->right_page = right_page;
+    for(int i = 0; i < ncells; i++) {
+        err = chidb_Btree_insertCell(btn, (ncell_t) i, &cells[i]);
+        if(err != CHIDB_OK)
+            return err;
+    }
+
+    return CHIDB_OK;
+}
+
+/* A node (other than the root) is rebalanced once less than
+ * a third of its page is in use */
+static bool chidb_Btree_isUnderfull(BTree *bt, BTreeNode *btn)
+{
+    return (uint32_t)(btn->cells_offset - btn->free_offset) * 3 > (uint32_t)bt->pager->usable_size * 2;
+}
+
+
+/* Rebalance a child of an internal node after a deletion
+ *
+ * If the child at position pos of node npage_parent is underfull, it is
+ * combined with one of its siblings (the next one, or the previous one if
+ * the child is the right page). The cells of both siblings are gathered in
+ * key order, together with the separator cell in the parent if it has to
+ * move down (internal nodes and index B-Trees). Then:
+ * - If all the cells fit in a single node, they are merged into the
+ *   right sibling, the separator is removed from the parent, and the
+ *   page of the left sibling is returned to the freelist.
+ * - Otherwise, the cells are redistributed evenly between the two
+ *   siblings, and the separator in the parent is replaced.
+ *
+ * The parent may end up with no cells (only a right page). That is only
+ * possible when the parent is the root, and is fixed by
+ * chidb_Btree_collapseRoot.
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - npage_parent: Page number of the parent node
+ * - pos: Position of the child in the parent (n_cells for the right page)
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+static int chidb_Btree_rebalance(BTree *bt, npage_t npage_parent, ncell_t pos)
+{
+    int err;
+    BTreeNode *parent = NULL, *child = NULL;
+    BTreeNode *left = NULL, *right = NULL, *newLeft = NULL, *newRight = NULL;
+    BTreeCell *cells = NULL;
+
+    // A node that could not be read is still returned, without a page
+    if((err = chidb_Btree_getNodeByPage(bt, npage_parent, &parent)) != CHIDB_OK || parent->n_cells == 0)
+        goto out;
+
+    if((err = chidb_Btree_getNodeByPage(bt, chidb_Btree_childPage(parent, pos), &child)) != CHIDB_OK ||
+       !chidb_Btree_isUnderfull(bt, child))
+        goto out;
+
+    // Find the siblings, and the separator between them
+    ncell_t nsep = (pos < parent->n_cells) ? pos : parent->n_cells - 1;
+    BTreeCell sep;
+    err = chidb_Btree_getCell(parent, nsep, &sep);
+    if(err != CHIDB_OK)
+        goto out;
+    npage_t nleft = chidb_Btree_childPage(parent, nsep);
+    npage_t nright = chidb_Btree_childPage(parent, nsep + 1);
+
+    // Load the siblings twice: once to read the cells from, and once to write them to
+    if((err = chidb_Btree_getNodeByPage(bt, nleft, &left)) != CHIDB_OK ||
+       (err = chidb_Btree_getNodeByPage(bt, nright, &right)) != CHIDB_OK ||
+       (err = chidb_Btree_getNodeByPage(bt, nleft, &newLeft)) != CHIDB_OK ||
+       (err = chidb_Btree_getNodeByPage(bt, nright, &newRight)) != CHIDB_OK)
+        goto out;
+
+    uint8_t type = left->type;
+    cells = malloc((left->n_cells + right->n_cells + 1) * sizeof(BTreeCell));
+    if(cells == NULL) {
+        err = CHIDB_ENOMEM;
+        goto out;
+    }
+    int ncells = 0;
+
+    chidb_Btree_collectCells(left, cells, &ncells);
+    if(type != PGTYPE_TABLE_LEAF) {
+        // The separator moves down, between the cells of both siblings
+        BTreeCell *down = &cells[ncells++];
+        *down = sep;
+        down->type = type;
+        switch(type) {
+            case PGTYPE_TABLE_INTERNAL:
+                down->fields.tableInternal.child_page = left->right_page;
+                break;
+            case PGTYPE_INDEX_INTERNAL:
+                down->fields.indexInternal.child_page = left->right_page;
+                down->fields.indexInternal.keyPk = sep.fields.indexInternal.keyPk;
+                break;
+            case PGTYPE_INDEX_LEAF:
+                down->fields.indexLeaf.keyPk = sep.fields.indexInternal.keyPk;
+                break;
+        }
+    }
+    chidb_Btree_collectCells(right, cells, &ncells);
+
+    uint32_t header = chidb_Btree_headerSize(type);
+    uint32_t total = chidb_Btree_cellListSize(cells, ncells);
+
+    if(header + chidb_Btree_packedListSize(cells, ncells) <= bt->pager->usable_size) {
+        // Merge both siblings into the right one
+        err = chidb_Btree_fillNode(bt, newRight, type, cells, ncells, right->right_page);
+        if(err == CHIDB_OK)
+            err = chidb_Btree_writeNode(bt, newRight);
+        if(err == CHIDB_OK)
+            err = chidb_Btree_removeCell(parent, nsep);
+        if(err == CHIDB_OK)
+            err = chidb_Btree_writeNode(bt, parent);
+        if(err == CHIDB_OK)
+            err = chidb_Btree_freePage(bt, nleft);
+    } else if(ncells >= ((type == PGTYPE_TABLE_LEAF) ? 2 : 3)) {
+        // Redistribute the cells. The left sibling gets the cells before
+        // position m. In a table leaf, cell m-1 also provides the new
+        // separator key; otherwise, cell m moves up to the parent.
+        int m;
+        uint32_t size = 0;
+        for(m = 0; m < ncells; m++) {
+            size += chidb_Btree_cellSize(&cells[m]) + sizeof(uint16_t);
+            if(size > total / 2)
+                break;
+        }
+        int last = (type == PGTYPE_TABLE_LEAF) ? ncells - 1 : ncells - 2;
+        if(m < 1)
+            m = 1;
+        if(m > last)
+            m = last;
+        int rstart = (type == PGTYPE_TABLE_LEAF) ? m : m + 1;
+
+        if(header + chidb_Btree_packedListSize(cells, m) <= bt->pager->usable_size &&
+           header + chidb_Btree_packedListSize(cells + rstart, ncells - rstart) <= bt->pager->usable_size) {
+            BTreeCell newsep;
+            npage_t left_right_page = 0;
+            if(type == PGTYPE_TABLE_LEAF) {
+                newsep = cells[m-1];
+            } else {
+                newsep = cells[m];
+                if(type == PGTYPE_TABLE_INTERNAL)
+                    left_right_page = cells[m].fields.tableInternal.child_page;
+                else if(type == PGTYPE_INDEX_INTERNAL)
+                    left_right_page = cells[m].fields.indexInternal.child_page;
+            }
+            newsep.type = parent->type;
+            if(parent->type == PGTYPE_TABLE_INTERNAL) {
+                newsep.fields.tableInternal.child_page = nleft;
+            } else {
+                newsep.fields.indexInternal.child_page = nleft;
+                newsep.fields.indexInternal.keyPk = (type == PGTYPE_INDEX_LEAF) ?
+                    cells[m].fields.indexLeaf.keyPk : cells[m].fields.indexInternal.keyPk;
+            }
+
+            err = chidb_Btree_fillNode(bt, newLeft, type, cells, m, left_right_page);
+            if(err == CHIDB_OK)
+                err = chidb_Btree_fillNode(bt, newRight, type, cells + rstart, ncells - rstart, right->right_page);
+            if(err == CHIDB_OK)
+                err = chidb_Btree_removeCell(parent, nsep);
+            if(err == CHIDB_OK)
+                err = chidb_Btree_insertCell(parent, nsep, &newsep);
+            if(err == CHIDB_OK)
+                err = chidb_Btree_writeNode(bt, newLeft);
+            if(err == CHIDB_OK)
+                err = chidb_Btree_writeNode(bt, newRight);
+            if(err == CHIDB_OK)
+                err = chidb_Btree_writeNode(bt, parent);
+        }
+    }
+
+out:
+    free(cells);
+    if(left != NULL)
+        chidb_Btree_freeMemNode(bt, left);
+    if(right != NULL)
+        chidb_Btree_freeMemNode(bt, right);
+    if(newLeft != NULL)
+        chidb_Btree_freeMemNode(bt, newLeft);
+    if(newRight != NULL)
+        chidb_Btree_freeMemNode(bt, newRight);
+    if(child != NULL)
+        chidb_Btree_freeMemNode(bt, child);
+    if(parent != NULL)
+        chidb_Btree_freeMemNode(bt, parent);
+
+    return err;
+}
+
+
+/* Remove an entry from a B-Tree and rebalance it
+ *
+ * Removes the entry that matches a given cell from the subtree rooted at
+ * npage, and then rebalances the nodes along the path back up to npage
+ * (see chidb_Btree_rebalance). If max is true, the target is ignored and
+ * the entry with the largest key in the subtree is removed instead.
+ *
+ * In a table B-Tree, the entry with the key of the target is removed.
+ * In an index B-Tree, the first entry with the indexed key of the target
+ * is removed, or, if pk is true, the entry whose primary key is also
+ * equal (see chidb_Btree_compareIndex). Entries can also be stored in
+ * the internal nodes of an index B-Tree. An entry removed from an
+ * internal node is replaced by the largest entry in its left subtree
+ * (which is always in a leaf).
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - npage: Page number of the root of the subtree
+ * - target: Cell with the key of the entry to remove
+ * - pk: Match the primary key too (index B-Trees only)
+ * - max: Remove the largest entry instead of the one with the given key
+ * - removed: Out parameter (may be NULL). Used to return the removed cell.
+ *            Table leaf cells are returned without their data.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOTFOUND: No entry with the given key was found
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+static int chidb_Btree_deleteEntry(BTree *bt, npage_t npage, BTreeCell *target, bool pk, bool max, BTreeCell *removed)
+{
+    int err;
+    BTreeNode *btn;
+    BTreeCell cell;
+    ncell_t i;
+
+    err = chidb_Btree_getNodeByPage(bt, npage, &btn);
+    if(err != CHIDB_OK)
+        return err;
+    bool index = (btn->type == PGTYPE_INDEX_INTERNAL || btn->type == PGTYPE_INDEX_LEAF);
+
+    // Position of the first cell >= target, which is the entry itself
+    // if they are equal
+    if(max)
+        i = btn->n_cells;
+    else if(index)
+        i = chidb_Btree_searchIndexCell(btn, target, pk, false);
+    else
+        i = chidb_Btree_searchCell(btn, target->key, false);
+    bool found = false;
+    if(i < btn->n_cells) {
+        chidb_Btree_getCell(btn, i, &cell);
+        found = index ? chidb_Btree_compareIndex(&cell, target, pk) == 0 : cell.key == target->key;
+    }
+
+    if(btn->type == PGTYPE_TABLE_LEAF || btn->type == PGTYPE_INDEX_LEAF) {
+        // Remove the entry from the leaf
+        if(max && btn->n_cells > 0) {
+            i = btn->n_cells - 1;
+            chidb_Btree_getCell(btn, i, &cell);
+            found = true;
+        }
+        if(!found) {
+            chidb_Btree_freeMemNode(bt, btn);
+            return CHIDB_ENOTFOUND;
+        }
+        if(removed) {
+            *removed = cell;
+            if(cell.type == PGTYPE_TABLE_LEAF)
+                removed->fields.tableLeaf.data = NULL;
+        }
+
+        err = chidb_Btree_removeCell(btn, i);
+        if(err == CHIDB_OK)
+            err = chidb_Btree_writeNode(bt, btn);
+        chidb_Btree_freeMemNode(bt, btn);
+        if(err == CHIDB_OK && cell.type == PGTYPE_TABLE_LEAF)
+            err = chidb_Btree_freeOverflow(bt, cell.fields.tableLeaf.overflow_page);
+        return err;
+    }
+
+    // Find the child that contains the entry (or the entry itself)
+    found = found && btn->type == PGTYPE_INDEX_INTERNAL;
+    npage_t child = chidb_Btree_childPage(btn, i);
+    chidb_Btree_freeMemNode(bt, btn);
+
+    if(found) {
+        // Replace the entry with the largest one in its left subtree
+        BTreeCell pred;
+        err = chidb_Btree_deleteEntry(bt, child, NULL, false, true, &pred);
+        if(err != CHIDB_OK)
+            return err;
+        if(removed)
+            *removed = cell;
+
+        BTreeCell replacement = pred;
+        replacement.type = PGTYPE_INDEX_INTERNAL;
+        replacement.fields.indexInternal.keyPk = pred.fields.indexLeaf.keyPk;
+        replacement.fields.indexInternal.child_page = child;
+
+        err = chidb_Btree_getNodeByPage(bt, npage, &btn);
+        if(err != CHIDB_OK)
+            return err;
+        err = chidb_Btree_removeCell(btn, i);
+        if(err == CHIDB_OK)
+            err = chidb_Btree_insertCell(btn, i, &replacement);
+        if(err == CHIDB_OK)
+            err = chidb_Btree_writeNode(bt, btn);
+        chidb_Btree_freeMemNode(bt, btn);
+    } else {
+        err = chidb_Btree_deleteEntry(bt, child, target, pk, max, removed);
+    }
+    if(err != CHIDB_OK)
+        return err;
+
+    return chidb_Btree_rebalance(bt, npage, i);
+}
+
+
+/* Shrink a B-Tree whose root has no cells left
+ *
+ * After a merge, the root of a B-Tree may be an internal node with no
+ * cells and only a right page. Since the root page of a B-Tree cannot
+ * change (it is referenced from the schema table), the contents of its
+ * only child are copied into the root, and the child's page is freed.
+ * This is repeated while possible. If the child does not fit in the
+ * root (only possible if the root is page 1, which has a smaller usable
+ * area because of the file header), the root is left as it is.
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - nroot: Page number of the root node
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+static int chidb_Btree_collapseRoot(BTree *bt, npage_t nroot)
+{
+    int err;
+    bool collapsed;
+
+    do {
+        BTreeNode *root, *child;
+        collapsed = false;
+
+        err = chidb_Btree_getNodeByPage(bt, nroot, &root);
+        if(err != CHIDB_OK)
+            return err;
+        if(root->n_cells > 0 || (root->type != PGTYPE_TABLE_INTERNAL && root->type != PGTYPE_INDEX_INTERNAL)) {
+            chidb_Btree_freeMemNode(bt, root);
+            break;
+        }
+
+        npage_t nchild = root->right_page;
+        err = chidb_Btree_getNodeByPage(bt, nchild, &child);
+        if(err != CHIDB_OK)
+            return err;
+
+        BTreeCell *cells = malloc((child->n_cells + 1) * sizeof(BTreeCell));
+        if(cells == NULL)
+            return CHIDB_ENOMEM;
+        int ncells = 0;
+        chidb_Btree_collectCells(child, cells, &ncells);
+
+        uint32_t offset = (nroot == 1) ? 100 : 0;
+        if(offset + chidb_Btree_headerSize(child->type) + chidb_Btree_packedListSize(cells, ncells) <= bt->pager->usable_size) {
+            err = chidb_Btree_fillNode(bt, root, child->type, cells, ncells, child->right_page);
+            if(err == CHIDB_OK)
+                err = chidb_Btree_writeNode(bt, root);
+            if(err == CHIDB_OK)
+                err = chidb_Btree_freePage(bt, nchild);
+            collapsed = (err == CHIDB_OK);
+        }
+
+        free(cells);
+        chidb_Btree_freeMemNode(bt, child);
+        chidb_Btree_freeMemNode(bt, root);
+    } while(collapsed);
+
+    return err;
+}
+
+
+/* Delete an entry from a B-Tree
+ *
+ * Removes the entry with a given key from a table or index B-Tree.
+ * Nodes that become underfull are merged with, or borrow cells from,
+ * a sibling (see chidb_Btree_rebalance), and pages that are no longer
+ * used are returned to the pager's freelist. The root node always
+ * stays in the same page. Like an insertion, a deletion is atomic
+ * inside a transaction.
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - nroot: Page number of the root node of the B-Tree we want to delete
+ *					this entry from.
+ * - key: Entry key (keyIdx in an index B-Tree)
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOTFOUND: No entry with the given key was found
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_delete(BTree *bt, npage_t nroot, key_t key)
+{
+    int err;
+    BTreeCell target;
+
+    chidb_Btree_setIntKey(&target, key);
+    err = chidb_Btree_deleteEntry(bt, nroot, &target, false, false, NULL);
+    if(err == CHIDB_OK)
+        err = chidb_Btree_collapseRoot(bt, nroot);
+
+    return err;
+}
+
+
+/* Delete an entry from an index B-Tree
+ *
+ * Same as chidb_Btree_delete, but removes the entry whose indexed key
+ * and primary key are both equal to those of a given cell. This is the
+ * way to remove one entry from an index with several entries with the
+ * same indexed key (or with a string key).
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - nroot: Page number of the root node of the index B-Tree
+ * - entry: Index cell (internal or leaf) with the keys of the entry
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOTFOUND: No such entry was found
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_deleteFromIndex(BTree *bt, npage_t nroot, BTreeCell *entry)
+{
+    int err;
+
+    err = chidb_Btree_deleteEntry(bt, nroot, entry, true, false, NULL);
+    if(err == CHIDB_OK)
+        err = chidb_Btree_collapseRoot(bt, nroot);
+
+    return err;
+}
+
+
+/* Update an entry in a table B-Tree
+ *
+ * Replaces the data associated with a key in a table B-Tree. Updates
+ * that do not change the size of the record (the common case for
+ * fixed-size columns) overwrite the data in place, unless the record
+ * has overflow pages. If the size changes but the new cell still fits
+ * in the leaf, the cell is rewritten within the same page, and its
+ * overflow pages (if any) are replaced. In both cases, the shape of the
+ * tree does not change. Otherwise, the entry is deleted and inserted
+ * again, which may split or merge nodes (as a single atomic change
+ * inside a transaction).
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - nroot: Page number of the root node of the B-Tree we want to update
+ *					this entry in.
+ * - key: Entry key
+ * - data: Pointer to new data
+ * - size: Number of bytes of new data
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOTFOUND: No entry with the given key was found
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_update(BTree *bt, npage_t nroot, key_t key, uint8_t *data, uint32_t size)
+{
+    int err;
+    BTreeNode *btn;
+    BTreeCell cell, new_cell;
+    npage_t npage = nroot;
+    ncell_t i;
+
+    // Find the leaf that contains the key
+    for(;;) {
+        err = chidb_Btree_getNodeByPage(bt, npage, &btn);
+        if(err != CHIDB_OK)
+            return err;
+        if(btn->type != PGTYPE_TABLE_INTERNAL)
+            break;
+        for(i = 0; i < btn->n_cells; i++) {
+            chidb_Btree_getCell(btn, i, &cell);
+            if(cell.key >= key)
+                break;
+        }
+        npage = chidb_Btree_childPage(btn, i);
+        chidb_Btree_freeMemNode(bt, btn);
+    }
+
+    for(i = 0; i < btn->n_cells; i++) {
+        chidb_Btree_getCell(btn, i, &cell);
+        if(cell.key >= key)
+            break;
+    }
+    if(btn->type != PGTYPE_TABLE_LEAF || i == btn->n_cells || cell.key != key) {
+        chidb_Btree_freeMemNode(bt, btn);
+        return CHIDB_ENOTFOUND;
+    }
+
+    new_cell = cell;
+    new_cell.fields.tableLeaf.data = data;
+    new_cell.fields.tableLeaf.data_size = size;
+    new_cell.fields.tableLeaf.overflow_page = 0;
+
+    if(cell.fields.tableLeaf.data_size == size && cell.fields.tableLeaf.overflow_page == 0) {
+        // Same size: overwrite the data in place
+        memcpy(cell.fields.tableLeaf.data, data, size);
+        err = chidb_Btree_writeNode(bt, btn);
+    } else if(chidb_Btree_cellSize(&new_cell) <= chidb_Btree_cellSize(&cell) + (btn->cells_offset - btn->free_offset)) {
+        // Different size, but still fits in this leaf: rewrite the cell
+        // (and replace its overflow pages, if any)
+        err = CHIDB_OK;
+        if(chidb_Btree_localSize(size) < size)
+            err = chidb_Btree_writeOverflow(bt, data, size, &new_cell.fields.tableLeaf.overflow_page);
+        if(err == CHIDB_OK)
+            err = chidb_Btree_removeCell(btn, i);
+        if(err == CHIDB_OK)
+            err = chidb_Btree_insertCell(btn, i, &new_cell);
+        if(err == CHIDB_OK)
+            err = chidb_Btree_writeNode(bt, btn);
+        if(err == CHIDB_OK)
+            err = chidb_Btree_freeOverflow(bt, cell.fields.tableLeaf.overflow_page);
+    } else {
+        // Does not fit: the tree has to be restructured
+        chidb_Btree_freeMemNode(bt, btn);
+        err = chidb_Btree_delete(bt, nroot, key);
+        if(err != CHIDB_OK)
+            return err;
+        return chidb_Btree_insertInTable(bt, nroot, key, data, size);
+    }
+
+    chidb_Btree_freeMemNode(bt, btn);
+    return err;
+}
+
+
+/* Free a B-Tree node
+ *
+ * Returns the page of a node that is no longer part of any B-Tree
+ * to the pager's freelist, so that it can be reused by
+ * chidb_Btree_newNode.
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - npage: Page number of the node
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EPAGENO: The provided page number is not valid
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_freePage(BTree *bt, npage_t npage)
+{
+    return chidb_Pager_freePage(bt->pager, npage);
+}
+
+
+/* Cells of a B-Tree, in key order, gathered by chidb_Btree_vacuumCollect.
+ * The nodes are kept in memory because the table leaf cells point into
+ * their pages. Cells with overflow pages point to a copy of all their
+ * data instead. */
+typedef struct
+{
+    BTreeCell *cells;
+    int ncells;
+    int maxcells;
+    BTreeNode **nodes;
+    int nnodes;
+    int maxnodes;
+} VacuumList;
+
+static void chidb_Btree_vacuumFreeList(BTree *bt, VacuumList *list)
+{
+    for(int i = 0; i < list->ncells; i++)
+        if(list->cells[i].type == PGTYPE_TABLE_LEAF && list->cells[i].fields.tableLeaf.overflow_page != 0)
+            free(list->cells[i].fields.tableLeaf.data);
+    for(int i = 0; i < list->nnodes; i++)
+        chidb_Btree_freeMemNode(bt, list->nodes[i]);
+    free(list->nodes);
+    free(list->cells);
+}
+
+/* Appends all the entries of the B-Tree rooted at npage to a list, in key
+ * order. Entries stored in index internal nodes are added as index leaf
+ * cells; table internal cells are skipped, since their keys are repeated
+ * in the leaves. */
+static int chidb_Btree_vacuumCollect(BTree *bt, npage_t npage, VacuumList *list)
+{
+    int err;
+    BTreeNode *btn;
+    BTreeCell cell;
+
+    err = chidb_Btree_getNodeByPage(bt, npage, &btn);
+    if(err != CHIDB_OK)
+        return err;
+    if(list->nnodes == list->maxnodes) {
+        list->maxnodes = list->maxnodes ? list->maxnodes * 2 : 16;
+        list->nodes = realloc(list->nodes, list->maxnodes * sizeof(BTreeNode *));
+        if(list->nodes == NULL)
+            return CHIDB_ENOMEM;
+    }
+    list->nodes[list->nnodes++] = btn;
+
+    for(ncell_t i = 0; i <= btn->n_cells; i++) {
+        bool leaf = (btn->type == PGTYPE_TABLE_LEAF || btn->type == PGTYPE_INDEX_LEAF);
+        if(!leaf) {
+            err = chidb_Btree_vacuumCollect(bt, chidb_Btree_childPage(btn, i), list);
+            if(err != CHIDB_OK)
+                return err;
+        }
+        if(i == btn->n_cells || btn->type == PGTYPE_TABLE_INTERNAL)
+            continue;
+
+        chidb_Btree_getCell(btn, i, &cell);
+        if(cell.type == PGTYPE_INDEX_INTERNAL) {
+            cell.type = PGTYPE_INDEX_LEAF;
+            cell.fields.indexLeaf.keyPk = cell.fields.indexInternal.keyPk;
+        }
+        if(cell.type == PGTYPE_TABLE_LEAF && cell.fields.tableLeaf.overflow_page != 0) {
+            uint8_t *data;
+            err = chidb_Btree_readPayload(bt, &cell, &data);
+            if(err != CHIDB_OK)
+                return err;
+            cell.fields.tableLeaf.data = data;
+        }
+        if(list->ncells == list->maxcells) {
+            list->maxcells = list->maxcells ? list->maxcells * 2 : 256;
+            list->cells = realloc(list->cells, list->maxcells * sizeof(BTreeCell));
+            if(list->cells == NULL)
+                return CHIDB_ENOMEM;
+        }
+        list->cells[list->ncells++] = cell;
+    }
+
+    return CHIDB_OK;
+}
+
+/* Writes a node with a list of cells to a page. If npage is zero, a new
+ * page is allocated (and its number returned in npage). Table leaf cells
+ * must have all their data in memory; their overflow pages are written
+ * here. */
+static int chidb_Btree_vacuumWriteNode(BTree *bt, npage_t *npage, uint8_t type,
+                                       BTreeCell *cells, int ncells, npage_t right_page)
+{
+    int err;
+    BTreeNode *btn;
+
+    for(int i = 0; i < ncells && type == PGTYPE_TABLE_LEAF; i++) {
+        uint32_t size = cells[i].fields.tableLeaf.data_size;
+        if(chidb_Btree_localSize(size) < size) {
+            err = chidb_Btree_writeOverflow(bt, cells[i].fields.tableLeaf.data, size, &cells[i].fields.tableLeaf.overflow_page);
+            if(err != CHIDB_OK)
+                return err;
+        }
+    }
+
+    if(*npage == 0)
+        chidb_Pager_allocatePage(bt->pager, npage);
+    err = chidb_Btree_getNodeByPage(bt, *npage, &btn);
+    if(err != CHIDB_OK)
+        return err;
+    err = chidb_Btree_fillNode(bt, btn, type, cells, ncells, right_page);
+    if(err == CHIDB_OK)
+        err = chidb_Btree_writeNode(bt, btn);
+    chidb_Btree_freeMemNode(bt, btn);
+
+    return err;
+}
+
+/* Build a B-Tree bottom-up from a list of entries in key order
+ *
+ * Each level is packed from left to right, filling every node before
+ * moving on to the next one, and is written to consecutive pages. Between
+ * two nodes of a level there is a separator that goes up to the next
+ * level: the largest key of the left node in a table B-Tree (which stays
+ * in the leaf), or the entry that follows the left node in an index
+ * B-Tree (which is removed from the level, as in any B-Tree). Internal
+ * levels are packed in the same way, with the children of the level
+ * below. This is repeated until a level fits in the root.
+ *
+ * Parameters
+ * - bt: B-Tree file to write the tree to
+ * - entries: Entries in key order (table leaf or index leaf cells)
+ * - nentries: Number of entries
+ * - leaf_type: PGTYPE_TABLE_LEAF or PGTYPE_INDEX_LEAF
+ * - nroot: In/out parameter. Page for the root node, or zero to
+ *          allocate a new page (in which case its number is returned).
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+static int chidb_Btree_vacuumBuild(BTree *bt, BTreeCell *entries, int nentries,
+                                   uint8_t leaf_type, npage_t *nroot)
+{
+    int err = CHIDB_OK;
+    bool table = (leaf_type == PGTYPE_TABLE_LEAF);
+    uint8_t int_type = table ? PGTYPE_TABLE_INTERNAL : PGTYPE_INDEX_INTERNAL;
+    uint16_t page_size = bt->pager->usable_size;
+    uint32_t root_offset = (*nroot == 1) ? 100 : 0;
+
+    /* The current level: n cells, and (above the leaves) n+1 children,
+     * the last of which is the right page */
+    BTreeCell *cells = malloc((nentries + 1) * sizeof(BTreeCell));
+    npage_t *children = NULL;
+    BTreeCell *seps = NULL;
+    npage_t *nodes = NULL;
+    int n = nentries;
+
+    if(cells == NULL)
+        return CHIDB_ENOMEM;
+    memcpy(cells, entries, nentries * sizeof(BTreeCell));
+
+    for(bool leaf = true; ; leaf = false) {
+        uint8_t type = leaf ? leaf_type : int_type;
+        bool keep_sep = leaf && table;
+        uint32_t capacity = page_size - chidb_Btree_headerSize(type);
+        npage_t right_page = leaf ? 0 : children[n];
+
+        if(!leaf) {
+            for(int i = 0; i < n; i++) {
+                cells[i].type = int_type;
+                if(table)
+                    cells[i].fields.tableInternal.child_page = children[i];
+                else
+                    cells[i].fields.indexInternal.child_page = children[i];
+            }
+        }
+
+        if(chidb_Btree_packedListSize(cells, n) <= capacity - root_offset) {
+            err = chidb_Btree_vacuumWriteNode(bt, nroot, type, cells, n, right_page);
+            break;
+        }
+
+        /* Split the level into nodes, and gather the separators and
+         * the pages of the nodes for the next level */
+        seps = realloc(seps, (n + 1) * sizeof(BTreeCell));
+        nodes = realloc(nodes, (n + 1) * sizeof(npage_t));
+        if(seps == NULL || nodes == NULL) {
+            err = CHIDB_ENOMEM;
+            break;
+        }
+        int nnodes = 0;
+        for(int first = 0; first < n; ) {
+            int last = first;
+            uint32_t used = 0;
+            while(last < n && used + chidb_Btree_cellSize(&cells[last]) + sizeof(uint16_t) <= capacity)
+                used += chidb_Btree_cellSize(&cells[last++]) + sizeof(uint16_t);
+            if(type == PGTYPE_INDEX_LEAF) {
+                /* Index leaves take more cells once they share a prefix.
+                 * The cells up to last fit even without it. */
+                int lo = last, hi = n;
+                while(lo < hi) {
+                    int mid = lo + (hi - lo + 1) / 2;
+                    if(chidb_Btree_packedListSize(&cells[first], mid - first) <= capacity)
+                        lo = mid;
+                    else
+                        hi = mid - 1;
+                }
+                last = lo;
+            }
+            if(nnodes == 0 && last == n)
+                last = n / 2;   /* Fits in a page, but not in the root */
+            if(!keep_sep && last == n - 1)
+                last--;         /* Leave at least one cell after the separator */
+            if(last <= first)
+                last = first + 1;
+
+            /* The right page of an internal node is the child that
+             * follows its last cell */
+            npage_t npage = 0;
+            err = chidb_Btree_vacuumWriteNode(bt, &npage, type, &cells[first], last - first,
+                                              leaf ? 0 : children[last]);
+            if(err != CHIDB_OK)
+                break;
+            nodes[nnodes] = npage;
+            if(last < n) {
+                seps[nnodes] = keep_sep ? cells[last - 1] : cells[last];
+                if(!keep_sep)
+                    last++;
+            }
+            nnodes++;
+            first = last;
+        }
+        if(err != CHIDB_OK)
+            break;
+
+        /* Separators become the cells of the next level. In a table
+         * B-Tree, only their keys are needed. */
+        n = nnodes - 1;
+        for(int i = 0; i < n; i++) {
+            cells[i] = seps[i];
+            cells[i].type = int_type;
+            if(!table)
+                cells[i].fields.indexInternal.keyPk = seps[i].fields.indexLeaf.keyPk;
+        }
+        npage_t *tmp = children;
+        children = nodes;
+        nodes = tmp;
+    }
+
+    free(cells);
+    free(children);
+    free(seps);
+    free(nodes);
+
+    return err;
+}
+
+/* Rebuild one B-Tree of a file into another file
+ *
+ * Parameters
+ * - bt: B-Tree file to read the tree from
+ * - dst: B-Tree file to write the tree to
+ * - nroot: Root page of the tree in bt
+ * - new_root: In/out parameter. Root page of the tree in dst (see
+ *             chidb_Btree_vacuumBuild)
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+static int chidb_Btree_vacuumTree(BTree *bt, BTree *dst, npage_t nroot, npage_t *new_root)
+{
+    int err;
+    VacuumList list = {0};
+    uint8_t leaf_type;
+
+    err = chidb_Btree_vacuumCollect(bt, nroot, &list);
+    if(err == CHIDB_OK) {
+        uint8_t type = list.nodes[0]->type;
+        leaf_type = (type == PGTYPE_TABLE_LEAF || type == PGTYPE_TABLE_INTERNAL) ? PGTYPE_TABLE_LEAF : PGTYPE_INDEX_LEAF;
+        err = chidb_Btree_vacuumBuild(dst, list.cells, list.ncells, leaf_type, new_root);
+    }
+    chidb_Btree_vacuumFreeList(bt, &list);
+
+    return err;
+}
+
+
+/* Rebuild a B-Tree file
+ *
+ * See chidb_Btree_vacuum, which this function implements. The pages of
+ * the new file have checksums if (and only if) checksums is true.
+ */
+static int chidb_Btree_rebuild(BTree *bt, bool checksums)
+{
+    int err;
+    Pager *pager;
+    BTree dst = {NULL, 0, bt->db, NULL};
+    VacuumList schema = {0};
+    npage_t *roots = NULL;   /* Pairs of old and new root pages */
+    npage_t npage;
+    char *filename;
+
+    if(bt->pager->in_txn)
+        return CHIDB_EMISUSE;
+
+    filename = malloc(strlen(bt->pager->filename) + strlen("-vacuum") + 1);
+    if(filename == NULL)
+        return CHIDB_ENOMEM;
+
+    /* Frames in the WAL refer to the old layout of the file, so they
+     * must all be in the file (and the WAL gone) before it is replaced */
+    bool wal = (bt->pager->wal != NULL);
+    err = chidb_Pager_setJournalMode(bt->pager, CHIDB_JOURNAL_DELETE);
+    if(err != CHIDB_OK) {
+        free(filename);
+        return err;
+    }
+
+    sprintf(filename, "%s-vacuum", bt->pager->filename);
+    chidb_Vfs_remove(bt->pager->vfs, filename);
+    err = chidb_Pager_openVfs(&pager, bt->pager->vfs, filename);
+    if(err != CHIDB_OK) {
+        free(filename);
+        if(wal)
+            chidb_Pager_setJournalMode(bt->pager, CHIDB_JOURNAL_WAL);
+        return err;
+    }
+    chidb_Pager_setPageSize(pager, bt->pager->page_size);
+    chidb_Pager_setChecksums(pager, checksums);
+    chidb_Pager_setSynchronous(pager, bt->pager->sync_mode);
+    dst.pager = pager;
+
+    /* Page 1 is reserved for the schema table */
+    chidb_Pager_allocatePage(pager, &npage);
+
+    /* Rebuild every tree listed in the schema table, and patch the
+     * root page in the in-memory copy of its schema record */
+    err = chidb_Btree_vacuumCollect(bt, 1, &schema);
+    if(err == CHIDB_OK && (roots = calloc(2 * schema.ncells + 2, sizeof(npage_t))) == NULL)
+        err = CHIDB_ENOMEM;
+    for(int i = 0; err == CHIDB_OK && i < schema.ncells; i++) {
+        BTreeCell *cell = &schema.cells[i];
+        DBRecord *dbr;
+        int32_t root;
+        npage_t new_root = 0;
+
+        chidb_DBRecord_unpack(&dbr, cell->fields.tableLeaf.data);
+        chidb_DBRecord_getInt32(dbr, 3, &root);
+        uint32_t root_offset = cell->fields.tableLeaf.data[0] + dbr->offsets[3];
+        bool valid = (chidb_DBRecord_getType(dbr, 3) == SQL_INTEGER_4BYTE);
+        chidb_DBRecord_destroy(dbr);
+        if(!valid || root <= 1 || root > bt->pager->n_pages) {
+            err = CHIDB_ECORRUPT;
+            break;
+        }
+
+        err = chidb_Btree_vacuumTree(bt, &dst, (npage_t) root, &new_root);
+        if(err != CHIDB_OK)
+            break;
+        put4byte(cell->fields.tableLeaf.data + root_offset, new_root);
+
+        roots[2 * i] = root;
+        roots[2 * i + 1] = new_root;
+    }
+
+    /* The schema table itself, followed by the header */
+    npage = 1;
+    if(err == CHIDB_OK)
+        err = chidb_Btree_vacuumBuild(&dst, schema.cells, schema.ncells, PGTYPE_TABLE_LEAF, &npage);
+    if(err == CHIDB_OK) {
+        MemPage *src_page, *dst_page;
+        chidb_Pager_readPage(bt->pager, 1, &src_page);
+        chidb_Pager_readPage(pager, 1, &dst_page);
+        memcpy(dst_page->data, src_page->data, 100);
+        dst_page->data[HEADER_RESERVED_OFFSET] = checksums ? PAGE_CHECKSUM_SIZE : 0;
+        pager->has_header = true;
+        chidb_Pager_writePage(pager, dst_page);
+        chidb_Pager_releaseMemPage(bt->pager, src_page);
+        chidb_Pager_releaseMemPage(pager, dst_page);
+        err = chidb_Pager_sync(pager);
+    }
+
+    if(err == CHIDB_OK && chidb_Vfs_rename(bt->pager->vfs, filename, bt->pager->filename) != CHIDB_OK)
+        err = CHIDB_EIO;
+    chidb_Btree_freeNodePool(&dst);
+    if(err != CHIDB_OK) {
+        free(roots);
+        chidb_Btree_vacuumFreeList(bt, &schema);
+        chidb_Vfs_remove(pager->vfs, filename);
+        chidb_Pager_close(pager);
+        free(filename);
+        if(wal)
+            chidb_Pager_setJournalMode(bt->pager, CHIDB_JOURNAL_WAL);
+        return err;
+    }
+
+    for(int j = 0; j < bt->schema_table_size; j++)
+        for(int i = 0; i < schema.ncells; i++)
+            if(bt->schema_table[j]->root_page == (int) roots[2 * i]) {
+                bt->schema_table[j]->root_page = roots[2 * i + 1];
+                break;
+            }
+    free(roots);
+    chidb_Btree_vacuumFreeList(bt, &schema);
+
+    /* The new pager keeps the (now renamed) file open */
+    char *journal_name = pager->journal_name;
+    free(pager->filename);
+    pager->filename = bt->pager->filename;
+    pager->journal_name = bt->pager->journal_name;
+    bt->pager->filename = NULL;
+    bt->pager->journal_name = journal_name;
+    pager->group_wait = bt->pager->group_wait;
+    pager->group_size = bt->pager->group_size;
+    chidb_Pager_close(bt->pager);
+    bt->pager = pager;
+    free(filename);
+
+    return wal ? chidb_Pager_setJournalMode(pager, CHIDB_JOURNAL_WAL) : CHIDB_OK;
+}
+
+
+/* Compact a B-Tree file
+ *
+ * Rewrites every B-Tree of the file into a new file (the database file
+ * name followed by "-vacuum"), with full nodes and with the nodes of each
+ * level in consecutive pages. B-Trees built by repeated insertions only
+ * have their nodes half full on average, so this roughly halves the number
+ * of pages that a scan has to read. The new file has an empty freelist.
+ *
+ * The schema table is rebuilt last, in page 1, with the root pages of
+ * the rebuilt trees (both in the file and in bt->schema_table). Once the
+ * new file has been written and flushed to disk, it is renamed over the
+ * database file, so the file is replaced atomically: a crash at any point
+ * leaves either the old file or the new one. The header of page 1 is
+ * copied as is, except for the freelist fields.
+ *
+ * Pages of the new file have checksums if those of the old one did
+ * (see chidb_Btree_setChecksums).
+ *
+ * Parameters
+ * - bt: B-Tree file
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ECORRUPT: The schema table has an invalid root page
+ * - CHIDB_EMISUSE: A transaction is active (the file cannot be replaced)
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_vacuum(BTree *bt)
+{
+    return chidb_Btree_rebuild(bt, bt->pager->checksums);
+}
+
+
+/* Turn page checksums on or off
+ *
+ * The pages of a file either all have a checksum or none do (see
+ * chidb_Pager_setChecksums), and checksums take up space that B-Tree
+ * nodes would otherwise use, so the whole file is rebuilt, as in
+ * chidb_Btree_vacuum. The header records whether pages have checksums.
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - on: Whether pages have checksums
+ *
+ * Return
+ * - CHIDB_OK: Operation successful (or checksums already were on/off)
+ * - CHIDB_ECORRUPT: The schema table has an invalid root page
+ * - CHIDB_ECHECKSUM: A page does not match its checksum
+ * - CHIDB_EMISUSE: A transaction is active
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_setChecksums(BTree *bt, bool on)
+{
+    if(bt->pager->in_txn)
+        return CHIDB_EMISUSE;
+    if(bt->pager->checksums == on)
+        return CHIDB_OK;
+
+    return chidb_Btree_rebuild(bt, on);
+}
+
+
+/* Set the journal mode of a B-Tree file
+ *
+ * Sets the journal mode of the pager (see chidb_Pager_setJournalMode),
+ * and records it in the file header, so that the file is opened in
+ * the same mode the next time. The header is updated in rollback
+ * journal mode.
+ *
+ * Parameters
+ * - bt: B-Tree file
+ * - mode: CHIDB_JOURNAL_DELETE or CHIDB_JOURNAL_WAL
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: A transaction is active, or the mode is not valid
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Btree_setJournalMode(BTree *bt, int mode)
+{
+    int err;
+    MemPage *page;
+    uint8_t version = (mode == CHIDB_JOURNAL_WAL) ? HEADER_VERSION_WAL : HEADER_VERSION_LEGACY;
+
+    if(bt->pager->in_txn || (mode != CHIDB_JOURNAL_DELETE && mode != CHIDB_JOURNAL_WAL))
+        return CHIDB_EMISUSE;
+
+    if(mode == CHIDB_JOURNAL_DELETE) {
+        err = chidb_Pager_setJournalMode(bt->pager, mode);
+        if(err != CHIDB_OK)
+            return err;
+    }
+
+    err = chidb_Pager_readPage(bt->pager, 1, &page);
+    if(err != CHIDB_OK)
+        return err;
+    if(page->data[HEADER_WRITE_VERSION_OFFSET] != version || page->data[HEADER_READ_VERSION_OFFSET] != version) {
+        page->data[HEADER_WRITE_VERSION_OFFSET] = version;
+        page->data[HEADER_READ_VERSION_OFFSET] = version;
+        err = chidb_Pager_begin(bt->pager);
+        if(err == CHIDB_OK && (err = chidb_Pager_writePage(bt->pager, page)) != CHIDB_OK)
+            chidb_Pager_rollback(bt->pager);
+        else if(err == CHIDB_OK)
+            err = chidb_Pager_commit(bt->pager);
+    }
+    chidb_Pager_releaseMemPage(bt->pager, page);
+    if(err != CHIDB_OK)
+        return err;
+
+    return chidb_Pager_setJournalMode(bt->pager, mode);
+}
+
+
+
 
 
 
@@ -15,34 +15,123 @@
 #define PGHEADER_FREE_OFFSET (1)
 #define PGHEADER_NCELLS_OFFSET (3)
 #define PGHEADER_CELL_OFFSET (5)
-#define PGHEADER_ZERO_OFFSET (7)
+#define PGHEADER_PREFIX_OFFSET (7)
 #define PGHEADER_RIGHTPG_OFFSET (8)
 
 #define LEAFPG_CELLSOFFSET_OFFSET (8)
 #define INTPG_CELLSOFFSET_OFFSET (12)
 
-/* Cell offsets and sizes */
+/* Cell offsets and sizes
+ *
+ * A table internal cell is the page number of its child followed by
+ * its key, a varint (see getVarint64). A table leaf cell is the size of
+ * its data, a varint, followed by its key, another varint, and then by
+ * the data. Varints are written with as few bytes as possible (one for
+ * values below 128), so only the fields below have a fixed offset.
+ * Files written when these varints were always padded to four bytes
+ * are read the same way. */
 
 #define TABLEINTCELL_CHILD_OFFSET (0)
 #define TABLEINTCELL_KEY_OFFSET (4)
 
 #define TABLELEAFCELL_SIZE_OFFSET (0)
-#define TABLELEAFCELL_KEY_OFFSET (4)
-#define TABLELEAFCELL_DATA_OFFSET (8)
 
-#define TABLEINTCELL_SIZE (8)
-#define TABLELEAFCELL_SIZE_WITHOUTDATA (8)
+/* An index cell holds a record with the indexed key, which has a field
+ * for each indexed column (at most INDEXCELL_MAXCOLS), followed by the
+ * primary key. Integers are stored in the smallest of the record
+ * integer types (SQL_INTEGER_1BYTE, 2BYTE, 4BYTE or 8BYTE) that holds
+ * them, i.e., without their leading zero bytes, so the keys of an index
+ * on small values take two bytes rather than eight. Files whose index
+ * cells always use SQL_INTEGER_4BYTE are read the same way.
+ *
+ * A field may also be a string, with the record type of a TEXT field
+ * (SQL_TEXT + 2 * length), or, in an index on several columns, NULL.
+ * Keys are compared field by field: NULL goes first, then integers, and
+ * then strings, in memcmp order (a string that is a prefix of another
+ * one goes first). The strings of a key share INDEXCELL_MAXTEXT bytes,
+ * and only as much of each as fits is stored, so that the record size
+ * and types are always one-byte varints; longer strings share the
+ * entries of their prefix, and callers must check the row itself.
+ * Entries are sorted by indexed key and then by primary key, so an index
+ * can have several entries with the same indexed key. The offsets of
+ * the key and the primary key below only hold in single-column indexes.
+ * INDEXINTCELL_MAXSIZE and INDEXLEAFCELL_MAXSIZE are the sizes with the
+ * most columns, the longest strings and an 8-byte primary key.
+ *
+ * The first column of the keys of an index leaf is prefix-compressed. A
+ * leaf may keep a prefix, shared by the strings of its cells, at the end
+ * of its page (above the cells), and the byte at PGHEADER_PREFIX_OFFSET
+ * holds its length (0 in any other node, and in files written before
+ * this). A string in the first column that starts with at least
+ * INDEXCELL_MINSHARED bytes of the prefix is stored as the number of
+ * bytes it shares with the prefix, followed by the rest of the string,
+ * with the record type of a BLOB (INDEXCELL_SHAREDTEXT + 2 * size). The
+ * prefix is chosen whenever the cells of a leaf are rewritten (when it
+ * is split, rebalanced or vacuumed), and cells that are inserted later
+ * share as much of it as they can. A cell never takes more space than
+ * chidb_Btree_cellSize says, so a leaf with room for a cell still has
+ * room for it whatever its prefix. */
 
 #define INDEXINTCELL_CHILD_OFFSET (0)
+#define INDEXINTCELL_SIZE_OFFSET (4)
+#define INDEXINTCELL_TYPEIDX_OFFSET (6)
+#define INDEXINTCELL_TYPEPK_OFFSET (7)
 #define INDEXINTCELL_KEYIDX_OFFSET (8)
-#define INDEXINTCELL_KEYPK_OFFSET (12)
 
 #define INDEXLEAFCELL_SIZE_OFFSET (0)
+#define INDEXLEAFCELL_TYPEIDX_OFFSET (2)
+#define INDEXLEAFCELL_TYPEPK_OFFSET (3)
 #define INDEXLEAFCELL_KEYIDX_OFFSET (4)
-#define INDEXLEAFCELL_KEYPK_OFFSET (8)
 
-#define INDEXINTCELL_SIZE (16)
-#define INDEXLEAFCELL_SIZE (12)
+#define INDEXCELL_MAXCOLS (4)
+#define INDEXCELL_MAXTEXT (57)
+
+#define INDEXINTCELL_MAXSIZE (INDEXINTCELL_TYPEIDX_OFFSET + INDEXCELL_MAXCOLS + 1 + INDEXCELL_MAXTEXT + 8 * INDEXCELL_MAXCOLS)
+#define INDEXLEAFCELL_MAXSIZE (INDEXLEAFCELL_TYPEIDX_OFFSET + INDEXCELL_MAXCOLS + 1 + INDEXCELL_MAXTEXT + 8 * INDEXCELL_MAXCOLS)
+
+#define INDEXCELL_SHAREDTEXT (SQL_TEXT - 1)
+#define INDEXCELL_MINSHARED (2)
+
+#define INDEXCELL_HEADER_SIZE(ncols) ((ncols) + 2)
+#define INDEXCELL_INTSIZE(type) (((type) == SQL_INTEGER_8BYTE) ? 8 : (type))
+#define INDEXCELL_ISTEXT(type) ((type) >= INDEXCELL_SHAREDTEXT)
+#define INDEXCELL_ISSHARED(type) (INDEXCELL_ISTEXT(type) && ((type) & 1) == 0)
+#define INDEXCELL_FIELDSIZE(type) (INDEXCELL_ISTEXT(type) ? ((type) - INDEXCELL_SHAREDTEXT) / 2 : INDEXCELL_INTSIZE(type))
+
+/* Types of the columns of an indexed key, in the order they sort in */
+#define INDEXKEY_NULL (0)
+#define INDEXKEY_INT (1)
+#define INDEXKEY_TEXT (2)
+
+/* Comparisons for chidb_Btree_seekIndex */
+#define INDEXSEEK_GE (0)
+#define INDEXSEEK_GT (1)
+#define INDEXSEEK_LE (2)
+#define INDEXSEEK_LT (3)
+
+/* Overflow pages. A table leaf cell whose data is larger than
+ * TABLELEAFCELL_MAXLOCAL keeps only a prefix of the data in the cell,
+ * followed by the page number of the first overflow page. Each overflow
+ * page holds the page number of the next one (0 in the last page)
+ * followed by as much of the remaining data as fits. The size of the
+ * prefix follows the same rule as SQLite, so that at least four cells
+ * fit in a leaf and the last overflow page is as full as possible. */
+#define TABLELEAFCELL_MAXLOCAL(ps) ((((ps) - 12) * 64 / 255) - 23)
+#define TABLELEAFCELL_MINLOCAL(ps) ((((ps) - 12) * 32 / 255) - 23)
+#define TABLELEAFCELL_OVERFLOW_SIZE (4)
+
+#define OVERFLOWPG_NEXT_OFFSET (0)
+#define OVERFLOWPG_DATA_OFFSET (4)
+
+/* File format version numbers in the header. As in SQLite, a file in
+ * WAL journal mode has both set to 2, and 1 otherwise. */
+#define HEADER_WRITE_VERSION_OFFSET (18)
+#define HEADER_READ_VERSION_OFFSET (19)
+#define HEADER_VERSION_LEGACY (1)
+#define HEADER_VERSION_WAL (2)
+
+/* Number of freed BTreeNode structs that a BTree keeps for reuse */
+#define NODE_POOL_SIZE (16)
 
 // Advance declarations
 typedef struct BTreeCell BTreeCell;
@@ -84,6 +173,8 @@ struct BTree
     int schema_table_size;
 	chidb *db;
 	Pager *pager;
+	BTreeNode *node_pool[NODE_POOL_SIZE]; /* Freed nodes, reused by chidb_Btree_getNodeByPage */
+	int n_node_pool;
 };
 
 /* The BTreeNode struct is an in-memory representation of a B-Tree node. Thus,
@@ -107,14 +198,48 @@ struct BTreeNode
 	uint16_t cells_offset;     /* Byte offset of start of cells in page */
 	npage_t right_page;        /* Right page (internal nodes only) */
 	uint8_t *celloffset_array; /* Pointer to start of cell offset array in the in-memory page */
+	key_t *keys;               /* Key of every cell, if has_keys is set */
+	ncell_t keys_size;         /* Number of keys that fit in keys */
+	bool has_keys;             /* Cleared whenever the cells are modified */
+	uint8_t *prefix;           /* Prefix shared by the keys of an index leaf, at the end of the page */
+	uint8_t prefix_len;        /* Number of bytes of prefix (0 if there is none) */
 };
 
+/* Decoded form of a B-Tree node. The pager keeps it next to the cached
+ * page (see chidb_Pager_setDecoded), so that loading the same node again
+ * does not have to parse its header and keys again. */
+struct BTreeNodeDecoded
+{
+	uint8_t type;
+	uint16_t free_offset;
+	ncell_t n_cells;
+	uint16_t cells_offset;
+	npage_t right_page;
+	key_t keys[];              /* Key of every cell */
+};
+typedef struct BTreeNodeDecoded BTreeNodeDecoded;
+
+/* A column of the indexed key of an index cell */
+struct BTreeKeyCol
+{
+	uint8_t type;  /* INDEXKEY_NULL, INDEXKEY_INT or INDEXKEY_TEXT */
+	uint8_t off;   /* Offset of the string in key_str (INDEXKEY_TEXT only) */
+	uint8_t len;   /* Number of bytes of the string (INDEXKEY_TEXT only) */
+	key_t value;   /* Integer (INDEXKEY_INT only) */
+};
+typedef struct BTreeKeyCol BTreeKeyCol;
+
 /* BTreeCell is an in-memory representation of a cell. See The chidb File Format 
  * document for more details on the meaning of each field */ 
 struct BTreeCell 
 {
 	uint8_t type;  /* Type of page where this cell is contained */
-	key_t key;     /* Key */
+	key_t key;     /* Key (for index cells, the first indexed column, or 0 if it is not an integer) */
+	uint8_t key_ncols;                       /* Index cells only: number of columns of the indexed key. A key
+	                                          * with fewer columns than the entries of an index matches all
+	                                          * the entries that start with its columns */
+	BTreeKeyCol key_cols[INDEXCELL_MAXCOLS]; /* Index cells only: columns of the indexed key */
+	uint8_t key_str[INDEXCELL_MAXTEXT];      /* Strings of the text columns, one after another (not NUL-terminated) */
 	union
 	{
 		struct
@@ -123,8 +248,10 @@ struct BTreeCell
 		} tableInternal;
 		struct
 		{
-			uint32_t data_size;  /* Number of bytes of data stored in this cell */
-			uint8_t *data;       /* Pointer to in-memory copy of data stored in this cell */
+			uint32_t data_size;  /* Number of bytes of data in this entry */
+			uint8_t *data;       /* Pointer to in-memory copy of data stored in this cell
+			                      * (only the local prefix, if the data overflows) */
+			npage_t overflow_page; /* First overflow page (if data_size > TABLELEAFCELL_MAXLOCAL) */
 		} tableLeaf;
 		struct
 		{
@@ -140,25 +267,49 @@ struct BTreeCell
 
  
 int chidb_Btree_open(const char *filename, chidb *db, BTree **bt);
+int chidb_Btree_openVfs(const char *filename, Vfs *vfs, chidb *db, BTree **bt);
 int chidb_Btree_close(BTree *bt);
 
 int chidb_Btree_getNodeByPage(BTree *bt, npage_t npage, BTreeNode **node);
 int chidb_Btree_freeMemNode(BTree *bt, BTreeNode *btn);
+int chidb_Btree_prefetchChildren(BTree *bt, BTreeNode *btn, ncell_t first);
 
 int chidb_Btree_newNode(BTree *bt, npage_t *npage, uint8_t type);
 int chidb_Btree_initEmptyNode(BTree *bt, npage_t npage, uint8_t type);
 int chidb_Btree_writeNode(BTree *bt, BTreeNode *node);
 
+int chidb_Btree_freePage(BTree *bt, npage_t npage);
+
 int chidb_Btree_getCell(BTreeNode *btn, ncell_t ncell, BTreeCell *cell);
 int chidb_Btree_insertCell(BTreeNode *btn, ncell_t ncell, BTreeCell *cell);
+int chidb_Btree_removeCell(BTreeNode *btn, ncell_t ncell);
+uint16_t chidb_Btree_cellSize(BTreeCell *cell);
+
+int chidb_Btree_find(BTree *bt, npage_t nroot, key_t key, uint8_t **data, uint32_t *size);
+int chidb_Btree_readPayload(BTree *bt, BTreeCell *cell, uint8_t **data);
 
-int chidb_Btree_find(BTree *bt, npage_t nroot, key_t key, uint8_t **data, uint16_t *size);
+void chidb_Btree_setIntKey(BTreeCell *cell, key_t v);
+void chidb_Btree_setTextKey(BTreeCell *cell, const char *str);
+void chidb_Btree_appendIntKey(BTreeCell *cell, key_t v);
+void chidb_Btree_appendTextKey(BTreeCell *cell, const char *str);
+void chidb_Btree_appendNullKey(BTreeCell *cell);
+int chidb_Btree_compareIndex(BTreeCell *a, BTreeCell *b, bool pk);
+int chidb_Btree_seekIndex(BTree *bt, npage_t nroot, BTreeCell *key, bool pk, int op, BTreeCell *cell);
 
-int chidb_Btree_insertInTable(BTree *bt, npage_t nroot, key_t key, uint8_t *data, uint16_t size);
+int chidb_Btree_insertInTable(BTree *bt, npage_t nroot, key_t key, uint8_t *data, uint32_t size);
 int chidb_Btree_insertInIndex(BTree *bt, npage_t nroot, key_t keyIdx, key_t keyPk);
+int chidb_Btree_insertInTextIndex(BTree *bt, npage_t nroot, const char *keyIdx, key_t keyPk);
 int chidb_Btree_insert(BTree *bt, npage_t nroot, BTreeCell *btc);
 int chidb_Btree_insertNonFull(BTree *bt, npage_t npage, BTreeCell *btc);
 int chidb_Btree_split(BTree *bt, npage_t npage_parent, npage_t npage_child, ncell_t parent_cell, npage_t *npage_child2);
 
+int chidb_Btree_delete(BTree *bt, npage_t nroot, key_t key);
+int chidb_Btree_deleteFromIndex(BTree *bt, npage_t nroot, BTreeCell *entry);
+int chidb_Btree_update(BTree *bt, npage_t nroot, key_t key, uint8_t *data, uint32_t size);
+
+int chidb_Btree_vacuum(BTree *bt);
+int chidb_Btree_setChecksums(BTree *bt, bool on);
+int chidb_Btree_setJournalMode(BTree *bt, int mode);
+
 
 #endif /*BTREE_H_*/
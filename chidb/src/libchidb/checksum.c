@@ -0,0 +1,157 @@
+/*****************************************************************************
+ *
+ *																 chidb
+ *
+ * This module computes the CRC32C checksums of pages (see
+ * chidb_Pager_setChecksums).
+ *
+ * On x86 processors with SSE4.2, the crc32 instruction computes CRC32C
+ * directly, eight bytes at a time. Elsewhere, the checksum is computed
+ * with the slicing-by-8 algorithm, which looks up each byte of an
+ * eight-byte word in its own table, so that the eight lookups do not
+ * depend on each other. Which one is used is decided once, at run
+ * time, so the library does not need to be built for SSE4.2.
+ *
+\*****************************************************************************/
+
+#include <string.h>
+#include <pthread.h>
+
+#include <chidbInt.h>
+
+#include "checksum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_SSE42
+#endif
+
+static uint32_t crc32c_table[8][256];
+static bool crc32c_sse42 = false;
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+
+static void chidb_Checksum_init(void)
+{
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t crc = i;
+		for (int j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (CRC32C_POLY & -(crc & 1));
+		crc32c_table[0][i] = crc;
+	}
+	/* Entry i of table k is the CRC of byte i followed by k zero bytes */
+	for (uint32_t i = 0; i < 256; i++)
+		for (int k = 1; k < 8; k++)
+			crc32c_table[k][i] = (crc32c_table[k - 1][i] >> 8) ^ crc32c_table[0][crc32c_table[k - 1][i] & 0xff];
+
+#ifdef CRC32C_SSE42
+	__builtin_cpu_init();
+	crc32c_sse42 = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+
+static uint32_t chidb_Checksum_slicing8(uint32_t crc, const uint8_t *buf, size_t len)
+{
+	while (len >= 8)
+	{
+		uint32_t lo = crc ^ ((uint32_t) buf[0] | (uint32_t) buf[1] << 8 | (uint32_t) buf[2] << 16 | (uint32_t) buf[3] << 24);
+		uint32_t hi = (uint32_t) buf[4] | (uint32_t) buf[5] << 8 | (uint32_t) buf[6] << 16 | (uint32_t) buf[7] << 24;
+		crc = crc32c_table[7][lo & 0xff] ^ crc32c_table[6][(lo >> 8) & 0xff] ^
+		      crc32c_table[5][(lo >> 16) & 0xff] ^ crc32c_table[4][lo >> 24] ^
+		      crc32c_table[3][hi & 0xff] ^ crc32c_table[2][(hi >> 8) & 0xff] ^
+		      crc32c_table[1][(hi >> 16) & 0xff] ^ crc32c_table[0][hi >> 24];
+		buf += 8;
+		len -= 8;
+	}
+	while (len-- > 0)
+		crc = crc32c_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+
+#ifdef CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t chidb_Checksum_sse42(uint32_t crc, const uint8_t *buf, size_t len)
+{
+#ifdef __x86_64__
+	uint64_t crc64 = crc;
+	while (len >= 8)
+	{
+		uint64_t word;
+		memcpy(&word, buf, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+		buf += 8;
+		len -= 8;
+	}
+	crc = (uint32_t) crc64;
+#endif
+	while (len >= 4)
+	{
+		uint32_t word;
+		memcpy(&word, buf, sizeof(word));
+		crc = _mm_crc32_u32(crc, word);
+		buf += 4;
+		len -= 4;
+	}
+	while (len-- > 0)
+		crc = _mm_crc32_u8(crc, *buf++);
+
+	return crc;
+}
+#endif
+
+
+/* Compute the CRC32C of a buffer
+ *
+ * Parameters
+ * - buf: Buffer.
+ * - len: Number of bytes.
+ *
+ * Return
+ * - The CRC32C of the buffer
+ */
+uint32_t chidb_Checksum_crc32c(const uint8_t *buf, size_t len)
+{
+	pthread_once(&crc32c_once, chidb_Checksum_init);
+#ifdef CRC32C_SSE42
+	if (crc32c_sse42)
+		return ~chidb_Checksum_sse42(~0u, buf, len);
+#endif
+
+	return ~chidb_Checksum_slicing8(~0u, buf, len);
+}
+
+
+/* Compute the CRC32C of a buffer without hardware support
+ *
+ * Gives the same result as chidb_Checksum_crc32c.
+ *
+ * Parameters
+ * - buf: Buffer.
+ * - len: Number of bytes.
+ *
+ * Return
+ * - The CRC32C of the buffer
+ */
+uint32_t chidb_Checksum_crc32cSoftware(const uint8_t *buf, size_t len)
+{
+	pthread_once(&crc32c_once, chidb_Checksum_init);
+
+	return ~chidb_Checksum_slicing8(~0u, buf, len);
+}
+
+
+/* Check whether checksums are computed with the crc32 instruction
+ *
+ * Return
+ * - true if the processor supports SSE4.2
+ */
+bool chidb_Checksum_hardware(void)
+{
+	pthread_once(&crc32c_once, chidb_Checksum_init);
+
+	return crc32c_sse42;
+}
@@ -0,0 +1,13 @@
+#ifndef CHECKSUM_H_
+#define CHECKSUM_H_
+
+#include <chidbInt.h>
+
+/* Reflected form of the Castagnoli polynomial */
+#define CRC32C_POLY (0x82F63B78)
+
+uint32_t chidb_Checksum_crc32c(const uint8_t *buf, size_t len);
+uint32_t chidb_Checksum_crc32cSoftware(const uint8_t *buf, size_t len);
+bool chidb_Checksum_hardware(void);
+
+#endif /*CHECKSUM_H_*/
@@ -35,6 +35,7 @@ dbm * init_dbm(chidb_stmt *stmt, uint8_t stopLoad, uint8_t forceLoad) {
 
 int get_table_size(dbm* input_dbm, int32_t table_num) {
 	if (table_num >= 0 && table_num < input_dbm->num_lists) {
+		load_list(input_dbm, table_num);
 		return *(input_dbm->list_lengths + table_num);
 	} else  {
 		return -1;
@@ -43,6 +44,9 @@ int get_table_size(dbm* input_dbm, int32_t table_num) {
 
 int operation_cursor_close(dbm *input_dbm, uint32_t cursor_id) {
 	//free(input_dbm->cursors[cursor_id].node);
+	free(input_dbm->cursors[cursor_id].data);
+	input_dbm->cursors[cursor_id].data = NULL;
+	input_dbm->cursors[cursor_id].on_tree = 0;
 	return DBM_OK;
 }
 
@@ -54,6 +58,13 @@ int clear_lists(dbm *input_dbm) {
 		free(input_dbm->cell_lists[i]);
 	}
 	free(input_dbm->cell_lists);
+	free(input_dbm->list_lengths);
+	free(input_dbm->list_loaded);
+	input_dbm->cell_lists = NULL;
+	input_dbm->list_lengths = NULL;
+	input_dbm->list_loaded = NULL;
+	input_dbm->num_lists = 0;
+	return DBM_OK;
 }
 
 //TODO: THIS NEEDS TO CLEAN Up ALL ALLOCATED CURSORS
@@ -87,93 +98,111 @@ int reset_dbm(dbm *input_dbm) {
 	return CHIDB_OK;
 }
 
-void add_nodes(chidb_stmt *stmt, int table_num, BTreeNode *node) {
+void add_nodes(dbm *input_dbm, int table_num, BTreeNode *node) {
 	if (node->type == PGTYPE_TABLE_LEAF || node->type == PGTYPE_INDEX_LEAF) {
-		uint32_t start = *(stmt->input_dbm->list_lengths + table_num);
-		*(stmt->input_dbm->list_lengths + table_num) += node->n_cells;
-		*(stmt->input_dbm->cell_lists + table_num) = realloc(*(stmt->input_dbm->cell_lists + table_num), sizeof(BTreeCell *) * *(stmt->input_dbm->list_lengths + table_num));
-		uint32_t end = *(stmt->input_dbm->list_lengths + table_num);
+		uint32_t start = *(input_dbm->list_lengths + table_num);
+		*(input_dbm->list_lengths + table_num) += node->n_cells;
+		*(input_dbm->cell_lists + table_num) = realloc(*(input_dbm->cell_lists + table_num), sizeof(BTreeCell *) * *(input_dbm->list_lengths + table_num));
+		uint32_t end = *(input_dbm->list_lengths + table_num);
 		int ecounter = 0;
 		for (int i = start; i < end; ++i) {
-			*(*(stmt->input_dbm->cell_lists + table_num) + i) = (BTreeCell *)malloc(sizeof(BTreeCell));
-			chidb_Btree_getCell(node, (ncell_t)ecounter, *(*(stmt->input_dbm->cell_lists + table_num) + i));
+			*(*(input_dbm->cell_lists + table_num) + i) = (BTreeCell *)malloc(sizeof(BTreeCell));
+			BTreeCell *cell = *(*(input_dbm->cell_lists + table_num) + i);
+			chidb_Btree_getCell(node, (ncell_t)ecounter, cell);
+			//RECORDS WITH OVERFLOW PAGES ARE READ IN FULL, SINCE DBM_COLUMN UNPACKS THE DATA POINTER
+			if (cell->type == PGTYPE_TABLE_LEAF && cell->fields.tableLeaf.overflow_page != 0) {
+				chidb_Btree_readPayload(input_dbm->db->bt, cell, &(cell->fields.tableLeaf.data));
+			}
 			ecounter += 1;	
 		}
 	}
 }
 
-void recursive_construct(chidb_stmt *stmt, BTree * bt, npage_t page_num, int table_num) {
+//INTERNAL NODES GO BACK TO THE B-TREE. LEAVES KEEP THEIR PAGE, SINCE THE CELL LISTS POINT INTO IT
+void release_node(BTree *bt, BTreeNode *node) {
+	if (node->type == PGTYPE_TABLE_INTERNAL || node->type == PGTYPE_INDEX_INTERNAL) {
+		chidb_Btree_freeMemNode(bt, node);
+	} else {
+		free(node->keys);
+		free(node);
+	}
+}
+
+void recursive_construct(dbm *input_dbm, npage_t page_num, int table_num) {
+	BTree *bt = input_dbm->db->bt;
 	BTreeNode *root_node;
-	chidb_Btree_getNodeByPage(bt, page_num, &(root_node));
+	int err = chidb_Btree_getNodeByPage(bt, page_num, &(root_node));
+	//A CORRUPTED PAGE FAILS THE STATEMENT, INSTEAD OF LOOKING EMPTY
+	if (err == CHIDB_ECHECKSUM) {
+		input_dbm->load_error = err;
+		release_node(bt, root_node);
+		return;
+	}
 	if (root_node->type == PGTYPE_TABLE_INTERNAL) {
 		int n_cells = root_node->n_cells;
 		for (int j = 0; j < n_cells; ++j) {
+			//PREFETCH THE NEXT WINDOW OF CHILDREN BEFORE DESCENDING INTO THEM
+			if (j % READAHEAD_PAGES == 0) {
+				chidb_Btree_prefetchChildren(bt, root_node, (ncell_t)j);
+			}
 			BTreeCell *curr = (BTreeCell *)malloc(sizeof(BTreeCell));
 			chidb_Btree_getCell(root_node, (ncell_t)j, curr);
 			npage_t child_page = curr->fields.tableInternal.child_page;
-			recursive_construct(stmt, bt, child_page, table_num);
+			recursive_construct(input_dbm, child_page, table_num);
 			free(curr);
 		}
 		if (root_node->right_page != NULL) {
-			recursive_construct(stmt, bt, root_node->right_page, table_num);
+			recursive_construct(input_dbm, root_node->right_page, table_num);
 		}
 	} else if (root_node->type == PGTYPE_INDEX_INTERNAL) {
 		int n_cells = root_node->n_cells;
 		for (int j = 0; j < n_cells; ++j) {
+			//PREFETCH THE NEXT WINDOW OF CHILDREN BEFORE DESCENDING INTO THEM
+			if (j % READAHEAD_PAGES == 0) {
+				chidb_Btree_prefetchChildren(bt, root_node, (ncell_t)j);
+			}
 			BTreeCell *curr = (BTreeCell *)malloc(sizeof(BTreeCell));
 			chidb_Btree_getCell(root_node, (ncell_t)j, curr);
 			npage_t child_page = curr->fields.tableInternal.child_page;
-			recursive_construct(stmt, bt, child_page, table_num);
+			recursive_construct(input_dbm, child_page, table_num);
 			free(curr);
 		}
 		if (root_node->right_page != NULL) {
-			recursive_construct(stmt, bt, root_node->right_page, table_num);
+			recursive_construct(input_dbm, root_node->right_page, table_num);
 		}
 	} else {
-		add_nodes(stmt, table_num, root_node);
+		add_nodes(input_dbm, table_num, root_node);
 	} 
-	free(root_node);
+	release_node(bt, root_node);
+}
+
+//THIS SETS UP EMPTY, NOT YET LOADED, LISTS FOR ALL THE TREES IN THE SCHEMA
+void prepare_lists(dbm *input_dbm) {
+	clear_lists(input_dbm);
+	input_dbm->num_lists = input_dbm->db->bt->schema_table_size;
+	input_dbm->cell_lists = (BTreeCell ***)calloc(input_dbm->num_lists, sizeof(BTreeCell **));
+	input_dbm->list_lengths = (uint32_t *)calloc(input_dbm->num_lists, sizeof(uint32_t));
+	input_dbm->list_loaded = (uint8_t *)calloc(input_dbm->num_lists, sizeof(uint8_t));
+	input_dbm->load_error = CHIDB_OK;
+}
+
+//THIS LOADS THE LIST OF ONE TREE. A STATEMENT THAT ONLY LOOKS UP A FEW ENTRIES (SEE DBM_SEEK AND
+//THE INDEX CURSORS) NEVER LOADS THE WHOLE TREE
+int load_list(dbm *input_dbm, uint32_t table_num) {
+	if (table_num >= input_dbm->num_lists) {
+		return CHIDB_ENOTFOUND;
+	}
+	if (input_dbm->list_loaded[table_num] == 0) {
+		input_dbm->list_loaded[table_num] = 1;
+		recursive_construct(input_dbm, input_dbm->db->bt->schema_table[table_num]->root_page, table_num);
+	}
+	return input_dbm->load_error;
 }
 
 void init_lists(chidb_stmt *stmt) {
-	stmt->input_dbm->cell_lists = (BTreeCell ***)malloc(sizeof(BTreeCell **) * stmt->db->bt->schema_table_size);
-	stmt->input_dbm->list_lengths = (uint32_t *)malloc(sizeof(uint32_t) * stmt->db->bt->schema_table_size);
-	stmt->input_dbm->num_lists = stmt->db->bt->schema_table_size; 
-	for (int i = 0; i < stmt->db->bt->schema_table_size; ++i) {
-		*(stmt->input_dbm->cell_lists + i) = NULL;
-		*(stmt->input_dbm->list_lengths + i) = 0;
-		int root_page_num = stmt->db->bt->schema_table[i]->root_page;
-		BTreeNode *root_node;
-		chidb_Btree_getNodeByPage(stmt->db->bt, root_page_num, &(root_node));
-		if (root_node->type == PGTYPE_TABLE_INTERNAL) {
-			int n_cells = root_node->n_cells;
-			for (int j = 0; j < n_cells; ++j) {
-				BTreeCell *curr = (BTreeCell *)malloc(sizeof(BTreeCell));
-				chidb_Btree_getCell(root_node, (ncell_t)j, curr);
-				npage_t child_page = curr->fields.tableInternal.child_page;
-				recursive_construct(stmt, stmt->db->bt, child_page, i);
-				free(curr);
-			}
-			if (root_node->right_page != NULL) {
-				recursive_construct(stmt, stmt->db->bt, root_node->right_page, i);
-			}
-		} else if (root_node->type == PGTYPE_INDEX_INTERNAL) {
-			int n_cells = root_node->n_cells;
-			for (int j = 0; j < n_cells; ++j) {
-				BTreeCell *curr = (BTreeCell *)malloc(sizeof(BTreeCell));
-				chidb_Btree_getCell(root_node, (ncell_t)j, curr);
-				npage_t child_page = curr->fields.tableInternal.child_page;
-				recursive_construct(stmt, stmt->db->bt, child_page, i);
-				free(curr);
-			}
-			if (root_node->right_page != NULL) {
-				recursive_construct(stmt, stmt->db->bt, root_node->right_page, i);
-			}
-		} else {
-			//PGTYPE_TABLE_LEAF
-			add_nodes(stmt, i, root_node);
-		}
-		free(root_node);
+	prepare_lists(stmt->input_dbm);
+	for (uint32_t i = 0; i < stmt->input_dbm->num_lists; ++i) {
+		load_list(stmt->input_dbm, i);
 	}
 }
 
@@ -491,155 +520,204 @@ int operation_ge(dbm *input_dbm, chidb_instruction inst) {
 	}
 }
 
-int operation_idxgt(dbm *input_dbm, chidb_instruction inst) {
-	if (input_dbm->registers[inst.P3].type == INTEGER) {
-		uint32_t table_num = input_dbm->cursors[inst.P1].table_num;
-		uint32_t pos =  input_dbm->cursors[inst.P1].pos;
-		int32_t PKey;
-		switch(input_dbm->cell_lists[table_num][pos]->type) {
-			case PGTYPE_INDEX_INTERNAL:
-				PKey = input_dbm->cell_lists[table_num][pos]->fields.indexInternal.keyPk;	
-			break;
-			case PGTYPE_INDEX_LEAF:
-				PKey = input_dbm->cell_lists[table_num][pos]->fields.indexLeaf.keyPk;
+//THE CELL A CURSOR POINTS TO: ITS OWN COPY, IF IT WAS POSITIONED IN THE B-TREE, OR ITS ENTRY IN THE CELL LIST
+BTreeCell *cursor_cell(dbm *input_dbm, uint32_t cursor_id) {
+	dbm_cursor *cursor = &(input_dbm->cursors[cursor_id]);
+	if (cursor->on_tree == 1) {
+		return &(cursor->cell);
+	}
+	return input_dbm->cell_lists[cursor->table_num][cursor->pos];
+}
+
+//TURNS AN ERROR FROM THE B-TREE MODULE INTO A DBM ERROR
+int btree_error(int retval) {
+	switch (retval) {
+		case CHIDB_OK: return DBM_OK;
+		case CHIDB_EDUPLICATE: return DBM_DUPLICATE_KEY;
+		case CHIDB_ENOMEM: return DBM_MEMORY_ERROR;
+		case CHIDB_ECORRUPT:
+		case CHIDB_ECHECKSUM: return DBM_CORRUPT;
+	}
+	return DBM_IO_ERROR;
+}
+
+//NUMBER OF COLUMNS IN THE KEYS OF AN INDEX CURSOR: P3 OF DBM_OPENREAD OR DBM_OPENWRITE (0 MEANS 1)
+uint32_t index_cols(dbm *input_dbm, uint32_t cursor_id) {
+	uint32_t cols = input_dbm->cursors[cursor_id].cols;
+	if (cols == 0) {
+		return 1;
+	}
+	return (cols > INDEXCELL_MAXCOLS) ? INDEXCELL_MAXCOLS : cols;
+}
+
+//BUILDS THE KEY TO COMPARE INDEX ENTRIES WITH FROM THE ncols REGISTERS STARTING AT reg, WHICH MUST HOLD INTEGERS,
+//STRINGS OR NULLS. IF prefix IS SET, THE KEY ENDS AT THE FIRST NULL, SO THAT ONLY THE COLUMNS BEFORE IT ARE COMPARED
+int register_index_key(dbm *input_dbm, uint32_t reg, uint32_t ncols, uint8_t prefix, key_t keyPk, BTreeCell *key) {
+	memset(key, 0, sizeof(BTreeCell));
+	key->type = PGTYPE_INDEX_LEAF;
+	key->fields.indexLeaf.keyPk = keyPk;
+	for (uint32_t i = reg; i < reg + ncols && i < DBM_MAX_REGISTERS; ++i) {
+		dbm_register *r = &(input_dbm->registers[i]);
+		if (r->type == INTEGER) {
+			chidb_Btree_appendIntKey(key, (key_t)r->data.int_val);
+		} else if (r->type == STRING && r->data.str_val != NULL) {
+			chidb_Btree_appendTextKey(key, r->data.str_val);
+		} else if (r->type == NL && prefix == 1) {
 			break;
-			default:
-				return DBM_INVALID_TYPE;
-		}
-		if (PKey > input_dbm->registers[inst.P3].data.int_val) {
-			input_dbm->program_counter = inst.P2;
+		} else if (r->type == NL) {
+			chidb_Btree_appendNullKey(key);
 		} else {
-			input_dbm->program_counter += 1;
+			return DBM_REGISTER_TYPE_MISMATCH;
 		}
+	}
+	return DBM_OK;
+}
+
+//MOVES AN INDEX CURSOR TO THE ENTRY chidb_Btree_seekIndex FINDS. found IS 0 IF THERE IS NONE, AND THE CURSOR DOES NOT MOVE
+int index_seek(dbm *input_dbm, uint32_t cursor_id, BTreeCell *key, bool pk, int op, uint8_t *found) {
+	dbm_cursor *cursor = &(input_dbm->cursors[cursor_id]);
+	BTreeCell cell;
+	int retval = chidb_Btree_seekIndex(input_dbm->db->bt, (npage_t)cursor->root_page_num, key, pk, op, &cell);
+	*found = 0;
+	if (retval == CHIDB_ENOTFOUND) {
 		return DBM_OK;
+	}
+	if (retval != CHIDB_OK) {
+		return btree_error(retval);
+	}
+	cursor->cell = cell;
+	cursor->on_tree = 1;
+	*found = 1;
+	return DBM_OK;
+}
+
+//COMPARES THE IdxKey OF THE ENTRY CURSOR P1 POINTS TO WITH THE KEY IN THE REGISTERS STARTING AT P3, ONE PER INDEXED
+//COLUMN UP TO THE FIRST NULL (SEE chidb_Btree_compareIndex)
+int index_compare(dbm *input_dbm, chidb_instruction inst, int *cmp) {
+	BTreeCell key;
+	BTreeCell *entry = cursor_cell(input_dbm, inst.P1);
+	if (entry->type != PGTYPE_INDEX_INTERNAL && entry->type != PGTYPE_INDEX_LEAF) {
+		return DBM_INVALID_TYPE;
+	}
+	int retval = register_index_key(input_dbm, inst.P3, index_cols(input_dbm, inst.P1), 1, 0, &key);
+	if (retval != DBM_OK) {
+		return retval;
+	}
+	*cmp = chidb_Btree_compareIndex(entry, &key, false);
+	return DBM_OK;
+}
+
+int operation_idxgt(dbm *input_dbm, chidb_instruction inst) {
+	int cmp;
+	int retval = index_compare(input_dbm, inst, &cmp);
+	if (retval != DBM_OK) {
+		return retval;
+	}
+	if (cmp > 0) {
+		input_dbm->program_counter = inst.P2;
 	} else {
-		return DBM_REGISTER_TYPE_MISMATCH;
-	}    
+		input_dbm->program_counter += 1;
+	}
+	return DBM_OK;
 }
 
 int operation_idxge(dbm *input_dbm, chidb_instruction inst) {
-	if (input_dbm->registers[inst.P3].type == INTEGER) {
-		uint32_t table_num = input_dbm->cursors[inst.P1].table_num;
-		uint32_t pos =  input_dbm->cursors[inst.P1].pos;
-		int32_t PKey;
-		switch(input_dbm->cell_lists[table_num][pos]->type) {
-			case PGTYPE_INDEX_INTERNAL:
-				PKey = input_dbm->cell_lists[table_num][pos]->fields.indexInternal.keyPk;	
-			break;
-			case PGTYPE_INDEX_LEAF:
-				PKey = input_dbm->cell_lists[table_num][pos]->fields.indexLeaf.keyPk;
-			break;
-			default:
-				return DBM_INVALID_TYPE;
-		}
-		if (PKey >= input_dbm->registers[inst.P3].data.int_val) {
-			input_dbm->program_counter = inst.P2;
-		} else {
-			input_dbm->program_counter += 1;
-		}
-		return DBM_OK;
+	int cmp;
+	int retval = index_compare(input_dbm, inst, &cmp);
+	if (retval != DBM_OK) {
+		return retval;
+	}
+	if (cmp >= 0) {
+		input_dbm->program_counter = inst.P2;
 	} else {
-		return DBM_REGISTER_TYPE_MISMATCH;
+		input_dbm->program_counter += 1;
 	}
+	return DBM_OK;
 }
 
-int operation_idxlt(dbm *input_dbm, chidb_instruction inst) {	
-	if (input_dbm->registers[inst.P3].type == INTEGER) {
-		uint32_t table_num = input_dbm->cursors[inst.P1].table_num;
-		uint32_t pos =  input_dbm->cursors[inst.P1].pos;
-		int32_t PKey;
-		switch(input_dbm->cell_lists[table_num][pos]->type) {
-			case PGTYPE_INDEX_INTERNAL:
-				PKey = input_dbm->cell_lists[table_num][pos]->fields.indexInternal.keyPk;	
-			break;
-			case PGTYPE_INDEX_LEAF:
-				PKey = input_dbm->cell_lists[table_num][pos]->fields.indexLeaf.keyPk;
-			break;
-			default:
-				return DBM_INVALID_TYPE;
-		}
-		if (PKey < input_dbm->registers[inst.P3].data.int_val) {
-			input_dbm->program_counter = inst.P2;
-		} else {
-			input_dbm->program_counter += 1;
-		}
-		return DBM_OK;
+int operation_idxlt(dbm *input_dbm, chidb_instruction inst) {
+	int cmp;
+	int retval = index_compare(input_dbm, inst, &cmp);
+	if (retval != DBM_OK) {
+		return retval;
+	}
+	if (cmp < 0) {
+		input_dbm->program_counter = inst.P2;
 	} else {
-		return DBM_REGISTER_TYPE_MISMATCH;
+		input_dbm->program_counter += 1;
 	}
+	return DBM_OK;
 }
 
 int operation_idxle(dbm *input_dbm, chidb_instruction inst) {
-	if (input_dbm->registers[inst.P3].type == INTEGER) {
-		uint32_t table_num = input_dbm->cursors[inst.P1].table_num;
-		uint32_t pos =  input_dbm->cursors[inst.P1].pos;
-		int32_t PKey;
-		switch(input_dbm->cell_lists[table_num][pos]->type) {
-			case PGTYPE_INDEX_INTERNAL:
-				PKey = input_dbm->cell_lists[table_num][pos]->fields.indexInternal.keyPk;	
-			break;
-			case PGTYPE_INDEX_LEAF:
-				PKey = input_dbm->cell_lists[table_num][pos]->fields.indexLeaf.keyPk;
-			break;
-			default:
-				return DBM_INVALID_TYPE;
-		}
-		if (PKey <= input_dbm->registers[inst.P3].data.int_val) {
-			input_dbm->program_counter = inst.P2;
-		} else {
-			input_dbm->program_counter += 1;
-		}
-		return DBM_OK;
+	int cmp;
+	int retval = index_compare(input_dbm, inst, &cmp);
+	if (retval != DBM_OK) {
+		return retval;
+	}
+	if (cmp <= 0) {
+		input_dbm->program_counter = inst.P2;
 	} else {
-		return DBM_REGISTER_TYPE_MISMATCH;
+		input_dbm->program_counter += 1;
 	}
+	return DBM_OK;
 }
 
 int operation_idxkey(dbm *input_dbm, chidb_instruction inst) {
     key_t key;
-    uint32_t table_num = input_dbm->cursors[inst.P1].table_num;
-    uint32_t pos =  input_dbm->cursors[inst.P1].pos;
+    BTreeCell *cell = cursor_cell(input_dbm, inst.P1);
 
-    switch(input_dbm->cell_lists[table_num][pos]->type) {
+    switch(cell->type) {
         case PGTYPE_INDEX_INTERNAL:
-            key = input_dbm->cell_lists[table_num][pos]->fields.indexInternal.keyPk;
+            key = cell->fields.indexInternal.keyPk;
             break;
         case PGTYPE_INDEX_LEAF:
-            key = input_dbm->cell_lists[table_num][pos]->fields.indexLeaf.keyPk;
+            key = cell->fields.indexLeaf.keyPk;
             break;
+        default:
+            return DBM_INVALID_TYPE;
     }
     input_dbm->registers[inst.P2].type = INTEGER;
-    input_dbm->registers[inst.P2].data.int_val = (int32_t)key;
-    input_dbm->registers[inst.P2].int_type = INT32;
+    input_dbm->registers[inst.P2].data.int_val = (int64_t)key;
+    input_dbm->registers[inst.P2].int_type = INT64;
+    input_dbm->program_counter += 1;
     return DBM_OK;
 }
 
 
 int operation_createtable(dbm * input_dbm, chidb_instruction inst) {
-    int res = chidb_Btree_newNode(input_dbm->db->bt, &input_dbm->registers[inst.P1].data.int_val,PGTYPE_TABLE_LEAF); 
+    npage_t npage;
+    int res = chidb_Btree_newNode(input_dbm->db->bt, &npage,PGTYPE_TABLE_LEAF); 
+    input_dbm->registers[inst.P1].type = INTEGER;
+    input_dbm->registers[inst.P1].int_type = INT32;
+    input_dbm->registers[inst.P1].data.int_val = npage;
+    input_dbm->program_counter += 1;
     if (res == CHIDB_OK) return DBM_OK;
     return res;
 }
 
 int operation_createindex(dbm * input_dbm, chidb_instruction inst) {
-    int res = chidb_Btree_newNode(input_dbm->db->bt, &input_dbm->registers[inst.P1].data.int_val,PGTYPE_INDEX_LEAF);
+    npage_t npage;
+    int res = chidb_Btree_newNode(input_dbm->db->bt, &npage,PGTYPE_INDEX_LEAF);
+    input_dbm->registers[inst.P1].type = INTEGER;
+    input_dbm->registers[inst.P1].int_type = INT32;
+    input_dbm->registers[inst.P1].data.int_val = npage;
+    input_dbm->program_counter += 1;
     if (res == CHIDB_OK) return DBM_OK;
     return res;
 }
 
 int operation_key(dbm *input_dbm, chidb_instruction inst) {
 	input_dbm->registers[inst.P2].type = INTEGER;
-	uint32_t table_num = input_dbm->cursors[inst.P1].table_num;
-	uint32_t pos = input_dbm->cursors[inst.P1].pos;
-	input_dbm->registers[inst.P2].data.int_val = (int32_t)input_dbm->cell_lists[table_num][pos]->key;
-	input_dbm->registers[inst.P2].int_type = INT32;
+	input_dbm->registers[inst.P2].data.int_val = (int64_t)cursor_cell(input_dbm, inst.P1)->key;
+	input_dbm->registers[inst.P2].int_type = INT64;
 	input_dbm->registers[inst.P2].touched = 0;
 	return DBM_OK;
 }
 
 int operation_integer(dbm *input_dbm, chidb_instruction inst) {
 	input_dbm->registers[inst.P2].type = INTEGER;
-	input_dbm->registers[inst.P2].data.int_val = inst.P1;
+	input_dbm->registers[inst.P2].data.int_val = (int32_t)inst.P1; //P1 IS A 32-BIT SIGNED VALUE
 	input_dbm->registers[inst.P2].int_type = INT32;
 	input_dbm->registers[inst.P2].touched = 0;
 	return DBM_OK;
@@ -662,8 +740,27 @@ int operation_string(dbm *input_dbm, chidb_instruction inst) {
 }
 
 int operation_rewind(dbm *input_dbm, chidb_instruction inst) {
-	if (input_dbm->cursors[inst.P1].touched == 1) {
-		input_dbm->cursors[inst.P1].pos = 0;
+	dbm_cursor *cursor = &(input_dbm->cursors[inst.P1]);
+	if (cursor->touched == 1 && cursor->is_index == 1) {
+		//AN EMPTY KEY MATCHES EVERY ENTRY, SO THE FIRST ENTRY IS THE FIRST ONE WITH A PRIMARY KEY >= 0
+		BTreeCell key;
+		uint8_t found;
+		memset(&key, 0, sizeof(BTreeCell));
+		key.type = PGTYPE_INDEX_LEAF;
+		int retval = index_seek(input_dbm, inst.P1, &key, true, INDEXSEEK_GE, &found);
+		if (retval != DBM_OK) {
+			return retval;
+		}
+		input_dbm->program_counter = found ? input_dbm->program_counter + 1 : inst.P2;
+		return DBM_OK;
+	}
+	if (cursor->touched == 1 && load_list(input_dbm, cursor->table_num) == CHIDB_ECHECKSUM) {
+		return DBM_CORRUPT;
+	}
+	//AN EMPTY TABLE HAS NO FIRST ENTRY TO POINT TO, SO IT IS TREATED LIKE AN UNOPENED CURSOR
+	if (cursor->touched == 1 && get_table_size(input_dbm, cursor->table_num) > 0) {
+		cursor->pos = 0;
+		cursor->on_tree = 0;
 		input_dbm->program_counter += 1;
 		return DBM_OK;
 	} else {
@@ -694,7 +791,11 @@ int operation_db_record(dbm *input_dbm, chidb_instruction inst) {
 			    	    chidb_DBRecord_appendInt16(dbrb, input_dbm->registers[i].data.int_val);
                         break;
                     case SQL_INTEGER_4BYTE:
-        				chidb_DBRecord_appendInt32(dbrb, input_dbm->registers[i].data.int_val);
+                        //VALUES THAT DO NOT FIT IN 4 BYTES ARE STORED IN 8
+                        if (input_dbm->registers[i].data.int_val == (int32_t)input_dbm->registers[i].data.int_val)
+        				    chidb_DBRecord_appendInt32(dbrb, input_dbm->registers[i].data.int_val);
+                        else
+                            chidb_DBRecord_appendInt64(dbrb, input_dbm->registers[i].data.int_val);
                         break;
                 }
 			break;
@@ -719,9 +820,60 @@ int operation_db_record(dbm *input_dbm, chidb_instruction inst) {
 	return DBM_OK;
 }
 
+//FIRST POSITION IN THE (LOADED) CELL LIST OF A TABLE WITH A KEY >= key, OR > key IF strict IS SET.
+//THE LIST IS IN KEY ORDER, SO IT IS A BINARY SEARCH
+uint32_t list_search(dbm *input_dbm, uint32_t table_num, key_t key, uint8_t strict) {
+	uint32_t lo = 0, hi = *(input_dbm->list_lengths + table_num);
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		key_t curr = input_dbm->cell_lists[table_num][mid]->key;
+		if (curr < key || (strict && curr == key)) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+//A TABLE CURSOR THAT DBM_SEEK POSITIONED IN THE B-TREE MOVES TO THE CELL LIST, ON THE FIRST KEY AFTER
+//THE ONE IT POINTS TO (OR ON THAT KEY, IF strict IS NOT SET)
+int cursor_to_list(dbm *input_dbm, uint32_t cursor_id, uint8_t strict) {
+	dbm_cursor *cursor = &(input_dbm->cursors[cursor_id]);
+	if (load_list(input_dbm, cursor->table_num) == CHIDB_ECHECKSUM) {
+		return DBM_CORRUPT;
+	}
+	cursor->pos = list_search(input_dbm, cursor->table_num, cursor->cell.key, strict);
+	cursor->on_tree = 0;
+	free(cursor->data);
+	cursor->data = NULL;
+	return DBM_OK;
+}
+
 int operation_next(dbm *input_dbm, chidb_instruction inst) {
-	if ((input_dbm->cursors[inst.P1].pos + 1) < *(input_dbm->list_lengths + input_dbm->cursors[inst.P1].table_num)) {
-		input_dbm->cursors[inst.P1].pos += 1;
+	dbm_cursor *cursor = &(input_dbm->cursors[inst.P1]);
+	if (cursor->is_index == 1) {
+		uint8_t found = 0;
+		if (cursor->on_tree == 1) {
+			BTreeCell key = cursor->cell;
+			int retval = index_seek(input_dbm, inst.P1, &key, true, INDEXSEEK_GT, &found);
+			if (retval != DBM_OK) {
+				return retval;
+			}
+		}
+		input_dbm->program_counter = found ? inst.P2 : input_dbm->program_counter + 1;
+		return DBM_OK;
+	}
+	if (cursor->on_tree == 1) {
+		int retval = cursor_to_list(input_dbm, inst.P1, 1);
+		if (retval != DBM_OK) {
+			return retval;
+		}
+		input_dbm->program_counter = ((int64_t)cursor->pos < get_table_size(input_dbm, cursor->table_num)) ? inst.P2 : input_dbm->program_counter + 1;
+		return DBM_OK;
+	}
+	if ((int64_t)cursor->pos + 1 < get_table_size(input_dbm, cursor->table_num)) {
+		cursor->pos += 1;
 		input_dbm->program_counter = inst.P2;
 	} else {
 		input_dbm->program_counter += 1;
@@ -730,102 +882,185 @@ int operation_next(dbm *input_dbm, chidb_instruction inst) {
 }
 
 int operation_prev(dbm *input_dbm, chidb_instruction inst) {
-	if (input_dbm->cursors[inst.P1].pos > 0) {
-		input_dbm->cursors[inst.P1].pos -= 1;
+	dbm_cursor *cursor = &(input_dbm->cursors[inst.P1]);
+	if (cursor->is_index == 1) {
+		uint8_t found = 0;
+		if (cursor->on_tree == 1) {
+			BTreeCell key = cursor->cell;
+			int retval = index_seek(input_dbm, inst.P1, &key, true, INDEXSEEK_LT, &found);
+			if (retval != DBM_OK) {
+				return retval;
+			}
+		}
+		input_dbm->program_counter = found ? inst.P2 : input_dbm->program_counter + 1;
+		return DBM_OK;
+	}
+	if (cursor->on_tree == 1) {
+		int retval = cursor_to_list(input_dbm, inst.P1, 0);
+		if (retval != DBM_OK) {
+			return retval;
+		}
+	}
+	if (cursor->pos > 0) {
+		cursor->pos -= 1;
 		input_dbm->program_counter = inst.P2;
 	} else {
 		input_dbm->program_counter += 1;
 	}
 	return DBM_OK;
 }
-//TODO - RETURN HERE
+
+//POSITIONS AN INDEX CURSOR ON THE FIRST ENTRY WHOSE IdxKey IS >= (OR >) THE KEY IN THE REGISTERS STARTING AT P3
+//(SEE index_compare), OR ON THE FIRST ONE EQUAL TO IT FOR DBM_SEEK. JUMPS TO P2 IF THERE IS NONE
+int operation_index_seek(dbm *input_dbm, chidb_instruction inst) {
+	BTreeCell key;
+	uint8_t found;
+	int retval = register_index_key(input_dbm, inst.P3, index_cols(input_dbm, inst.P1), 1, 0, &key);
+	if (retval != DBM_OK) {
+		return retval;
+	}
+	retval = index_seek(input_dbm, inst.P1, &key, false, (inst.instruction == DBM_SEEKGT) ? INDEXSEEK_GT : INDEXSEEK_GE, &found);
+	if (retval != DBM_OK) {
+		return retval;
+	}
+	if (found && inst.instruction == DBM_SEEK && chidb_Btree_compareIndex(&(input_dbm->cursors[inst.P1].cell), &key, false) != 0) {
+		found = 0;
+	}
+	input_dbm->program_counter = found ? input_dbm->program_counter + 1 : inst.P2;
+	return DBM_OK;
+}
 
 int operation_seek(dbm* input_dbm, chidb_instruction inst) {
-	uint32_t old_pos = input_dbm->cursors[inst.P1].pos;
-	uint32_t curr = 0;
-	uint32_t table_num = input_dbm->cursors[inst.P1].table_num;
-	int32_t cmp_val = input_dbm->registers[inst.P3].data.int_val;
-	uint8_t found = 0;
-	for (; curr < *(input_dbm->list_lengths + input_dbm->cursors[inst.P1].table_num); ++curr) {
-		if (cmp_val == input_dbm->cell_lists[table_num][curr]->key) {
-			found = 1;
-			break;
-		}
+	dbm_cursor *cursor = &(input_dbm->cursors[inst.P1]);
+	key_t key = (key_t)input_dbm->registers[inst.P3].data.int_val;
+	if (cursor->is_index == 1) {
+		return operation_index_seek(input_dbm, inst);
 	}
-	if (found == 1) {
-		input_dbm->cursors[inst.P1].pos = curr;
-		input_dbm->program_counter += 1;
+	if (cursor->table_num < input_dbm->num_lists && input_dbm->list_loaded[cursor->table_num] == 1) {
+		uint32_t curr = list_search(input_dbm, cursor->table_num, key, 0);
+		if (curr < *(input_dbm->list_lengths + cursor->table_num) && input_dbm->cell_lists[cursor->table_num][curr]->key == key) {
+			cursor->pos = curr;
+			cursor->on_tree = 0;
+			input_dbm->program_counter += 1;
+		} else {
+			input_dbm->program_counter = inst.P2;
+		}
 		return DBM_OK;
-	} else {
-		input_dbm->cursors[inst.P1].pos = old_pos;
+	}
+	
+	//A SINGLE LOOKUP GOES DOWN THE B-TREE, INSTEAD OF LOADING THE WHOLE TABLE
+	uint8_t *data;
+	uint32_t size;
+	int retval = chidb_Btree_find(input_dbm->db->bt, (npage_t)cursor->root_page_num, key, &data, &size);
+	if (retval == CHIDB_ENOTFOUND) {
 		input_dbm->program_counter = inst.P2;
 		return DBM_OK;
 	}
+	if (retval != CHIDB_OK) {
+		return btree_error(retval);
+	}
+	free(cursor->data);
+	cursor->data = data;
+	memset(&(cursor->cell), 0, sizeof(BTreeCell));
+	cursor->cell.type = PGTYPE_TABLE_LEAF;
+	cursor->cell.key = key;
+	cursor->cell.fields.tableLeaf.data_size = size;
+	cursor->cell.fields.tableLeaf.data = data;
+	cursor->on_tree = 1;
+	input_dbm->program_counter += 1;
+	return DBM_OK;
 }
 
 int operation_seekgt(dbm* input_dbm, chidb_instruction inst) {
-	uint32_t old_pos = input_dbm->cursors[inst.P1].pos;
-	uint32_t curr = 0;
-	uint32_t table_num = input_dbm->cursors[inst.P1].table_num;
-	int32_t cmp_val = input_dbm->registers[inst.P3].data.int_val;
-	uint8_t found = 0;
-	for (; curr < *(input_dbm->list_lengths + input_dbm->cursors[inst.P1].table_num); ++curr) {
-		if (cmp_val < input_dbm->cell_lists[table_num][curr]->key) {
-			found = 1;
-			break;
-		}
+	dbm_cursor *cursor = &(input_dbm->cursors[inst.P1]);
+	if (cursor->is_index == 1) {
+		return operation_index_seek(input_dbm, inst);
+	}
+	if (load_list(input_dbm, cursor->table_num) == CHIDB_ECHECKSUM) {
+		return DBM_CORRUPT;
 	}
-	if (found == 1) {
-		input_dbm->cursors[inst.P1].pos = curr;
+	uint32_t curr = list_search(input_dbm, cursor->table_num, (key_t)input_dbm->registers[inst.P3].data.int_val, 1);
+	if ((int64_t)curr < get_table_size(input_dbm, cursor->table_num)) {
+		cursor->pos = curr;
+		cursor->on_tree = 0;
 		input_dbm->program_counter += 1;
-		return DBM_OK;
 	} else {
-		input_dbm->cursors[inst.P1].pos = old_pos;
 		input_dbm->program_counter = inst.P2;
-		return DBM_OK;
 	}
+	return DBM_OK;
 }
 
 int operation_seekge(dbm* input_dbm, chidb_instruction inst) {
-	uint32_t old_pos = input_dbm->cursors[inst.P1].pos;
-	uint32_t curr = 0;
-	uint32_t table_num = input_dbm->cursors[inst.P1].table_num;
-	int32_t cmp_val = input_dbm->registers[inst.P3].data.int_val;
-	uint8_t found = 0;
-	for (; curr < *(input_dbm->list_lengths + input_dbm->cursors[inst.P1].table_num); ++curr) {
-		if (cmp_val <= input_dbm->cell_lists[table_num][curr]->key) {
-			found = 1;
-			break;
-		}
+	dbm_cursor *cursor = &(input_dbm->cursors[inst.P1]);
+	if (cursor->is_index == 1) {
+		return operation_index_seek(input_dbm, inst);
+	}
+	if (load_list(input_dbm, cursor->table_num) == CHIDB_ECHECKSUM) {
+		return DBM_CORRUPT;
 	}
-	if (found == 1) {
-		input_dbm->cursors[inst.P1].pos = curr;
+	uint32_t curr = list_search(input_dbm, cursor->table_num, (key_t)input_dbm->registers[inst.P3].data.int_val, 0);
+	if ((int64_t)curr < get_table_size(input_dbm, cursor->table_num)) {
+		cursor->pos = curr;
+		cursor->on_tree = 0;
 		input_dbm->program_counter += 1;
-		return DBM_OK;
 	} else {
-		input_dbm->cursors[inst.P1].pos = old_pos;
 		input_dbm->program_counter = inst.P2;
-		return DBM_OK;
 	}
+	return DBM_OK;
 }
 
+//DBM_IDXINSERT AND DBM_IDXDELETE
+//ADD OR REMOVE THE ENTRY (IdxKey IN THE REGISTERS STARTING AT P2, ONE PER INDEXED COLUMN, AND PKey IN REGISTER P3)
+//TO OR FROM THE INDEX OF CURSOR P1. AN IdxKey THAT IS ALL NULLS IS NOT INDEXED, AND REMOVING AN ENTRY THAT IS NOT
+//THERE IS NOT AN ERROR
 int operation_idxinsert(dbm *input_dbm, chidb_instruction inst) {
-  key_t keyIdx = (key_t)input_dbm->registers[inst.P2].data.int_val;
-  key_t keyPk = (key_t)input_dbm->registers[inst.P3].data.int_val;
-  npage_t nroot = (npage_t)input_dbm->table_root;
+  BTreeCell entry;
+  npage_t nroot = (npage_t)input_dbm->cursors[inst.P1].root_page_num;
+  int retval, nulls = 0;
 
-  int retval = chidb_Btree_insertInIndex(input_dbm->db->bt, nroot, keyIdx, keyPk);
+  input_dbm->program_counter += 1;
+  retval = register_index_key(input_dbm, inst.P2, index_cols(input_dbm, inst.P1), 0, (key_t)input_dbm->registers[inst.P3].data.int_val, &entry);
+  if (retval != DBM_OK) {
+      return retval;
+  }
+  for (int i = 0; i < entry.key_ncols; i++) {
+      nulls += (entry.key_cols[i].type == INDEXKEY_NULL);
+  }
+  if (nulls == entry.key_ncols) {
+      return DBM_OK;
+  }
 
-  switch (retval) {
-      case CHIDB_EDUPLICATE: return DBM_DUPLICATE_KEY; break;
-      case CHIDB_ENOMEM: return DBM_MEMORY_ERROR; break;
-      case CHIDB_EIO: return DBM_IO_ERROR; break;
+  if (inst.instruction == DBM_IDXDELETE) {
+      retval = chidb_Btree_deleteFromIndex(input_dbm->db->bt, nroot, &entry);
+      if (retval == CHIDB_ENOTFOUND) {
+          retval = CHIDB_OK;
+      }
+  } else {
+      retval = chidb_Btree_insert(input_dbm->db->bt, nroot, &entry);
   }
-  return DBM_OK;
+  return btree_error(retval);
+}
+
+//DBM_ADDSCHEMA
+//ADDS A ROW TO THE SCHEMA TABLE (SEE chidb_add_schema) FROM THE FIVE REGISTERS STARTING AT P1:
+//TYPE, NAME, TABLE NAME, ROOT PAGE AND SQL
+int operation_addschema(dbm *input_dbm, chidb_instruction inst) {
+	dbm_register *r = &(input_dbm->registers[inst.P1]);
+	
+	input_dbm->program_counter += 1;
+	if (r[0].type != STRING || r[1].type != STRING || r[2].type != STRING || r[3].type != INTEGER || r[4].type != STRING) {
+		return DBM_REGISTER_TYPE_MISMATCH;
+	}
+	int retval = chidb_add_schema(input_dbm->db, r[0].data.str_val, r[1].data.str_val, r[2].data.str_val, (int)r[3].data.int_val, r[4].data.str_val);
+	if (retval == CHIDB_EDUPLICATE) {
+		return DBM_DUPLICATE_KEY;
+	}
+	return btree_error(retval);
 }
 
 int operation_scopy(dbm *input_dbm, chidb_instruction inst) {
 	input_dbm->registers[inst.P2].type = input_dbm->registers[inst.P1].type;
+	input_dbm->registers[inst.P2].touched = 0; //A SHALLOW COPY DOES NOT OWN THE VALUE
   
 	switch (input_dbm->registers[inst.P1].type) {
   		case INTEGER:
@@ -846,6 +1081,7 @@ int operation_scopy(dbm *input_dbm, chidb_instruction inst) {
 			input_dbm->registers[inst.P2].data.record_val = input_dbm->registers[inst.P1].data.record_val;
 		break;
   	}
+  input_dbm->program_counter += 1;
   return DBM_OK;
 }
 
@@ -856,7 +1092,7 @@ int operation_insert_record(dbm *input_dbm, chidb_instruction inst) {
     if (input_dbm->registers[inst.P2].type == RECORD) {
     	uint8_t *packed_record;
     	 chidb_DBRecord_pack(input_dbm->registers[inst.P2].data.record_val, &(packed_record));
-			int retval = chidb_Btree_insertInTable(input_dbm->db->bt, (npage_t)input_dbm->cursors[inst.P1].root_page_num, (key_t)input_dbm->registers[inst.P3].data.int_val, packed_record, (uint16_t)input_dbm->registers[inst.P2].data.record_val->packed_len);
+			int retval = chidb_Btree_insertInTable(input_dbm->db->bt, (npage_t)input_dbm->cursors[inst.P1].root_page_num, (key_t)input_dbm->registers[inst.P3].data.int_val, packed_record, input_dbm->registers[inst.P2].data.record_val->packed_len);
     if (retval == CHIDB_EDUPLICATE) {
 			return DBM_DUPLICATE_KEY;
 		}
@@ -872,12 +1108,102 @@ int operation_insert_record(dbm *input_dbm, chidb_instruction inst) {
 	return DBM_OK;
 }
 
+//DBM_UPDATE
+//REPLACES THE RECORD OF AN EXISTING ENTRY. SAME OPERANDS AS DBM_INSERT
+int operation_update_record(dbm *input_dbm, chidb_instruction inst) {
+	input_dbm->program_counter += 1;
+	
+	if (input_dbm->registers[inst.P2].type != RECORD) {
+		return DBM_INVALID_TYPE;
+	}
+	uint8_t *packed_record;
+	if (chidb_DBRecord_pack(input_dbm->registers[inst.P2].data.record_val, &(packed_record)) != CHIDB_OK) {
+		return DBM_MEMORY_ERROR;
+	}
+	int retval = chidb_Btree_update(input_dbm->db->bt, (npage_t)input_dbm->cursors[inst.P1].root_page_num, (key_t)input_dbm->registers[inst.P3].data.int_val, packed_record, input_dbm->registers[inst.P2].data.record_val->packed_len);
+	free(packed_record);
+	return btree_error(retval);
+}
+
+//DBM_DELETE
+//REMOVES THE ENTRY THE CURSOR POINTS TO FROM ITS B-TREE. THE CURSOR KEEPS ITS POSITION
+//IN THE (ALREADY LOADED) CELL LIST, SO DBM_NEXT STILL MOVES ON TO THE FOLLOWING ENTRY
+int operation_delete(dbm *input_dbm, chidb_instruction inst) {
+	key_t key = cursor_cell(input_dbm, inst.P1)->key;
+	
+	input_dbm->program_counter += 1;
+	int retval = chidb_Btree_delete(input_dbm->db->bt, (npage_t)input_dbm->cursors[inst.P1].root_page_num, key);
+	return btree_error(retval);
+}
+
+//DBM_VACUUM
+//REBUILDS EVERY B-TREE IN THE FILE (SEE chidb_Btree_vacuum). NO OPERANDS
+int operation_vacuum(dbm *input_dbm, chidb_instruction inst) {
+	input_dbm->program_counter += 1;
+	int retval = chidb_Btree_vacuum(input_dbm->db->bt);
+	if (retval == CHIDB_ENOMEM) {
+		return DBM_MEMORY_ERROR;
+	}
+	if (retval == CHIDB_EMISUSE) {
+		return DBM_MISUSE;
+	}
+	if (retval != CHIDB_OK) {
+		return DBM_IO_ERROR;
+	}
+	return DBM_OK;
+}
+
+//DBM_BEGIN, DBM_COMMIT, DBM_ROLLBACK
+//START OR END A TRANSACTION (SEE chidb_begin, chidb_commit AND chidb_rollback). NO OPERANDS
+int operation_transaction(dbm *input_dbm, chidb_instruction inst) {
+	int retval;
+	
+	input_dbm->program_counter += 1;
+	if (inst.instruction == DBM_BEGIN) {
+		retval = chidb_begin(input_dbm->db);
+	} else if (inst.instruction == DBM_COMMIT) {
+		retval = chidb_commit(input_dbm->db);
+	} else {
+		retval = chidb_rollback(input_dbm->db);
+	}
+	if (retval == CHIDB_EMISUSE) {
+		return DBM_MISUSE;
+	}
+	if (retval == CHIDB_ENOMEM) {
+		return DBM_MEMORY_ERROR;
+	}
+	if (retval != CHIDB_OK) {
+		return DBM_IO_ERROR;
+	}
+	return DBM_OK;
+}
+
+//DBM_PRAGMA
+//CHANGES THE SETTING P1 (A DBM_PRAGMA_* CODE) TO THE VALUE P2
+int operation_pragma(dbm *input_dbm, chidb_instruction inst) {
+	int retval;
+	
+	input_dbm->program_counter += 1;
+	if (inst.P1 == DBM_PRAGMA_SYNCHRONOUS) {
+		retval = chidb_synchronous(input_dbm->db, inst.P2);
+	} else {
+		retval = chidb_journal_mode(input_dbm->db, inst.P2);
+	}
+	if (retval == CHIDB_EMISUSE) {
+		return DBM_MISUSE;
+	}
+	if (retval == CHIDB_ENOMEM) {
+		return DBM_MEMORY_ERROR;
+	}
+	if (retval != CHIDB_OK) {
+		return DBM_IO_ERROR;
+	}
+	return DBM_OK;
+}
+
 int operation_column(dbm *input_dbm, chidb_instruction inst) {
 	DBRecord *record;
-	uint32_t table_num = input_dbm->cursors[inst.P1].table_num;
-	uint32_t pos = input_dbm->cursors[inst.P1].pos;
-	//input_dbm->registers[inst.P2].data.int_val = (int32_t)input_dbm->cell_lists[table_num][pos]->key;
-	chidb_DBRecord_unpack(&(record), input_dbm->cell_lists[table_num][pos]->fields.tableLeaf.data);
+	chidb_DBRecord_unpack(&(record), cursor_cell(input_dbm, inst.P1)->fields.tableLeaf.data);
 	
 	int type = chidb_DBRecord_getType(record, inst.P2);
 	if (type == SQL_NULL) {
@@ -887,7 +1213,7 @@ int operation_column(dbm *input_dbm, chidb_instruction inst) {
 		input_dbm->program_counter += 1;
 		return DBM_OK;
 	}
-	if (type == SQL_INTEGER_1BYTE || type == SQL_INTEGER_2BYTE || type == SQL_INTEGER_4BYTE) {
+	if (type == SQL_INTEGER_1BYTE || type == SQL_INTEGER_2BYTE || type == SQL_INTEGER_4BYTE || type == SQL_INTEGER_8BYTE) {
 		input_dbm->registers[inst.P3].type = INTEGER;
 		if (type == SQL_INTEGER_1BYTE) {
 			int8_t *v = (int8_t *)malloc(sizeof(int8_t));
@@ -910,6 +1236,10 @@ int operation_column(dbm *input_dbm, chidb_instruction inst) {
 			input_dbm->registers[inst.P3].int_type = INT32;
 			free(v);
 		}
+		if (type == SQL_INTEGER_8BYTE) {
+			chidb_DBRecord_getInt64(record, inst.P2, &(input_dbm->registers[inst.P3].data.int_val));
+			input_dbm->registers[inst.P3].int_type = INT64;
+		}
 		input_dbm->program_counter += 1;
 		return DBM_OK;
 	}
@@ -939,14 +1269,22 @@ int tick_dbm(dbm *input_dbm, chidb_instruction inst) {
 			}
 			
 			uint32_t page_num = (input_dbm->registers[inst.P2]).data.int_val;
-			chidb_Btree_getNodeByPage(input_dbm->db->bt, page_num, &(input_dbm->cursors[inst.P1].node));
+			int err = chidb_Btree_getNodeByPage(input_dbm->db->bt, page_num, &(input_dbm->cursors[inst.P1].node));
+			if (err == CHIDB_ECHECKSUM) {
+				input_dbm->tick_result = DBM_CORRUPT;
+				return DBM_HALT_STATE;
+			}
+			operation_cursor_close(input_dbm, inst.P1);
 			input_dbm->cursors[inst.P1].touched = 1;
+			input_dbm->cursors[inst.P1].is_index = (err == CHIDB_OK && (input_dbm->cursors[inst.P1].node->type == PGTYPE_INDEX_INTERNAL || input_dbm->cursors[inst.P1].node->type == PGTYPE_INDEX_LEAF));
 			input_dbm->cursors[inst.P1].cols = inst.P3;
 			input_dbm->cursors[inst.P1].root_page_num = page_num;
 			input_dbm->tick_result = DBM_OK;
 			input_dbm->program_counter += 1;
 			
 			
+			//A TREE THAT IS NOT IN THE SCHEMA YET (E.G., AN INDEX BEING CREATED) HAS NO CELL LIST
+			input_dbm->cursors[inst.P1].table_num = input_dbm->db->bt->schema_table_size;
 			for (int i = 0; i < input_dbm->db->bt->schema_table_size; ++i) {
 				int root_page_num = input_dbm->db->bt->schema_table[i]->root_page;
 				if (root_page_num == page_num) {
@@ -962,6 +1300,7 @@ int tick_dbm(dbm *input_dbm, chidb_instruction inst) {
 			if (retval == DBM_OK) {
 				input_dbm->program_counter += 1;
 				input_dbm->tick_result = DBM_OK;
+				return DBM_OK;
 			} else {
 				input_dbm->tick_result = DBM_OPENRW_ERROR;
 				return DBM_HALT_STATE;
@@ -1057,6 +1396,63 @@ int tick_dbm(dbm *input_dbm, chidb_instruction inst) {
 			}
 			break;
 		}
+		case DBM_UPDATE: {
+			int retval = operation_update_record(input_dbm, inst);
+			if (retval == DBM_OK) {
+				input_dbm->tick_result = DBM_OK;
+				return DBM_OK;
+			} else {
+				input_dbm->tick_result = retval;
+				return DBM_HALT_STATE;
+			}
+			break;
+		}
+		case DBM_VACUUM: {
+			int retval = operation_vacuum(input_dbm, inst);
+			if (retval == DBM_OK) {
+				input_dbm->tick_result = DBM_OK;
+				return DBM_OK;
+			} else {
+				input_dbm->tick_result = retval;
+				return DBM_HALT_STATE;
+			}
+			break;
+		}
+		case DBM_BEGIN:
+		case DBM_COMMIT:
+		case DBM_ROLLBACK: {
+			int retval = operation_transaction(input_dbm, inst);
+			if (retval == DBM_OK) {
+				input_dbm->tick_result = DBM_OK;
+				return DBM_OK;
+			} else {
+				input_dbm->tick_result = retval;
+				return DBM_HALT_STATE;
+			}
+			break;
+		}
+		case DBM_PRAGMA: {
+			int retval = operation_pragma(input_dbm, inst);
+			if (retval == DBM_OK) {
+				input_dbm->tick_result = DBM_OK;
+				return DBM_OK;
+			} else {
+				input_dbm->tick_result = retval;
+				return DBM_HALT_STATE;
+			}
+			break;
+		}
+		case DBM_DELETE: {
+			int retval = operation_delete(input_dbm, inst);
+			if (retval == DBM_OK) {
+				input_dbm->tick_result = DBM_OK;
+				return DBM_OK;
+			} else {
+				input_dbm->tick_result = retval;
+				return DBM_HALT_STATE;
+			}
+			break;
+		}
 		case DBM_EQ: {
 			int retval = operation_eq(input_dbm, inst);
 			if (retval == DBM_OK) {
@@ -1183,7 +1579,8 @@ int tick_dbm(dbm *input_dbm, chidb_instruction inst) {
 			}
 			break;
 		}
-		case DBM_IDXINSERT: {
+		case DBM_IDXINSERT:
+		case DBM_IDXDELETE: {
 			int retval = operation_idxinsert(input_dbm, inst);
 			if (retval == DBM_OK) {
 				input_dbm->tick_result = DBM_OK;
@@ -1194,6 +1591,17 @@ int tick_dbm(dbm *input_dbm, chidb_instruction inst) {
 			}
 			break;
 		}
+		case DBM_ADDSCHEMA: {
+			int retval = operation_addschema(input_dbm, inst);
+			if (retval == DBM_OK) {
+				input_dbm->tick_result = DBM_OK;
+				return DBM_OK;
+			} else {
+				input_dbm->tick_result = retval;
+				return DBM_HALT_STATE;
+			}
+			break;
+		}
 		case DBM_CREATETABLE: {
 			int retval = operation_createtable(input_dbm, inst);
 			if (retval == DBM_OK) {
@@ -1252,7 +1660,10 @@ int generate_result_row(chidb_stmt *stmt) {
 	for (; index < bound; ++index) {
 		switch (stmt->input_dbm->registers[index].type) {
 			case INTEGER:
-				chidb_DBRecord_appendInt32(dbrb, stmt->input_dbm->registers[index].data.int_val);
+				if (stmt->input_dbm->registers[index].data.int_val == (int32_t)stmt->input_dbm->registers[index].data.int_val)
+					chidb_DBRecord_appendInt32(dbrb, stmt->input_dbm->registers[index].data.int_val);
+				else
+					chidb_DBRecord_appendInt64(dbrb, stmt->input_dbm->registers[index].data.int_val);
 			break;
 			case STRING:
 				chidb_DBRecord_appendString(dbrb, stmt->input_dbm->registers[index].data.str_val);
@@ -20,6 +20,8 @@
 #define DBM_DUPLICATE_KEY (9009)
 #define DBM_MEMORY_ERROR (9010)
 #define DBM_IO_ERROR (9011)
+#define DBM_MISUSE (9012)
+#define DBM_CORRUPT (9013)
 
 //INTERNAL DBM RETURN TYPES
 #define DBM_OK (0)
@@ -64,12 +66,25 @@
 #define DBM_CREATEINDEX (29)
 #define DBM_SCOPY (30)
 #define DBM_HALT (31)
+#define DBM_DELETE (33)
+#define DBM_UPDATE (34)
+#define DBM_VACUUM (35)
+#define DBM_BEGIN (36)
+#define DBM_COMMIT (37)
+#define DBM_ROLLBACK (38)
+#define DBM_PRAGMA (39)
+#define DBM_IDXDELETE (40)
+#define DBM_ADDSCHEMA (41)
+
+//SETTINGS THAT DBM_PRAGMA CAN CHANGE (P1)
+#define DBM_PRAGMA_SYNCHRONOUS (0)
+#define DBM_PRAGMA_JOURNAL_MODE (1)
 
 enum dbm_register_type {INTEGER, STRING, BINARY, NL, RECORD};
 //FOR INTERNAL DBM USE ONLY
 typedef enum dbm_register_type dbm_register_type;
 
-enum dbm_register_integer_sub_type {INT8, INT16, INT32};
+enum dbm_register_integer_sub_type {INT8, INT16, INT32, INT64};
 typedef enum dbm_register_integer_sub_type dbm_register_integer_sub_type;
 
 
@@ -80,7 +95,7 @@ struct dbm_register {
 	size_t data_len; //TO BE USED WHEN STORING STRINGS AND BINARY VALUES
 	uint8_t touched;
 	union internal_data{
-		int32_t int_val;
+		int64_t int_val;
 		char *str_val;
 		uint8_t *bin_val;
 		DBRecord *record_val;
@@ -98,6 +113,10 @@ struct dbm_cursor {
 	uint32_t root_page_num;
 	uint32_t table_num;
 	uint32_t cols;
+	uint8_t is_index; //THE CURSOR IS ON AN INDEX B-TREE, WHICH IS SEARCHED IN PLACE INSTEAD OF LOADED INTO A LIST
+	uint8_t on_tree; //THE CURSOR POINTS TO cell (FOUND IN THE B-TREE) INSTEAD OF TO pos IN THE CELL LIST
+	BTreeCell cell;
+	uint8_t *data; //RECORD OF cell, OWNED BY THE CURSOR
 };
 
 typedef struct dbm_cursor dbm_cursor;
@@ -132,13 +151,14 @@ struct dbm {
 	uint32_t tick_result; //stores the result of the last tick operation - used for error tracking
 	char *error_str;
 	uint8_t readwritestate;
-  uint32_t table_root; //Root page of current table to be inserted to
 	dbm_register registers[DBM_MAX_REGISTERS];
 	dbm_cursor cursors[DBM_MAX_CURSORS];
 	chidb *db;
 	uint32_t num_lists;
 	BTreeCell ***cell_lists;
 	uint32_t *list_lengths;
+	uint8_t *list_loaded; //LISTS ARE ONLY LOADED WHEN A CURSOR NEEDS THEM (SEE load_list)
+	int load_error; //CHIDB_ECHECKSUM IF A PAGE COULD NOT BE READ INTO THE CELL LISTS
 	
 	//DEPRECATED
   SQLStatement * create_table;
@@ -171,6 +191,7 @@ struct chidb_stmt {
     table_l *table_list; //table list
     
     uint8_t initialized_dbm;
+    uint8_t autocommit; //THE STATEMENT RUNS IN A TRANSACTION OF ITS OWN, BEGUN BY chidb_step
     dbm *input_dbm;
 };
 
@@ -180,6 +201,12 @@ dbm * init_dbm(chidb_stmt *,uint8_t, uint8_t);
 //THIS LOADS IN THE TREES AS LISTS FOR NEXT AND PREV
 void init_lists(chidb_stmt *);
 
+//THIS SETS UP EMPTY, NOT YET LOADED, LISTS FOR ALL THE TREES IN THE SCHEMA
+void prepare_lists(dbm *);
+
+//THIS LOADS THE LIST OF ONE TREE, IF IT WAS NOT LOADED YET. RETURNS THE LOAD ERROR (CHIDB_OK IF NONE)
+int load_list(dbm *, uint32_t);
+
 //THIS RESETS A DBM TO ITS INITIAL STATE
 int reset_dbm(dbm *);
 
@@ -0,0 +1,216 @@
+/*****************************************************************************
+ *
+ *																 chidb
+ *
+ * This module compresses blocks of data for the compress VFS (see vfs.c).
+ *
+ * The format is that of LZ4 blocks: a sequence of literals followed by a
+ * match (a copy of earlier output), repeated. Each sequence starts with a
+ * token byte, whose high four bits are the number of literals and whose
+ * low four bits are the length of the match minus LZ_MIN_MATCH. A value
+ * of 15 means that the length goes on in the following bytes, which are
+ * added to it up to (and including) the first byte that is not 255. The
+ * literals come next, then the distance back to the match in two bytes
+ * (least significant first), then the rest of the match length. The last
+ * sequence only has literals.
+ *
+ * Matches are found greedily, with a hash table of the last position at
+ * which each four-byte sequence was seen. This favours speed over ratio:
+ * both directions run at memory speed, and text still shrinks two to
+ * four times.
+ *
+\*****************************************************************************/
+
+#include <string.h>
+
+#include <chidbInt.h>
+
+#include "lz.h"
+
+
+static uint32_t chidb_Lz_read32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+
+static uint32_t chidb_Lz_hash(uint32_t v)
+{
+	return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+
+/* Write a length that did not fit in a nibble. Returns the new output
+ * position, or NULL if there is no room */
+static uint8_t *chidb_Lz_putLength(uint8_t *op, uint8_t *oend, size_t n)
+{
+	for (; n >= 255; n -= 255)
+	{
+		if (op >= oend)
+			return NULL;
+		*op++ = 255;
+	}
+	if (op >= oend)
+		return NULL;
+	*op++ = (uint8_t) n;
+
+	return op;
+}
+
+
+/* Write a sequence: literals, and then (if mlen is not zero) a match.
+ * Returns the new output position, or NULL if there is no room */
+static uint8_t *chidb_Lz_putSequence(uint8_t *op, uint8_t *oend, const uint8_t *lit, size_t nlit,
+                                     size_t offset, size_t mlen)
+{
+	uint8_t *token = op++;
+	size_t mcode = mlen ? mlen - LZ_MIN_MATCH : 0;
+
+	if (token >= oend)
+		return NULL;
+	*token = (uint8_t) (((nlit < 15 ? nlit : 15) << 4) | (mcode < 15 ? mcode : 15));
+	if (nlit >= 15 && (op = chidb_Lz_putLength(op, oend, nlit - 15)) == NULL)
+		return NULL;
+	if ((size_t) (oend - op) < nlit)
+		return NULL;
+	memcpy(op, lit, nlit);
+	op += nlit;
+	if (mlen == 0)
+		return op;
+
+	if (oend - op < 2)
+		return NULL;
+	*op++ = (uint8_t) offset;
+	*op++ = (uint8_t) (offset >> 8);
+	if (mcode >= 15 && (op = chidb_Lz_putLength(op, oend, mcode - 15)) == NULL)
+		return NULL;
+
+	return op;
+}
+
+
+/* Compress a block
+ *
+ * Parameters
+ * - src: Data to compress.
+ * - len: Number of bytes of data.
+ * - dst: Buffer for the compressed data.
+ * - cap: Size of dst.
+ *
+ * Return
+ * - Number of bytes of compressed data, or 0 if it does not fit in
+ *   cap bytes (i.e., the data does not compress well enough)
+ */
+size_t chidb_Lz_compress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap)
+{
+	uint32_t table[1 << LZ_HASH_BITS];
+	const uint8_t *anchor = src, *ip = src;
+	const uint8_t *iend = src + len;
+	const uint8_t *mlimit = (len > LZ_LAST_LITERALS) ? iend - LZ_LAST_LITERALS : src;
+	uint8_t *op = dst, *oend = dst + cap;
+
+	memset(table, 0xFF, sizeof(table));
+	while (ip + LZ_MIN_MATCH <= mlimit)
+	{
+		uint32_t v = chidb_Lz_read32(ip);
+		uint32_t h = chidb_Lz_hash(v);
+		uint32_t ref = table[h];
+
+		table[h] = (uint32_t) (ip - src);
+		if (ref == UINT32_MAX || ip - (src + ref) > LZ_MAX_OFFSET || chidb_Lz_read32(src + ref) != v)
+		{
+			ip++;
+			continue;
+		}
+
+		const uint8_t *match = src + ref;
+		size_t mlen = LZ_MIN_MATCH;
+		while (ip + mlen < mlimit && ip[mlen] == match[mlen])
+			mlen++;
+		op = chidb_Lz_putSequence(op, oend, anchor, ip - anchor, ip - match, mlen);
+		if (op == NULL)
+			return 0;
+		ip += mlen;
+		anchor = ip;
+	}
+
+	op = chidb_Lz_putSequence(op, oend, anchor, iend - anchor, 0, 0);
+
+	return (op == NULL) ? 0 : (size_t) (op - dst);
+}
+
+
+/* Read a length that did not fit in a nibble */
+static int chidb_Lz_getLength(const uint8_t **ip, const uint8_t *iend, size_t *n)
+{
+	uint8_t b;
+
+	do
+	{
+		if (*ip >= iend)
+			return CHIDB_ECORRUPT;
+		b = *(*ip)++;
+		*n += b;
+	} while (b == 255);
+
+	return CHIDB_OK;
+}
+
+
+/* Decompress a block
+ *
+ * Parameters
+ * - src: Compressed data.
+ * - len: Number of bytes of compressed data.
+ * - dst: Buffer for the data.
+ * - dst_len: Size of the data before it was compressed.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ECORRUPT: The compressed data is not valid, or its size once
+ *                   decompressed is not dst_len
+ */
+int chidb_Lz_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_len)
+{
+	const uint8_t *ip = src, *iend = src + len;
+	uint8_t *op = dst, *oend = dst + dst_len;
+
+	while (ip < iend)
+	{
+		uint8_t token = *ip++;
+		size_t nlit = token >> 4;
+		size_t mlen = token & 0x0F;
+
+		if (nlit == 15 && chidb_Lz_getLength(&ip, iend, &nlit) != CHIDB_OK)
+			return CHIDB_ECORRUPT;
+		if ((size_t) (iend - ip) < nlit || (size_t) (oend - op) < nlit)
+			return CHIDB_ECORRUPT;
+		memcpy(op, ip, nlit);
+		ip += nlit;
+		op += nlit;
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return CHIDB_ECORRUPT;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (mlen == 15 && chidb_Lz_getLength(&ip, iend, &mlen) != CHIDB_OK)
+			return CHIDB_ECORRUPT;
+		mlen += LZ_MIN_MATCH;
+		if (offset == 0 || offset > (size_t) (op - dst) || (size_t) (oend - op) < mlen)
+			return CHIDB_ECORRUPT;
+
+		/* The match may overlap the bytes it produces */
+		const uint8_t *match = op - offset;
+		for (size_t i = 0; i < mlen; i++)
+			op[i] = match[i];
+		op += mlen;
+	}
+
+	return (op == oend) ? CHIDB_OK : CHIDB_ECORRUPT;
+}
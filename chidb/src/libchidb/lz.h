@@ -0,0 +1,20 @@
+#ifndef LZ_H_
+#define LZ_H_
+
+#include <chidbInt.h>
+
+/* Matches are at least this long, and at most this far back */
+#define LZ_MIN_MATCH (4)
+#define LZ_MAX_OFFSET (65535)
+
+/* The last bytes of a block are always literals, so that the matcher
+ * can read four bytes at a time without running past the end */
+#define LZ_LAST_LITERALS (5)
+
+/* Positions of recent four-byte sequences, by hash */
+#define LZ_HASH_BITS (12)
+
+size_t chidb_Lz_compress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap);
+int chidb_Lz_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_len);
+
+#endif /*LZ_H_*/
@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <chidb.h>
 #include <string.h>
+#include <strings.h>
 #include "btree.h"
 #include "dbm.h"
 #include "parser.h"
@@ -39,6 +40,23 @@ int chidb_open(const char *file, chidb **db)
 	return CHIDB_OK;
 }
 
+int chidb_open_vfs(const char *file, const char *vfs, chidb **db)
+{
+	Vfs *v = chidb_Vfs_find(vfs);
+	if (v == NULL)
+		return CHIDB_ECANTOPEN;
+
+	*db = malloc(sizeof(chidb));
+	if (*db == NULL)
+		return CHIDB_ENOMEM;
+	chidb_Btree_openVfs(file, v, *db, &(*db)->bt);
+	
+    chidb_load_schema(*db);
+    chidb_print_schema(*db);
+
+	return CHIDB_OK;
+}
+
 void chidb_print_schema(chidb *  db) {
     int schema_row_index = 0;
     printf("=== Printing Schema ===\n");
@@ -64,7 +82,13 @@ int chidb_load_schema(chidb * db) {
             db->bt->schema_table = realloc(db->bt->schema_table,schema_size*sizeof(SchemaTableRow *));
             db->bt->schema_table[schema_row_index] = calloc(1,sizeof(SchemaTableRow));
 
-            chidb_DBRecord_unpack(&dbr,cell->fields.tableLeaf.data);
+            // Long CREATE statements may not fit in the cell
+            uint8_t *data = cell->fields.tableLeaf.data;
+            if (cell->fields.tableLeaf.overflow_page != 0)
+                chidb_Btree_readPayload(db->bt, cell, &data);
+            chidb_DBRecord_unpack(&dbr,data);
+            if (data != cell->fields.tableLeaf.data)
+                free(data);
             chidb_DBRecord_getString(dbr,0,&db->bt->schema_table[schema_row_index]->item_type);
             chidb_DBRecord_getString(dbr,1,&db->bt->schema_table[schema_row_index]->item_name);
             chidb_DBRecord_getString(dbr,2,&db->bt->schema_table[schema_row_index]->assoc_table_name);
@@ -85,14 +109,146 @@ int chidb_load_schema(chidb * db) {
     return CHIDB_OK;
 }
 
-int chidb_close(chidb *db)
+/* Discard the in-memory schema table and load it again from the file
+ *
+ * A rollback can undo the CREATE statements of the transaction, and
+ * the root pages of the trees that they moved.
+ */
+static int chidb_reload_schema(chidb *db)
 {
-	chidb_Btree_close(db->bt);
+    for (int i = 0; i < db->bt->schema_table_size; i++) {
+        free(db->bt->schema_table[i]->item_type);
+        free(db->bt->schema_table[i]->item_name);
+        free(db->bt->schema_table[i]->assoc_table_name);
+        free(db->bt->schema_table[i]->sql);
+        free(db->bt->schema_table[i]);
+    }
+    free(db->bt->schema_table);
+    db->bt->schema_table_size = 0;
+
+    return chidb_load_schema(db);
+}
+
+/* Add a row to the schema table
+ *
+ * The row gets the key after the last one in use, and the in-memory
+ * schema table is loaded again, so that later statements see it.
+ *
+ * Parameters
+ * - db: chidb database
+ * - type: "table" or "index"
+ * - name: Name of the table or index
+ * - table: Table that the row belongs to
+ * - root_page: Root page of the B-Tree
+ * - sql: CREATE statement (without the final semicolon)
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_add_schema(chidb *db, const char *type, const char *name, const char *table, int root_page, const char *sql)
+{
+    DBRecordBuffer dbrb;
+    DBRecord *dbr;
+    uint8_t *packed;
+    int err;
+
+    chidb_DBRecord_create_empty(&dbrb, 5);
+    chidb_DBRecord_appendString(&dbrb, (char *) type);
+    chidb_DBRecord_appendString(&dbrb, (char *) name);
+    chidb_DBRecord_appendString(&dbrb, (char *) table);
+    chidb_DBRecord_appendInt32(&dbrb, root_page);
+    chidb_DBRecord_appendString(&dbrb, (char *) sql);
+    chidb_DBRecord_finalize(&dbrb, &dbr);
+    chidb_DBRecord_pack(dbr, &packed);
+
+    // Rows are not necessarily numbered 1 to n (e.g., after a rollback)
+    key_t key = db->bt->schema_table_size + 1;
+    while((err = chidb_Btree_insertInTable(db->bt, 1, key, packed, dbr->packed_len)) == CHIDB_EDUPLICATE)
+        key++;
+    free(packed);
+    chidb_DBRecord_destroy(dbr);
+    if(err != CHIDB_OK)
+        return err;
+
+    return chidb_reload_schema(db);
+}
+
+int chidb_begin(chidb *db)
+{
+    return chidb_Pager_begin(db->bt->pager);
+}
+
+int chidb_commit(chidb *db)
+{
+    int err = chidb_Pager_commit(db->bt->pager);
+
+    // A commit that fails rolls the transaction back
+    if(err != CHIDB_OK && err != CHIDB_EMISUSE)
+        chidb_reload_schema(db);
+    return err;
+}
+
+int chidb_rollback(chidb *db)
+{
+    int err = chidb_Pager_rollback(db->bt->pager);
+    if(err != CHIDB_OK)
+        return err;
+
+    return chidb_reload_schema(db);
+}
+
+int chidb_journal_mode(chidb *db, int mode)
+{
+    return chidb_Btree_setJournalMode(db->bt, mode);
+}
+
+int chidb_group_commit(chidb *db, int max_wait, int batch_size)
+{
+    if(max_wait < 0 || batch_size < 1)
+        return CHIDB_EMISUSE;
+
+    return chidb_Pager_setGroupCommit(db->bt->pager, max_wait, batch_size);
+}
+
+int chidb_synchronous(chidb *db, int mode)
+{
+    return chidb_Pager_setSynchronous(db->bt->pager, mode);
+}
+
+int chidb_cache(chidb *db, int policy, int npages)
+{
+    if(npages < 0)
+        return CHIDB_EMISUSE;
+
+    return chidb_Pager_setCache(db->bt->pager, policy, npages);
+}
+
+int chidb_cache_stats(chidb *db, uint64_t *hits, uint64_t *misses)
+{
+    CacheStats stats;
+
+    chidb_Pager_cacheStats(db->bt->pager, &stats);
+    *hits = stats.hits;
+    *misses = stats.misses;
+    return CHIDB_OK;
+}
+
+int chidb_checksums(chidb *db, int on)
+{
+    int err = chidb_Btree_setChecksums(db->bt, on != 0);
 
+    return (err == CHIDB_ECHECKSUM) ? CHIDB_ECORRUPT : err;
+}
+
+int chidb_close(chidb *db)
+{
     for (int i = 0; i < db->bt->schema_table_size; i++) {
         free(db->bt->schema_table[i]);
     }
     free(db->bt->schema_table);
+	chidb_Btree_close(db->bt);
 	free(db);
 	return CHIDB_OK;
 } 
@@ -103,7 +259,597 @@ int table_pair_compare(const void* a, const void* b) {
 
 }
 
-int chidb_prepare(chidb *db, const char *sql, chidb_stmt **stmt)
+/* Compile the WHERE clause of a single-table statement
+ *
+ * Appends, for each condition, the instructions that load both operands
+ * into new registers, followed by a conditional jump that skips the
+ * current row when the condition does not hold. The jump addresses are
+ * left as placeholders (P2 = 0), and must be set by the caller.
+ *
+ * Parameters
+ * - stmt: Statement being compiled (using cursor 0 on the table)
+ * - numlines: Number of instructions already in the statement
+ * - rmax: In/out parameter with the last register in use
+ * - conds: WHERE conditions
+ * - nconds: Number of WHERE conditions
+ * - create: CREATE TABLE statement of the table
+ *
+ * Return
+ * - The new number of instructions in the statement
+ */
+static int chidb_prepare_where(chidb_stmt *stmt, int numlines, int *rmax, Condition *conds, int nconds, SQLStatement *create)
+{
+    for(int i = 0; i < nconds; i++) {
+        // Load the column (or the primary key) of the first operand
+        for(int c = 0; c < create->query.createTable.ncols; c++) {
+            if(!strcmp(conds[i].op1.name, create->query.createTable.cols[c].name)) {
+                stmt->ins = realloc(stmt->ins, (numlines + 1) * sizeof(chidb_instruction));
+                if(c == create->query.createTable.pk) {
+                    stmt->ins[numlines].instruction = DBM_KEY;      // Get a primary key value
+                    stmt->ins[numlines].P1 = 0;                     // using cursor 0
+                    stmt->ins[numlines].P2 = ++(*rmax);             // into a new register
+                } else {
+                    stmt->ins[numlines].instruction = DBM_COLUMN;   // Get a column value
+                    stmt->ins[numlines].P1 = 0;                     // using cursor 0
+                    stmt->ins[numlines].P2 = c;                     // from column c
+                    stmt->ins[numlines].P3 = ++(*rmax);             // into a new register
+                }
+                numlines++;
+                break;
+            }
+        }
+
+        // Load the second operand
+        stmt->ins = realloc(stmt->ins, (numlines + 1) * sizeof(chidb_instruction));
+        if(conds[i].op == OP_ISNULL || conds[i].op == OP_ISNOTNULL) {
+            stmt->ins[numlines].instruction = DBM_NULL;                     // Store a null type
+            stmt->ins[numlines].P2 = ++(*rmax);                             // into a new register
+        } else if(conds[i].op2Type == OP2_INT) {
+            stmt->ins[numlines].instruction = DBM_INTEGER;                  // Integer type
+            stmt->ins[numlines].P1 = conds[i].op2.integer;                  // Store the integer
+            stmt->ins[numlines].P2 = ++(*rmax);                             // into a new register
+        } else if(conds[i].op2Type == OP2_STR) {
+            stmt->ins[numlines].instruction = DBM_STRING;                   // String type
+            stmt->ins[numlines].P1 = strlen(conds[i].op2.string) + 1;       // Store the length
+            stmt->ins[numlines].P2 = ++(*rmax);                             // into a new register
+            stmt->ins[numlines].P4 = conds[i].op2.string;                   // and keep a ptr
+        } else {
+            for(int c = 0; c < create->query.createTable.ncols; c++) {
+                if(!strcmp(conds[i].op2.col.name, create->query.createTable.cols[c].name)) {
+                    if(c == create->query.createTable.pk) {
+                        stmt->ins[numlines].instruction = DBM_KEY;      // Get a primary key value
+                        stmt->ins[numlines].P1 = 0;                     // using cursor 0
+                        stmt->ins[numlines].P2 = ++(*rmax);             // into a new register
+                    } else {
+                        stmt->ins[numlines].instruction = DBM_COLUMN;   // Get a column value
+                        stmt->ins[numlines].P1 = 0;                     // using cursor 0
+                        stmt->ins[numlines].P2 = c;                     // from column c
+                        stmt->ins[numlines].P3 = ++(*rmax);             // into a new register
+                    }
+                    break;
+                }
+            }
+        }
+        numlines++;
+
+        // Store the conditional jump instruction (taken when the condition is false)
+        stmt->ins = realloc(stmt->ins, (numlines + 1) * sizeof(chidb_instruction));
+        switch(conds[i].op) {
+            case OP_EQ:
+            case OP_ISNULL:
+                stmt->ins[numlines].instruction = DBM_NE;
+                break;
+            case OP_NE:
+            case OP_ISNOTNULL:
+                stmt->ins[numlines].instruction = DBM_EQ;
+                break;
+            case OP_LT:
+                stmt->ins[numlines].instruction = DBM_GE;
+                break;
+            case OP_GT:
+                stmt->ins[numlines].instruction = DBM_LE;
+                break;
+            case OP_LTE:
+                stmt->ins[numlines].instruction = DBM_GT;
+                break;
+            case OP_GTE:
+                stmt->ins[numlines].instruction = DBM_LT;
+                break;
+        }
+        stmt->ins[numlines].P1 = *rmax - 1;                 // Get the register of the first operand
+        stmt->ins[numlines].P2 = 0;                         // Placeholder for jump address (set later)
+        stmt->ins[numlines].P3 = *rmax;                     // Get the register of the second operand
+        numlines++;
+    }
+
+    return numlines;
+}
+
+/* Check that the columns in a WHERE clause exist in a table */
+static bool chidb_prepare_checkWhere(Condition *conds, int nconds, SQLStatement *create)
+{
+    for(int i = 0; i < nconds; i++) {
+        bool match1 = false, match2 = (conds[i].op2Type != OP2_COL || conds[i].op == OP_ISNULL || conds[i].op == OP_ISNOTNULL);
+        for(int j = 0; j < create->query.createTable.ncols; j++) {
+            if(!strcmp(conds[i].op1.name, create->query.createTable.cols[j].name))
+                match1 = true;
+            if(!match2 && !strcmp(conds[i].op2.col.name, create->query.createTable.cols[j].name))
+                match2 = true;
+        }
+        if(!match1 || !match2)
+            return false;
+    }
+    return true;
+}
+
+/* Resolve the setting and the value of a PRAGMA statement
+ *
+ * Supported settings are "synchronous" (OFF, NORMAL or FULL, or 0, 1
+ * or 2) and "journal_mode" (DELETE or WAL).
+ *
+ * Parameters
+ * - pragma: PRAGMA statement
+ * - setting: Out parameter. DBM_PRAGMA_* code of the setting
+ * - value: Out parameter. New value of the setting
+ *
+ * Return
+ * - true if the setting and the value are valid, false otherwise
+ */
+static bool chidb_prepare_pragma(PragmaStatement *pragma, int *setting, int *value)
+{
+    static const char *sync_modes[] = {"off", "normal", "full"};
+    static const char *journal_modes[] = {"delete", "wal"};
+    const char **names;
+    int nnames;
+
+    if(!strcasecmp(pragma->name, "synchronous")) {
+        *setting = DBM_PRAGMA_SYNCHRONOUS;
+        names = sync_modes;
+        nnames = 3;
+    } else if(!strcasecmp(pragma->name, "journal_mode")) {
+        *setting = DBM_PRAGMA_JOURNAL_MODE;
+        names = journal_modes;
+        nnames = 2;
+    } else
+        return false;
+
+    if(pragma->val.type == INS_INT) {
+        *value = pragma->val.val.integer;
+        return *setting == DBM_PRAGMA_SYNCHRONOUS && *value >= 0 && *value < nnames;
+    }
+    for(*value = 0; *value < nnames; (*value)++)
+        if(!strcasecmp(pragma->val.val.string, names[*value]))
+            return true;
+    return false;
+}
+
+/* An index on some columns of a table (see chidb_prepare_indexes) */
+struct index_info {
+    int root;                       // Root page of the index B-Tree
+    int ncols;                      // Number of indexed columns
+    int cols[INDEXCELL_MAXCOLS];    // Indexed columns of the table, in index order
+};
+typedef struct index_info IndexInfo;
+
+/* Find the columns of a CREATE INDEX statement in its table
+ *
+ * Parameters
+ * - index_stmt: CREATE INDEX statement
+ * - create: CREATE TABLE statement of the table
+ * - index: Out parameter. The columns of the index (root is not set)
+ *
+ * Return
+ * - true if the index has at most INDEXCELL_MAXCOLS columns, and all
+ *   of them are in the table
+ */
+static bool chidb_prepare_indexColumns(SQLStatement *index_stmt, SQLStatement *create, IndexInfo *index)
+{
+    CreateIndexStatement *ci = &index_stmt->query.createIndex;
+
+    if(index_stmt->type != STMT_CREATEINDEX || ci->ncols < 1 || ci->ncols > INDEXCELL_MAXCOLS)
+        return false;
+    index->ncols = ci->ncols;
+    for(int i = 0; i < ci->ncols; i++) {
+        index->cols[i] = -1;
+        for(int c = 0; c < create->query.createTable.ncols; c++) {
+            if(!strcmp(ci->cols[i], create->query.createTable.cols[c].name))
+                index->cols[i] = c;
+        }
+        if(index->cols[i] < 0)
+            return false;
+    }
+    return true;
+}
+
+/* Find the indexes of a table
+ *
+ * Parameters
+ * - db: chidb database
+ * - table: Name of the table
+ * - create: CREATE TABLE statement of the table
+ * - indexes: Out parameter. Array with the indexes of the table, which
+ *            the caller must free
+ *
+ * Return
+ * - The number of indexes of the table
+ */
+static int chidb_prepare_indexes(chidb *db, const char *table, SQLStatement *create, IndexInfo **indexes)
+{
+    int nindexes = 0;
+
+    *indexes = NULL;
+    for(int i = 0; i < db->bt->schema_table_size; i++) {
+        SchemaTableRow *row = db->bt->schema_table[i];
+        SQLStatement *index_stmt;
+        if(strcmp(row->item_type, "index") || strcmp(row->assoc_table_name, table))
+            continue;
+        if(chidb_parser(row->sql, &index_stmt) != CHIDB_OK)
+            continue;
+        *indexes = realloc(*indexes, (nindexes + 1) * sizeof(IndexInfo));
+        if(chidb_prepare_indexColumns(index_stmt, create, &(*indexes)[nindexes])) {
+            (*indexes)[nindexes].root = row->root_page;
+            nindexes++;
+        }
+        chidb_parser_SQLStatement_destroy(index_stmt);
+    }
+    return nindexes;
+}
+
+/* Open the indexes of a table for writing
+ *
+ * Index i is opened with cursor i + 1 (cursor 0 is the table).
+ *
+ * Parameters
+ * - stmt: Statement being compiled
+ * - numlines: Number of instructions already in the statement
+ * - rmax: In/out parameter with the last register in use
+ * - indexes: Indexes of the table
+ * - nindexes: Number of indexes
+ *
+ * Return
+ * - The new number of instructions in the statement
+ */
+static int chidb_prepare_openIndexes(chidb_stmt *stmt, int numlines, int *rmax, IndexInfo *indexes, int nindexes)
+{
+    for(int i = 0; i < nindexes; i++) {
+        stmt->ins = realloc(stmt->ins, (numlines + 2) * sizeof(chidb_instruction));
+        stmt->ins[numlines].instruction = DBM_INTEGER;      // Integer type
+        stmt->ins[numlines].P1 = indexes[i].root;           // Store the root page of the index
+        stmt->ins[numlines].P2 = ++(*rmax);                 // into a new register
+        numlines++;
+        stmt->ins[numlines].instruction = DBM_OPENWRITE;    // Open the index
+        stmt->ins[numlines].P1 = i + 1;                     // with cursor i + 1
+        stmt->ins[numlines].P2 = *rmax;                     // on the page in that register
+        stmt->ins[numlines].P3 = indexes[i].ncols;          // having keys of ncols columns
+        numlines++;
+    }
+    return numlines;
+}
+
+/* Compile the changes to the indexes of a table for one row
+ *
+ * Appends, for each index (see chidb_prepare_openIndexes), an
+ * instruction that adds the entry of a row to it, or removes it. The
+ * entry is taken from the registers with a new row, or read from the
+ * row that cursor 0 points to. The key of an index on several columns
+ * is first gathered in consecutive registers.
+ *
+ * Parameters
+ * - stmt: Statement being compiled
+ * - numlines: Number of instructions already in the statement
+ * - rmax: In/out parameter with the last register in use
+ * - instruction: DBM_IDXINSERT or DBM_IDXDELETE
+ * - indexes: Indexes of the table
+ * - nindexes: Number of indexes
+ * - changed: Which columns of the table change (NULL if all of them).
+ *            Indexes on none of these columns are left alone.
+ * - start: First register of the new row, or -1 to use the row of
+ *          cursor 0
+ * - pk: Primary key column of the table
+ *
+ * Return
+ * - The new number of instructions in the statement
+ */
+static int chidb_prepare_indexRow(chidb_stmt *stmt, int numlines, int *rmax, uint32_t instruction,
+                                  IndexInfo *indexes, int nindexes, bool *changed, int start, int pk)
+{
+    for(int i = 0; i < nindexes; i++) {
+        int rkey = start + indexes[i].cols[0], rpk = start + pk;
+        bool change = (changed == NULL);
+        for(int j = 0; j < indexes[i].ncols; j++)
+            change = change || changed[indexes[i].cols[j]];
+        if(!change)
+            continue;
+
+        if(start < 0 || indexes[i].ncols > 1)
+            rkey = *rmax + 1;
+        for(int j = 0; (start < 0 || indexes[i].ncols > 1) && j < indexes[i].ncols; j++) {
+            int col = indexes[i].cols[j];
+            stmt->ins = realloc(stmt->ins, (numlines + 1) * sizeof(chidb_instruction));
+            if(start >= 0) {
+                stmt->ins[numlines].instruction = DBM_SCOPY;    // Copy the indexed value
+                stmt->ins[numlines].P1 = start + col;           // from the new row
+                stmt->ins[numlines].P2 = ++(*rmax);             // into a new register
+            } else if(col == pk) {
+                stmt->ins[numlines].instruction = DBM_KEY;      // Get the primary key value
+                stmt->ins[numlines].P1 = 0;                     // using cursor 0
+                stmt->ins[numlines].P2 = ++(*rmax);             // into a new register
+            } else {
+                stmt->ins[numlines].instruction = DBM_COLUMN;   // Get the indexed value
+                stmt->ins[numlines].P1 = 0;                     // using cursor 0
+                stmt->ins[numlines].P2 = col;                   // from the indexed column
+                stmt->ins[numlines].P3 = ++(*rmax);             // into a new register
+            }
+            numlines++;
+        }
+        if(start < 0) {
+            stmt->ins = realloc(stmt->ins, (numlines + 1) * sizeof(chidb_instruction));
+            stmt->ins[numlines].instruction = DBM_KEY;          // Get the primary key value
+            stmt->ins[numlines].P1 = 0;                         // using cursor 0
+            stmt->ins[numlines].P2 = rpk = ++(*rmax);           // into a new register
+            numlines++;
+        }
+
+        stmt->ins = realloc(stmt->ins, (numlines + 1) * sizeof(chidb_instruction));
+        stmt->ins[numlines].instruction = instruction;          // Add or remove the entry
+        stmt->ins[numlines].P1 = i + 1;                         // in the index of cursor i + 1
+        stmt->ins[numlines].P2 = rkey;                          // with the indexed values from this register
+        stmt->ins[numlines].P3 = rpk;                           // and the primary key in this one
+        numlines++;
+    }
+    return numlines;
+}
+
+/* Close the indexes opened by chidb_prepare_openIndexes */
+static int chidb_prepare_closeIndexes(chidb_stmt *stmt, int numlines, int nindexes)
+{
+    for(int i = 0; i < nindexes; i++) {
+        stmt->ins = realloc(stmt->ins, (numlines + 1) * sizeof(chidb_instruction));
+        stmt->ins[numlines].instruction = DBM_CLOSE;        // Close the cursor
+        stmt->ins[numlines].P1 = i + 1;                     // of index i
+        numlines++;
+    }
+    return numlines;
+}
+
+/* Find a condition of a WHERE clause that compares a column with a
+ * literal of the same type, using one of two operators */
+static Condition *chidb_prepare_findCond(SelectStatement *select, ColumnSchema *col, int op1, int op2)
+{
+    for(int i = 0; i < select->where_nconds; i++) {
+        Condition *c = &select->where_conds[i];
+        if((c->op == op1 || c->op == op2) && (c->op2Type == OP2_INT || c->op2Type == OP2_STR) &&
+           !strcmp(c->op1.name, col->name) && (c->op2Type == OP2_STR) == (col->type == SQL_TEXT))
+            return c;
+    }
+    return NULL;
+}
+
+/* Store the literal of a condition into a register (or a null value,
+ * if there is no condition) */
+static int chidb_prepare_literal(chidb_stmt *stmt, int numlines, Condition *cond, int reg)
+{
+    stmt->ins = realloc(stmt->ins, (numlines + 1) * sizeof(chidb_instruction));
+    if(cond == NULL) {
+        stmt->ins[numlines].instruction = DBM_NULL;                 // Store a null value
+        stmt->ins[numlines].P2 = reg;                               // into the register
+    } else if(cond->op2Type == OP2_INT) {
+        stmt->ins[numlines].instruction = DBM_INTEGER;              // Integer type
+        stmt->ins[numlines].P1 = cond->op2.integer;                 // Store the integer
+        stmt->ins[numlines].P2 = reg;                               // into the register
+    } else {
+        stmt->ins[numlines].instruction = DBM_STRING;               // String type
+        stmt->ins[numlines].P1 = strlen(cond->op2.string) + 1;      // Store the length
+        stmt->ins[numlines].P2 = reg;                               // into the register
+        stmt->ins[numlines].P4 = cond->op2.string;                  // and keep a ptr
+    }
+    return numlines + 1;
+}
+
+/* Compile a single-table SELECT that can be answered with an index
+ *
+ * An index can be used if the WHERE clause compares its first columns
+ * for equality with literals of the same type, and maybe the next
+ * column with a range (>, >=, < or <=); an index on (tenant, time)
+ * serves "tenant = 1 AND time >= 100 AND time < 200", as well as
+ * "tenant = 1" alone. The index that matches the most columns is used.
+ * Only the entries of the index from the first key in the range to the
+ * last one are visited, and their rows are looked up in the table (with
+ * DBM_SEEK) instead of scanning the whole table. Both ends of the range
+ * are inclusive, since strings in the index may be cut short (see
+ * btree.h), so the whole WHERE clause is checked on each row as usual.
+ *
+ * Parameters
+ * - stmt: Statement being compiled
+ * - table: The table in the FROM clause
+ * - select: SELECT statement
+ *
+ * Return
+ * - The number of instructions in the statement, or 0 if there is no
+ *   index that can be used (and nothing was compiled)
+ */
+static int chidb_prepare_indexSelect(chidb_stmt *stmt, tabledata *table, SelectStatement *select)
+{
+    SQLStatement *create = table->create;
+    IndexInfo *indexes;
+    int nindexes = chidb_prepare_indexes(stmt->db, table->name, create, &indexes);
+    Condition *eq[INDEXCELL_MAXCOLS], *low = NULL, *high = NULL;
+    int neq = 0, score = 0, root = 0;
+
+    // Find the index with the most columns in the WHERE clause: two
+    // points for each equality, and one for a range after them
+    for(int j = 0; j < nindexes; j++) {
+        IndexInfo *index = &indexes[j];
+        Condition *ieq[INDEXCELL_MAXCOLS], *ilow = NULL, *ihigh = NULL;
+        int ineq = 0;
+        if(index->cols[0] == table->pk)
+            continue;
+        while(ineq < index->ncols &&
+              (ieq[ineq] = chidb_prepare_findCond(select, &create->query.createTable.cols[index->cols[ineq]], OP_EQ, OP_EQ)) != NULL)
+            ineq++;
+        if(ineq < index->ncols) {
+            ilow = chidb_prepare_findCond(select, &create->query.createTable.cols[index->cols[ineq]], OP_GT, OP_GTE);
+            ihigh = chidb_prepare_findCond(select, &create->query.createTable.cols[index->cols[ineq]], OP_LT, OP_LTE);
+        }
+        if(2 * ineq + (ilow != NULL || ihigh != NULL) > score) {
+            score = 2 * ineq + (ilow != NULL || ihigh != NULL);
+            memcpy(eq, ieq, ineq * sizeof(Condition *));
+            neq = ineq;
+            low = ilow;
+            high = ihigh;
+            root = index->root;
+        }
+    }
+    free(indexes);
+    if(score == 0)
+        return 0;
+    bool range = (low != NULL || high != NULL);
+
+    int numlines = 0;
+    int rmax = 0;
+
+    // Open the table with cursor 0, and the index with cursor 1
+    stmt->ins = malloc(4 * sizeof(chidb_instruction));
+    stmt->ins[numlines].instruction = DBM_INTEGER;      // Integer type
+    stmt->ins[numlines].P1 = table->root;               // Store the root page of the table
+    stmt->ins[numlines].P2 = 0;                         // into register 0
+    numlines++;
+    stmt->ins[numlines].instruction = DBM_OPENREAD;     // Open the table
+    stmt->ins[numlines].P1 = 0;                         // with cursor 0
+    stmt->ins[numlines].P2 = 0;                         // on the page in register 0
+    stmt->ins[numlines].P3 = table->num_cols;           // having num_cols columns
+    numlines++;
+    stmt->ins[numlines].instruction = DBM_INTEGER;      // Integer type
+    stmt->ins[numlines].P1 = root;                      // Store the root page of the index
+    stmt->ins[numlines].P2 = ++rmax;                    // into a new register
+    numlines++;
+    stmt->ins[numlines].instruction = DBM_OPENREAD;     // Open the index
+    stmt->ins[numlines].P1 = 1;                         // with cursor 1
+    stmt->ins[numlines].P2 = rmax;                      // on the page in that register
+    stmt->ins[numlines].P3 = neq + range;               // comparing keys of this many columns
+    numlines++;
+
+    // Store the keys of the first and the last entries to visit: the
+    // values of the equalities, followed by the ends of the range. A
+    // missing end is a null value, which makes the key shorter, so that
+    // it matches all the entries with the values of the equalities.
+    int rlow = rmax + 1;
+    for(int i = 0; i < neq; i++)
+        numlines = chidb_prepare_literal(stmt, numlines, eq[i], ++rmax);
+    if(range)
+        numlines = chidb_prepare_literal(stmt, numlines, low, ++rmax);
+    int rhigh = rlow;
+    if(range) {
+        rhigh = rmax + 1;
+        for(int i = 0; i < neq; i++)
+            numlines = chidb_prepare_literal(stmt, numlines, eq[i], ++rmax);
+        numlines = chidb_prepare_literal(stmt, numlines, high, ++rmax);
+    }
+
+    // Go to the first entry
+    int seek = numlines;
+    stmt->ins = realloc(stmt->ins, (numlines + 1) * sizeof(chidb_instruction));
+    stmt->ins[numlines].instruction = DBM_SEEKGE;       // Go to the first entry >= the first key
+    stmt->ins[numlines].P1 = 1;                         // in the index
+    stmt->ins[numlines].P2 = 0;                         // or, if there is none, jump to CLOSE (set later)
+    stmt->ins[numlines].P3 = rlow;
+    numlines++;
+
+    // Stop after the last entry, and find the row of each one
+    int loop = numlines;
+    stmt->ins = realloc(stmt->ins, (numlines + 3) * sizeof(chidb_instruction));
+    stmt->ins[numlines].instruction = DBM_IDXGT;        // Stop when the entry is > the last key
+    stmt->ins[numlines].P1 = 1;                         // in the index
+    stmt->ins[numlines].P2 = 0;                         // by jumping to CLOSE (set later)
+    stmt->ins[numlines].P3 = rhigh;
+    numlines++;
+    stmt->ins[numlines].instruction = DBM_IDXKEY;       // Get the primary key of the entry
+    stmt->ins[numlines].P1 = 1;                         // in the index
+    stmt->ins[numlines].P2 = ++rmax;                    // into a new register
+    numlines++;
+    int seekrow = numlines;
+    stmt->ins[numlines].instruction = DBM_SEEK;         // Go to the row with that primary key
+    stmt->ins[numlines].P1 = 0;                         // in the table
+    stmt->ins[numlines].P2 = 0;                         // or skip the entry if there is none (set later)
+    stmt->ins[numlines].P3 = rmax;
+    numlines++;
+
+    // Skip the rows that do not match the whole WHERE clause
+    int firstcond = numlines;
+    numlines = chidb_prepare_where(stmt, numlines, &rmax, select->where_conds, select->where_nconds, create);
+    int lastcond = numlines;
+
+    // Select the columns
+    int start = rmax + 1;
+    int ncols = (select->select_ncols == SELECT_ALL) ? table->num_cols : select->select_ncols;
+    for(int i = 0; i < ncols; i++) {
+        int c = i;
+        for(int j = 0; select->select_ncols != SELECT_ALL && j < table->num_cols; j++) {
+            if(!strcmp(select->select_cols[i].name, create->query.createTable.cols[j].name))
+                c = j;
+        }
+        stmt->ins = realloc(stmt->ins, (numlines + 1) * sizeof(chidb_instruction));
+        if(c == table->pk) {
+            stmt->ins[numlines].instruction = DBM_KEY;      // Get a primary key value
+            stmt->ins[numlines].P1 = 0;                     // using cursor 0
+            stmt->ins[numlines].P2 = ++rmax;                // into a new register
+        } else {
+            stmt->ins[numlines].instruction = DBM_COLUMN;   // Get a column value
+            stmt->ins[numlines].P1 = 0;                     // using cursor 0
+            stmt->ins[numlines].P2 = c;                     // from column c
+            stmt->ins[numlines].P3 = ++rmax;                // into a new register
+        }
+        numlines++;
+    }
+
+    // Get Result Row
+    stmt->ins = realloc(stmt->ins, (numlines + 1) * sizeof(chidb_instruction));
+    stmt->ins[numlines].instruction = DBM_RESULTROW;    // Get a result row
+    stmt->ins[numlines].P1 = start;                     // Identify start register
+    stmt->ins[numlines].P2 = ncols;                     // Identify the number of columns in the result
+    numlines++;
+
+    // Move on to the next entry of the index
+    int next = numlines;
+    stmt->ins = realloc(stmt->ins, (numlines + 1) * sizeof(chidb_instruction));
+    stmt->ins[numlines].instruction = DBM_NEXT;         // Go to the next entry
+    stmt->ins[numlines].P1 = 1;                         // of the index
+    stmt->ins[numlines].P2 = loop;                      // and check it again
+    numlines++;
+
+    // Update the conditional jumps to point to the NEXT instruction
+    stmt->ins[seekrow].P2 = next;
+    for(int i = firstcond; i < lastcond; i++) {
+        if(stmt->ins[i].instruction == DBM_EQ ||
+           stmt->ins[i].instruction == DBM_NE ||
+           stmt->ins[i].instruction == DBM_LT ||
+           stmt->ins[i].instruction == DBM_LE ||
+           stmt->ins[i].instruction == DBM_GT ||
+           stmt->ins[i].instruction == DBM_GE)
+            stmt->ins[i].P2 = next;
+    }
+
+    // Close the cursors
+    stmt->ins = realloc(stmt->ins, (numlines + 3) * sizeof(chidb_instruction));
+    stmt->ins[seek].P2 = numlines;                      // (SEEKGE and IDXGT jump here)
+    stmt->ins[loop].P2 = numlines;
+    stmt->ins[numlines].instruction = DBM_CLOSE;        // Close the cursor
+    stmt->ins[numlines].P1 = 0;                         // of the table
+    numlines++;
+    stmt->ins[numlines].instruction = DBM_CLOSE;        // Close the cursor
+    stmt->ins[numlines].P1 = 1;                         // of the index
+    numlines++;
+
+    // Halt execution
+    stmt->ins[numlines].instruction = DBM_HALT;         // Halt execution
+    stmt->ins[numlines].P1 = 0;                         // with return value 0
+    numlines++;
+
+    return numlines;
+}
+
+/* Compile a statement (see chidb_prepare) */
+static int chidb_prepare_statement(chidb *db, const char *sql, chidb_stmt **stmt)
 {
     int err;
 
@@ -114,12 +860,14 @@ int chidb_prepare(chidb *db, const char *sql, chidb_stmt **stmt)
         return CHIDB_EINVALIDSQL;
 
     int first_where_ops[10];
+    int pragma_setting, pragma_value;
     // Check that the query is valid against our schema table
     int root_page;
     int ncols;
     int pk;
+    IndexInfo index_info;
     SchemaTableRow *schema_row = NULL;
-    SQLStatement *create_table_stmt;
+    SQLStatement *create_table_stmt = NULL;
     switch(sql_stmt->type) {
         case STMT_SELECT:
         {
@@ -224,6 +972,95 @@ int chidb_prepare(chidb *db, const char *sql, chidb_stmt **stmt)
             }
             break;
         }
+        case STMT_DELETE:
+        {
+            // Check that the table name is valid
+            for(int i = 0; i < db->bt->schema_table_size; i++) {
+                if(!strcmp(sql_stmt->query.delete.table, db->bt->schema_table[i]->item_name) &&
+                   !strcmp(db->bt->schema_table[i]->item_type, "table")) {
+                    schema_row = db->bt->schema_table[i];
+                    root_page = schema_row->root_page;
+                    break;
+                }
+            }
+            if(!schema_row)
+                return CHIDB_EINVALIDSQL;
+
+            // Check that all column names in the WHERE clause are valid
+            chidb_parser(schema_row->sql, &create_table_stmt);
+            pk = create_table_stmt->query.createTable.pk;
+            ncols = create_table_stmt->query.createTable.ncols;
+            if(!chidb_prepare_checkWhere(sql_stmt->query.delete.where_conds, sql_stmt->query.delete.where_nconds, create_table_stmt))
+                return CHIDB_EINVALIDSQL;
+            break;
+        }
+        case STMT_UPDATE:
+        {
+            // Check that the table name is valid
+            for(int i = 0; i < db->bt->schema_table_size; i++) {
+                if(!strcmp(sql_stmt->query.update.table, db->bt->schema_table[i]->item_name) &&
+                   !strcmp(db->bt->schema_table[i]->item_type, "table")) {
+                    schema_row = db->bt->schema_table[i];
+                    root_page = schema_row->root_page;
+                    break;
+                }
+            }
+            if(!schema_row)
+                return CHIDB_EINVALIDSQL;
+
+            chidb_parser(schema_row->sql, &create_table_stmt);
+            pk = create_table_stmt->query.createTable.pk;
+            ncols = create_table_stmt->query.createTable.ncols;
+
+            // Check that all SET columns are valid. The primary key cannot be
+            // changed, since the entry would have to move in the B-Tree.
+            for(int i = 0; i < sql_stmt->query.update.nsets; i++) {
+                int match = 0;
+                for(int j = 0; j < ncols; j++) {
+                    if(!strcmp(sql_stmt->query.update.sets[i].col, create_table_stmt->query.createTable.cols[j].name) && j != pk) {
+                        match = 1;
+                        break;
+                    }
+                }
+                if(!match)
+                    return CHIDB_EINVALIDSQL;
+            }
+
+            // Check that all column names in the WHERE clause are valid
+            if(!chidb_prepare_checkWhere(sql_stmt->query.update.where_conds, sql_stmt->query.update.where_nconds, create_table_stmt))
+                return CHIDB_EINVALIDSQL;
+            break;
+        }
+        case STMT_CREATEINDEX:
+        {
+            // Check that the index name is not in use, and that the table is valid
+            for(int i = 0; i < db->bt->schema_table_size; i++) {
+                if(!strcmp(sql_stmt->query.createIndex.index, db->bt->schema_table[i]->item_name))
+                    return CHIDB_EINVALIDSQL;
+                if(!strcmp(sql_stmt->query.createIndex.table, db->bt->schema_table[i]->item_name) &&
+                   !strcmp(db->bt->schema_table[i]->item_type, "table")) {
+                    schema_row = db->bt->schema_table[i];
+                    root_page = schema_row->root_page;
+                }
+            }
+            if(!schema_row)
+                return CHIDB_EINVALIDSQL;
+
+            // Check that the columns are valid
+            chidb_parser(schema_row->sql, &create_table_stmt);
+            pk = create_table_stmt->query.createTable.pk;
+            ncols = create_table_stmt->query.createTable.ncols;
+            if(!chidb_prepare_indexColumns(sql_stmt, create_table_stmt, &index_info))
+                return CHIDB_EINVALIDSQL;
+            break;
+        }
+        case STMT_PRAGMA:
+        {
+            // Check that the setting and its value are valid
+            if(!chidb_prepare_pragma(&sql_stmt->query.pragma, &pragma_setting, &pragma_value))
+                return CHIDB_EINVALIDSQL;
+            break;
+        }
     }
 
     // Compile the SQL statement into valid chidb statements
@@ -261,6 +1098,10 @@ int chidb_prepare(chidb *db, const char *sql, chidb_stmt **stmt)
             //if(sr)
             //    break;
         }
+    } else {
+        tablelist->num_tables = 0;
+        tablelist->num_cols = 0;
+        tablelist->tables = NULL;
     }
     
    
@@ -269,12 +1110,13 @@ int chidb_prepare(chidb *db, const char *sql, chidb_stmt **stmt)
 
     tabledata* new_table_data = malloc(tablelist->num_tables * sizeof(tabledata));
     table_pair* table_pair_list = malloc(tablelist->num_tables * sizeof(table_pair));
-    (*stmt)->input_dbm = init_dbm((*stmt),0,1);
-    init_lists(*stmt);
+    // The cell lists are only loaded to order the tables of a join
+    (*stmt)->input_dbm = init_dbm((*stmt),0,0);
+    prepare_lists((*stmt)->input_dbm);
     (*stmt)->initialized_dbm=1;
     for(int ii = 0; ii < tablelist->num_tables; ii++) {
       table_pair_list[ii].table_num = ii;
-      table_pair_list[ii].table_size = get_table_size((*stmt)->input_dbm, tablelist->tables[ii].table_num);
+      table_pair_list[ii].table_size = (tablelist->num_tables > 1) ? get_table_size((*stmt)->input_dbm, tablelist->tables[ii].table_num) : 0;
       //printf("table_name: %s\n", tablelist->tables[ii].name); 
       //printf("table_size: %d\n", table_pair_list[ii].table_size);
     }
@@ -301,6 +1143,13 @@ int chidb_prepare(chidb *db, const char *sql, chidb_stmt **stmt)
             int rmax = 0;
             (*stmt)->ins = NULL;
 
+            // Look up an indexed value instead of scanning the table, if possible
+            if(tablelist->num_tables == 1 &&
+               (numlines = chidb_prepare_indexSelect(*stmt, &tablelist->tables[0], &sql_stmt->query.select)) > 0) {
+                (*stmt)->num_instructions = numlines;
+                break;
+            }
+
             for(int t = 0; t < tablelist->num_tables; t++) {
                 // Store the page number
                 (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
@@ -620,6 +1469,14 @@ int chidb_prepare(chidb *db, const char *sql, chidb_stmt **stmt)
             (*stmt)->ins[numlines].P3 = create_table_stmt->query.createTable.pk+1; // with primary key in column pk in this register
             numlines++;
 
+            // Add the new row to the indexes of the table
+            IndexInfo *indexes;
+            int nindexes = chidb_prepare_indexes(db, sql_stmt->query.insert.table, create_table_stmt, &indexes);
+            numlines = chidb_prepare_openIndexes(*stmt, numlines, &rmax, indexes, nindexes);
+            numlines = chidb_prepare_indexRow(*stmt, numlines, &rmax, DBM_IDXINSERT, indexes, nindexes, NULL, 1, pk);
+            numlines = chidb_prepare_closeIndexes(*stmt, numlines, nindexes);
+            free(indexes);
+
             // Close the cursor
             (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
             (*stmt)->ins[numlines].instruction = DBM_CLOSE;      // Close the cursor
@@ -639,41 +1496,474 @@ int chidb_prepare(chidb *db, const char *sql, chidb_stmt **stmt)
             }
             */
 
+            break;
+        }
+        case STMT_DELETE:
+        {
+            int numlines = 0;
+            int rmax = 0;
+
+            // Store the page number
+            (*stmt)->ins = malloc(sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_INTEGER;    // Integer type
+            (*stmt)->ins[numlines].P1 = root_page;               // Store the root page
+            (*stmt)->ins[numlines].P2 = 0;                       // into register 0
+            numlines++;
+
+            // Open the B-Tree
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_OPENWRITE;  // Open a B-Tree
+            (*stmt)->ins[numlines].P1 = 0;                       // with cursor 0
+            (*stmt)->ins[numlines].P2 = 0;                       // on the page in register 0
+            (*stmt)->ins[numlines].P3 = ncols;                   // having ncols columns
+            numlines++;
+
+            // Open the indexes of the table
+            IndexInfo *indexes;
+            int nindexes = chidb_prepare_indexes(db, sql_stmt->query.delete.table, create_table_stmt, &indexes);
+            numlines = chidb_prepare_openIndexes(*stmt, numlines, &rmax, indexes, nindexes);
+
+            // Rewind the B-Tree
+            int rewind = numlines;
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_REWIND;     // Rewind to the beginning of the B-Tree
+            (*stmt)->ins[numlines].P1 = 0;                       // using cursor 0
+            (*stmt)->ins[numlines].P2 = 0;                       // and if the table is empty, jump to CLOSE (set later)
+            numlines++;
+
+            // Skip the rows that do not match the WHERE clause
+            int firstcond = numlines;
+            numlines = chidb_prepare_where(*stmt, numlines, &rmax, sql_stmt->query.delete.where_conds,
+                                           sql_stmt->query.delete.where_nconds, create_table_stmt);
+
+            // Remove the row from the indexes
+            numlines = chidb_prepare_indexRow(*stmt, numlines, &rmax, DBM_IDXDELETE, indexes, nindexes, NULL, -1, pk);
+
+            // Delete the row
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_DELETE;     // Delete the entry
+            (*stmt)->ins[numlines].P1 = 0;                       // pointed to by cursor 0
+            numlines++;
+
+            // Move on to the next row
+            int next = numlines;
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_NEXT;       // Go to the next entry
+            (*stmt)->ins[numlines].P1 = 0;                       // of cursor 0
+            (*stmt)->ins[numlines].P2 = firstcond;               // and check the WHERE clause again
+            numlines++;
+
+            // Update the conditional jumps to point to the NEXT instruction
+            for(int i = firstcond; i < next; i++) {
+                if((*stmt)->ins[i].instruction == DBM_EQ ||
+                   (*stmt)->ins[i].instruction == DBM_NE ||
+                   (*stmt)->ins[i].instruction == DBM_LT ||
+                   (*stmt)->ins[i].instruction == DBM_LE ||
+                   (*stmt)->ins[i].instruction == DBM_GT ||
+                   (*stmt)->ins[i].instruction == DBM_GE)
+                    (*stmt)->ins[i].P2 = next;
+            }
+
+            // Close the cursor
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_CLOSE;      // Close the cursor
+            (*stmt)->ins[numlines].P1 = 0;                       // number 0
+            (*stmt)->ins[rewind].P2 = numlines;                  // (REWIND jumps here on an empty table)
+            numlines++;
+            numlines = chidb_prepare_closeIndexes(*stmt, numlines, nindexes);
+            free(indexes);
+
+            // Halt execution
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_HALT;       // Halt execution
+            (*stmt)->ins[numlines].P1 = 0;                       // with return value 0
+            numlines++;
+
+            (*stmt)->num_instructions = numlines;
+
+            break;
+        }
+        case STMT_UPDATE:
+        {
+            int numlines = 0;
+            int rmax = 0;
+
+            // Store the page number
+            (*stmt)->ins = malloc(sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_INTEGER;    // Integer type
+            (*stmt)->ins[numlines].P1 = root_page;               // Store the root page
+            (*stmt)->ins[numlines].P2 = 0;                       // into register 0
+            numlines++;
+
+            // Open the B-Tree
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_OPENWRITE;  // Open a B-Tree
+            (*stmt)->ins[numlines].P1 = 0;                       // with cursor 0
+            (*stmt)->ins[numlines].P2 = 0;                       // on the page in register 0
+            (*stmt)->ins[numlines].P3 = ncols;                   // having ncols columns
+            numlines++;
+
+            // Open the indexes of the table
+            IndexInfo *indexes;
+            int nindexes = chidb_prepare_indexes(db, sql_stmt->query.update.table, create_table_stmt, &indexes);
+            numlines = chidb_prepare_openIndexes(*stmt, numlines, &rmax, indexes, nindexes);
+
+            // Rewind the B-Tree
+            int rewind = numlines;
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_REWIND;     // Rewind to the beginning of the B-Tree
+            (*stmt)->ins[numlines].P1 = 0;                       // using cursor 0
+            (*stmt)->ins[numlines].P2 = 0;                       // and if the table is empty, jump to CLOSE (set later)
+            numlines++;
+
+            // Skip the rows that do not match the WHERE clause
+            int firstcond = numlines;
+            numlines = chidb_prepare_where(*stmt, numlines, &rmax, sql_stmt->query.update.where_conds,
+                                           sql_stmt->query.update.where_nconds, create_table_stmt);
+            int lastcond = numlines;
+
+            // Remove the old values of the columns in the SET clause from their indexes
+            bool *changed = calloc(ncols, sizeof(bool));
+            for(int c = 0; c < ncols; c++) {
+                for(int i = 0; i < sql_stmt->query.update.nsets; i++) {
+                    if(!strcmp(sql_stmt->query.update.sets[i].col, create_table_stmt->query.createTable.cols[c].name))
+                        changed[c] = true;
+                }
+            }
+            numlines = chidb_prepare_indexRow(*stmt, numlines, &rmax, DBM_IDXDELETE, indexes, nindexes, changed, -1, pk);
+
+            // Store the new record contents into registers: the new value of
+            // the columns in the SET clause, and the current value of the rest
+            int start = rmax + 1;
+            for(int c = 0; c < ncols; c++) {
+                Assignment *set = NULL;
+                for(int i = 0; i < sql_stmt->query.update.nsets; i++) {
+                    if(!strcmp(sql_stmt->query.update.sets[i].col, create_table_stmt->query.createTable.cols[c].name))
+                        set = &sql_stmt->query.update.sets[i];
+                }
+
+                (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+                if(set == NULL && c == pk) {
+                    (*stmt)->ins[numlines].instruction = DBM_KEY;        // Get the primary key value
+                    (*stmt)->ins[numlines].P1 = 0;                       // using cursor 0
+                    (*stmt)->ins[numlines].P2 = ++rmax;                  // into a new register
+                } else if(set == NULL) {
+                    (*stmt)->ins[numlines].instruction = DBM_COLUMN;     // Get the current column value
+                    (*stmt)->ins[numlines].P1 = 0;                       // using cursor 0
+                    (*stmt)->ins[numlines].P2 = c;                       // from column c
+                    (*stmt)->ins[numlines].P3 = ++rmax;                  // into a new register
+                } else {
+                    switch(set->val.type) {
+                        case INS_INT:
+                            (*stmt)->ins[numlines].instruction = DBM_INTEGER;    // Store an integer value
+                            (*stmt)->ins[numlines].P1 = set->val.val.integer;
+                            (*stmt)->ins[numlines].P2 = ++rmax;
+                            break;
+                        case INS_STR:
+                            (*stmt)->ins[numlines].instruction = DBM_STRING;     // Store a string pointer
+                            (*stmt)->ins[numlines].P1 = strlen(set->val.val.string) + 1;
+                            (*stmt)->ins[numlines].P2 = ++rmax;
+                            (*stmt)->ins[numlines].P4 = set->val.val.string;
+                            break;
+                        case INS_NULL:
+                            (*stmt)->ins[numlines].instruction = DBM_NULL;       // Store a null value
+                            (*stmt)->ins[numlines].P2 = ++rmax;
+                            break;
+                    }
+                }
+                numlines++;
+            }
+
+            // Make the new record
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_MAKERECORD;             // Create a new record
+            (*stmt)->ins[numlines].P1 = start;                               // beginning with register start
+            (*stmt)->ins[numlines].P2 = ncols;                               // with this many columns
+            (*stmt)->ins[numlines].P3 = ++rmax;                              // and store the record in a new register
+            numlines++;
+
+            // Replace the record
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_UPDATE;                 // Replace the record
+            (*stmt)->ins[numlines].P1 = 0;                                   // using cursor 0
+            (*stmt)->ins[numlines].P2 = rmax;                                // with the record in register rmax
+            (*stmt)->ins[numlines].P3 = start + pk;                          // with primary key in column pk in this register
+            numlines++;
+
+            // Add the new values to the indexes
+            numlines = chidb_prepare_indexRow(*stmt, numlines, &rmax, DBM_IDXINSERT, indexes, nindexes, changed, start, pk);
+            free(changed);
+
+            // Move on to the next row
+            int next = numlines;
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_NEXT;       // Go to the next entry
+            (*stmt)->ins[numlines].P1 = 0;                       // of cursor 0
+            (*stmt)->ins[numlines].P2 = firstcond;               // and check the WHERE clause again
+            numlines++;
+
+            // Update the conditional jumps to point to the NEXT instruction
+            for(int i = firstcond; i < lastcond; i++) {
+                if((*stmt)->ins[i].instruction == DBM_EQ ||
+                   (*stmt)->ins[i].instruction == DBM_NE ||
+                   (*stmt)->ins[i].instruction == DBM_LT ||
+                   (*stmt)->ins[i].instruction == DBM_LE ||
+                   (*stmt)->ins[i].instruction == DBM_GT ||
+                   (*stmt)->ins[i].instruction == DBM_GE)
+                    (*stmt)->ins[i].P2 = next;
+            }
+
+            // Close the cursor
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_CLOSE;      // Close the cursor
+            (*stmt)->ins[numlines].P1 = 0;                       // number 0
+            (*stmt)->ins[rewind].P2 = numlines;                  // (REWIND jumps here on an empty table)
+            numlines++;
+            numlines = chidb_prepare_closeIndexes(*stmt, numlines, nindexes);
+            free(indexes);
+
+            // Halt execution
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_HALT;       // Halt execution
+            (*stmt)->ins[numlines].P1 = 0;                       // with return value 0
+            numlines++;
+
+            (*stmt)->num_instructions = numlines;
+
+            break;
+        }
+        case STMT_CREATEINDEX:
+        {
+            int numlines = 0;
+            int rmax = 0;
+
+            // Create the index B-Tree
+            (*stmt)->ins = malloc(5 * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_CREATEINDEX; // Create an empty index B-Tree
+            (*stmt)->ins[numlines].P1 = 0;                       // and store its root page into register 0
+            numlines++;
+
+            // Open the table, and the new index
+            (*stmt)->ins[numlines].instruction = DBM_INTEGER;    // Integer type
+            (*stmt)->ins[numlines].P1 = root_page;               // Store the root page of the table
+            (*stmt)->ins[numlines].P2 = ++rmax;                  // into register 1
+            numlines++;
+            (*stmt)->ins[numlines].instruction = DBM_OPENREAD;   // Open the table
+            (*stmt)->ins[numlines].P1 = 0;                       // with cursor 0
+            (*stmt)->ins[numlines].P2 = rmax;                    // on the page in register 1
+            (*stmt)->ins[numlines].P3 = ncols;                   // having ncols columns
+            numlines++;
+            (*stmt)->ins[numlines].instruction = DBM_OPENWRITE;  // Open the index
+            (*stmt)->ins[numlines].P1 = 1;                       // with cursor 1
+            (*stmt)->ins[numlines].P2 = 0;                       // on the page in register 0
+            (*stmt)->ins[numlines].P3 = index_info.ncols;        // having keys of ncols columns
+            numlines++;
+
+            // Rewind the table
+            int rewind = numlines;
+            (*stmt)->ins[numlines].instruction = DBM_REWIND;     // Rewind to the beginning of the table
+            (*stmt)->ins[numlines].P1 = 0;                       // using cursor 0
+            (*stmt)->ins[numlines].P2 = 0;                       // and if it is empty, jump to CLOSE (set later)
+            numlines++;
+
+            // Add the entry of each row to the index
+            int first = numlines;
+            numlines = chidb_prepare_indexRow(*stmt, numlines, &rmax, DBM_IDXINSERT, &index_info, 1, NULL, -1, pk);
+
+            // Move on to the next row
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 3) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_NEXT;       // Go to the next row
+            (*stmt)->ins[numlines].P1 = 0;                       // of cursor 0
+            (*stmt)->ins[numlines].P2 = first;                   // and add it too
+            numlines++;
+
+            // Close the cursors
+            (*stmt)->ins[rewind].P2 = numlines;                  // (REWIND jumps here on an empty table)
+            (*stmt)->ins[numlines].instruction = DBM_CLOSE;      // Close the cursor
+            (*stmt)->ins[numlines].P1 = 0;                       // number 0
+            numlines++;
+            (*stmt)->ins[numlines].instruction = DBM_CLOSE;      // Close the cursor
+            (*stmt)->ins[numlines].P1 = 1;                       // number 1
+            numlines++;
+
+            // Add the index to the schema table: type, name, table, root page and SQL
+            char *values[] = {"index", sql_stmt->query.createIndex.index, sql_stmt->query.createIndex.table,
+                              NULL, chidb_parser_CreateIndexToString(sql_stmt)};
+            int schema = rmax + 1;
+            for(int i = 0; i < 5; i++) {
+                (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+                if(values[i] == NULL) {
+                    (*stmt)->ins[numlines].instruction = DBM_SCOPY;  // Copy the root page of the index
+                    (*stmt)->ins[numlines].P1 = 0;                   // from register 0
+                    (*stmt)->ins[numlines].P2 = ++rmax;              // into a new register
+                } else {
+                    (*stmt)->ins[numlines].instruction = DBM_STRING; // String type
+                    (*stmt)->ins[numlines].P1 = strlen(values[i]) + 1; // Store the length
+                    (*stmt)->ins[numlines].P2 = ++rmax;              // into a new register
+                    (*stmt)->ins[numlines].P4 = values[i];           // and keep a ptr
+                }
+                numlines++;
+            }
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 2) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_ADDSCHEMA;  // Add a row to the schema table
+            (*stmt)->ins[numlines].P1 = schema;                  // with the values in the five registers from here
+            numlines++;
+
+            // Halt execution
+            (*stmt)->ins[numlines].instruction = DBM_HALT;       // Halt execution
+            (*stmt)->ins[numlines].P1 = 0;                       // with return value 0
+            numlines++;
+
+            (*stmt)->num_instructions = numlines;
+
+            break;
+        }
+        case STMT_VACUUM:
+        {
+            int numlines = 0;
+
+            // Rebuild the whole file
+            (*stmt)->ins = malloc(sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_VACUUM;     // Compact all the B-Trees
+            numlines++;
+
+            // Halt execution
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_HALT;       // Halt execution
+            (*stmt)->ins[numlines].P1 = 0;                       // with return value 0
+            numlines++;
+
+            (*stmt)->num_instructions = numlines;
+
+            break;
+        }
+        case STMT_BEGIN:
+        case STMT_COMMIT:
+        case STMT_ROLLBACK:
+        {
+            int numlines = 0;
+
+            // Start or end a transaction
+            (*stmt)->ins = malloc(sizeof(chidb_instruction));
+            if(sql_stmt->type == STMT_BEGIN)
+                (*stmt)->ins[numlines].instruction = DBM_BEGIN;
+            else if(sql_stmt->type == STMT_COMMIT)
+                (*stmt)->ins[numlines].instruction = DBM_COMMIT;
+            else
+                (*stmt)->ins[numlines].instruction = DBM_ROLLBACK;
+            numlines++;
+
+            // Halt execution
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_HALT;       // Halt execution
+            (*stmt)->ins[numlines].P1 = 0;                       // with return value 0
+            numlines++;
+
+            (*stmt)->num_instructions = numlines;
+
+            break;
+        }
+        case STMT_PRAGMA:
+        {
+            int numlines = 0;
+
+            // Change the setting
+            (*stmt)->ins = malloc(sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_PRAGMA;
+            (*stmt)->ins[numlines].P1 = pragma_setting;          // Setting to change
+            (*stmt)->ins[numlines].P2 = pragma_value;            // New value
+            numlines++;
+
+            // Halt execution
+            (*stmt)->ins = realloc((*stmt)->ins, (numlines + 1) * sizeof(chidb_instruction));
+            (*stmt)->ins[numlines].instruction = DBM_HALT;       // Halt execution
+            (*stmt)->ins[numlines].P1 = 0;                       // with return value 0
+            numlines++;
+
+            (*stmt)->num_instructions = numlines;
+
             break;
         }
     }
 
 	//let the dbm know that we should initialize the dbm for statement
 	(*stmt)->initialized_dbm = 0;
+	(*stmt)->autocommit = 0;
 	return CHIDB_OK;
 }
 
+int chidb_prepare(chidb *db, const char *sql, chidb_stmt **stmt)
+{
+    // Read from the newest snapshot of a database in WAL mode, which
+    // checkpoints leave alone until the statement is finalized
+    int err = chidb_Pager_beginRead(db->bt->pager);
+    if(err != CHIDB_OK)
+        return err;
+
+    err = chidb_prepare_statement(db, sql, stmt);
+    if(err != CHIDB_OK)
+        chidb_Pager_endRead(db->bt->pager);
+    return err;
+}
+
+// Whether a statement modifies the database
+static bool chidb_stmt_writes(chidb_stmt *stmt)
+{
+    switch(stmt->sql->type) {
+        case STMT_INSERT:
+        case STMT_CREATETABLE:
+        case STMT_CREATEINDEX:
+        case STMT_DELETE:
+        case STMT_UPDATE:
+            return true;
+    }
+    return false;
+}
+
 int chidb_step(chidb_stmt *stmt)
 {
 	if (stmt->initialized_dbm == 0) {
-		//dbm needs to be initialized
-		stmt->input_dbm = init_dbm(stmt, 1, 0);
-		init_lists(stmt);	
+		//dbm needs to be initialized. THE CELL LISTS ARE LOADED AGAIN (WHEN A CURSOR NEEDS THEM), SINCE
+		//THE TREES MAY HAVE CHANGED SINCE chidb_prepare
+		prepare_lists(stmt->input_dbm);
 		stmt->initialized_dbm = 1;
 	}
+	if (stmt->input_dbm->load_error == CHIDB_ECHECKSUM)
+		return CHIDB_ECORRUPT;
+	
+	//OUTSIDE A TRANSACTION, A STATEMENT THAT MODIFIES THE DATABASE RUNS IN ONE OF ITS OWN: ALL THE
+	//B-TREE CHANGES IT MAKES (E.G., A ROW AND ITS INDEX ENTRIES) ARE COMMITTED TOGETHER, OR NOT AT ALL
+	if (stmt->input_dbm->program_counter == 0 && !stmt->autocommit && !stmt->db->bt->pager->in_txn && chidb_stmt_writes(stmt)) {
+		int err = chidb_begin(stmt->db);
+		if (err != CHIDB_OK) {
+			return err;
+		}
+		stmt->autocommit = 1;
+	}
 	
-	//DEPRECATED
-	//stmt->input_dbm->create_table = stmt->create_table;
+	//DEPRECATED, but MAKERECORD still reads the column types from it
+	stmt->input_dbm->create_table = stmt->create_table;
 	stmt->input_dbm->table_list = stmt->table_list;
 	
-  if (stmt->sql->type == STMT_INSERT) {
-  	for (int i = 0; i < stmt->db->bt->schema_table_size; i++) {
-    	if (strcmp(stmt->sql->query.insert.table,stmt->db->bt->schema_table[i]->item_name) == 0) {
-      	stmt->input_dbm->table_root = stmt->db->bt->schema_table[i]->root_page;
-      }
-    }
-  }
 	//INSTRUCTION LOOP
 	uint32_t result = 0;
 	do {
 		result = tick_dbm(stmt->input_dbm, *(stmt->ins + stmt->input_dbm->program_counter));
 	} while (result == DBM_OK);
 	
+	//THE STATEMENT IS OVER: KEEP ITS CHANGES ONLY IF IT SUCCEEDED
+	if (result != DBM_RESULT && stmt->autocommit) {
+		stmt->autocommit = 0;
+		if (result == DBM_HALT_STATE && stmt->input_dbm->tick_result == DBM_OK) {
+			int err = chidb_commit(stmt->db);
+			if (err != CHIDB_OK) {
+				return err;
+			}
+		} else {
+			chidb_rollback(stmt->db);
+		}
+	}
+	
 	if (result == DBM_HALT_STATE) {
 		uint32_t tr = stmt->input_dbm->tick_result;
 		if (tr == DBM_OK) {
@@ -688,7 +1978,10 @@ int chidb_step(chidb_stmt *stmt)
 			if (tr == CHIDB_EIO) {
 				return DBM_IO_ERROR;
 			}
-    	if (tr == DBM_INVALID_INSTRUCTION) {
+    	if (tr == DBM_CORRUPT) {
+    		return CHIDB_ECORRUPT;
+    	}
+    	if (tr == DBM_INVALID_INSTRUCTION || tr == DBM_MISUSE) {
     		return CHIDB_EMISUSE;
     	}
     	if (tr == DBM_IO_ERROR || tr == DBM_OPENRW_ERROR || tr == DBM_MEMORY_FREE_ERROR || tr == DBM_MEMORY_ERROR || tr == DBM_CELL_NUMBER_BOUNDS) {
@@ -713,6 +2006,11 @@ int chidb_step(chidb_stmt *stmt)
 
 int chidb_finalize(chidb_stmt *stmt)
 {
+	//A STATEMENT THAT WAS NOT RUN TO THE END KEEPS NONE OF ITS CHANGES
+	if (stmt->autocommit) {
+		chidb_rollback(stmt->db);
+	}
+	chidb_Pager_endRead(stmt->db->bt->pager);
 	reset_dbm(stmt->input_dbm);
   clear_lists(stmt->input_dbm);
   free(stmt->input_dbm);
@@ -769,9 +2067,31 @@ const char *chidb_column_name(chidb_stmt* stmt, int col)
 
 int chidb_column_int(chidb_stmt *stmt, int col)
 {
-    int retval;
-    chidb_DBRecord_getInt32(stmt->record, col, &retval);
-    return retval;
+    return (int) chidb_column_int64(stmt, col);
+}
+
+int64_t chidb_column_int64(chidb_stmt *stmt, int col)
+{
+    int8_t i8;
+    int16_t i16;
+    int32_t i32;
+    int64_t i64;
+
+    switch(chidb_DBRecord_getType(stmt->record, col)) {
+        case SQL_INTEGER_1BYTE:
+            chidb_DBRecord_getInt8(stmt->record, col, &i8);
+            return i8;
+        case SQL_INTEGER_2BYTE:
+            chidb_DBRecord_getInt16(stmt->record, col, &i16);
+            return i16;
+        case SQL_INTEGER_4BYTE:
+            chidb_DBRecord_getInt32(stmt->record, col, &i32);
+            return i32;
+        case SQL_INTEGER_8BYTE:
+            chidb_DBRecord_getInt64(stmt->record, col, &i64);
+            return i64;
+    }
+    return 0;
 }
 
 // TODO: Free the returned string from memory...
@@ -25,17 +25,36 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/types.h>
-#include <sys/stat.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <time.h>
 
 #include <chidbInt.h>
 
 #include "pager.h"
+#include "checksum.h"
+#include "util.h"
+
+static int chidb_Pager_pageIO(Pager *pager, npage_t npage, uint16_t offset, uint8_t *buf, size_t len, bool write);
+static int chidb_Pager_playback(Pager *pager, VfsFile *journal);
+static int chidb_Pager_recover(Pager *pager);
+static int chidb_Pager_openWal(Pager *pager);
+static int chidb_Pager_spill(Pager *pager);
+static int chidb_Pager_bumpChangeCounter(Pager *pager);
+static void chidb_Pager_setChecksum(Pager *pager, uint8_t *data);
+static void chidb_Pager_updateCache(Pager *pager);
+static void chidb_Pager_dropReadAhead(Pager *pager);
+static int chidb_Pager_readAhead(Pager *pager, npage_t npage);
 
 /* Open a file
  *
- * This function opens a file for paged access.
+ * This function opens a file for paged access. The file, and the
+ * journal or WAL that go with it, are accessed through the default
+ * VFS (see chidb_Vfs_find).
+ *
+ * If the file name is ":memory:", a new, empty in-memory database is
+ * created instead, with every page kept in the memory VFS. Each of them
+ * is private to its pager, and is gone once the pager is closed.
  *
  * Parameters
  * - pager: An out parameter. Used to return a pointer to the
@@ -49,18 +68,98 @@
  */
 int chidb_Pager_open(Pager **pager, const char *filename)
 {
+	static uint32_t n_memory = 0;
+	char name[32];
+
+	if (strcmp(filename, MEMORY_FILENAME) != 0)
+		return chidb_Pager_openVfs(pager, chidb_Vfs_find(NULL), filename);
+
+	/* A name that no other in-memory database has */
+	sprintf(name, "%s%u", MEMORY_FILENAME, __sync_add_and_fetch(&n_memory, 1));
+
+	return chidb_Pager_openVfs(pager, chidb_Vfs_find("memory"), name);
+}
+
+
+/* Open a file in a given VFS
+ *
+ * Parameters
+ * - pager: An out parameter. Used to return a pointer to the
+ *			 newly created Pager.
+ * - vfs: VFS of the file.
+ * - filename: Database file (might not exist)
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Pager_openVfs(Pager **pager, Vfs *vfs, const char *filename)
+{
+	int rc;
+
 	*pager = malloc(sizeof(Pager));
 	if (pager == NULL)
 		return CHIDB_ENOMEM;
-	(*pager)->f = fopen(filename, "r+");
-	
-	if ((*pager)->f == NULL)
-		(*pager)->f = fopen(filename, "w+");
+	(*pager)->vfs = vfs;
+	(*pager)->has_header = false;
+	(*pager)->free_head = 0;
+	(*pager)->n_free = 0;
+	(*pager)->in_txn = false;
+	(*pager)->dirty = NULL;
+	(*pager)->dirty_size = 0;
+	(*pager)->dirty_list = NULL;
+	(*pager)->n_dirty = 0;
+	(*pager)->max_dirty = 0;
+	(*pager)->spilled = NULL;
+	(*pager)->n_spilled = 0;
+	(*pager)->file_written = false;
+	(*pager)->spill_size = DEFAULT_SPILL_PAGES;
+	(*pager)->journal = NULL;
+	(*pager)->wal = NULL;
+	(*pager)->n_readers = 0;
+	(*pager)->group_wait = 0;
+	(*pager)->group_size = 1;
+	(*pager)->sync_mode = CHIDB_SYNC_FULL;
+	(*pager)->ra_data = NULL;
+	memset((*pager)->ra_pages, 0, sizeof((*pager)->ra_pages));
+	(*pager)->ra_next = 0;
+	(*pager)->ra_end = 0;
+	(*pager)->last_read = 0;
+	(*pager)->seq_run = 0;
+	(*pager)->ra_hits = 0;
+	(*pager)->n_pool = 0;
+	(*pager)->page_size = 0;
+	(*pager)->usable_size = 0;
+	(*pager)->checksums = false;
+	(*pager)->cache = NULL;
+	(*pager)->cache_policy = DEFAULT_CACHE_POLICY;
+	(*pager)->cache_size = DEFAULT_CACHE_PAGES;
+	(*pager)->change_counter = 0;
+	(*pager)->filename = strdup(filename);
+	if ((*pager)->filename == NULL)
+		return CHIDB_ENOMEM;
+	(*pager)->journal_name = malloc(strlen(filename) + strlen(JOURNAL_SUFFIX) + 1);
+	if ((*pager)->journal_name == NULL)
+		return CHIDB_ENOMEM;
+	sprintf((*pager)->journal_name, "%s%s", filename, JOURNAL_SUFFIX);
+	rc = chidb_Vfs_open((*pager)->vfs, filename, VFS_OPEN_CREATE | VFS_OPEN_MAIN, &(*pager)->f);
+	if (rc != CHIDB_OK)
+		return rc == CHIDB_ENOMEM ? rc : CHIDB_EIO;
 
-	if ((*pager)->f == NULL)
-		return CHIDB_EIO;
-	else
+	/* A journal left behind by a transaction that never finished
+	 * committing means the file may be half-written. If another
+	 * connection holds the lock, the journal is still its own, and is
+	 * left alone */
+	rc = chidb_Vfs_lock((*pager)->f, VFS_LOCK_EXCLUSIVE, false);
+	if (rc == CHIDB_EBUSY)
 		return CHIDB_OK;
+	if (rc != CHIDB_OK)
+		return CHIDB_EIO;
+	rc = chidb_Pager_recover(*pager);
+	chidb_Vfs_lock((*pager)->f, VFS_LOCK_NONE, true);
+
+	return rc;
 }
 
 
@@ -71,19 +170,110 @@ int chidb_Pager_open(Pager **pager, const char *filename)
  * It will not verify if the page size makes size. If an incorrect
  * page size is provided, this will result in unexpected behaviour.
  *
+ * If the file has a non-empty WAL, the pager switches to WAL journal
+ * mode, since the WAL holds the newest version of some pages.
+ *
  * Parameters
  * - pager: A Pager.
  * - pagesize: Size of a page (in bytes)
  *
  * Return
  * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the WAL
  */
 int chidb_Pager_setPageSize(Pager *pager, uint16_t pagesize)
 {
+	VfsFile *f;
+	uint64_t size;
+	char *walname;
+	int rc = CHIDB_OK;
+
 	pager->page_size = pagesize;
+	pager->usable_size = pagesize - (pager->checksums ? PAGE_CHECKSUM_SIZE : 0);
+	chidb_Pager_dropReadAhead(pager);
+	free(pager->ra_data);
+	pager->ra_data = NULL;
+	while (pager->n_pool > 0)
+		free(pager->pool[--pager->n_pool]);
+	rc = chidb_Pager_setCache(pager, pager->cache_policy, pager->cache_size);
+	if (rc != CHIDB_OK)
+		return rc;
 	chidb_Pager_getRealDBSize(pager, &pager->n_pages);
+
+	walname = malloc(strlen(pager->filename) + strlen(WAL_SUFFIX) + 1);
+	if (walname == NULL)
+		return CHIDB_ENOMEM;
+	sprintf(walname, "%s%s", pager->filename, WAL_SUFFIX);
+	if (pager->wal == NULL && chidb_Vfs_open(pager->vfs, walname, 0, &f) == CHIDB_OK)
+	{
+		if (chidb_Vfs_size(f, &size) == CHIDB_OK && size > 0)
+			rc = chidb_Pager_openWal(pager);
+		chidb_Vfs_close(f);
+	}
+	free(walname);
 	
-	return CHIDB_OK;
+	return rc;
+}
+
+
+/* Allocate page buffers
+ *
+ * The buffers are aligned so that the VFS can read and write them with
+ * direct I/O (see PAGE_BUFFER_ALIGN).
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - n: Number of consecutive pages in the buffer.
+ *
+ * Return
+ * - The buffer, or NULL if it could not be allocated
+ */
+static uint8_t *chidb_Pager_allocBuffer(Pager *pager, size_t n)
+{
+	size_t align = sizeof(void *);
+	void *buf;
+
+	while (align < PAGE_BUFFER_ALIGN && pager->page_size % (align * 2) == 0)
+		align *= 2;
+	if (posix_memalign(&buf, align, n * pager->page_size) != 0)
+		return NULL;
+
+	return buf;
+}
+
+
+/* Take a zeroed page buffer from the pool (or allocate a new one)
+ *
+ * Parameters
+ * - pager: A Pager.
+ *
+ * Return
+ * - The buffer, or NULL if it could not be allocated
+ */
+static uint8_t *chidb_Pager_getBuffer(Pager *pager)
+{
+	uint8_t *buf = (pager->n_pool > 0) ? pager->pool[--pager->n_pool] : chidb_Pager_allocBuffer(pager, 1);
+
+	if (buf != NULL)
+		memset(buf, 0, pager->page_size);
+
+	return buf;
+}
+
+
+/* Return a page buffer to the pool (or free it if the pool is full)
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - buf: A buffer from chidb_Pager_getBuffer.
+ */
+static void chidb_Pager_putBuffer(Pager *pager, uint8_t *buf)
+{
+	if (pager->n_pool < BUFFER_POOL_SIZE)
+		pager->pool[pager->n_pool++] = buf;
+	else
+		free(buf);
 }
 
 
@@ -94,6 +284,10 @@ int chidb_Pager_setPageSize(Pager *pager, uint16_t pagesize)
  * the page size is unknown, since the chidb header always occupies
  * the first 100 bytes of the file.
  *
+ * Reading the header also tells the pager that page 1 of this file
+ * holds a chidb header, so the pager will keep the freelist fields
+ * of the header up to date from now on (see chidb_Pager_writePage).
+ *
  * Parameters
  * - pager: A Pager.
  * - header: Pointer to a byte array with enough space for 100 bytes.
@@ -105,144 +299,1997 @@ int chidb_Pager_setPageSize(Pager *pager, uint16_t pagesize)
 int chidb_Pager_readHeader(Pager *pager, uint8_t *header)
 {
 	int count;
-	count = fseek(pager->f, 0, SEEK_SET);
-	count = fread(header, 1, 100, pager->f);
+	uint32_t frame;
+	if (pager->wal != NULL && (frame = chidb_Wal_findFrame(pager->wal, 1)) != 0)
+	{
+		uint8_t *data = malloc(pager->page_size);
+		if (data == NULL)
+			return CHIDB_ENOMEM;
+		count = chidb_Wal_readFrame(pager->wal, frame, data) == CHIDB_OK ? 100 : 0;
+		memcpy(header, data, 100);
+		free(data);
+	}
+	else
+		count = chidb_Vfs_read(pager->f, header, 100, 0) == CHIDB_OK ? 100 : 0;
+	pager->has_header = true;
 	if (count != 100)
+	{
+		pager->free_head = 0;
+		pager->n_free = 0;
 		return CHIDB_NOHEADER;
+	}
 	else
+	{
+		pager->change_counter = get4byte(header + HEADER_CHANGE_COUNTER_OFFSET);
+		chidb_Pager_setChecksums(pager, header[HEADER_RESERVED_OFFSET] == PAGE_CHECKSUM_SIZE);
+		pager->free_head = get4byte(header + HEADER_FREELIST_HEAD_OFFSET);
+		pager->n_free = get4byte(header + HEADER_FREELIST_COUNT_OFFSET);
 		return CHIDB_OK;
+	}
 }
 
 
-/* Allocate an extra page on the file
+/* Write the freelist fields of the file header
+ *
+ * Only the freelist fields are written, so that this can be done
+ * without reading (and possibly clobbering) the rest of page 1.
+ * If the file has no chidb header (e.g., when the pager is used on
+ * its own), the freelist is only kept in memory.
  *
  * Parameters
  * - pager: A Pager.
- * - npage: An out parameter that will contain the page number of the
- *          new page.
  *
  * Return
  * - CHIDB_OK: Operation successful
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
  */
-int chidb_Pager_allocatePage(Pager *pager, npage_t *npage)
+static int chidb_Pager_writeFreelistHeader(Pager *pager)
 {
-	/* We simply increment the page number counter. readPage
-	 * and writePage take care of the rest. */
-	*npage = ++pager->n_pages;
+	uint8_t buf[8];
 
-	return CHIDB_OK;	
+	if (!pager->has_header)
+		return CHIDB_OK;
+
+	put4byte(buf, pager->free_head);
+	put4byte(buf + 4, pager->n_free);
+
+	return chidb_Pager_pageIO(pager, 1, HEADER_FREELIST_HEAD_OFFSET, buf, sizeof(buf), true);
 }
 
 
-/* Read a page from file
+/* Read or write part of a page in the database file
  *
- * This page reads a page from the file, and creates an in-memory copy
- * in a MemPage struct (see header file for more details on this struct).
- * Always use chidb_Pager_releaseMemPage to free the memory allocated for
- * a MemPage created by this function.
- * Any changes done to a MemPage will not be effective until you call
- * chidb_Pager_writePage with that MemPage.
+ * This bypasses any transaction (see chidb_Pager_pageIO).
  *
  * Parameters
  * - pager: A Pager.
- * - npage: Page number of page to read.
- * - page: Out parameter. Used to return a pointer to newly created MemPage
+ * - npage: Page number.
+ * - offset: Offset within the page.
+ * - buf: Buffer to read into / write from.
+ * - len: Number of bytes.
+ * - write: Whether to write (true) or read (false).
  *
  * Return
  * - CHIDB_OK: Operation successful
- * - CHIDB_ENOMEM: Could not allocate memory
  * - CHIDB_EIO: An I/O error has occurred when accessing the file
  */
-int	chidb_Pager_readPage(Pager *pager, npage_t npage, MemPage **page)
+static int chidb_Pager_fileIO(Pager *pager, npage_t npage, uint16_t offset, uint8_t *buf, size_t len, bool write)
 {
-	if (npage > pager->n_pages)
-		return CHIDB_EPAGENO;
-	int n;
-	
-	*page = malloc(sizeof(MemPage));
-	if (page == NULL)
-		return CHIDB_ENOMEM;
-	(*page)->npage = npage;
-	(*page)->data = calloc(pager->page_size, 1);
-	if ((*page)->data == NULL)
-		return CHIDB_ENOMEM;
-	fseek(pager->f, (npage - 1) * pager->page_size, SEEK_SET);
-	n = fread((*page)->data, 1, pager->page_size, pager->f);
-	VTRACEF("Read %i bytes from page %i into memory [%x data: %x]", n, npage, *page, (*page)->data);
-	
+	uint64_t pos = (uint64_t) (npage - 1) * pager->page_size + offset;
+	bool counter = (npage == 1 && offset == HEADER_CHANGE_COUNTER_OFFSET);
+	uint8_t *page = NULL;
+	int rc;
+
+	if (write)
+		for (int i = 0; i < READAHEAD_PAGES; i++)
+			if (pager->ra_pages[i] == npage)
+				pager->ra_pages[i] = 0;
+
+	/* The checksum covers the whole page, so the whole page is written */
+	if (write && pager->checksums)
+	{
+		page = chidb_Pager_getBuffer(pager);
+		if (page == NULL)
+			return CHIDB_ENOMEM;
+		pos -= offset;
+		if (len < pager->page_size)
+			chidb_Vfs_read(pager->f, page, pager->page_size, pos);
+		memcpy(page + offset, buf, len);
+		chidb_Pager_setChecksum(pager, page);
+		buf = page;
+		offset = 0;
+		len = pager->page_size;
+	}
+	rc = write ? chidb_Vfs_write(pager->f, buf, len, pos) : chidb_Vfs_read(pager->f, buf, len, pos);
+	if (rc == CHIDB_OK && write && pager->cache != NULL)
+		chidb_PageCache_update(pager->cache, npage, offset, buf, len);
+	if (page != NULL)
+		chidb_Pager_putBuffer(pager, page);
+	if (rc != CHIDB_OK)
+		return CHIDB_EIO;
+	if (!write)
+		return CHIDB_OK;
+
+	if (pager->has_header && pager->wal == NULL && !counter)
+		return chidb_Pager_bumpChangeCounter(pager);
+
 	return CHIDB_OK;
 }
 
 
-/* Write a page to file
+/* Store the checksum of a page in its last bytes
  *
- * This page writes the in-memory copy of a page (stored in a MemPage
- * struct) back to disk.
+ * Parameters
+ * - pager: A Pager with checksums.
+ * - data: Contents of the page.
+ */
+static void chidb_Pager_setChecksum(Pager *pager, uint8_t *data)
+{
+	put4byte(data + pager->usable_size, chidb_Checksum_crc32c(data, pager->usable_size));
+}
+
+
+/* Check the checksum of a page that was just read
+ *
+ * A page of zeros (e.g., a page past the end of the file, or one that
+ * was allocated but never written) has no checksum, and is accepted.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - npage: Page number.
+ * - data: Contents of the page.
+ *
+ * Return
+ * - CHIDB_OK: The page is intact (or there are no checksums)
+ * - CHIDB_ECHECKSUM: The contents of the page do not match its checksum
+ */
+static int chidb_Pager_verifyChecksum(Pager *pager, npage_t npage, uint8_t *data)
+{
+	if (!pager->checksums || get4byte(data + pager->usable_size) == chidb_Checksum_crc32c(data, pager->usable_size))
+		return CHIDB_OK;
+	for (uint16_t i = 0; i < pager->page_size; i++)
+		if (data[i] != 0)
+		{
+			VTRACEF("Checksum mismatch in page %i", npage);
+			return CHIDB_ECHECKSUM;
+		}
+
+	return CHIDB_OK;
+}
+
+
+/* Compute the checksums of the dirty pages, before they are written
+ * to the file or the WAL */
+static void chidb_Pager_checksumDirty(Pager *pager)
+{
+	if (!pager->checksums)
+		return;
+	for (npage_t i = 0; i < pager->n_dirty; i++)
+		chidb_Pager_setChecksum(pager, pager->dirty[pager->dirty_list[i]]);
+}
+
+
+/* Increment the change counter in the file header
+ *
+ * Inside a transaction, the new value is written to page 1 of the
+ * transaction. Outside of one, it is written to the file right away.
  *
  * Parameters
  * - pager: A Pager.
- * - page: In-memory copy of page to write
  *
  * Return
  * - CHIDB_OK: Operation successful
- * - CHIDB_EPAGENO: The page has an incorrect page number
+ * - CHIDB_ENOMEM: Could not allocate memory
  * - CHIDB_EIO: An I/O error has occurred when accessing the file
  */
-int	chidb_Pager_writePage(Pager *pager, MemPage *page)
+static int chidb_Pager_bumpChangeCounter(Pager *pager)
 {
-	if (page->npage > pager->n_pages)
-		return CHIDB_EPAGENO;
-	int n;
-	fseek(pager->f, (page->npage - 1) * pager->page_size, SEEK_SET);
-	n = fwrite(page->data, 1, pager->page_size, pager->f);
-	VTRACEF("Wrote %i bytes to page %i", n, page->npage);
-	return CHIDB_OK;
+	uint8_t buf[4];
+	uint32_t counter = 0;
+	int rc;
+
+	/* A header that is still being written counts as 0 */
+	if (chidb_Pager_pageIO(pager, 1, HEADER_CHANGE_COUNTER_OFFSET, buf, sizeof(buf), false) == CHIDB_OK)
+		counter = get4byte(buf);
+	if (counter < pager->change_counter)
+		counter = pager->change_counter;
+	put4byte(buf, counter + 1);
+	rc = chidb_Pager_pageIO(pager, 1, HEADER_CHANGE_COUNTER_OFFSET, buf, sizeof(buf), true);
+	if (rc == CHIDB_OK)
+		pager->change_counter = counter + 1;
+
+	return rc;
 }
 
 
-/* Release an in-memory copy of a page
+/* Read the committed version of a page
+ *
+ * In WAL mode, this is the newest frame for the page in the WAL, if
+ * there is one. Otherwise, it is the page in the database file.
  *
  * Parameters
  * - pager: A Pager.
- * - page: In-memory copy of page to write
+ * - npage: Page number.
+ * - data: Buffer with room for a page. Whatever is past the end of
+ *         the file reads as zeros.
  *
  * Return
  * - CHIDB_OK: Operation successful
- * - CHIDB_EPAGENO: The page has an incorrect page number
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
  */
-int	chidb_Pager_releaseMemPage(Pager *pager, MemPage *page)
+static int chidb_Pager_readCommitted(Pager *pager, npage_t npage, uint8_t *data)
 {
-	if (page->npage > pager->n_pages)
-		return CHIDB_EPAGENO;
+	uint32_t frame;
+
+	if (pager->wal != NULL && (frame = chidb_Wal_findFrame(pager->wal, npage)) != 0)
+		return chidb_Wal_readFrame(pager->wal, frame, data);
+
+	if (chidb_Vfs_read(pager->f, data, pager->page_size, (uint64_t) (npage - 1) * pager->page_size) == CHIDB_EIO)
+		return CHIDB_EIO;
 
-	VTRACEF("Releasing page %i from memory [%x data: %x]", page->npage, page, page->data);
-	free(page->data);
-	free(page);
-	
 	return CHIDB_OK;
 }
 
 
-/* Computes the number of pages in a file.
+/* Checksum of a journal record
  *
  * Parameters
- * - pager: A Pager.
- * - npages: Out parameter. Number of pages.
+ * - nonce: Nonce of the journal.
+ * - npage: Page number.
+ * - data: Original contents of the page.
+ * - page_size: Size of a page.
+ *
+ * Return
+ * - The checksum
+ */
+static uint32_t chidb_Pager_journalChecksum(uint32_t nonce, npage_t npage, uint8_t *data, uint16_t page_size)
+{
+	uint32_t cksum = nonce ^ npage;
+
+	for (int i = 0; i < page_size; i++)
+		cksum = cksum * 31 + data[i];
+
+	return cksum;
+}
+
+
+/* Create the rollback journal and write its header
+ *
+ * Parameters
+ * - pager: A Pager in a transaction.
  *
  * Return
  * - CHIDB_OK: Operation successful
+ * - CHIDB_EIO: An I/O error has occurred when accessing the journal
  */
-int chidb_Pager_getRealDBSize(Pager *pager, npage_t *npages)
+static int chidb_Pager_openJournal(Pager *pager)
 {
-	struct stat buf;
-	fstat(fileno(pager->f), &buf);
-	*npages = buf.st_size / pager->page_size;
-	
+	uint8_t header[JOURNAL_HEADER_SIZE];
+	int rc;
+
+	rc = chidb_Vfs_open(pager->vfs, pager->journal_name, VFS_OPEN_CREATE, &pager->journal);
+	if (rc != CHIDB_OK)
+	{
+		pager->journal = NULL;
+		return rc == CHIDB_ENOMEM ? rc : CHIDB_EIO;
+	}
+
+	/* A new nonce makes records left over from an older journal invalid */
+	pager->journal_nonce = (uint32_t) time(NULL) ^ ((uint32_t) getpid() << 16) ^ (uint32_t) rand();
+	memcpy(header, JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE);
+	put4byte(header + JOURNAL_NONCE_OFFSET, pager->journal_nonce);
+	put4byte(header + JOURNAL_DBSIZE_OFFSET, pager->txn_n_pages);
+	put4byte(header + JOURNAL_PAGESIZE_OFFSET, pager->page_size);
+	if (chidb_Vfs_truncate(pager->journal, 0) != CHIDB_OK ||
+	    chidb_Vfs_write(pager->journal, header, sizeof(header), 0) != CHIDB_OK)
+		return CHIDB_EIO;
+	pager->journal_size = sizeof(header);
+
 	return CHIDB_OK;
 }
 
 
-/* Closes a pager and frees up all resources used by the pager.
+static int chidb_Pager_comparePages(const void *a, const void *b)
+{
+	npage_t x = *(const npage_t *) a, y = *(const npage_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+
+/* Write the dirty pages to the database file
+ *
+ * The pages are sorted by page number, and each run of consecutive
+ * pages is copied into a staging buffer and written with a single
+ * request. Up to WRITEBACK_BATCH pages are handed to the VFS at once,
+ * so that it can have the device write them in parallel (see
+ * chidb_Vfs_writeBatch). The dirty pages are left in memory.
+ *
+ * Parameters
+ * - pager: A Pager in a transaction.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+static int chidb_Pager_writeDirty(Pager *pager)
+{
+	VfsIo ios[WRITEBACK_BATCH];
+	uint8_t *staging;
+	int rc = CHIDB_OK;
+
+	if (pager->n_dirty == 0)
+		return CHIDB_OK;
+	chidb_Pager_checksumDirty(pager);
+	qsort(pager->dirty_list, pager->n_dirty, sizeof(npage_t), chidb_Pager_comparePages);
+	staging = chidb_Pager_allocBuffer(pager, WRITEBACK_BATCH);
+	if (staging == NULL)
+		return CHIDB_ENOMEM;
+
+	pager->file_written = true;
+	for (npage_t i = 0; rc == CHIDB_OK && i < pager->n_dirty; )
+	{
+		npage_t end = (pager->n_dirty - i > WRITEBACK_BATCH) ? i + WRITEBACK_BATCH : pager->n_dirty;
+		uint8_t *next = staging;
+		int n = 0;
+
+		while (i < end)
+		{
+			npage_t first = pager->dirty_list[i];
+			npage_t j = i + 1;
+			while (j < end && pager->dirty_list[j] == pager->dirty_list[j - 1] + 1)
+				j++;
+			if (j - i == 1)
+				ios[n].buf = pager->dirty[first];
+			else
+			{
+				ios[n].buf = next;
+				for (npage_t k = i; k < j; k++, next += pager->page_size)
+					memcpy(next, pager->dirty[pager->dirty_list[k]], pager->page_size);
+			}
+			ios[n].len = (size_t) (j - i) * pager->page_size;
+			ios[n].offset = (uint64_t) (first - 1) * pager->page_size;
+			n++;
+			i = j;
+		}
+		rc = chidb_Vfs_writeBatch(pager->f, ios, n);
+	}
+	free(staging);
+
+	return rc;
+}
+
+
+/* Write the dirty pages out before the transaction commits
+ *
+ * Called when a transaction in rollback journal mode has spill_size
+ * dirty pages, so that its memory use stays bounded. The journal is
+ * flushed first, since the original pages are about to be overwritten,
+ * and the dirty pages are then written to the file and freed. A page
+ * that is written to again is read back from the file, and is not
+ * journaled a second time. If the transaction is rolled back, the
+ * original pages are copied back from the journal.
+ *
+ * Parameters
+ * - pager: A Pager in a transaction.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+static int chidb_Pager_spill(Pager *pager)
+{
+	int rc = CHIDB_OK;
+
+	if (pager->journal == NULL)
+		rc = chidb_Pager_openJournal(pager);
+	if (rc == CHIDB_OK && pager->sync_mode != CHIDB_SYNC_OFF && chidb_Vfs_sync(pager->journal) != CHIDB_OK)
+		rc = CHIDB_EIO;
+	if (rc == CHIDB_OK)
+		rc = chidb_Pager_writeDirty(pager);
+	if (rc != CHIDB_OK)
+		return rc;
+
+	for (npage_t i = 0; i < pager->n_dirty; i++)
+	{
+		npage_t npage = pager->dirty_list[i];
+		chidb_Pager_putBuffer(pager, pager->dirty[npage]);
+		pager->dirty[npage] = NULL;
+		pager->spilled[npage] = 1;
+		if (pager->cache != NULL)
+			chidb_PageCache_remove(pager->cache, npage);
+	}
+	pager->n_spilled += pager->n_dirty;
+	pager->n_dirty = 0;
+	chidb_Pager_dropReadAhead(pager);
+	VTRACEF("Spilled %i pages", pager->n_spilled);
+
+	return CHIDB_OK;
+}
+
+
+/* Get the in-memory copy of a page written during a transaction
+ *
+ * The first time a page is written in a transaction, its original
+ * contents are read and appended to the rollback journal (unless the
+ * page is past the end of the file as it was when the transaction
+ * began, the pager is in WAL mode, or the page was already spilled),
+ * and become the in-memory copy of the page that readPage and writePage
+ * work on until the transaction ends. Adding a page when there are
+ * already spill_size of them spills them first (see chidb_Pager_spill).
+ *
+ * Parameters
+ * - pager: A Pager in a transaction.
+ * - npage: Page number.
+ * - data: Out parameter. In-memory copy of the page.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+static int chidb_Pager_dirtyPage(Pager *pager, npage_t npage, uint8_t **data)
+{
+	uint8_t *record;
+	uint8_t *copy;
+
+	if (npage >= pager->dirty_size)
+	{
+		npage_t size = pager->dirty_size ? pager->dirty_size : 64;
+		while (size <= npage)
+			size *= 2;
+		uint8_t **dirty = realloc(pager->dirty, size * sizeof(uint8_t *));
+		if (dirty == NULL)
+			return CHIDB_ENOMEM;
+		memset(dirty + pager->dirty_size, 0, (size - pager->dirty_size) * sizeof(uint8_t *));
+		pager->dirty = dirty;
+		uint8_t *spilled = realloc(pager->spilled, size);
+		if (spilled == NULL)
+			return CHIDB_ENOMEM;
+		memset(spilled + pager->dirty_size, 0, size - pager->dirty_size);
+		pager->spilled = spilled;
+		pager->dirty_size = size;
+	}
+
+	if (pager->dirty[npage] != NULL)
+	{
+		*data = pager->dirty[npage];
+		return CHIDB_OK;
+	}
+
+	if (pager->wal == NULL && pager->spill_size != 0 && pager->n_dirty >= pager->spill_size)
+	{
+		int rc = chidb_Pager_spill(pager);
+		if (rc != CHIDB_OK)
+			return rc;
+	}
+
+	if (pager->n_dirty == pager->max_dirty)
+	{
+		npage_t max = pager->max_dirty ? pager->max_dirty * 2 : 64;
+		npage_t *list = realloc(pager->dirty_list, max * sizeof(npage_t));
+		if (list == NULL)
+			return CHIDB_ENOMEM;
+		pager->dirty_list = list;
+		pager->max_dirty = max;
+	}
+
+	copy = chidb_Pager_getBuffer(pager);
+	if (copy == NULL)
+		return CHIDB_ENOMEM;
+
+	if (npage <= pager->txn_n_pages || pager->spilled[npage])
+	{
+		/* Pages that were allocated but never written read as zeros */
+		int rc = chidb_Pager_readCommitted(pager, npage, copy);
+
+		/* With a WAL, the original stays where it is until a checkpoint.
+		 * A page that was spilled was journaled before that. */
+		bool journal = pager->wal == NULL && !pager->spilled[npage];
+		if (rc == CHIDB_OK && journal && pager->journal == NULL)
+			rc = chidb_Pager_openJournal(pager);
+		if (rc == CHIDB_OK && journal)
+		{
+			/* The whole record is appended with a single write */
+			record = malloc(JOURNAL_RECORD_SIZE(pager->page_size));
+			if (record == NULL)
+				rc = CHIDB_ENOMEM;
+		}
+		if (rc == CHIDB_OK && journal)
+		{
+			put4byte(record, npage);
+			memcpy(record + 4, copy, pager->page_size);
+			put4byte(record + 4 + pager->page_size, chidb_Pager_journalChecksum(pager->journal_nonce, npage, copy, pager->page_size));
+			rc = chidb_Vfs_write(pager->journal, record, JOURNAL_RECORD_SIZE(pager->page_size), pager->journal_size);
+			free(record);
+			if (rc == CHIDB_OK)
+				pager->journal_size += JOURNAL_RECORD_SIZE(pager->page_size);
+		}
+		if (rc != CHIDB_OK)
+		{
+			chidb_Pager_putBuffer(pager, copy);
+			return rc;
+		}
+	}
+
+	pager->dirty[npage] = copy;
+	pager->dirty_list[pager->n_dirty++] = npage;
+	*data = copy;
+
+	return CHIDB_OK;
+}
+
+
+/* Read or write part of a page
+ *
+ * The freelist only ever touches a few bytes of a trunk page, so there
+ * is no need to go through a full MemPage. Inside a transaction, the
+ * in-memory copy of the page is used instead of the file.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - npage: Page number.
+ * - offset: Offset within the page.
+ * - buf: Buffer to read into / write from.
+ * - len: Number of bytes.
+ * - write: Whether to write (true) or read (false).
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+static int chidb_Pager_pageIO(Pager *pager, npage_t npage, uint16_t offset, uint8_t *buf, size_t len, bool write)
+{
+	uint8_t *data;
+	int rc;
+
+	if (pager->in_txn && (write || (npage < pager->dirty_size && pager->dirty[npage] != NULL)))
+	{
+		rc = chidb_Pager_dirtyPage(pager, npage, &data);
+		if (rc != CHIDB_OK)
+			return rc;
+		if (write)
+			memcpy(data + offset, buf, len);
+		else
+			memcpy(buf, data + offset, len);
+		return CHIDB_OK;
+	}
+
+	if (!write && pager->wal != NULL && chidb_Wal_findFrame(pager->wal, npage) != 0)
+	{
+		data = malloc(pager->page_size);
+		if (data == NULL)
+			return CHIDB_ENOMEM;
+		rc = chidb_Pager_readCommitted(pager, npage, data);
+		memcpy(buf, data + offset, len);
+		free(data);
+		return rc;
+	}
+
+	return chidb_Pager_fileIO(pager, npage, offset, buf, len, write);
+}
+
+
+/* End a transaction started by a function of the pager itself
+ *
+ * In WAL mode, pages only reach the database file through checkpoints,
+ * so changes made outside a transaction are made in one of their own.
+ *
+ * Parameters
+ * - pager: A Pager in a transaction.
+ * - rc: Result of the change
+ *
+ * Return
+ * - rc, or the error returned by chidb_Pager_commit
+ */
+static int chidb_Pager_endAutocommit(Pager *pager, int rc)
+{
+	if (rc != CHIDB_OK)
+	{
+		chidb_Pager_rollback(pager);
+		return rc;
+	}
+
+	return chidb_Pager_commit(pager);
+}
+
+
+/* Allocate an extra page on the file
+ *
+ * If the freelist is not empty, a free page is reused: the last leaf
+ * of the first trunk page or, if that trunk has no leaves left, the
+ * trunk page itself. Otherwise, the file grows by one page.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - npage: An out parameter that will contain the page number of the
+ *          new page.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Pager_allocatePage(Pager *pager, npage_t *npage)
+{
+	if (pager->wal != NULL && !pager->in_txn)
+	{
+		int rc = chidb_Pager_begin(pager);
+		if (rc != CHIDB_OK)
+			return rc;
+		return chidb_Pager_endAutocommit(pager, chidb_Pager_allocatePage(pager, npage));
+	}
+
+	if (pager->free_head != 0)
+	{
+		uint8_t trunk[FREELIST_TRUNK_HEADER];
+		int rc;
+
+		rc = chidb_Pager_pageIO(pager, pager->free_head, 0, trunk, sizeof(trunk), false);
+		if (rc != CHIDB_OK)
+			return rc;
+
+		uint32_t nleaves = get4byte(trunk + FREELIST_TRUNK_NLEAVES_OFFSET);
+		if (nleaves > 0)
+		{
+			/* Take the last leaf of the trunk */
+			uint8_t leaf[4];
+			rc = chidb_Pager_pageIO(pager, pager->free_head, FREELIST_TRUNK_HEADER + 4 * (nleaves - 1), leaf, sizeof(leaf), false);
+			if (rc != CHIDB_OK)
+				return rc;
+			put4byte(trunk + FREELIST_TRUNK_NLEAVES_OFFSET, nleaves - 1);
+			rc = chidb_Pager_pageIO(pager, pager->free_head, FREELIST_TRUNK_NLEAVES_OFFSET,
+			                        trunk + FREELIST_TRUNK_NLEAVES_OFFSET, 4, true);
+			if (rc != CHIDB_OK)
+				return rc;
+			*npage = get4byte(leaf);
+		}
+		else
+		{
+			/* The trunk is empty, so it is the page we reuse */
+			*npage = pager->free_head;
+			pager->free_head = get4byte(trunk + FREELIST_TRUNK_NEXT_OFFSET);
+		}
+		pager->n_free--;
+		VTRACEF("Reusing free page %i (%i free pages left)", *npage, pager->n_free);
+
+		return chidb_Pager_writeFreelistHeader(pager);
+	}
+
+	/* We simply increment the page number counter. readPage
+	 * and writePage take care of the rest. */
+	*npage = ++pager->n_pages;
+
+	return CHIDB_OK;	
+}
+
+
+/* Return a page to the freelist
+ *
+ * The freelist is stored as in SQLite: the header points to the first
+ * trunk page, and each trunk page contains the page number of the next
+ * trunk, followed by the number of leaf pages it holds and their page
+ * numbers. A freed page is added as a leaf of the first trunk, which
+ * only requires writing a few bytes of that trunk (the contents of a
+ * leaf page are never read or written). If the first trunk is full,
+ * or there is no trunk yet, the freed page becomes the new first trunk.
+ * The contents of the page are lost. Page 1 can never be freed.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - npage: Page number of the page to free.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EPAGENO: The page has an incorrect page number
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Pager_freePage(Pager *pager, npage_t npage)
+{
+	uint8_t trunk[FREELIST_TRUNK_HEADER];
+	int rc;
+
+	if (npage <= 1 || npage > pager->n_pages)
+		return CHIDB_EPAGENO;
+
+	if (pager->wal != NULL && !pager->in_txn)
+	{
+		rc = chidb_Pager_begin(pager);
+		if (rc != CHIDB_OK)
+			return rc;
+		return chidb_Pager_endAutocommit(pager, chidb_Pager_freePage(pager, npage));
+	}
+
+	if (pager->free_head != 0)
+	{
+		rc = chidb_Pager_pageIO(pager, pager->free_head, 0, trunk, sizeof(trunk), false);
+		if (rc != CHIDB_OK)
+			return rc;
+
+		uint32_t nleaves = get4byte(trunk + FREELIST_TRUNK_NLEAVES_OFFSET);
+		if (nleaves < FREELIST_TRUNK_MAXLEAVES(pager->usable_size))
+		{
+			/* Add the page as a leaf of the first trunk */
+			uint8_t leaf[4];
+			put4byte(leaf, npage);
+			rc = chidb_Pager_pageIO(pager, pager->free_head, FREELIST_TRUNK_HEADER + 4 * nleaves, leaf, sizeof(leaf), true);
+			if (rc != CHIDB_OK)
+				return rc;
+			put4byte(trunk + FREELIST_TRUNK_NLEAVES_OFFSET, nleaves + 1);
+			rc = chidb_Pager_pageIO(pager, pager->free_head, FREELIST_TRUNK_NLEAVES_OFFSET,
+			                        trunk + FREELIST_TRUNK_NLEAVES_OFFSET, 4, true);
+			if (rc != CHIDB_OK)
+				return rc;
+
+			pager->n_free++;
+			VTRACEF("Freed page %i as a leaf of trunk %i (%i free pages)", npage, pager->free_head, pager->n_free);
+			return chidb_Pager_writeFreelistHeader(pager);
+		}
+	}
+
+	/* The page becomes the new first trunk */
+	put4byte(trunk + FREELIST_TRUNK_NEXT_OFFSET, pager->free_head);
+	put4byte(trunk + FREELIST_TRUNK_NLEAVES_OFFSET, 0);
+	rc = chidb_Pager_pageIO(pager, npage, 0, trunk, sizeof(trunk), true);
+	if (rc != CHIDB_OK)
+		return rc;
+
+	pager->free_head = npage;
+	pager->n_free++;
+	VTRACEF("Freed page %i as a new trunk (%i free pages)", npage, pager->n_free);
+
+	return chidb_Pager_writeFreelistHeader(pager);
+}
+
+
+/* Throw away the pages read ahead of time
+ *
+ * Must be called whenever the pages in the file or the WAL may have
+ * changed under the read-ahead buffer.
+ *
+ * Parameters
+ * - pager: A Pager.
+ */
+static void chidb_Pager_dropReadAhead(Pager *pager)
+{
+	memset(pager->ra_pages, 0, sizeof(pager->ra_pages));
+	pager->ra_next = 0;
+	pager->ra_end = 0;
+}
+
+
+/* Prefetch pages
+ *
+ * Tells the pager that the given pages will be read soon. If the VFS
+ * can read a batch of pages at once (see chidb_Vfs_readBatch), they
+ * are read into the read-ahead buffer, from which chidb_Pager_readPage
+ * takes them. Otherwise, the VFS is only given a hint (see
+ * chidb_Vfs_prefetch), so that the operating system can start reading
+ * them in the background.
+ *
+ * Pages written in the current transaction, pages with a frame in the
+ * WAL, and pages past the end of the file are skipped, as are pages
+ * past the first READAHEAD_PAGES. When the buffer is full, the oldest
+ * slots are reused.
+ *
+ * A failed prefetch does not affect later reads, so callers are free
+ * to ignore errors.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - pages: Page numbers, preferably in increasing order.
+ * - n: Number of pages.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Pager_prefetch(Pager *pager, npage_t *pages, int n)
+{
+	VfsIo ios[READAHEAD_PAGES];
+	int slots[READAHEAD_PAGES];
+	npage_t want[READAHEAD_PAGES];
+	int m = 0;
+	int rc;
+
+	for (int i = 0; i < n && m < READAHEAD_PAGES; i++)
+	{
+		npage_t npage = pages[i];
+		bool buffered = false;
+		if (npage == 0 || npage > pager->n_pages ||
+		    (npage < pager->dirty_size && pager->dirty[npage] != NULL) ||
+		    (pager->cache != NULL && chidb_PageCache_contains(pager->cache, npage)) ||
+		    (pager->wal != NULL && chidb_Wal_findFrame(pager->wal, npage) != 0))
+			continue;
+		for (int j = 0; j < READAHEAD_PAGES; j++)
+			buffered = buffered || pager->ra_pages[j] == npage;
+		if (!buffered)
+			want[m++] = npage;
+	}
+	if (m == 0)
+		return CHIDB_OK;
+
+	/* Contiguous pages are hinted as a single range */
+	if (pager->f->methods->readBatch == NULL)
+	{
+		rc = CHIDB_OK;
+		for (int i = 0, j; rc == CHIDB_OK && i < m; i = j)
+		{
+			for (j = i + 1; j < m && want[j] == want[j - 1] + 1; j++)
+				;
+			rc = chidb_Vfs_prefetch(pager->f, (uint64_t) (want[i] - 1) * pager->page_size,
+			                        (uint64_t) (j - i) * pager->page_size);
+		}
+		return rc;
+	}
+
+	if (pager->ra_data == NULL)
+	{
+		pager->ra_data = chidb_Pager_allocBuffer(pager, READAHEAD_PAGES);
+		if (pager->ra_data == NULL)
+			return CHIDB_ENOMEM;
+	}
+
+	/* Empty slots first, then the oldest ones */
+	for (int i = 0, slot = 0; i < m; i++)
+	{
+		while (slot < READAHEAD_PAGES && pager->ra_pages[slot] != 0)
+			slot++;
+		if (slot < READAHEAD_PAGES)
+			slots[i] = slot++;
+		else
+		{
+			slots[i] = pager->ra_next;
+			pager->ra_next = (pager->ra_next + 1) % READAHEAD_PAGES;
+		}
+		pager->ra_pages[slots[i]] = 0;
+		ios[i].buf = pager->ra_data + (size_t) slots[i] * pager->page_size;
+		ios[i].len = pager->page_size;
+		ios[i].offset = (uint64_t) (want[i] - 1) * pager->page_size;
+	}
+	rc = chidb_Vfs_readBatch(pager->f, ios, m);
+	if (rc == CHIDB_ESHORTREAD)
+		rc = CHIDB_OK;
+	if (rc != CHIDB_OK)
+		return rc;
+	for (int i = 0; i < m; i++)
+		pager->ra_pages[slots[i]] = want[i];
+	VTRACEF("Read %i pages ahead of time", m);
+
+	return CHIDB_OK;
+}
+
+
+/* Prefetch the pages after a sequential read
+ *
+ * Once READAHEAD_TRIGGER consecutive pages have been read, the next
+ * READAHEAD_PAGES pages are prefetched, and the read-ahead is extended
+ * whenever the reads get within half that distance of its end.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - npage: Page that was just read.
+ *
+ * Return
+ * - CHIDB_OK: Always (read-ahead errors are ignored)
+ */
+static int chidb_Pager_readAhead(Pager *pager, npage_t npage)
+{
+	npage_t pages[READAHEAD_PAGES];
+	npage_t first, last;
+	int n = 0;
+
+	if (pager->seq_run < READAHEAD_TRIGGER || npage + READAHEAD_PAGES / 2 <= pager->ra_end)
+		return CHIDB_OK;
+
+	first = (pager->ra_end > npage) ? pager->ra_end + 1 : npage + 1;
+	last = npage + READAHEAD_PAGES;
+	if (last > pager->n_pages)
+		last = pager->n_pages;
+	for (npage_t p = first; p <= last; p++)
+		pages[n++] = p;
+	pager->ra_end = last;
+	if (n > 0)
+		chidb_Pager_prefetch(pager, pages, n);
+
+	return CHIDB_OK;
+}
+
+
+/* Read a page from file
+ *
+ * This page reads a page from the file, and creates an in-memory copy
+ * in a MemPage struct (see header file for more details on this struct).
+ * Always use chidb_Pager_releaseMemPage to free the memory allocated for
+ * a MemPage created by this function.
+ * Any changes done to a MemPage will not be effective until you call
+ * chidb_Pager_writePage with that MemPage.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - npage: Page number of page to read.
+ * - page: Out parameter. Used to return a pointer to newly created MemPage
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ * - CHIDB_ECHECKSUM: The page does not match its checksum
+ */
+int	chidb_Pager_readPage(Pager *pager, npage_t npage, MemPage **page)
+{
+	if (npage > pager->n_pages)
+		return CHIDB_EPAGENO;
+	int n;
+	
+	*page = malloc(sizeof(MemPage));
+	if (page == NULL)
+		return CHIDB_ENOMEM;
+	(*page)->npage = npage;
+	(*page)->data = chidb_Pager_getBuffer(pager);
+	if ((*page)->data == NULL)
+		return CHIDB_ENOMEM;
+	if (npage < pager->dirty_size && pager->dirty[npage] != NULL)
+	{
+		memcpy((*page)->data, pager->dirty[npage], pager->page_size);
+		VTRACEF("Read page %i from the current transaction [%x data: %x]", npage, *page, (*page)->data);
+		return CHIDB_OK;
+	}
+	if (npage == pager->last_read + 1)
+		pager->seq_run++;
+	else
+		pager->seq_run = 0;
+	pager->last_read = npage;
+	if (pager->cache != NULL && chidb_PageCache_get(pager->cache, npage, (*page)->data) == CHIDB_OK)
+	{
+		VTRACEF("Read page %i from the page cache [%x data: %x]", npage, *page, (*page)->data);
+		return CHIDB_OK;
+	}
+	n = CHIDB_ENOTFOUND;
+	for (int i = 0; i < READAHEAD_PAGES && n != CHIDB_OK; i++)
+		if (pager->ra_pages[i] == npage)
+		{
+			memcpy((*page)->data, pager->ra_data + (size_t) i * pager->page_size, pager->page_size);
+			pager->ra_pages[i] = 0;
+			pager->ra_hits++;
+			n = CHIDB_OK;
+			VTRACEF("Read page %i from the read-ahead buffer [%x data: %x]", npage, *page, (*page)->data);
+		}
+	if (n != CHIDB_OK)
+	{
+		n = chidb_Pager_readCommitted(pager, npage, (*page)->data);
+		VTRACEF("Read page %i into memory [%x data: %x] (%i)", npage, *page, (*page)->data, n);
+	}
+	if (n == CHIDB_OK && chidb_Pager_verifyChecksum(pager, npage, (*page)->data) != CHIDB_OK)
+	{
+		chidb_Pager_releaseMemPage(pager, *page);
+		*page = NULL;
+		return CHIDB_ECHECKSUM;
+	}
+
+	/* A spilled page in the file is not committed yet */
+	if (n == CHIDB_OK && pager->cache != NULL && !(npage < pager->dirty_size && pager->spilled[npage]))
+		chidb_PageCache_put(pager->cache, npage, (*page)->data);
+	
+	return chidb_Pager_readAhead(pager, npage);
+}
+
+
+/* Write a page to file
+ *
+ * This page writes the in-memory copy of a page (stored in a MemPage
+ * struct) back to disk.
+ *
+ * Inside a transaction, the page is only written to the file when
+ * the transaction commits (see chidb_Pager_begin).
+ *
+ * When writing page 1 of a chidb file, the freelist fields of the
+ * header are refreshed first. Callers may be holding a copy of page 1
+ * that was read before the freelist last changed, and writing that
+ * copy back as-is would lose the freed pages.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - page: In-memory copy of page to write
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EPAGENO: The page has an incorrect page number
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int	chidb_Pager_writePage(Pager *pager, MemPage *page)
+{
+	if (page->npage > pager->n_pages)
+		return CHIDB_EPAGENO;
+	if (pager->wal != NULL && !pager->in_txn)
+	{
+		int rc = chidb_Pager_begin(pager);
+		if (rc != CHIDB_OK)
+			return rc;
+		return chidb_Pager_endAutocommit(pager, chidb_Pager_writePage(pager, page));
+	}
+	if (page->npage == 1 && pager->has_header)
+	{
+		put4byte(page->data + HEADER_FREELIST_HEAD_OFFSET, pager->free_head);
+		put4byte(page->data + HEADER_FREELIST_COUNT_OFFSET, pager->n_free);
+	}
+	if (pager->in_txn)
+	{
+		uint8_t *data;
+		int rc = chidb_Pager_dirtyPage(pager, page->npage, &data);
+		if (rc != CHIDB_OK)
+			return rc;
+		memcpy(data, page->data, pager->page_size);
+		VTRACEF("Wrote page %i in the current transaction", page->npage);
+		return CHIDB_OK;
+	}
+	int rc = chidb_Pager_fileIO(pager, page->npage, 0, page->data, pager->page_size, true);
+	VTRACEF("Wrote page %i", page->npage);
+	return rc;
+}
+
+
+/* Release an in-memory copy of a page
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - page: In-memory copy of page to write
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EPAGENO: The page has an incorrect page number
+ */
+int	chidb_Pager_releaseMemPage(Pager *pager, MemPage *page)
+{
+	if (page->npage > pager->n_pages)
+		return CHIDB_EPAGENO;
+
+	VTRACEF("Releasing page %i from memory [%x data: %x]", page->npage, page, page->data);
+	chidb_Pager_putBuffer(pager, page->data);
+	free(page);
+	
+	return CHIDB_OK;
+}
+
+
+/* Computes the number of pages in a file.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - npages: Out parameter. Number of pages.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Pager_getRealDBSize(Pager *pager, npage_t *npages)
+{
+	uint64_t size;
+	if (chidb_Vfs_size(pager->f, &size) != CHIDB_OK)
+		return CHIDB_EIO;
+	*npages = size / pager->page_size;
+	
+	return CHIDB_OK;
+}
+
+
+/* Flush all writes to stable storage
+ *
+ * With the synchronous setting off, the writes are only handed over
+ * to the operating system.
+ *
+ * Parameters
+ * - pager: A Pager.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Pager_sync(Pager *pager)
+{
+	if (pager->sync_mode != CHIDB_SYNC_OFF && chidb_Vfs_sync(pager->f) != CHIDB_OK)
+		return CHIDB_EIO;
+
+	return CHIDB_OK;
+}
+
+
+/* Begin a transaction
+ *
+ * Until the transaction ends, pages written with chidb_Pager_writePage
+ * (and the changes made to the freelist) are kept in memory, and the
+ * original contents of every page that is overwritten are saved in a
+ * rollback journal (the database file name followed by "-journal").
+ * chidb_Pager_commit then writes all of them with a single flush of the
+ * journal and a single flush of the database file, so that either all
+ * or none of the changes made in the transaction survive a crash: if
+ * the journal is still there when the file is opened again, the
+ * original pages are copied back (see chidb_Pager_recover).
+ *
+ * Only one connection can write at a time, so the transaction first
+ * waits for an exclusive lock on the database file, which it holds
+ * until its journal is deleted. Holding the lock is also what tells
+ * other connections that the journal is not hot yet.
+ *
+ * In WAL mode there is no rollback journal: the pages are appended to
+ * the WAL when the transaction commits. The lock is held until they
+ * are in the WAL, and the transaction starts from the newest snapshot
+ * in the WAL (see chidb_Pager_refresh).
+ *
+ * Parameters
+ * - pager: A Pager.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: A transaction is already active
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Pager_begin(Pager *pager)
+{
+	if (pager->in_txn)
+		return CHIDB_EMISUSE;
+
+	/* A writer has to start from the newest snapshot, and from a file
+	 * without half-written transactions */
+	if (chidb_Vfs_lock(pager->f, VFS_LOCK_EXCLUSIVE, true) != CHIDB_OK)
+		return CHIDB_EIO;
+	int rc = (pager->wal == NULL) ? chidb_Pager_recover(pager) : CHIDB_OK;
+	if (rc == CHIDB_OK)
+		rc = chidb_Pager_refresh(pager);
+	if (rc != CHIDB_OK)
+	{
+		chidb_Vfs_lock(pager->f, VFS_LOCK_NONE, true);
+		return rc;
+	}
+
+	pager->in_txn = true;
+	pager->txn_n_pages = pager->n_pages;
+	pager->txn_free_head = pager->free_head;
+	pager->txn_n_free = pager->n_free;
+
+	return CHIDB_OK;
+}
+
+
+/* Finish a transaction, discarding the in-memory pages and the journal
+ *
+ * Parameters
+ * - pager: A Pager in a transaction.
+ */
+static void chidb_Pager_endTxn(Pager *pager)
+{
+	for (npage_t i = 0; i < pager->n_dirty; i++)
+	{
+		chidb_Pager_putBuffer(pager, pager->dirty[pager->dirty_list[i]]);
+		pager->dirty[pager->dirty_list[i]] = NULL;
+	}
+	pager->n_dirty = 0;
+	if (pager->n_spilled > 0)
+		memset(pager->spilled, 0, pager->dirty_size);
+	pager->n_spilled = 0;
+	pager->file_written = false;
+
+	if (pager->journal != NULL)
+	{
+		chidb_Vfs_close(pager->journal);
+		pager->journal = NULL;
+		chidb_Vfs_remove(pager->vfs, pager->journal_name);
+	}
+	chidb_Vfs_lock(pager->f, VFS_LOCK_NONE, true);
+	pager->in_txn = false;
+}
+
+
+/* Copy the original pages in a journal back into the database file
+ *
+ * Records are copied in order until the end of the journal or the
+ * first record with a bad checksum (which was still being written when
+ * the transaction stopped), and the file is truncated to its size when
+ * the transaction began.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - journal: The journal file.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+static int chidb_Pager_playback(Pager *pager, VfsFile *journal)
+{
+	uint8_t header[JOURNAL_HEADER_SIZE];
+	uint8_t *record;
+	uint64_t offset = JOURNAL_HEADER_SIZE;
+	int rc = CHIDB_OK;
+
+	/* Without a complete header, the file was never written to */
+	if (chidb_Vfs_read(journal, header, sizeof(header), 0) != CHIDB_OK ||
+	    memcmp(header, JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE) != 0)
+		return CHIDB_OK;
+
+	uint32_t nonce = get4byte(header + JOURNAL_NONCE_OFFSET);
+	npage_t n_pages = get4byte(header + JOURNAL_DBSIZE_OFFSET);
+	uint16_t page_size = get4byte(header + JOURNAL_PAGESIZE_OFFSET);
+
+	record = malloc(JOURNAL_RECORD_SIZE(page_size));
+	if (record == NULL)
+		return CHIDB_ENOMEM;
+	for (; chidb_Vfs_read(journal, record, JOURNAL_RECORD_SIZE(page_size), offset) == CHIDB_OK;
+	     offset += JOURNAL_RECORD_SIZE(page_size))
+	{
+		npage_t npage = get4byte(record);
+		if (get4byte(record + 4 + page_size) != chidb_Pager_journalChecksum(nonce, npage, record + 4, page_size))
+			break;
+		if (chidb_Vfs_write(pager->f, record + 4, page_size, (uint64_t) (npage - 1) * page_size) != CHIDB_OK)
+		{
+			rc = CHIDB_EIO;
+			break;
+		}
+		VTRACEF("Restored page %i from the journal", npage);
+	}
+	free(record);
+	chidb_Pager_dropReadAhead(pager);
+
+	if (rc == CHIDB_OK && chidb_Vfs_truncate(pager->f, (uint64_t) n_pages * page_size) != CHIDB_OK)
+		rc = CHIDB_EIO;
+	if (rc == CHIDB_OK && chidb_Vfs_sync(pager->f) != CHIDB_OK)
+		rc = CHIDB_EIO;
+
+	return rc;
+}
+
+
+/* Roll back a transaction left behind by a connection that is gone
+ *
+ * A connection holds the exclusive lock on the database file from
+ * chidb_Pager_begin until its journal is deleted, so a journal found
+ * while holding that lock belongs to a transaction that will never
+ * finish (a hot journal). Its original pages are copied back into the
+ * file (see chidb_Pager_playback), and the journal is deleted.
+ *
+ * Parameters
+ * - pager: A Pager holding the exclusive lock.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful (or there was no journal)
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+static int chidb_Pager_recover(Pager *pager)
+{
+	VfsFile *journal;
+	uint8_t buf[8];
+	int rc;
+
+	rc = chidb_Vfs_open(pager->vfs, pager->journal_name, 0, &journal);
+	if (rc == CHIDB_ENOTFOUND)
+		return CHIDB_OK;
+	if (rc != CHIDB_OK)
+		return rc == CHIDB_ENOMEM ? rc : CHIDB_EIO;
+	rc = chidb_Pager_playback(pager, journal);
+	chidb_Vfs_close(journal);
+	if (rc != CHIDB_OK)
+		return rc;
+	chidb_Vfs_remove(pager->vfs, pager->journal_name);
+	VTRACEF("Rolled back the hot journal of %s", pager->filename);
+
+	/* Whatever was read since the file was opened may be undone */
+	if (pager->cache != NULL)
+		chidb_PageCache_clear(pager->cache);
+	if (pager->page_size != 0)
+		chidb_Pager_getRealDBSize(pager, &pager->n_pages);
+	if (pager->has_header && chidb_Vfs_read(pager->f, buf, sizeof(buf), HEADER_FREELIST_HEAD_OFFSET) == CHIDB_OK)
+	{
+		pager->free_head = get4byte(buf);
+		pager->n_free = get4byte(buf + 4);
+	}
+
+	return CHIDB_OK;
+}
+
+
+/* Commit a transaction
+ *
+ * The journal is flushed to disk before any page in the database file
+ * is overwritten. Once all the pages written during the transaction
+ * have been written and flushed to disk, the journal is deleted, which
+ * is what makes the transaction durable. The pages are written in page
+ * order, with runs of consecutive pages coalesced into single writes
+ * (see chidb_Pager_writeDirty). If writing to the database file fails,
+ * the transaction is rolled back.
+ *
+ * In WAL mode, the pages are instead appended to the WAL, and the write
+ * lock is released before the WAL is flushed to disk, so that commits
+ * from other connections can share the flush (see
+ * chidb_Pager_setGroupCommit). Once the WAL holds WAL_AUTOCHECKPOINT
+ * frames, they are copied back into the database file (see
+ * chidb_Pager_checkpoint).
+ *
+ * Which of these flushes actually happen depends on the synchronous
+ * setting (see chidb_Pager_setSynchronous).
+ *
+ * Parameters
+ * - pager: A Pager.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: No transaction is active
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file. In WAL
+ *              mode, if the WAL could not be flushed, the transaction
+ *              is in the WAL (and visible), but may not survive a crash.
+ */
+int chidb_Pager_commit(Pager *pager)
+{
+	int rc = CHIDB_OK;
+
+	if (!pager->in_txn)
+		return CHIDB_EMISUSE;
+
+	if (pager->n_dirty > 0 && pager->wal != NULL)
+	{
+		uint64_t commit;
+		chidb_Pager_checksumDirty(pager);
+		rc = chidb_Wal_append(pager->wal, pager->dirty_list, pager->n_dirty, pager->dirty, pager->n_pages, &commit);
+		if (rc != CHIDB_OK)
+		{
+			chidb_Pager_rollback(pager);
+			return rc;
+		}
+		VTRACEF("Appended %i pages to the WAL", pager->n_dirty);
+		chidb_Pager_updateCache(pager);
+
+		/* Other writers can append while this commit waits for its
+		 * fsync, and share it (see chidb_Wal_sync) */
+		chidb_Pager_endTxn(pager);
+		if (pager->sync_mode == CHIDB_SYNC_FULL)
+			rc = chidb_Wal_sync(pager->wal, commit, pager->group_wait, pager->group_size);
+	}
+	else
+	{
+		if (pager->n_dirty > 0 || pager->n_spilled > 0)
+		{
+			/* Even if no page was overwritten, the journal records the
+			 * size of the file, so that new pages can be truncated away */
+			if (pager->has_header)
+				rc = chidb_Pager_bumpChangeCounter(pager);
+			if (rc == CHIDB_OK && pager->journal == NULL)
+				rc = chidb_Pager_openJournal(pager);
+			if (rc == CHIDB_OK && pager->sync_mode != CHIDB_SYNC_OFF && chidb_Vfs_sync(pager->journal) != CHIDB_OK)
+				rc = CHIDB_EIO;
+			if (rc == CHIDB_OK)
+				rc = chidb_Pager_writeDirty(pager);
+			if (rc == CHIDB_OK)
+				rc = chidb_Pager_sync(pager);
+
+			/* Whatever was written is copied back from the journal */
+			if (rc != CHIDB_OK)
+			{
+				chidb_Pager_rollback(pager);
+				return rc;
+			}
+			VTRACEF("Committed %i pages", pager->n_dirty + pager->n_spilled);
+			chidb_Pager_updateCache(pager);
+		}
+		chidb_Pager_endTxn(pager);
+	}
+
+	chidb_Pager_dropReadAhead(pager);
+	if (rc != CHIDB_OK)
+		return rc;
+
+	/* The transaction is durable even if the checkpoint fails */
+	if (pager->wal != NULL && pager->wal->n_frames >= WAL_AUTOCHECKPOINT)
+		chidb_Pager_checkpoint(pager);
+
+	return CHIDB_OK;
+}
+
+
+/* Bring the cached copies of the dirty pages up to date
+ *
+ * Called once the dirty pages are committed. Pages that are not in the
+ * cache are not added to it.
+ *
+ * Parameters
+ * - pager: A Pager.
+ */
+static void chidb_Pager_updateCache(Pager *pager)
+{
+	if (pager->cache == NULL)
+		return;
+	for (npage_t i = 0; i < pager->n_dirty; i++)
+		chidb_PageCache_update(pager->cache, pager->dirty_list[i], 0, pager->dirty[pager->dirty_list[i]], pager->page_size);
+}
+
+
+/* Roll back a transaction
+ *
+ * Usually nothing has been written to the database file before the
+ * transaction commits, so rolling back only has to throw away the
+ * in-memory pages and the journal, and restore the size of the file and
+ * the freelist. If pages were written out early (see chidb_Pager_spill)
+ * or the commit failed halfway, the original pages are first copied
+ * back from the journal. If that fails too, the journal is left behind,
+ * and is played back the next time the file is opened.
+ *
+ * Parameters
+ * - pager: A Pager.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: No transaction is active
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: The original pages could not be restored
+ */
+int chidb_Pager_rollback(Pager *pager)
+{
+	int rc = CHIDB_OK;
+
+	if (!pager->in_txn)
+		return CHIDB_EMISUSE;
+
+	if (pager->file_written && pager->journal != NULL)
+	{
+		rc = chidb_Pager_playback(pager, pager->journal);
+		if (rc != CHIDB_OK)
+		{
+			chidb_Vfs_close(pager->journal);
+			pager->journal = NULL;
+		}
+	}
+	pager->n_pages = pager->txn_n_pages;
+	pager->free_head = pager->txn_free_head;
+	pager->n_free = pager->txn_n_free;
+	chidb_Pager_endTxn(pager);
+	if (pager->cache != NULL)
+		chidb_PageCache_clear(pager->cache);
+
+	return rc;
+}
+
+
+/* Switch to WAL mode
+ *
+ * Parameters
+ * - pager: A Pager.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the WAL
+ */
+static int chidb_Pager_openWal(Pager *pager)
+{
+	int rc = chidb_Wal_open(&pager->wal, pager->vfs, pager->filename, pager->page_size);
+
+	chidb_Pager_dropReadAhead(pager);
+	if (rc != CHIDB_OK)
+	{
+		pager->wal = NULL;
+		return rc;
+	}
+	if (pager->wal->db_size != 0)
+		pager->n_pages = pager->wal->db_size;
+
+	/* Snapshots being read are now in the WAL */
+	if (pager->n_readers > 0 && chidb_Wal_beginRead(pager->wal) != CHIDB_OK)
+	{
+		chidb_Wal_close(pager->wal, false);
+		pager->wal = NULL;
+		return CHIDB_EIO;
+	}
+
+	return CHIDB_OK;
+}
+
+
+/* Set the journal mode
+ *
+ * In CHIDB_JOURNAL_DELETE mode (the default), transactions write pages
+ * in place and use a rollback journal (see chidb_Pager_begin). In
+ * CHIDB_JOURNAL_WAL mode, they append pages to a write-ahead log
+ * instead (see wal.c), which turns random writes into sequential ones.
+ * Leaving WAL mode runs a checkpoint and deletes the WAL.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - mode: CHIDB_JOURNAL_DELETE or CHIDB_JOURNAL_WAL.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: A transaction is active, or the mode is not valid
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Pager_setJournalMode(Pager *pager, int mode)
+{
+	int rc;
+
+	if (pager->in_txn || (mode != CHIDB_JOURNAL_DELETE && mode != CHIDB_JOURNAL_WAL))
+		return CHIDB_EMISUSE;
+
+	if (mode == CHIDB_JOURNAL_WAL && pager->wal == NULL)
+		return chidb_Pager_openWal(pager);
+
+	if (mode == CHIDB_JOURNAL_DELETE && pager->wal != NULL)
+	{
+		rc = chidb_Pager_checkpoint(pager);
+		if (rc != CHIDB_OK)
+			return rc;
+		chidb_Wal_close(pager->wal, true);
+		pager->wal = NULL;
+	}
+
+	return CHIDB_OK;
+}
+
+
+/* Move to the newest snapshot of the file
+ *
+ * In WAL mode, adds the commits made by other connections to the WAL
+ * index, so that the pages they wrote (and the size of the file and the
+ * freelist) become visible. Until then, this connection keeps reading
+ * the snapshot it had, without waiting for any writer.
+ *
+ * Parameters
+ * - pager: A Pager.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Pager_refresh(Pager *pager)
+{
+	uint8_t buf[8];
+	int rc;
+
+	if (pager->in_txn)
+		return CHIDB_OK;
+
+	/* Other connections may have written to the file since the pages
+	 * were read ahead */
+	chidb_Pager_dropReadAhead(pager);
+	if (pager->wal == NULL)
+	{
+		/* Every write to the file changes its change counter. Without
+		 * a header, there is no telling what changed */
+		bool changed = true;
+		if (pager->has_header && chidb_Vfs_read(pager->f, buf, 4, HEADER_CHANGE_COUNTER_OFFSET) == CHIDB_OK)
+		{
+			changed = get4byte(buf) != pager->change_counter;
+			pager->change_counter = get4byte(buf);
+		}
+		if (changed && pager->cache != NULL)
+			chidb_PageCache_clear(pager->cache);
+		return CHIDB_OK;
+	}
+
+	uint32_t n_frames = pager->wal->n_frames;
+	uint32_t salt1 = pager->wal->salt1;
+	rc = chidb_Wal_refresh(pager->wal);
+	if (rc != CHIDB_OK || (pager->wal->n_frames == n_frames && pager->wal->salt1 == salt1))
+		return rc;
+
+	if (pager->cache != NULL)
+		chidb_PageCache_clear(pager->cache);
+
+	if (pager->wal->db_size != 0)
+		pager->n_pages = pager->wal->db_size;
+	else
+		chidb_Pager_getRealDBSize(pager, &pager->n_pages);
+	if (pager->has_header)
+	{
+		rc = chidb_Pager_pageIO(pager, 1, HEADER_FREELIST_HEAD_OFFSET, buf, sizeof(buf), false);
+		pager->free_head = get4byte(buf);
+		pager->n_free = get4byte(buf + 4);
+	}
+
+	return rc;
+}
+
+
+/* Start and stop reading a snapshot
+ *
+ * chidb_Pager_beginRead moves to the newest snapshot (see
+ * chidb_Pager_refresh) and, in WAL mode, keeps checkpoints from
+ * changing what the snapshot reads until chidb_Pager_endRead is called
+ * (see chidb_Wal_beginRead). Calls can be nested, e.g. by statements
+ * that are being run at the same time, and the snapshot is kept until
+ * the last one ends.
+ *
+ * Parameters
+ * - pager: A Pager.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Pager_beginRead(Pager *pager)
+{
+	if (pager->wal != NULL && pager->n_readers == 0 && chidb_Wal_beginRead(pager->wal) != CHIDB_OK)
+		return CHIDB_EIO;
+	pager->n_readers++;
+
+	int rc = chidb_Pager_refresh(pager);
+	if (rc != CHIDB_OK)
+		chidb_Pager_endRead(pager);
+
+	return rc;
+}
+
+void chidb_Pager_endRead(Pager *pager)
+{
+	if (pager->n_readers > 0 && --pager->n_readers == 0 && pager->wal != NULL)
+		chidb_Wal_endRead(pager->wal);
+}
+
+
+/* Copy the pages in the WAL back into the database file
+ *
+ * The newest version of every page in the WAL is written to the
+ * database file, in page order, and the file is flushed to disk.
+ * After that, the WAL is restarted. Does nothing in rollback journal
+ * mode.
+ *
+ * Nothing is copied while other connections are reading a snapshot,
+ * which may be older than the pages in the WAL, and the WAL is not
+ * restarted if some of them started reading during the checkpoint (see
+ * chidb_Wal_beginCheckpoint). The snapshots of this connection are the
+ * newest one, so they do not get in the way.
+ *
+ * Parameters
+ * - pager: A Pager.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EBUSY: Other connections are reading a snapshot, so the WAL
+ *                was not (entirely) checkpointed
+ * - CHIDB_EMISUSE: A transaction is active
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Pager_checkpoint(Pager *pager)
+{
+	uint8_t *data;
+	int rc = CHIDB_OK;
+
+	if (pager->wal == NULL)
+		return CHIDB_OK;
+	if (pager->in_txn)
+		return CHIDB_EMISUSE;
+
+	/* Frames appended by other connections must be copied too, and none
+	 * can be appended while the WAL is being restarted */
+	if (chidb_Vfs_lock(pager->f, VFS_LOCK_EXCLUSIVE, true) != CHIDB_OK)
+		return CHIDB_EIO;
+	rc = chidb_Pager_refresh(pager);
+	if (rc != CHIDB_OK || pager->wal->n_frames == 0)
+	{
+		chidb_Vfs_lock(pager->f, VFS_LOCK_NONE, true);
+		return rc;
+	}
+	if (pager->n_readers > 0)
+		chidb_Wal_endRead(pager->wal);
+	rc = chidb_Wal_beginCheckpoint(pager->wal);
+	if (rc != CHIDB_OK)
+	{
+		if (pager->n_readers > 0)
+			chidb_Wal_beginRead(pager->wal);
+		chidb_Vfs_lock(pager->f, VFS_LOCK_NONE, true);
+		return rc;
+	}
+
+	/* The WAL has to be on disk before any page in the file is
+	 * overwritten, since the file is inconsistent until the end */
+	if (pager->sync_mode != CHIDB_SYNC_OFF)
+		rc = chidb_Wal_flush(pager->wal);
+	data = (rc == CHIDB_OK) ? chidb_Pager_allocBuffer(pager, CHECKPOINT_BATCH) : NULL;
+	if (data == NULL)
+	{
+		chidb_Wal_endCheckpoint(pager->wal);
+		if (pager->n_readers > 0)
+			chidb_Wal_beginRead(pager->wal);
+		chidb_Vfs_lock(pager->f, VFS_LOCK_NONE, true);
+		return (rc == CHIDB_OK) ? CHIDB_ENOMEM : rc;
+	}
+
+	/* Pages are copied CHECKPOINT_BATCH at a time, with one batch of
+	 * reads from the WAL and one batch of writes to the file. The pages
+	 * are read into data in page order, so a run of consecutive pages
+	 * is written with a single request. */
+	npage_t npage = 1;
+	while (rc == CHIDB_OK && npage < pager->wal->index_size)
+	{
+		uint32_t frames[CHECKPOINT_BATCH];
+		VfsIo ios[CHECKPOINT_BATCH];
+		int n = 0, nios = 0;
+
+		for (; n < CHECKPOINT_BATCH && npage < pager->wal->index_size; npage++)
+		{
+			if (pager->wal->index[npage] == 0)
+				continue;
+			frames[n] = pager->wal->index[npage];
+			if (nios > 0 && ios[nios - 1].offset + ios[nios - 1].len == (uint64_t) (npage - 1) * pager->page_size)
+				ios[nios - 1].len += pager->page_size;
+			else
+			{
+				ios[nios].buf = data + (size_t) n * pager->page_size;
+				ios[nios].len = pager->page_size;
+				ios[nios].offset = (uint64_t) (npage - 1) * pager->page_size;
+				nios++;
+			}
+			n++;
+		}
+		if (n == 0)
+			break;
+		rc = chidb_Wal_readFrames(pager->wal, frames, n, data);
+		if (rc == CHIDB_OK)
+			rc = chidb_Vfs_writeBatch(pager->f, ios, nios);
+	}
+	free(data);
+	chidb_Pager_dropReadAhead(pager);
+
+	if (rc == CHIDB_OK)
+		rc = chidb_Pager_sync(pager);
+	if (rc == CHIDB_OK)
+		rc = chidb_Wal_restart(pager->wal);
+	chidb_Wal_endCheckpoint(pager->wal);
+	if (pager->n_readers > 0)
+		chidb_Wal_beginRead(pager->wal);
+	chidb_Vfs_lock(pager->f, VFS_LOCK_NONE, true);
+	VTRACEF("Checkpoint finished (%i)", rc);
+
+	return rc;
+}
+
+
+/* Set how commits in WAL mode share their fsync
+ *
+ * When a commit needs to flush the WAL to disk and no other thread is
+ * flushing it, it waits up to max_wait microseconds for commits from
+ * other connections (in this process) to join it, or until batch_size
+ * commits are waiting, and then flushes all of them at once. With
+ * max_wait set to 0 (the default), the WAL is flushed right away, and
+ * only commits made while a flush is in progress are grouped.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - max_wait: Maximum time to wait for other commits (in microseconds).
+ * - batch_size: Number of commits to wait for (at least 1).
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: batch_size is 0
+ */
+int chidb_Pager_setGroupCommit(Pager *pager, uint32_t max_wait, uint32_t batch_size)
+{
+	if (batch_size == 0)
+		return CHIDB_EMISUSE;
+
+	pager->group_wait = max_wait;
+	pager->group_size = batch_size;
+
+	return CHIDB_OK;
+}
+
+
+/* Set when the pager flushes its writes to stable storage
+ *
+ * - CHIDB_SYNC_FULL (the default): Every commit is flushed to disk
+ *   before it returns, so committed transactions survive a power loss.
+ * - CHIDB_SYNC_NORMAL: In WAL mode, commits are not flushed; the WAL is
+ *   only flushed before a checkpoint. A power loss can lose the last
+ *   commits, but cannot corrupt the file. In rollback journal mode, this
+ *   is the same as CHIDB_SYNC_FULL, since skipping any flush there could
+ *   corrupt the file.
+ * - CHIDB_SYNC_OFF: Nothing is ever flushed. The file survives a crash
+ *   of the process, but a power loss can corrupt it.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - mode: CHIDB_SYNC_OFF, CHIDB_SYNC_NORMAL or CHIDB_SYNC_FULL
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: Invalid mode
+ */
+int chidb_Pager_setSynchronous(Pager *pager, int mode)
+{
+	if (mode != CHIDB_SYNC_OFF && mode != CHIDB_SYNC_NORMAL && mode != CHIDB_SYNC_FULL)
+		return CHIDB_EMISUSE;
+
+	pager->sync_mode = mode;
+
+	return CHIDB_OK;
+}
+
+
+/* Set how many dirty pages a transaction keeps in memory
+ *
+ * In rollback journal mode, once a transaction has n dirty pages, they
+ * are written to the database file before the transaction commits (see
+ * chidb_Pager_spill), so that a large transaction does not need memory
+ * for every page it writes. In WAL mode, all the dirty pages are kept
+ * in memory until the commit.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - n: Number of dirty pages (0 for no limit)
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ */
+int chidb_Pager_setSpillSize(Pager *pager, npage_t n)
+{
+	pager->spill_size = n;
+
+	return CHIDB_OK;
+}
+
+
+/* Set the page cache of a pager
+ *
+ * The cache keeps the committed contents of recently read pages, so
+ * that reading them again needs no I/O. Any pages already cached are
+ * dropped. CHIDB_CACHE_2Q (the default) keeps pages that are used
+ * repeatedly in the cache even while large scans go through it;
+ * CHIDB_CACHE_LRU evicts the least recently used page.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - policy: CHIDB_CACHE_NONE, CHIDB_CACHE_LRU or CHIDB_CACHE_2Q
+ * - npages: Maximum number of pages in the cache (0 for no cache)
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: Invalid policy
+ * - CHIDB_ENOMEM: Could not allocate memory
+ */
+int chidb_Pager_setCache(Pager *pager, int policy, npage_t npages)
+{
+	if (policy != CHIDB_CACHE_NONE && policy != CHIDB_CACHE_LRU && policy != CHIDB_CACHE_2Q)
+		return CHIDB_EMISUSE;
+
+	if (pager->cache != NULL)
+		chidb_PageCache_destroy(pager->cache);
+	pager->cache = NULL;
+	pager->cache_policy = policy;
+	pager->cache_size = npages;
+
+	/* The cache is created once the page size is known */
+	if (policy == CHIDB_CACHE_NONE || npages == 0 || pager->page_size == 0)
+		return CHIDB_OK;
+
+	return chidb_PageCache_create(&pager->cache, policy, npages, pager->page_size);
+}
+
+
+/* Get the hit and miss counts of the page cache
+ *
+ * The counts start over when the cache is changed with
+ * chidb_Pager_setCache.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - stats: Out parameter. Used to return the counts (all 0 if there
+ *          is no cache).
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ */
+int chidb_Pager_cacheStats(Pager *pager, CacheStats *stats)
+{
+	if (pager->cache != NULL)
+		*stats = pager->cache->stats;
+	else
+		memset(stats, 0, sizeof(CacheStats));
+
+	return CHIDB_OK;
+}
+
+
+/* Turn page checksums on or off
+ *
+ * With checksums, the last PAGE_CHECKSUM_SIZE bytes of every page hold
+ * the CRC32C of the rest of the page, which is computed when the page
+ * is written to the file or the WAL, and checked whenever the page is
+ * read from them. A page that does not match its checksum (e.g., after
+ * a disk silently corrupted it) cannot be read. Only usable_size bytes
+ * of each page are available for anything else.
+ *
+ * This does not convert the pages already in the file. Files with a
+ * header record whether they have checksums, and the pager turns them
+ * on when it reads a header that says so (see chidb_Pager_readHeader).
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - on: Whether pages have checksums.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: A transaction is active
+ */
+int chidb_Pager_setChecksums(Pager *pager, bool on)
+{
+	if (pager->in_txn)
+		return CHIDB_EMISUSE;
+
+	pager->checksums = on;
+	pager->usable_size = pager->page_size - (on ? PAGE_CHECKSUM_SIZE : 0);
+
+	return CHIDB_OK;
+}
+
+
+/* Get the decoded form of a page
+ *
+ * Layers above the pager can keep a decoded form of a page (e.g., the
+ * parsed header of a B-Tree node) in the page cache, next to the page
+ * itself, with chidb_Pager_setDecoded. It is thrown away whenever the
+ * page changes, so it always matches what chidb_Pager_readPage returns.
+ * Pages modified by the current transaction have no decoded form.
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - npage: Page number.
+ * - decoded: Out parameter. Used to return the decoded form, or NULL if
+ *            none has been set yet.
+ *
+ * Return
+ * - CHIDB_OK: The page is cached, so a decoded form can be kept
+ * - CHIDB_ENOTFOUND: No decoded form can be kept for the page
+ */
+int chidb_Pager_getDecoded(Pager *pager, npage_t npage, void **decoded)
+{
+	*decoded = NULL;
+	if (pager->cache == NULL || (npage < pager->dirty_size && pager->dirty[npage] != NULL) ||
+	    !chidb_PageCache_contains(pager->cache, npage))
+		return CHIDB_ENOTFOUND;
+
+	*decoded = chidb_PageCache_getAux(pager->cache, npage);
+
+	return CHIDB_OK;
+}
+
+
+/* Keep the decoded form of a page
+ *
+ * Parameters
+ * - pager: A Pager.
+ * - npage: Page number.
+ * - decoded: Decoded form of the page, allocated with malloc as a single
+ *            block. The pager takes ownership of it.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOTFOUND: No decoded form can be kept for the page (decoded
+ *                    is freed)
+ */
+int chidb_Pager_setDecoded(Pager *pager, npage_t npage, void *decoded)
+{
+	if (pager->cache == NULL || (npage < pager->dirty_size && pager->dirty[npage] != NULL))
+	{
+		free(decoded);
+		return CHIDB_ENOTFOUND;
+	}
+
+	return chidb_PageCache_setAux(pager->cache, npage, decoded);
+}
+
+
+/* Closes a pager and frees up all resources used by the pager.
+ *
+ * An active transaction is rolled back. In WAL mode, the last
+ * connection to close the database checkpoints and deletes the WAL.
  *
  * Parameters
  * - pager: A Pager.
@@ -253,7 +2300,24 @@ int chidb_Pager_getRealDBSize(Pager *pager, npage_t *npages)
  */
 int chidb_Pager_close(Pager *pager)
 {
-	fclose(pager->f);
+	if (pager->in_txn)
+		chidb_Pager_rollback(pager);
+	if (pager->wal != NULL)
+	{
+		bool last = chidb_Wal_isExclusive(pager->wal);
+		chidb_Wal_close(pager->wal, last && chidb_Pager_checkpoint(pager) == CHIDB_OK);
+	}
+	chidb_Vfs_close(pager->f);
+	if (pager->cache != NULL)
+		chidb_PageCache_destroy(pager->cache);
+	free(pager->ra_data);
+	while (pager->n_pool > 0)
+		free(pager->pool[--pager->n_pool]);
+	free(pager->dirty);
+	free(pager->spilled);
+	free(pager->dirty_list);
+	free(pager->journal_name);
+	free(pager->filename);
 	free(pager);
 	
 	return CHIDB_OK;
@@ -3,6 +3,9 @@
 
 #include <stdio.h>
 #include <chidbInt.h>
+#include "vfs.h"
+#include "wal.h"
+#include "pcache.h"
 
 struct MemPage
 {
@@ -11,22 +14,152 @@ struct MemPage
 };
 typedef struct MemPage MemPage;
 
+/* File name that opens a new in-memory database (see chidb_Pager_open) */
+#define MEMORY_FILENAME ":memory:"
+
+/* Location of the change counter and the freelist fields in the file
+ * header. The change counter is incremented by every change made to the
+ * file in rollback journal mode, so that other connections know when
+ * their page cache is out of date (see chidb_Pager_refresh). */
+#define HEADER_CHANGE_COUNTER_OFFSET (24)
+#define HEADER_FREELIST_HEAD_OFFSET (32)
+#define HEADER_FREELIST_COUNT_OFFSET (36)
+
+/* Pages can end with a CRC32C checksum of the rest of the page (see
+ * chidb_Pager_setChecksums). The header records this as the number of
+ * bytes reserved at the end of every page. */
+#define HEADER_RESERVED_OFFSET (20)
+#define PAGE_CHECKSUM_SIZE (4)
+
+/* Layout of a freelist trunk page: the page number of the next trunk,
+ * the number of leaves in this trunk, and the page numbers of the leaves */
+#define FREELIST_TRUNK_NEXT_OFFSET (0)
+#define FREELIST_TRUNK_NLEAVES_OFFSET (4)
+#define FREELIST_TRUNK_HEADER (8)
+#define FREELIST_TRUNK_MAXLEAVES(page_size) (((page_size) - FREELIST_TRUNK_HEADER) / 4)
+
+/* Layout of the rollback journal: a header with a magic string, a random
+ * nonce for the record checksums, and the size of the database file (in
+ * pages) and of a page when the transaction began. The header is followed
+ * by records with a page number, the original contents of that page, and
+ * a checksum. */
+#define JOURNAL_SUFFIX "-journal"
+#define JOURNAL_MAGIC "chidbjnl"
+#define JOURNAL_MAGIC_SIZE (8)
+#define JOURNAL_NONCE_OFFSET (8)
+#define JOURNAL_DBSIZE_OFFSET (12)
+#define JOURNAL_PAGESIZE_OFFSET (16)
+#define JOURNAL_HEADER_SIZE (20)
+#define JOURNAL_RECORD_SIZE(page_size) (4 + (page_size) + 4)
+
+/* Number of pages a checkpoint copies from the WAL at a time */
+#define CHECKPOINT_BATCH (64)
+
+/* Dirty pages are written out WRITEBACK_BATCH at a time, in page order
+ * (see chidb_Pager_writeDirty). By default, a transaction in rollback
+ * journal mode writes its dirty pages out early once it has
+ * DEFAULT_SPILL_PAGES of them (see chidb_Pager_setSpillSize). */
+#define WRITEBACK_BATCH (64)
+#define DEFAULT_SPILL_PAGES (2000)
+
+/* Page buffers are aligned for direct I/O (see the "direct" VFS) to
+ * the largest power of two that divides the page size, up to
+ * PAGE_BUFFER_ALIGN. Up to BUFFER_POOL_SIZE free buffers are kept for
+ * reuse. */
+#define PAGE_BUFFER_ALIGN (4096)
+#define BUFFER_POOL_SIZE (64)
+
+/* Read-ahead: after READAHEAD_TRIGGER reads of consecutive pages, the
+ * pager prefetches up to READAHEAD_PAGES pages past the last one read
+ * (see chidb_Pager_prefetch) */
+#define READAHEAD_PAGES (32)
+#define READAHEAD_TRIGGER (2)
+
 struct Pager
 {
-	FILE *f;
+	Vfs *vfs;             /* Storage of the file, its journal and its WAL */
+	VfsFile *f;
+	char *filename;       /* Name of the database file */
 	npage_t n_pages;
 	uint16_t page_size;
+	uint16_t usable_size; /* Bytes of a page before the checksum (page_size without checksums) */
+	bool checksums;       /* Every page ends with a checksum */
+	bool has_header;      /* Page 1 starts with the chidb file header */
+	npage_t free_head;    /* First freelist trunk page (0 if empty) */
+	npage_t n_free;       /* Number of pages in the freelist (trunks and leaves) */
+
+	/* Transaction state (see chidb_Pager_begin) */
+	bool in_txn;          /* A transaction is active */
+	npage_t txn_n_pages;  /* n_pages, free_head and n_free when the */
+	npage_t txn_free_head;/* transaction began, restored on rollback */
+	npage_t txn_n_free;
+	uint8_t **dirty;      /* Pages written during the transaction, indexed by page number */
+	npage_t dirty_size;   /* Number of entries in dirty */
+	npage_t *dirty_list;  /* Page numbers of the dirty pages */
+	npage_t n_dirty;
+	npage_t max_dirty;
+	uint8_t *spilled;     /* Pages written out before the commit, indexed by page number (dirty_size entries) */
+	npage_t n_spilled;
+	bool file_written;    /* The file was written during the transaction, and must be restored on rollback */
+	npage_t spill_size;   /* Number of dirty pages that triggers a spill (0 for no limit) */
+	char *journal_name;   /* Name of the rollback journal */
+	VfsFile *journal;     /* Rollback journal (NULL until the first page is written) */
+	uint64_t journal_size;/* Size of the journal, where the next record goes */
+	uint32_t journal_nonce;
+	Wal *wal;             /* Write-ahead log (NULL in rollback journal mode) */
+	int n_readers;        /* Number of snapshots being read (see chidb_Pager_beginRead) */
+	uint32_t group_wait;  /* Group commit settings (see chidb_Pager_setGroupCommit) */
+	uint32_t group_size;
+	uint8_t sync_mode;    /* When to flush to stable storage (see chidb_Pager_setSynchronous) */
+
+	/* Read-ahead state (see chidb_Pager_prefetch) */
+	uint8_t *ra_data;     /* READAHEAD_PAGES pages read ahead of time (NULL until needed) */
+	npage_t ra_pages[READAHEAD_PAGES]; /* Page held in each slot of ra_data (0 if none) */
+	int ra_next;          /* Next slot to reuse when all of them are taken */
+	npage_t ra_end;       /* Last page prefetched by sequential read-ahead */
+	npage_t last_read;    /* Last page read from the file or the WAL */
+	npage_t seq_run;      /* Number of consecutive pages read before last_read */
+	uint64_t ra_hits;     /* Number of reads served from ra_data */
+
+	uint8_t *pool[BUFFER_POOL_SIZE]; /* Free page buffers */
+	int n_pool;
+
+	/* Page cache (see chidb_Pager_setCache) */
+	PageCache *cache;     /* NULL if there is no cache */
+	int cache_policy;
+	npage_t cache_size;
+	uint32_t change_counter; /* Change counter of the file when the cache was last known to be valid */
 };
 typedef struct Pager Pager;
 
 int chidb_Pager_open(Pager **pager, const char *filename);
+int chidb_Pager_openVfs(Pager **pager, Vfs *vfs, const char *filename);
 int chidb_Pager_setPageSize(Pager *pager, uint16_t pagesize);
 int chidb_Pager_readHeader(Pager *pager, uint8_t *header);
 int chidb_Pager_allocatePage(Pager *pager, npage_t *npage);
+int chidb_Pager_freePage(Pager *pager, npage_t npage);
 int chidb_Pager_releaseMemPage(Pager *pager, MemPage *page);
 int	chidb_Pager_readPage(Pager *pager, npage_t page_num, MemPage **page);
 int chidb_Pager_writePage(Pager *pager, MemPage *page);
 int chidb_Pager_getRealDBSize(Pager *pager, npage_t *npages);
+int chidb_Pager_prefetch(Pager *pager, npage_t *pages, int n);
+int chidb_Pager_sync(Pager *pager);
+int chidb_Pager_begin(Pager *pager);
+int chidb_Pager_commit(Pager *pager);
+int chidb_Pager_rollback(Pager *pager);
+int chidb_Pager_setJournalMode(Pager *pager, int mode);
+int chidb_Pager_refresh(Pager *pager);
+int chidb_Pager_beginRead(Pager *pager);
+void chidb_Pager_endRead(Pager *pager);
+int chidb_Pager_checkpoint(Pager *pager);
+int chidb_Pager_setGroupCommit(Pager *pager, uint32_t max_wait, uint32_t batch_size);
+int chidb_Pager_setSynchronous(Pager *pager, int mode);
+int chidb_Pager_setSpillSize(Pager *pager, npage_t n);
+int chidb_Pager_setCache(Pager *pager, int policy, npage_t npages);
+int chidb_Pager_cacheStats(Pager *pager, CacheStats *stats);
+int chidb_Pager_setChecksums(Pager *pager, bool on);
+int chidb_Pager_getDecoded(Pager *pager, npage_t npage, void **decoded);
+int chidb_Pager_setDecoded(Pager *pager, npage_t npage, void *decoded);
 int chidb_Pager_close(Pager *pager);
 
 #endif /*PAGER_H_*/
@@ -34,29 +34,61 @@ int chidb_parser_addFromTable(SQLStatement *stmt, char *table)
 	return CHIDB_OK;
 }
 
+/* The WHERE clause can be part of a SELECT, DELETE, or UPDATE statement */
+static void chidb_parser_whereClause(SQLStatement *stmt, uint8_t **nconds, Condition ***conds)
+{
+	switch (stmt->type)
+	{
+		case STMT_DELETE:
+			*nconds = &stmt->query.delete.where_nconds;
+			*conds = &stmt->query.delete.where_conds;
+			break;
+		case STMT_UPDATE:
+			*nconds = &stmt->query.update.where_nconds;
+			*conds = &stmt->query.update.where_conds;
+			break;
+		default:
+			*nconds = &stmt->query.select.where_nconds;
+			*conds = &stmt->query.select.where_conds;
+	}
+}
+
+static Condition *chidb_parser_currentCondition(SQLStatement *stmt)
+{
+	uint8_t *nconds;
+	Condition **conds;
+	
+	chidb_parser_whereClause(stmt, &nconds, &conds);
+	return &(*conds)[*nconds - 1];
+}
+
 int chidb_parser_newCondition(SQLStatement *stmt)
 {
-	stmt->query.select.where_nconds++;
-	stmt->query.select.where_conds = realloc(stmt->query.select.where_conds, stmt->query.select.where_nconds * sizeof(Condition));
+	uint8_t *nconds;
+	Condition **conds;
+	
+	chidb_parser_whereClause(stmt, &nconds, &conds);
+	(*nconds)++;
+	*conds = realloc(*conds, *nconds * sizeof(Condition));
 	
 	return CHIDB_OK;
 }
 
 int chidb_parser_setConditionOperand1(SQLStatement *stmt, char *table, char *col)
 {
-	int ncond = stmt->query.select.where_nconds - 1;
+	Condition *cond = chidb_parser_currentCondition(stmt);
 	
-	stmt->query.select.where_conds[ncond].op1.table = table;
-	stmt->query.select.where_conds[ncond].op1.name = col;
+	cond->op1.table = table;
+	cond->op1.name = col;
 	
 	return CHIDB_OK;
 }
 
 int chidb_parser_setConditionOperator(SQLStatement *stmt, uint8_t op)
 {
-	int ncond = stmt->query.select.where_nconds - 1;
+	Condition *cond = chidb_parser_currentCondition(stmt);
 	
-	stmt->query.select.where_conds[ncond].op = op;
+	cond->op = op;
 	
 	return CHIDB_OK;
 }
@@ -64,31 +96,31 @@ int chidb_parser_setConditionOperator(SQLStatement *stmt, uint8_t op)
 
 int chidb_parser_setConditionOperand2Integer(SQLStatement *stmt, int v)
 {
-	int ncond = stmt->query.select.where_nconds - 1;
+	Condition *cond = chidb_parser_currentCondition(stmt);
 	
-	stmt->query.select.where_conds[ncond].op2Type = OP2_INT;
-	stmt->query.select.where_conds[ncond].op2.integer = v;
+	cond->op2Type = OP2_INT;
+	cond->op2.integer = v;
 	
 	return CHIDB_OK;
 }
 
 int chidb_parser_setConditionOperand2String(SQLStatement *stmt, char *v)
 {
-	int ncond = stmt->query.select.where_nconds - 1;
+	Condition *cond = chidb_parser_currentCondition(stmt);
 	
-	stmt->query.select.where_conds[ncond].op2Type = OP2_STR;
-	stmt->query.select.where_conds[ncond].op2.string = v;
+	cond->op2Type = OP2_STR;
+	cond->op2.string = v;
 	
 	return CHIDB_OK;
 }
 
 int chidb_parser_setConditionOperand2Column(SQLStatement *stmt, char *table, char *col)
 {
-	int ncond = stmt->query.select.where_nconds - 1;
+	Condition *cond = chidb_parser_currentCondition(stmt);
 	
-	stmt->query.select.where_conds[ncond].op2Type = OP2_COL;
-	stmt->query.select.where_conds[ncond].op2.col.table = table;
-	stmt->query.select.where_conds[ncond].op2.col.name = col;
+	cond->op2Type = OP2_COL;
+	cond->op2.col.table = table;
+	cond->op2.col.name = col;
 	
 	return CHIDB_OK;
 }
@@ -139,6 +171,130 @@ int chidb_parser_addInsertNullValue(SQLStatement *stmt)
 }
 
 
+int chidb_parser_initDeleteStmt(SQLStatement *stmt)
+{
+	stmt->type = STMT_DELETE;
+	stmt->query.delete.table = NULL;
+	stmt->query.delete.where_nconds = 0;
+	stmt->query.delete.where_conds = NULL;
+	
+	return CHIDB_OK;
+}
+
+int chidb_parser_setDeleteTable(SQLStatement *stmt, char *table)
+{
+	stmt->query.delete.table = table;
+	
+	return CHIDB_OK;
+}
+
+int chidb_parser_initUpdateStmt(SQLStatement *stmt)
+{
+	stmt->type = STMT_UPDATE;
+	stmt->query.update.table = NULL;
+	stmt->query.update.nsets = 0;
+	stmt->query.update.sets = NULL;
+	stmt->query.update.where_nconds = 0;
+	stmt->query.update.where_conds = NULL;
+	
+	return CHIDB_OK;
+}
+
+int chidb_parser_setUpdateTable(SQLStatement *stmt, char *table)
+{
+	stmt->query.update.table = table;
+	
+	return CHIDB_OK;
+}
+
+static Assignment *chidb_parser_newAssignment(SQLStatement *stmt, char *col)
+{
+	stmt->query.update.nsets++;
+	stmt->query.update.sets = realloc(stmt->query.update.sets, stmt->query.update.nsets * sizeof(Assignment));
+	stmt->query.update.sets[stmt->query.update.nsets-1].col = col;
+	
+	return &stmt->query.update.sets[stmt->query.update.nsets-1];
+}
+
+int chidb_parser_addUpdateIntValue(SQLStatement *stmt, char *col, int v)
+{
+	Assignment *set = chidb_parser_newAssignment(stmt, col);
+	set->val.type = INS_INT;
+	set->val.val.integer = v;
+	
+	return CHIDB_OK;
+}
+
+int chidb_parser_addUpdateStrValue(SQLStatement *stmt, char *col, char *v)
+{
+	Assignment *set = chidb_parser_newAssignment(stmt, col);
+	set->val.type = INS_STR;
+	set->val.val.string = v;
+	
+	return CHIDB_OK;
+}
+
+int chidb_parser_addUpdateNullValue(SQLStatement *stmt, char *col)
+{
+	Assignment *set = chidb_parser_newAssignment(stmt, col);
+	set->val.type = INS_NULL;
+	
+	return CHIDB_OK;
+}
+
+int chidb_parser_initVacuumStmt(SQLStatement *stmt)
+{
+	stmt->type = STMT_VACUUM;
+	
+	return CHIDB_OK;
+}
+
+int chidb_parser_initBeginStmt(SQLStatement *stmt)
+{
+	stmt->type = STMT_BEGIN;
+	
+	return CHIDB_OK;
+}
+
+int chidb_parser_initCommitStmt(SQLStatement *stmt)
+{
+	stmt->type = STMT_COMMIT;
+	
+	return CHIDB_OK;
+}
+
+int chidb_parser_initRollbackStmt(SQLStatement *stmt)
+{
+	stmt->type = STMT_ROLLBACK;
+	
+	return CHIDB_OK;
+}
+
+int chidb_parser_initPragmaStmt(SQLStatement *stmt, char *name)
+{
+	stmt->type = STMT_PRAGMA;
+	stmt->query.pragma.name = name;
+	stmt->query.pragma.val.type = INS_NULL;
+	
+	return CHIDB_OK;
+}
+
+int chidb_parser_setPragmaIntValue(SQLStatement *stmt, int v)
+{
+	stmt->query.pragma.val.type = INS_INT;
+	stmt->query.pragma.val.val.integer = v;
+	
+	return CHIDB_OK;
+}
+
+int chidb_parser_setPragmaStrValue(SQLStatement *stmt, char *v)
+{
+	stmt->query.pragma.val.type = INS_STR;
+	stmt->query.pragma.val.val.string = v;
+	
+	return CHIDB_OK;
+}
+
 int chidb_parser_initCreateTableStmt(SQLStatement *stmt)
 {
 	stmt->type = STMT_CREATETABLE;
@@ -169,12 +325,22 @@ int chidb_parser_addCreateTableColumn(SQLStatement *stmt, char* name, uint8_t ty
 	return CHIDB_OK;
 }
 
-int chidb_parser_initCreateIndexStmt(SQLStatement *stmt, char* index, char *table, char *col)
+int chidb_parser_initCreateIndexStmt(SQLStatement *stmt, char* index, char *table)
 {
 	stmt->type = STMT_CREATEINDEX;
 	stmt->query.createIndex.index = index;
-	stmt->query.createIndex.on.table = table;
-	stmt->query.createIndex.on.name = col;
+	stmt->query.createIndex.table = table;
+	stmt->query.createIndex.ncols = 0;
+	stmt->query.createIndex.cols = NULL;
+	
+	return CHIDB_OK;
+}
+
+int chidb_parser_addCreateIndexColumn(SQLStatement *stmt, char* name)
+{
+	stmt->query.createIndex.ncols++;
+	stmt->query.createIndex.cols = realloc(stmt->query.createIndex.cols, stmt->query.createIndex.ncols * sizeof(char *));
+	stmt->query.createIndex.cols[stmt->query.createIndex.ncols-1] = name;
 	
 	return CHIDB_OK;
 }
@@ -193,11 +359,20 @@ int chidb_parser_SQLStatement_destroyInternal(SQLStatement stmt) {
   case STMT_INSERT:
     chidb_parser_InsertStatement_destroyInternal(stmt.query.insert);
     break;
+  case STMT_DELETE:
+    chidb_parser_DeleteStatement_destroyInternal(stmt.query.delete);
+    break;
+  case STMT_UPDATE:
+    chidb_parser_UpdateStatement_destroyInternal(stmt.query.update);
+    break;
   case STMT_CREATETABLE:
     chidb_parser_CreateTableStatement_destroyInternal(stmt.query.createTable);
     break;
   case STMT_CREATEINDEX:
     chidb_parser_CreateIndexStatement_destroyInternal(stmt.query.createIndex);
+    break;
+  case STMT_PRAGMA:
+    chidb_parser_PragmaStatement_destroyInternal(stmt.query.pragma);
   }
   return CHIDB_OK;
 }
@@ -223,6 +398,27 @@ int chidb_parser_InsertStatement_destroyInternal(InsertStatement insert) {
   return CHIDB_OK;
 }
 
+int chidb_parser_DeleteStatement_destroyInternal(DeleteStatement delete) {
+  free(delete.table);
+  for(int i = 0; i < delete.where_nconds; i++)
+    chidb_parser_Condition_destroyInternal(delete.where_conds[i]);
+  free(delete.where_conds);
+  return CHIDB_OK;
+}
+
+int chidb_parser_UpdateStatement_destroyInternal(UpdateStatement update) {
+  free(update.table);
+  for(int i = 0; i < update.nsets; i++) {
+    free(update.sets[i].col);
+    chidb_parser_Value_destroyInternal(update.sets[i].val);
+  }
+  free(update.sets);
+  for(int i = 0; i < update.where_nconds; i++)
+    chidb_parser_Condition_destroyInternal(update.where_conds[i]);
+  free(update.where_conds);
+  return CHIDB_OK;
+}
+
 int chidb_parser_CreateTableStatement_destroyInternal(CreateTableStatement createTable) {
   free(createTable.table);
   for(int i = 0; i < createTable.ncols; i++)
@@ -233,7 +429,16 @@ int chidb_parser_CreateTableStatement_destroyInternal(CreateTableStatement creat
 
 int chidb_parser_CreateIndexStatement_destroyInternal(CreateIndexStatement createIndex) {
   free(createIndex.index);
-  chidb_parser_Column_destroyInternal(createIndex.on);
+  free(createIndex.table);
+  for(int i = 0; i < createIndex.ncols; i++)
+    free(createIndex.cols[i]);
+  free(createIndex.cols);
+  return CHIDB_OK;
+}
+
+int chidb_parser_PragmaStatement_destroyInternal(PragmaStatement pragma) {
+  free(pragma.name);
+  chidb_parser_Value_destroyInternal(pragma.val);
   return CHIDB_OK;
 }
 
@@ -418,6 +623,98 @@ char* chidb_parser_InsertToString(SQLStatement *stmt)
 	return s;
 }
 
+char* chidb_parser_DeleteToString(SQLStatement *stmt)
+{
+	char *s = malloc(1);
+	*s = '\0';
+	
+	chidb_astrcat(&s, "DELETE FROM ");
+	chidb_astrcat(&s, stmt->query.delete.table);
+	chidb_astrcat(&s,  " ");
+
+	if (stmt->query.delete.where_nconds > 0)
+	{
+		chidb_astrcat(&s, "WHERE ");
+		chidb_parser_appendCondition(&s, &stmt->query.delete.where_conds[0]);
+		for(int i=1; i<stmt->query.delete.where_nconds; i++)
+		{
+			chidb_astrcat(&s, "AND ");			
+			chidb_parser_appendCondition(&s, &stmt->query.delete.where_conds[i]);
+		}
+	}
+	
+	return s;
+}
+
+char* chidb_parser_UpdateToString(SQLStatement *stmt)
+{
+	char *s = malloc(1);
+	*s = '\0';
+	
+	chidb_astrcat(&s, "UPDATE ");
+	chidb_astrcat(&s, stmt->query.update.table);
+	chidb_astrcat(&s, " SET ");
+	for(int i=0; i<stmt->query.update.nsets; i++)
+	{
+		if (i > 0)
+			chidb_astrcat(&s, ", ");
+		chidb_astrcat(&s, stmt->query.update.sets[i].col);
+		chidb_astrcat(&s, " = ");
+		chidb_parser_appendInsertValue(&s, &stmt->query.update.sets[i].val);
+	}
+	chidb_astrcat(&s,  " ");
+
+	if (stmt->query.update.where_nconds > 0)
+	{
+		chidb_astrcat(&s, "WHERE ");
+		chidb_parser_appendCondition(&s, &stmt->query.update.where_conds[0]);
+		for(int i=1; i<stmt->query.update.where_nconds; i++)
+		{
+			chidb_astrcat(&s, "AND ");			
+			chidb_parser_appendCondition(&s, &stmt->query.update.where_conds[i]);
+		}
+	}
+	
+	return s;
+}
+
+char* chidb_parser_VacuumToString(SQLStatement *stmt)
+{
+	char *s = malloc(1);
+	*s = '\0';
+	
+	chidb_astrcat(&s, "VACUUM");
+	
+	return s;
+}
+
+char* chidb_parser_TransactionToString(SQLStatement *stmt)
+{
+	char *s = malloc(1);
+	*s = '\0';
+	
+	switch(stmt->type)
+	{
+		case STMT_BEGIN:    chidb_astrcat(&s, "BEGIN"); break;
+		case STMT_COMMIT:   chidb_astrcat(&s, "COMMIT"); break;
+		case STMT_ROLLBACK: chidb_astrcat(&s, "ROLLBACK"); break;
+	}
+	
+	return s;
+}
+
+char* chidb_parser_PragmaToString(SQLStatement *stmt)
+{
+	char *s;
+	
+	if(stmt->query.pragma.val.type == INS_INT)
+		asprintf(&s, "PRAGMA %s = %i", stmt->query.pragma.name, stmt->query.pragma.val.val.integer);
+	else
+		asprintf(&s, "PRAGMA %s = %s", stmt->query.pragma.name, stmt->query.pragma.val.val.string);
+	
+	return s;
+}
+
 char* chidb_parser_CreateTableToString(SQLStatement *stmt)
 {
 	char *s = malloc(1);
@@ -441,9 +738,13 @@ char* chidb_parser_CreateTableToString(SQLStatement *stmt)
 char* chidb_parser_CreateIndexToString(SQLStatement *stmt)
 {
 	char *s;
-	asprintf(&s, "CREATE INDEX %s ON %s(%s)", stmt->query.createIndex.index, 
-	                                               stmt->query.createIndex.on.table,
-	                                               stmt->query.createIndex.on.name);
+	asprintf(&s, "CREATE INDEX %s ON %s(", stmt->query.createIndex.index, 
+	                                       stmt->query.createIndex.table);
+	for(int i = 0; i < stmt->query.createIndex.ncols; i++)
+	{
+		chidb_astrcat(&s, stmt->query.createIndex.cols[i]);
+		chidb_astrcat(&s, (i < stmt->query.createIndex.ncols - 1) ? ", " : ")");
+	}
 	return s;
 }
 
@@ -453,6 +754,13 @@ char* chidb_parser_StatementToString(SQLStatement *stmt)
 	{
 		case STMT_SELECT:      return chidb_parser_SelectToString(stmt);
 		case STMT_INSERT:      return chidb_parser_InsertToString(stmt);
+		case STMT_DELETE:      return chidb_parser_DeleteToString(stmt);
+		case STMT_UPDATE:      return chidb_parser_UpdateToString(stmt);
+		case STMT_VACUUM:      return chidb_parser_VacuumToString(stmt);
+		case STMT_BEGIN:
+		case STMT_COMMIT:
+		case STMT_ROLLBACK:    return chidb_parser_TransactionToString(stmt);
+		case STMT_PRAGMA:      return chidb_parser_PragmaToString(stmt);
 		case STMT_CREATETABLE: return chidb_parser_CreateTableToString(stmt);
 		case STMT_CREATEINDEX: return chidb_parser_CreateIndexToString(stmt);
 	}
@@ -480,6 +788,61 @@ int chidb_parser_printInsert(SQLStatement *stmt)
 	return CHIDB_OK;
 }
 
+int chidb_parser_printDelete(SQLStatement *stmt)
+{
+	char *s = chidb_parser_DeleteToString(stmt);
+	
+	fprintf(stderr, "%s\n", s);
+	
+	free(s); 
+
+	return CHIDB_OK;
+}
+
+int chidb_parser_printUpdate(SQLStatement *stmt)
+{
+	char *s = chidb_parser_UpdateToString(stmt);
+	
+	fprintf(stderr, "%s\n", s);
+	
+	free(s); 
+
+	return CHIDB_OK;
+}
+
+int chidb_parser_printVacuum(SQLStatement *stmt)
+{
+	char *s = chidb_parser_VacuumToString(stmt);
+	
+	fprintf(stderr, "%s\n", s);
+	
+	free(s); 
+
+	return CHIDB_OK;
+}
+
+int chidb_parser_printTransaction(SQLStatement *stmt)
+{
+	char *s = chidb_parser_TransactionToString(stmt);
+	
+	fprintf(stderr, "%s\n", s);
+	
+	free(s); 
+
+	return CHIDB_OK;
+}
+
+int chidb_parser_printPragma(SQLStatement *stmt)
+{
+	char *s = chidb_parser_PragmaToString(stmt);
+	
+	fprintf(stderr, "%s\n", s);
+	
+	free(s); 
+
+	return CHIDB_OK;
+}
+
 int chidb_parser_printCreateTable(SQLStatement *stmt)
 {
 	char *s = chidb_parser_CreateTableToString(stmt);
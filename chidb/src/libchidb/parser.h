@@ -7,6 +7,13 @@
 #define STMT_INSERT (1)
 #define STMT_CREATETABLE  (2)
 #define STMT_CREATEINDEX  (3)
+#define STMT_DELETE  (4)
+#define STMT_UPDATE  (5)
+#define STMT_VACUUM  (6)
+#define STMT_BEGIN  (7)
+#define STMT_COMMIT  (8)
+#define STMT_ROLLBACK  (9)
+#define STMT_PRAGMA  (10)
 
 #define SELECT_ALL (-1)
 
@@ -88,6 +95,31 @@ struct InsertStatement
 };
 typedef struct InsertStatement InsertStatement;
 
+struct Assignment
+{
+	char *col;
+	Value val;
+};
+typedef struct Assignment Assignment;
+
+struct UpdateStatement
+{
+	char *table;
+	uint8_t nsets;
+	Assignment *sets;
+	uint8_t where_nconds;
+	Condition *where_conds;
+};
+typedef struct UpdateStatement UpdateStatement;
+
+struct DeleteStatement
+{
+	char *table;
+	uint8_t where_nconds;
+	Condition *where_conds;
+};
+typedef struct DeleteStatement DeleteStatement;
+
 struct CreateTableStatement
 {
 	char *table;
@@ -100,18 +132,30 @@ typedef struct CreateTableStatement CreateTableStatement;
 struct CreateIndexStatement
 {
 	char *index;
-	Column on;
+	char *table;
+	uint8_t ncols;
+	char **cols;
 };
 typedef struct CreateIndexStatement CreateIndexStatement;
 
+struct PragmaStatement
+{
+	char *name;
+	Value val;
+};
+typedef struct PragmaStatement PragmaStatement;
+
 struct SQLStatement
 {
 	uint8_t type;
         union {
 	  SelectStatement select;
 	  InsertStatement insert;
+	  DeleteStatement delete;
+	  UpdateStatement update;
 	  CreateTableStatement createTable;
 	  CreateIndexStatement createIndex;
+	  PragmaStatement pragma;
 	} query;
 };
 typedef struct SQLStatement SQLStatement;
@@ -137,21 +181,49 @@ int chidb_parser_addInsertIntValue(SQLStatement *stmt, int v);
 int chidb_parser_addInsertStrValue(SQLStatement *stmt, char *v);
 int chidb_parser_addInsertNullValue(SQLStatement *stmt);
 
+/* DELETE */
+int chidb_parser_initDeleteStmt(SQLStatement *stmt);
+int chidb_parser_setDeleteTable(SQLStatement *stmt, char *table);
+
+/* UPDATE */
+int chidb_parser_initUpdateStmt(SQLStatement *stmt);
+int chidb_parser_setUpdateTable(SQLStatement *stmt, char *table);
+int chidb_parser_addUpdateIntValue(SQLStatement *stmt, char *col, int v);
+int chidb_parser_addUpdateStrValue(SQLStatement *stmt, char *col, char *v);
+int chidb_parser_addUpdateNullValue(SQLStatement *stmt, char *col);
+
+/* VACUUM */
+int chidb_parser_initVacuumStmt(SQLStatement *stmt);
+
+/* BEGIN, COMMIT, ROLLBACK */
+int chidb_parser_initBeginStmt(SQLStatement *stmt);
+int chidb_parser_initCommitStmt(SQLStatement *stmt);
+int chidb_parser_initRollbackStmt(SQLStatement *stmt);
+
+/* PRAGMA */
+int chidb_parser_initPragmaStmt(SQLStatement *stmt, char *name);
+int chidb_parser_setPragmaIntValue(SQLStatement *stmt, int v);
+int chidb_parser_setPragmaStrValue(SQLStatement *stmt, char *v);
+
 /* CREATE TABLE */
 int chidb_parser_initCreateTableStmt(SQLStatement *stmt);
 int chidb_parser_setCreateTableName(SQLStatement *stmt, char *table);
 int chidb_parser_addCreateTableColumn(SQLStatement *stmt, char* name, uint8_t type, bool pk);
 
 /* CREATE INDEX */
-int chidb_parser_initCreateIndexStmt(SQLStatement *stmt, char* index, char *table, char *col);
+int chidb_parser_initCreateIndexStmt(SQLStatement *stmt, char* index, char *table);
+int chidb_parser_addCreateIndexColumn(SQLStatement *stmt, char* name);
 
 /* CLEANUP */
 int chidb_parser_SQLStatement_destroy(SQLStatement *stmt);
 int chidb_parser_SQLStatement_destroyInternal(SQLStatement stmt);
 int chidb_parser_SelectStatement_destroyInternal(SelectStatement select);
 int chidb_parser_InsertStatement_destroyInternal(InsertStatement insert);
+int chidb_parser_DeleteStatement_destroyInternal(DeleteStatement delete);
+int chidb_parser_UpdateStatement_destroyInternal(UpdateStatement update);
 int chidb_parser_CreateTableStatement_destroyInternal(CreateTableStatement createTable);
 int chidb_parser_CreateIndexStatement_destroyInternal(CreateIndexStatement createIndex);
+int chidb_parser_PragmaStatement_destroyInternal(PragmaStatement pragma);
 int chidb_parser_Condition_destroyInternal(Condition cond);
 int chidb_parser_Value_destroyInternal(Value val);
 int chidb_parser_Column_destroyInternal(Column col);
@@ -162,10 +234,20 @@ char* chidb_parser_StatementToString(SQLStatement *stmt);
 
 char* chidb_parser_SelectToString(SQLStatement *stmt);
 char* chidb_parser_InsertToString(SQLStatement *stmt);
+char* chidb_parser_DeleteToString(SQLStatement *stmt);
+char* chidb_parser_UpdateToString(SQLStatement *stmt);
+char* chidb_parser_VacuumToString(SQLStatement *stmt);
+char* chidb_parser_TransactionToString(SQLStatement *stmt);
+char* chidb_parser_PragmaToString(SQLStatement *stmt);
 char* chidb_parser_CreateTableToString(SQLStatement *stmt);
 char* chidb_parser_CreateIndexToString(SQLStatement *stmt);
 int chidb_parser_printSelect(SQLStatement *stmt);
 int chidb_parser_printInsert(SQLStatement *stmt);
+int chidb_parser_printDelete(SQLStatement *stmt);
+int chidb_parser_printUpdate(SQLStatement *stmt);
+int chidb_parser_printVacuum(SQLStatement *stmt);
+int chidb_parser_printTransaction(SQLStatement *stmt);
+int chidb_parser_printPragma(SQLStatement *stmt);
 int chidb_parser_printCreateTable(SQLStatement *stmt);
 int chidb_parser_printCreateIndex(SQLStatement *stmt);
 
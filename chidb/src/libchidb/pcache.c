@@ -0,0 +1,436 @@
+/*****************************************************************************
+ *
+ *																 chidb
+ *
+ * This module contains the page cache, which keeps the committed contents
+ * of recently read pages in memory so that the pager does not have to
+ * read them again from the file or the WAL (see chidb_Pager_readPage).
+ *
+ * The cache holds up to a fixed number of pages, and the replacement
+ * policy decides which page to evict when it is full:
+ *
+ * - CHIDB_CACHE_LRU evicts the least recently used page. A scan that
+ *   reads more pages than the cache holds evicts every other page,
+ *   including the internal nodes that point lookups go through.
+ *
+ * - CHIDB_CACHE_2Q (Johnson and Shasha, 1994) is scan resistant. Pages
+ *   read for the first time go to a small FIFO queue (A1in), and are
+ *   evicted from there without touching the rest of the cache. The page
+ *   numbers of the pages evicted from A1in are remembered for a while
+ *   (A1out), and a page that is read again while it is on A1out is
+ *   promoted to the main LRU list (Am). A scan therefore only ever
+ *   cycles through A1in, while pages that are used repeatedly stay on
+ *   Am.
+ *
+ * Every entry is in a hash table by page number, including the entries
+ * on A1out, which have no contents. The cache counts its hits, misses
+ * and evictions, so that policies can be compared on a workload.
+ *
+ * Callers can also keep a decoded form of a cached page next to it
+ * (e.g., the header and keys of a B-Tree node), which is freed as soon
+ * as the contents of the page change or the page leaves the cache.
+ *
+\*****************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <chidbInt.h>
+
+#include "pcache.h"
+
+
+static uint32_t chidb_PageCache_hash(PageCache *cache, npage_t npage)
+{
+	return (npage * 2654435761u) & cache->hash_mask;
+}
+
+
+static CacheEntry *chidb_PageCache_find(PageCache *cache, npage_t npage)
+{
+	CacheEntry *e = cache->hash[chidb_PageCache_hash(cache, npage)];
+
+	while (e != NULL && e->npage != npage)
+		e = e->hnext;
+
+	return e;
+}
+
+
+static void chidb_PageCache_unhash(PageCache *cache, CacheEntry *e)
+{
+	CacheEntry **p = &cache->hash[chidb_PageCache_hash(cache, e->npage)];
+
+	while (*p != e)
+		p = &(*p)->hnext;
+	*p = e->hnext;
+}
+
+
+static void chidb_PageCache_unlink(PageCache *cache, CacheEntry *e)
+{
+	CacheList *l = &cache->lists[e->list];
+
+	if (e->prev != NULL)
+		e->prev->next = e->next;
+	else
+		l->head = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+	else
+		l->tail = e->prev;
+	l->n--;
+}
+
+
+static void chidb_PageCache_push(PageCache *cache, CacheEntry *e, int list)
+{
+	CacheList *l = &cache->lists[list];
+
+	e->list = list;
+	e->prev = NULL;
+	e->next = l->head;
+	if (l->head != NULL)
+		l->head->prev = e;
+	else
+		l->tail = e;
+	l->head = e;
+	l->n++;
+}
+
+
+/* Remove an entry from its list and the hash table, and free it */
+static void chidb_PageCache_drop(PageCache *cache, CacheEntry *e)
+{
+	chidb_PageCache_unlink(cache, e);
+	chidb_PageCache_unhash(cache, e);
+	free(e->aux);
+	free(e->data);
+	free(e);
+}
+
+
+/* Make room for a page, if the cache is full
+ *
+ * Returns the buffer of the evicted page, to be reused for the new one
+ * (NULL if there was room). In 2Q, a page evicted from A1in is moved to
+ * A1out, and the oldest entry on A1out is forgotten if it is full.
+ */
+static uint8_t *chidb_PageCache_evict(PageCache *cache)
+{
+	CacheList *in = &cache->lists[CACHE_LIST_IN];
+	CacheList *main = &cache->lists[CACHE_LIST_MAIN];
+	CacheEntry *victim;
+	uint8_t *data;
+
+	if (in->n + main->n < cache->capacity)
+		return NULL;
+
+	cache->stats.evictions++;
+	if (main->n == 0 || (cache->policy == CHIDB_CACHE_2Q && in->n > cache->max_in))
+		victim = in->tail;
+	else
+		victim = main->tail;
+	data = victim->data;
+	victim->data = NULL;
+	free(victim->aux);
+	victim->aux = NULL;
+
+	if (victim->list == CACHE_LIST_IN && cache->max_out > 0)
+	{
+		chidb_PageCache_unlink(cache, victim);
+		chidb_PageCache_push(cache, victim, CACHE_LIST_OUT);
+		if (cache->lists[CACHE_LIST_OUT].n > cache->max_out)
+			chidb_PageCache_drop(cache, cache->lists[CACHE_LIST_OUT].tail);
+	}
+	else
+		chidb_PageCache_drop(cache, victim);
+
+	return data;
+}
+
+
+/* Create a page cache
+ *
+ * Parameters
+ * - cache: Out parameter. Used to return the new cache.
+ * - policy: CHIDB_CACHE_LRU or CHIDB_CACHE_2Q.
+ * - capacity: Maximum number of pages (at least 1).
+ * - page_size: Size of a page (in bytes).
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EMISUSE: Invalid policy or capacity
+ * - CHIDB_ENOMEM: Could not allocate memory
+ */
+int chidb_PageCache_create(PageCache **cache, int policy, npage_t capacity, uint16_t page_size)
+{
+	uint32_t hash_size = 64;
+
+	if ((policy != CHIDB_CACHE_LRU && policy != CHIDB_CACHE_2Q) || capacity == 0)
+		return CHIDB_EMISUSE;
+
+	*cache = calloc(1, sizeof(PageCache));
+	if (*cache == NULL)
+		return CHIDB_ENOMEM;
+	(*cache)->policy = policy;
+	(*cache)->page_size = page_size;
+	(*cache)->capacity = capacity;
+	if (policy == CHIDB_CACHE_2Q)
+	{
+		(*cache)->max_in = (uint64_t) capacity * CACHE_2Q_IN_PERCENT / 100;
+		(*cache)->max_out = (uint64_t) capacity * CACHE_2Q_OUT_PERCENT / 100;
+	}
+
+	/* Room for every entry, including the ones on A1out */
+	while (hash_size < 2 * (capacity + (*cache)->max_out))
+		hash_size *= 2;
+	(*cache)->hash = calloc(hash_size, sizeof(CacheEntry *));
+	if ((*cache)->hash == NULL)
+	{
+		free(*cache);
+		return CHIDB_ENOMEM;
+	}
+	(*cache)->hash_mask = hash_size - 1;
+
+	return CHIDB_OK;
+}
+
+
+/* Look up a page
+ *
+ * A hit on the main list makes the page the most recently used one. In
+ * 2Q, a hit on A1in does not move the page, so that pages that are only
+ * read in a short burst still leave the cache early.
+ *
+ * Parameters
+ * - cache: A page cache.
+ * - npage: Page number.
+ * - data: Buffer with room for a page, where the contents are copied.
+ *
+ * Return
+ * - CHIDB_OK: The page is in the cache
+ * - CHIDB_ENOTFOUND: The page is not in the cache
+ */
+int chidb_PageCache_get(PageCache *cache, npage_t npage, uint8_t *data)
+{
+	CacheEntry *e = chidb_PageCache_find(cache, npage);
+
+	if (e == NULL || e->list == CACHE_LIST_OUT)
+	{
+		cache->stats.misses++;
+		return CHIDB_ENOTFOUND;
+	}
+
+	cache->stats.hits++;
+	memcpy(data, e->data, cache->page_size);
+	if (e->list == CACHE_LIST_MAIN && cache->lists[CACHE_LIST_MAIN].head != e)
+	{
+		chidb_PageCache_unlink(cache, e);
+		chidb_PageCache_push(cache, e, CACHE_LIST_MAIN);
+	}
+
+	return CHIDB_OK;
+}
+
+
+/* Check whether a page is in the cache
+ *
+ * Unlike chidb_PageCache_get, this does not count as a use of the page.
+ *
+ * Parameters
+ * - cache: A page cache.
+ * - npage: Page number.
+ *
+ * Return
+ * - true if the contents of the page are in the cache
+ */
+bool chidb_PageCache_contains(PageCache *cache, npage_t npage)
+{
+	CacheEntry *e = chidb_PageCache_find(cache, npage);
+
+	return e != NULL && e->list != CACHE_LIST_OUT;
+}
+
+
+/* Add a page that was just read to the cache
+ *
+ * Evicts a page if the cache is full. With LRU, and with 2Q for a page
+ * that is on A1out, the page goes to the main list; otherwise it goes
+ * to A1in. If the page is already in the cache, its contents are
+ * replaced.
+ *
+ * Parameters
+ * - cache: A page cache.
+ * - npage: Page number.
+ * - data: Contents of the page.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ */
+int chidb_PageCache_put(PageCache *cache, npage_t npage, const uint8_t *data)
+{
+	CacheEntry *e = chidb_PageCache_find(cache, npage);
+	uint8_t *buf;
+	int list = CACHE_LIST_IN;
+
+	if (e != NULL && e->list != CACHE_LIST_OUT)
+	{
+		memcpy(e->data, data, cache->page_size);
+		free(e->aux);
+		e->aux = NULL;
+		return CHIDB_OK;
+	}
+
+	if (cache->policy == CHIDB_CACHE_LRU || e != NULL)
+		list = CACHE_LIST_MAIN;
+	if (e != NULL)
+		chidb_PageCache_unlink(cache, e);
+
+	buf = chidb_PageCache_evict(cache);
+	if (buf == NULL && (buf = malloc(cache->page_size)) == NULL)
+	{
+		if (e != NULL)
+		{
+			chidb_PageCache_unhash(cache, e);
+			free(e);
+		}
+		return CHIDB_ENOMEM;
+	}
+	if (e == NULL)
+	{
+		e = malloc(sizeof(CacheEntry));
+		if (e == NULL)
+		{
+			free(buf);
+			return CHIDB_ENOMEM;
+		}
+		e->npage = npage;
+		e->aux = NULL;
+		e->hnext = cache->hash[chidb_PageCache_hash(cache, npage)];
+		cache->hash[chidb_PageCache_hash(cache, npage)] = e;
+	}
+	e->data = buf;
+	memcpy(e->data, data, cache->page_size);
+	chidb_PageCache_push(cache, e, list);
+
+	return CHIDB_OK;
+}
+
+
+/* Change part of a page, if it is in the cache
+ *
+ * Used when a page is written, so that the cache keeps matching the
+ * committed contents of the page. Does not count as a use of the page.
+ *
+ * Parameters
+ * - cache: A page cache.
+ * - npage: Page number.
+ * - offset: Offset within the page.
+ * - buf: New contents.
+ * - len: Number of bytes.
+ */
+void chidb_PageCache_update(PageCache *cache, npage_t npage, uint16_t offset, const uint8_t *buf, size_t len)
+{
+	CacheEntry *e = chidb_PageCache_find(cache, npage);
+
+	if (e != NULL && e->list != CACHE_LIST_OUT)
+	{
+		memcpy(e->data + offset, buf, len);
+		free(e->aux);
+		e->aux = NULL;
+	}
+}
+
+
+/* Get the decoded form of a cached page
+ *
+ * Parameters
+ * - cache: A page cache.
+ * - npage: Page number.
+ *
+ * Return
+ * - The decoded form set with chidb_PageCache_setAux, or NULL if there
+ *   is none (or the page is not in the cache)
+ */
+void *chidb_PageCache_getAux(PageCache *cache, npage_t npage)
+{
+	CacheEntry *e = chidb_PageCache_find(cache, npage);
+
+	return e != NULL ? e->aux : NULL;
+}
+
+
+/* Keep a decoded form of a cached page
+ *
+ * The cache takes ownership of aux (a single block allocated with
+ * malloc), and frees it when the contents of the page change or the
+ * page is evicted.
+ *
+ * Parameters
+ * - cache: A page cache.
+ * - npage: Page number.
+ * - aux: Decoded form of the current contents of the page.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOTFOUND: The page is not in the cache (aux is freed)
+ */
+int chidb_PageCache_setAux(PageCache *cache, npage_t npage, void *aux)
+{
+	CacheEntry *e = chidb_PageCache_find(cache, npage);
+
+	if (e == NULL || e->list == CACHE_LIST_OUT)
+	{
+		free(aux);
+		return CHIDB_ENOTFOUND;
+	}
+	free(e->aux);
+	e->aux = aux;
+
+	return CHIDB_OK;
+}
+
+
+/* Remove a page from the cache
+ *
+ * Parameters
+ * - cache: A page cache.
+ * - npage: Page number.
+ */
+void chidb_PageCache_remove(PageCache *cache, npage_t npage)
+{
+	CacheEntry *e = chidb_PageCache_find(cache, npage);
+
+	if (e != NULL)
+		chidb_PageCache_drop(cache, e);
+}
+
+
+/* Remove every page from the cache
+ *
+ * The statistics are kept.
+ *
+ * Parameters
+ * - cache: A page cache.
+ */
+void chidb_PageCache_clear(PageCache *cache)
+{
+	for (int i = 0; i < CACHE_NLISTS; i++)
+		while (cache->lists[i].head != NULL)
+			chidb_PageCache_drop(cache, cache->lists[i].head);
+}
+
+
+/* Free a page cache and all the pages in it
+ *
+ * Parameters
+ * - cache: A page cache.
+ */
+void chidb_PageCache_destroy(PageCache *cache)
+{
+	chidb_PageCache_clear(cache);
+	free(cache->hash);
+	free(cache);
+}
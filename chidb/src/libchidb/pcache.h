@@ -0,0 +1,75 @@
+#ifndef PCACHE_H_
+#define PCACHE_H_
+
+#include <chidbInt.h>
+
+/* Page cache of a pager, unless changed with chidb_Pager_setCache */
+#define DEFAULT_CACHE_POLICY (CHIDB_CACHE_2Q)
+#define DEFAULT_CACHE_PAGES (2000)
+
+/* 2Q: maximum size of A1in (pages seen once) and A1out (pages recently
+ * evicted from A1in, of which only the number is kept), as percentages
+ * of the capacity of the cache */
+#define CACHE_2Q_IN_PERCENT (25)
+#define CACHE_2Q_OUT_PERCENT (50)
+
+/* Lists that an entry can be on */
+#define CACHE_LIST_MAIN (0)   /* The LRU list, or Am in 2Q */
+#define CACHE_LIST_IN (1)     /* 2Q: A1in, first in first out */
+#define CACHE_LIST_OUT (2)    /* 2Q: A1out, without the contents of the pages */
+#define CACHE_NLISTS (3)
+
+struct CacheEntry
+{
+	npage_t npage;
+	uint8_t *data;        /* Contents of the page (NULL on A1out) */
+	void *aux;            /* Decoded form of the contents, or NULL (see chidb_PageCache_setAux) */
+	int list;
+	struct CacheEntry *prev;  /* Towards the most recently used end of the list */
+	struct CacheEntry *next;
+	struct CacheEntry *hnext; /* Next entry in the same hash bucket */
+};
+typedef struct CacheEntry CacheEntry;
+
+struct CacheList
+{
+	CacheEntry *head;     /* Most recently inserted or used */
+	CacheEntry *tail;
+	npage_t n;
+};
+typedef struct CacheList CacheList;
+
+struct CacheStats
+{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+};
+typedef struct CacheStats CacheStats;
+
+struct PageCache
+{
+	int policy;           /* CHIDB_CACHE_LRU or CHIDB_CACHE_2Q */
+	uint16_t page_size;
+	npage_t capacity;     /* Maximum number of pages held */
+	npage_t max_in;       /* Maximum size of A1in and A1out (2Q only) */
+	npage_t max_out;
+	CacheEntry **hash;    /* Entries of every list, by page number */
+	uint32_t hash_mask;
+	CacheList lists[CACHE_NLISTS];
+	CacheStats stats;
+};
+typedef struct PageCache PageCache;
+
+int chidb_PageCache_create(PageCache **cache, int policy, npage_t capacity, uint16_t page_size);
+int chidb_PageCache_get(PageCache *cache, npage_t npage, uint8_t *data);
+bool chidb_PageCache_contains(PageCache *cache, npage_t npage);
+int chidb_PageCache_put(PageCache *cache, npage_t npage, const uint8_t *data);
+void chidb_PageCache_update(PageCache *cache, npage_t npage, uint16_t offset, const uint8_t *buf, size_t len);
+void *chidb_PageCache_getAux(PageCache *cache, npage_t npage);
+int chidb_PageCache_setAux(PageCache *cache, npage_t npage, void *aux);
+void chidb_PageCache_remove(PageCache *cache, npage_t npage);
+void chidb_PageCache_clear(PageCache *cache);
+void chidb_PageCache_destroy(PageCache *cache);
+
+#endif /*PCACHE_H_*/
@@ -150,6 +150,30 @@ int chidb_DBRecord_appendInt32(DBRecordBuffer *dbrb, int32_t v)
 	return CHIDB_OK;
 }
 
+/* Append an 8-byte integer to an initialized DBRecordBuffer
+ *
+ * Parameters
+ * - dbrb: Initialized DBRecordBuffer
+ * - v: Value to append
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ */
+int chidb_DBRecord_appendInt64(DBRecordBuffer *dbrb, int64_t v)
+{
+	dbrb->dbr->offsets[dbrb->field] = dbrb->offset;
+	
+	dbrb->dbr->types[dbrb->field] = SQL_INTEGER_8BYTE;
+	if (dbrb->offset + 8 > dbrb->buf_size) { dbrb->buf_size += 1024; dbrb->dbr->data = realloc(dbrb->dbr->data, dbrb->buf_size); }
+	put8byte(&dbrb->dbr->data[dbrb->offset], v);
+	dbrb->offset += 8;
+	dbrb->header_size++;
+	dbrb->field++;
+
+	return CHIDB_OK;
+}
+
 /* Append a NULL value to an initialized DBRecordBuffer
  *
  * Parameters
@@ -186,12 +210,12 @@ int chidb_DBRecord_appendString(DBRecordBuffer *dbrb,  char *v)
 	dbrb->dbr->offsets[dbrb->field] = dbrb->offset;
 
 	len = strlen(v);
-	if (dbrb->offset + len > dbrb->buf_size) { dbrb->buf_size += 1024; dbrb->dbr->data = realloc(dbrb->dbr->data, dbrb->buf_size); }
+	if (dbrb->offset + len > dbrb->buf_size) { dbrb->buf_size = dbrb->offset + len + 1024; dbrb->dbr->data = realloc(dbrb->dbr->data, dbrb->buf_size); }
 	memcpy(&dbrb->dbr->data[dbrb->offset], v, len);
 	dbrb->offset += len;
 	dbrb->dbr->types[dbrb->field] = len * 2 + SQL_TEXT;
 	dbrb->field++;
-	dbrb->header_size += 4;
+	dbrb->header_size += varintLen64(dbrb->dbr->types[dbrb->field - 1]);
 	
 	return CHIDB_OK;
 }
@@ -246,17 +270,7 @@ int chidb_DBRecord_unpack(DBRecord **dbr, uint8_t *raw)
 	(*dbr)->types = malloc(0xFF * sizeof(uint32_t));
 	while(header_pos < header_size)
 	{
-		if (raw[header_pos] & 0x80)
-		{
-			getVarint32(&raw[header_pos], &(*dbr)->types[(*dbr)->nfields]);
-			header_pos += 4;
-		}
-		else
-		{
-			(*dbr)->types[(*dbr)->nfields] = raw[header_pos];
-			header_pos += 1;
-		}
-		
+		header_pos += GETVARINT32(&raw[header_pos], (*dbr)->types[(*dbr)->nfields]);
 		(*dbr)->nfields++;
 	}
 	(*dbr)->types = realloc((*dbr)->types, (*dbr)->nfields * sizeof(uint32_t));
@@ -277,6 +291,8 @@ int chidb_DBRecord_unpack(DBRecord **dbr, uint8_t *raw)
 			offset += 2;
 		else if (type == SQL_INTEGER_4BYTE)
 			offset += 4;
+		else if (type == SQL_INTEGER_8BYTE)
+			offset += 8;
 		else if (type == SQL_TEXT)
 		{
 			int len;
@@ -317,16 +333,7 @@ int chidb_DBRecord_pack(DBRecord *dbr, uint8_t **p)
 	uint8_t header_pos = 1;
 	for(int i=0; i < dbr->nfields; i++)
 	{
-		if (chidb_DBRecord_getType(dbr, i) == SQL_TEXT)
-		{
-			putVarint32(*p + header_pos, dbr->types[i]);
-			header_pos +=4;
-		}
-		else
-		{
-			(*p)[header_pos] = dbr->types[i];
-			header_pos +=1;
-		}
+		header_pos += putVarint32(*p + header_pos, dbr->types[i]);
 	}
 	memcpy(*p + (*p)[0], dbr->data, dbr->data_len);
 	
@@ -342,13 +349,14 @@ int chidb_DBRecord_pack(DBRecord *dbr, uint8_t **p)
  *
  * Return
  * - SQL_NULL, SQL_INTEGER_1BYTE, SQL_INTEGER_2BYTE, SQL_INTEGER_4BYTE,
- *   or SQL_TEXT depending on the field type.
+ *   SQL_INTEGER_8BYTE or SQL_TEXT depending on the field type.
  * - SQL_NOTVALID if the specified field has an invalid field type.
  */
 int chidb_DBRecord_getType(DBRecord *dbr, uint8_t field)
 {
 	if(dbr->types[field] == SQL_NULL || dbr->types[field] == SQL_INTEGER_1BYTE ||
-	   dbr->types[field] == SQL_INTEGER_2BYTE || dbr->types[field] == SQL_INTEGER_4BYTE)
+	   dbr->types[field] == SQL_INTEGER_2BYTE || dbr->types[field] == SQL_INTEGER_4BYTE ||
+	   dbr->types[field] == SQL_INTEGER_8BYTE)
 		return dbr->types[field];
 	else if ((dbr->types[field] - SQL_TEXT) % 2 == 0)
 		return SQL_TEXT;
@@ -411,6 +419,24 @@ int chidb_DBRecord_getInt32(DBRecord *dbr, uint8_t field, int32_t *v)
 }
 
 
+/* Returns the value of an 8-byte integer field
+ *
+ * Parameters
+ * - dbr: The DBRecord
+ * - field: Index of the field
+ * - v: Out parameter used to return the value
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ */
+int chidb_DBRecord_getInt64(DBRecord *dbr, uint8_t field, int64_t *v)
+{
+	*v = get8byte(&dbr->data[dbr->offsets[field]]);
+	
+	return CHIDB_OK;
+}
+
+
 /* Returns the value of a string field
  *
  * Parameters
@@ -486,6 +512,12 @@ int chidb_DBRecord_print(DBRecord *dbr)
 			chidb_DBRecord_getInt32(dbr, i, (int32_t *) &i32);
 			printf("| %i ", i32);
 		}
+		else if (type == SQL_INTEGER_8BYTE)
+		{
+			int64_t i64;
+			chidb_DBRecord_getInt64(dbr, i, &i64);
+			printf("| %lld ", (long long) i64);
+		}
 		else if (type == SQL_TEXT)
 		{
 			char *s;
@@ -514,6 +546,7 @@ int chidb_DBRecord_print(DBRecord *dbr)
  * - i1: A 1-byte integer
  * - i2: A 2-byte integer
  * . i4: A 4-byte integer
+ * - i8: An 8-byte integer
  *
  * For example, "|s|0|i1|i2|i4|".
  *
@@ -545,7 +578,7 @@ int chidb_DBRecord_create(DBRecord **dbr, const char *spec, ...)
     while (*aux)
     {
     	char intsize;
-		char *s; uint8_t i8; uint16_t i16; uint32_t i32;
+		char *s; uint8_t i8; uint16_t i16; uint32_t i32; int64_t i64;
 
     	switch(*aux++)
     	{
@@ -565,6 +598,10 @@ int chidb_DBRecord_create(DBRecord **dbr, const char *spec, ...)
     					i32 = va_arg(args, int);
     					chidb_DBRecord_appendInt32(&dbrb, i32);
     					break;
+    				case '8':
+    					i64 = va_arg(args, int64_t);
+    					chidb_DBRecord_appendInt64(&dbrb, i64);
+    					break;
     			}
 
     			break;
@@ -17,7 +17,7 @@ typedef struct DBRecord DBRecord;
 struct DBRecordBuffer 
 {
 	DBRecord *dbr;
-	uint16_t buf_size;
+	uint32_t buf_size;
     uint8_t field;
     uint32_t offset;
     uint8_t header_size;	
@@ -30,6 +30,7 @@ int chidb_DBRecord_create_empty(DBRecordBuffer *dbrb, uint8_t nfields);
 int chidb_DBRecord_appendInt8(DBRecordBuffer *dbrb, int8_t v);
 int chidb_DBRecord_appendInt16(DBRecordBuffer *dbrb, int16_t v);
 int chidb_DBRecord_appendInt32(DBRecordBuffer *dbrb, int32_t v);
+int chidb_DBRecord_appendInt64(DBRecordBuffer *dbrb, int64_t v);
 int chidb_DBRecord_appendNull(DBRecordBuffer *dbrb);
 int chidb_DBRecord_appendString(DBRecordBuffer *dbrb,  char *v);
 int chidb_DBRecord_finalize(DBRecordBuffer *dbrb, DBRecord **dbr);
@@ -42,6 +43,7 @@ int chidb_DBRecord_getType(DBRecord *dbr, uint8_t field);
 int chidb_DBRecord_getInt8(DBRecord *dbr, uint8_t field, int8_t *v);
 int chidb_DBRecord_getInt16(DBRecord *dbr, uint8_t field, int16_t *v);
 int chidb_DBRecord_getInt32(DBRecord *dbr, uint8_t field, int32_t *v);
+int chidb_DBRecord_getInt64(DBRecord *dbr, uint8_t field, int64_t *v);
 int chidb_DBRecord_getString(DBRecord *dbr, uint8_t field, char **v);
 int chidb_DBRecord_getStringLength(DBRecord *dbr, uint8_t field, int *len);
 
@@ -20,6 +20,10 @@ SQLStatement *__stmt;
 
 %token TK_SELECT TK_FROM TK_WHERE TK_STAR
 %token TK_INSERT TK_INTO TK_VALUES
+%token TK_DELETE TK_UPDATE TK_SET
+%token TK_VACUUM
+%token TK_BEGIN TK_COMMIT TK_END TK_ROLLBACK TK_TRANSACTION
+%token TK_PRAGMA
 %token TK_CREATE TK_TABLE TK_BYTE TK_SMALLINT TK_INTEGER TK_TEXT TK_PRIMARY TK_KEY
 %token TK_INDEX TK_ON
 %token TK_EXPLAIN
@@ -71,6 +75,61 @@ sql_statement:
 	 
 	| 
 	
+	delete_statement TK_SEMICOLON
+	
+	{
+		#ifdef DEBUG
+		TRACE("The parsed DELETE statement is:");
+		chidb_parser_printDelete(__stmt);
+		#endif
+	}
+	 
+	| 
+	
+	update_statement TK_SEMICOLON
+	
+	{
+		#ifdef DEBUG
+		TRACE("The parsed UPDATE statement is:");
+		chidb_parser_printUpdate(__stmt);
+		#endif
+	}
+	 
+	| 
+	
+	vacuum_statement TK_SEMICOLON
+	
+	{
+		#ifdef DEBUG
+		TRACE("The parsed VACUUM statement is:");
+		chidb_parser_printVacuum(__stmt);
+		#endif
+	}
+	 
+	| 
+	
+	transaction_statement TK_SEMICOLON
+	
+	{
+		#ifdef DEBUG
+		TRACE("The parsed transaction statement is:");
+		chidb_parser_printTransaction(__stmt);
+		#endif
+	}
+	 
+	| 
+	
+	pragma_statement TK_SEMICOLON
+	
+	{
+		#ifdef DEBUG
+		TRACE("The parsed PRAGMA statement is:");
+		chidb_parser_printPragma(__stmt);
+		#endif
+	}
+	 
+	| 
+	
 	createtable_statement TK_SEMICOLON
 
 	{
@@ -368,6 +427,182 @@ insert_val:
 	} 
 
 
+/********************/
+/* DELETE statement */
+/********************/
+
+delete_statement: 
+	TK_DELETE TK_FROM 
+	
+	{
+		chidb_parser_initDeleteStmt(__stmt);
+	} 
+	
+	TK_ID 
+	
+	{
+		chidb_parser_setDeleteTable(__stmt, $4);
+	} 
+	
+	where_clause
+	
+	;
+
+
+/********************/
+/* UPDATE statement */
+/********************/
+
+update_statement: 
+	TK_UPDATE 
+	
+	{
+		chidb_parser_initUpdateStmt(__stmt);
+	} 
+	
+	TK_ID 
+	
+	{
+		chidb_parser_setUpdateTable(__stmt, $3);
+	} 
+	
+	TK_SET set_list where_clause
+	
+	;
+
+set_list: 
+	set_val set_list_r;
+
+set_list_r: 
+	TK_COMMA set_val set_list_r 
+	| 
+	/* Empty */
+	;
+
+set_val: 
+	TK_ID TK_EQ TK_INT 
+	
+	{
+		chidb_parser_addUpdateIntValue(__stmt, $1, $3);
+	} 
+
+	| 
+	
+	TK_ID TK_EQ TK_STRING
+	{
+		chidb_parser_addUpdateStrValue(__stmt, $1, $3);
+	} 
+
+	| 
+	
+	TK_ID TK_EQ TK_NULL
+	{
+		chidb_parser_addUpdateNullValue(__stmt, $1);
+	} 
+
+	;
+
+
+/********************/
+/* VACUUM statement */
+/********************/
+
+vacuum_statement: 
+	TK_VACUUM 
+	
+	{
+		chidb_parser_initVacuumStmt(__stmt);
+	} 
+	
+	;
+
+
+/*****************************************/
+/* BEGIN, COMMIT and ROLLBACK statements */
+/*****************************************/
+
+transaction_statement: 
+	TK_BEGIN opt_transaction
+	
+	{
+		chidb_parser_initBeginStmt(__stmt);
+	} 
+	
+	|
+	
+	TK_COMMIT opt_transaction
+	
+	{
+		chidb_parser_initCommitStmt(__stmt);
+	} 
+	
+	|
+	
+	TK_END opt_transaction
+	
+	{
+		chidb_parser_initCommitStmt(__stmt);
+	} 
+	
+	|
+	
+	TK_ROLLBACK opt_transaction
+	
+	{
+		chidb_parser_initRollbackStmt(__stmt);
+	} 
+	
+	;
+
+opt_transaction: 
+	TK_TRANSACTION 
+	
+	|
+	/* Empty */
+	;
+
+
+/********************/
+/* PRAGMA statement */
+/********************/
+
+pragma_statement: 
+	TK_PRAGMA TK_ID 
+	
+	{
+		chidb_parser_initPragmaStmt(__stmt, $2);
+	} 
+	
+	TK_EQ pragma_val
+	
+	;
+
+pragma_val:
+	TK_INT
+	
+	{
+		chidb_parser_setPragmaIntValue(__stmt, $1);
+	} 
+	
+	|
+	
+	TK_ID
+	
+	{
+		chidb_parser_setPragmaStrValue(__stmt, $1);
+	} 
+	
+	|
+	
+	TK_DELETE
+	
+	{
+		chidb_parser_setPragmaStrValue(__stmt, strdup("delete"));
+	} 
+	
+	;
+
+
 /**************************/
 /* CREATE TABLE statement */
 /**************************/
@@ -440,12 +675,35 @@ cr_col:
 
 createindex_statement:
 
-	TK_CREATE TK_INDEX TK_ID TK_ON TK_ID TK_LPAREN TK_ID TK_RPAREN
+	TK_CREATE TK_INDEX TK_ID TK_ON TK_ID
 	
 	{
-		chidb_parser_initCreateIndexStmt(__stmt, $3, $5, $7);
+		chidb_parser_initCreateIndexStmt(__stmt, $3, $5);
 	} 		
 	
+	TK_LPAREN idx_collist TK_RPAREN
+	
+	;
+
+
+idx_collist: 
+	idx_col idx_collist_r;
+
+idx_collist_r: 
+	TK_COMMA idx_col idx_collist_r 
+	| 
+	/* Empty */
+	;
+
+idx_col: 
+	TK_ID 
+	
+	{
+		chidb_parser_addCreateIndexColumn(__stmt, $1);
+	}
+	
+	;
+	
 
 
 %%
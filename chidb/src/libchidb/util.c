@@ -20,33 +20,133 @@ void put4byte(unsigned char *p, uint32_t v){
   p[3] = (uint8_t)v;
 }
 
+/*
+** Read or write an eight-byte big-endian integer value.
+*/
+uint64_t get8byte(const uint8_t *p){
+  return ((uint64_t) get4byte(p) << 32) | get4byte(p + 4);
+}
+
+void put8byte(unsigned char *p, uint64_t v){
+  put4byte(p, (uint32_t)(v>>32));
+  put4byte(p + 4, (uint32_t)v);
+}
+
+/*
+** Read or write a varint, in the SQLite format: seven bits per byte,
+** most significant first, with the high bit set on every byte but the
+** last. A ninth byte, if there is one, holds eight bits, so that no
+** varint is longer than VARINT_MAXSIZE bytes. All of these return the
+** number of bytes read or written.
+**
+** Varints are written with as few bytes as possible, but leading 0x80
+** bytes are valid (they add nothing to the value), so the varints of
+** files written when they always took four bytes are read correctly.
+**
+** Most varints in a file (the types in record headers, and the sizes
+** and keys of small tables) take one or two bytes, so those are decoded
+** before falling back to the general loop. GETVARINT32 in util.h also
+** saves the function call for one-byte varints.
+*/
 int getVarint32(const uint8_t *p, uint32_t *v)
 {
-	*v = 0;
-	
-	*v  = ((uint32_t) (p[3] & 0x7F));
-	*v |= ((uint32_t) (p[2] & 0x7F)) << 7;
-	*v |= ((uint32_t) (p[1] & 0x7F)) << 14;
-	*v |= ((uint32_t) (p[0] & 0x7F)) << 21;
-	
-	return CHIDB_OK;
+	uint64_t x;
+	int n;
+
+	if(!(p[0] & 0x80))
+	{
+		*v = p[0];
+		return 1;
+	}
+	if(!(p[1] & 0x80))
+	{
+		*v = ((uint32_t)(p[0] & 0x7F) << 7) | p[1];
+		return 2;
+	}
+	n = getVarint64(p, &x);
+	*v = (uint32_t)x;
+
+	return n;
 }
 
 int putVarint32(uint8_t *p, uint32_t v)
 {
-	uint32_t aux;
-	
-	aux = v & 0x0000007F;
-	aux |= ((v & 0x00003F80) << 1) | 0x00008000;
-	aux |= ((v & 0x001FC000) << 2) | 0x00800000;
-	aux |= ((v & 0x0FE00000) << 3) | 0x80000000;
-	
-	p[3] = (uint8_t)(aux);
-  	p[2] = (uint8_t)(aux>>8);
-  	p[1] = (uint8_t)(aux>>16);
-  	p[0] = (uint8_t)(aux>>24);
-	
-	return CHIDB_OK;
+	if(v < 0x80)
+	{
+		p[0] = (uint8_t)v;
+		return 1;
+	}
+	if(v < 0x4000)
+	{
+		p[0] = (uint8_t)(v >> 7) | 0x80;
+		p[1] = (uint8_t)(v & 0x7F);
+		return 2;
+	}
+
+	return putVarint64(p, v);
+}
+
+int getVarint64(const uint8_t *p, uint64_t *v)
+{
+	uint64_t x;
+
+	if(!(p[0] & 0x80))
+	{
+		*v = p[0];
+		return 1;
+	}
+	if(!(p[1] & 0x80))
+	{
+		*v = ((uint64_t)(p[0] & 0x7F) << 7) | p[1];
+		return 2;
+	}
+
+	x = ((uint64_t)(p[0] & 0x7F) << 7) | (p[1] & 0x7F);
+	for(int i = 2; i < VARINT_MAXSIZE - 1; i++)
+	{
+		x = (x << 7) | (p[i] & 0x7F);
+		if(!(p[i] & 0x80))
+		{
+			*v = x;
+			return i + 1;
+		}
+	}
+	*v = (x << 8) | p[VARINT_MAXSIZE - 1];
+
+	return VARINT_MAXSIZE;
+}
+
+int putVarint64(uint8_t *p, uint64_t v)
+{
+	int n = varintLen64(v);
+
+	if(n == VARINT_MAXSIZE)
+	{
+		p[VARINT_MAXSIZE - 1] = (uint8_t)v;
+		v >>= 8;
+	}
+	for(int i = (n == VARINT_MAXSIZE) ? n - 2 : n - 1; i >= 0; i--)
+	{
+		p[i] = (uint8_t)(v & 0x7F) | 0x80;
+		v >>= 7;
+	}
+	if(n < VARINT_MAXSIZE)
+		p[n - 1] &= 0x7F;
+
+	return n;
+}
+
+/* Number of bytes that putVarint64 (or putVarint32) takes to write v */
+int varintLen64(uint64_t v)
+{
+	int n = 1;
+
+	if(v >> 56)
+		return VARINT_MAXSIZE;
+	while(v >>= 7)
+		n++;
+
+	return n;
 }
 
 
@@ -56,7 +156,7 @@ void chidb_BTree_recordPrinter(BTreeNode *btn, BTreeCell *btc)
 	
 	chidb_DBRecord_unpack(&dbr, btc->fields.tableLeaf.data);
 	
-	printf("< %5i >", btc->key);
+	printf("< %5llu >", (unsigned long long) btc->key);
 	chidb_DBRecord_print(dbr);
 	printf("\n");
 	 
@@ -65,7 +165,7 @@ void chidb_BTree_recordPrinter(BTreeNode *btn, BTreeCell *btc)
 
 void chidb_BTree_stringPrinter(BTreeNode *btn, BTreeCell *btc)
 {
-	printf("%5i -> %10s\n", btc->key, btc->fields.tableLeaf.data);
+	printf("%5llu -> %10s\n", (unsigned long long) btc->key, btc->fields.tableLeaf.data);
 }
 
 int chidb_astrcat(char **dst, char *src)
@@ -110,11 +210,11 @@ int chidb_Btree_print(BTree *bt, npage_t npage, fBTreeCellPrinter printer, bool
 			
 			last_key = btc.key;
 			if(verbose)
-				printf("Printing Keys <= %i\n", last_key);
+				printf("Printing Keys <= %llu\n", (unsigned long long) last_key);
 			chidb_Btree_print(bt, btc.fields.tableInternal.child_page, printer, verbose);
 		}
 		if(verbose)
-			printf("Printing Keys > %i\n", last_key);
+			printf("Printing Keys > %llu\n", (unsigned long long) last_key);
 		chidb_Btree_print(bt, btn->right_page, printer, verbose);
 	}
 	else if (btn->type == PGTYPE_INDEX_LEAF)
@@ -126,7 +226,7 @@ int chidb_Btree_print(BTree *bt, npage_t npage, fBTreeCellPrinter printer, bool
 			BTreeCell btc;
 			
 			chidb_Btree_getCell(btn, i, &btc);
-			printf("%10i -> %10i\n", btc.key, btc.fields.indexLeaf.keyPk);			
+			printf("%10llu -> %10llu\n", (unsigned long long) btc.key, (unsigned long long) btc.fields.indexLeaf.keyPk);			
 		}
 	}
 	else if (btn->type == PGTYPE_INDEX_INTERNAL)
@@ -142,12 +242,12 @@ int chidb_Btree_print(BTree *bt, npage_t npage, fBTreeCellPrinter printer, bool
 			chidb_Btree_getCell(btn, i, &btc);
 			last_key = btc.key;
 			if(verbose)
-				printf("Printing Keys < %i\n", last_key);
+				printf("Printing Keys < %llu\n", (unsigned long long) last_key);
 			chidb_Btree_print(bt, btc.fields.indexInternal.child_page, printer, verbose);
-			printf("%10i -> %10i\n", btc.key, btc.fields.indexInternal.keyPk);		
+			printf("%10llu -> %10llu\n", (unsigned long long) btc.key, (unsigned long long) btc.fields.indexInternal.keyPk);		
 		}
 		if(verbose)	
-			printf("Printing Keys > %i\n", last_key);
+			printf("Printing Keys > %llu\n", (unsigned long long) last_key);
 		chidb_Btree_print(bt, btn->right_page, printer, verbose);
 	}
 	
@@ -12,10 +12,22 @@
 /* Return the distance in bytes between the pointers elm and hd */
 #define OFFSET(hd, elm) ((uint8_t *)(&(elm))-(uint8_t *)(&hd))
 
+/* Varints (see util.c) take at most this many bytes */
+#define VARINT_MAXSIZE (9)
+
+/* Read a varint into the uint32_t lvalue v, without a function call if
+ * it takes one byte. Evaluates to the number of bytes read. */
+#define GETVARINT32(p, v) ((*(p) < 0x80) ? ((v) = *(p), 1) : getVarint32((p), &(v)))
+
 uint32_t get4byte(const uint8_t *p);
 void put4byte(unsigned char *p, uint32_t v);
+uint64_t get8byte(const uint8_t *p);
+void put8byte(unsigned char *p, uint64_t v);
 int getVarint32(const uint8_t *p, uint32_t *v);
 int putVarint32(uint8_t *p, uint32_t v);
+int getVarint64(const uint8_t *p, uint64_t *v);
+int putVarint64(uint8_t *p, uint64_t v);
+int varintLen64(uint64_t v);
 
 int chidb_astrcat(char **dst, char *src);
 
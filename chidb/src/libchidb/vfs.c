@@ -0,0 +1,2132 @@
+/*****************************************************************************
+ *
+ *																 chidb
+ *
+ * This module contains the virtual file system (VFS) layer that the pager
+ * and the WAL use to access their files.
+ *
+ * A VFS opens and removes files, and an open file (a VfsFile) is read
+ * and written at explicit offsets, so that there is no file position to
+ * keep track of and no buffering between chidb and the operating system.
+ * The operations on a file go through a table of methods, so the pager
+ * does not need to know where the file lives.
+ *
+ * VFSs are registered by name, and the first one registered (or the last
+ * one registered with make_default) is used when no name is given. The
+ * default VFS, "posix", is built on pread/pwrite, fsync, ftruncate and
+ * flock.
+ *
+ * The "memory" VFS keeps files in RAM, and is used for in-memory
+ * databases (see chidb_Pager_open). The contents of a file are an array
+ * of fixed-size chunks, each allocated the first time it is written, so
+ * growing a file never copies it. A file only lives for as long as it is
+ * open: it is deleted when its last VfsFile is closed.
+ *
+ * The "uring" VFS is the POSIX VFS with batches of reads and writes (see
+ * chidb_Vfs_readBatch) submitted together through io_uring, so that the
+ * device can work on all of them at once instead of one at a time. It
+ * talks to the kernel directly, without liburing. Whether io_uring can
+ * be used is checked the first time a file is opened; if it cannot (an
+ * old kernel, or a sandbox that forbids it), batches fall back to one
+ * pread or pwrite per request.
+ *
+ * The "direct" VFS is the POSIX VFS with the main database file opened
+ * with O_DIRECT, so that its pages are not cached a second time by the
+ * operating system. Direct I/O needs the buffer, the offset and the
+ * length to be aligned to the block size of the device (which is asked
+ * from the kernel with statx). Aligned requests, such as whole pages
+ * read into buffers from the pager (see chidb_Pager_readPage), go
+ * straight to the device. Anything else (the file header, the
+ * freelist fields, or pages smaller than a block) goes through an
+ * aligned bounce buffer padded to whole blocks, and writes to it
+ * read the blocks first. On a file system without direct I/O, the file
+ * is opened as with the POSIX VFS. Journals and WALs are always opened
+ * as with the POSIX VFS, since their records are not aligned.
+ *
+ * The "compress" VFS keeps the main database file compressed, which
+ * suits large tables that are seldom written, such as archives of text:
+ * the file takes less space, and scanning it reads fewer bytes. The file
+ * is cut into blocks of COMPRESS_BLOCK_SIZE bytes (a page), and each block
+ * is compressed (see lz.c) into a record of its own, with the number of
+ * the block, a sequence number and a checksum. Since records vary in
+ * size, a block cannot be found from its offset, so the VFS keeps a map
+ * from blocks to records, which it builds by scanning the file for
+ * records. Writing a block appends a new record (or puts it in the first
+ * free space that is large enough), and the newest record of a block is
+ * the one that counts. The space of the old record is only reused after
+ * the next sync, so a crash always leaves a complete copy of every block
+ * that was synced. Journals and WALs are stored as with the POSIX VFS.
+ *
+\*****************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#include <chidbInt.h>
+
+#include "vfs.h"
+#include "util.h"
+#include "checksum.h"
+#include "lz.h"
+
+
+/* A file opened with the POSIX VFS */
+struct PosixFile
+{
+	VfsFile base;
+	int fd;
+};
+typedef struct PosixFile PosixFile;
+
+
+static int chidb_Vfs_posixClose(VfsFile *file)
+{
+	int rc = close(((PosixFile *) file)->fd);
+
+	free(file);
+
+	return rc == 0 ? CHIDB_OK : CHIDB_EIO;
+}
+
+
+static int chidb_Vfs_posixRead(VfsFile *file, void *buf, size_t len, uint64_t offset)
+{
+	int fd = ((PosixFile *) file)->fd;
+	uint8_t *p = buf;
+
+	while (len > 0)
+	{
+		ssize_t n = pread(fd, p, len, (off_t) offset);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return CHIDB_EIO;
+		if (n == 0)
+		{
+			/* Past the end of the file */
+			memset(p, 0, len);
+			return CHIDB_ESHORTREAD;
+		}
+		p += n;
+		len -= n;
+		offset += n;
+	}
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_posixWrite(VfsFile *file, const void *buf, size_t len, uint64_t offset)
+{
+	int fd = ((PosixFile *) file)->fd;
+	const uint8_t *p = buf;
+
+	while (len > 0)
+	{
+		ssize_t n = pwrite(fd, p, len, (off_t) offset);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return CHIDB_EIO;
+		p += n;
+		len -= n;
+		offset += n;
+	}
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_posixSync(VfsFile *file)
+{
+	return fsync(((PosixFile *) file)->fd) == 0 ? CHIDB_OK : CHIDB_EIO;
+}
+
+
+static int chidb_Vfs_posixTruncate(VfsFile *file, uint64_t size)
+{
+	return ftruncate(((PosixFile *) file)->fd, (off_t) size) == 0 ? CHIDB_OK : CHIDB_EIO;
+}
+
+
+static int chidb_Vfs_posixSize(VfsFile *file, uint64_t *size)
+{
+	struct stat st;
+
+	if (fstat(((PosixFile *) file)->fd, &st) != 0)
+		return CHIDB_EIO;
+	*size = st.st_size;
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_posixLock(VfsFile *file, int level, bool wait)
+{
+	int op = (level == VFS_LOCK_EXCLUSIVE) ? LOCK_EX : (level == VFS_LOCK_SHARED) ? LOCK_SH : LOCK_UN;
+
+	if (!wait)
+		op |= LOCK_NB;
+	while (flock(((PosixFile *) file)->fd, op) != 0)
+	{
+		if (errno == EWOULDBLOCK)
+			return CHIDB_EBUSY;
+		if (errno != EINTR)
+			return CHIDB_EIO;
+	}
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_posixId(VfsFile *file, uint64_t id[2])
+{
+	struct stat st;
+
+	if (fstat(((PosixFile *) file)->fd, &st) != 0)
+		return CHIDB_EIO;
+	id[0] = st.st_dev;
+	id[1] = st.st_ino;
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_posixPrefetch(VfsFile *file, uint64_t offset, uint64_t len)
+{
+	/* Only a hint: the kernel starts reading without waiting */
+	if (posix_fadvise(((PosixFile *) file)->fd, (off_t) offset, (off_t) len, POSIX_FADV_WILLNEED) != 0)
+		return CHIDB_EIO;
+
+	return CHIDB_OK;
+}
+
+
+static const VfsMethods posix_methods =
+{
+	chidb_Vfs_posixClose,
+	chidb_Vfs_posixRead,
+	chidb_Vfs_posixWrite,
+	chidb_Vfs_posixSync,
+	chidb_Vfs_posixTruncate,
+	chidb_Vfs_posixSize,
+	chidb_Vfs_posixLock,
+	chidb_Vfs_posixId,
+	NULL,
+	NULL,
+	chidb_Vfs_posixPrefetch
+};
+
+
+/* Open a file with open(2), in a structure of the given size that
+ * starts with a PosixFile */
+static int chidb_Vfs_posixOpenFile(Vfs *vfs, const char *path, int flags, size_t size,
+                                   const VfsMethods *methods, PosixFile **file)
+{
+	PosixFile *pf;
+	int fd;
+
+	do
+		fd = open(path, O_RDWR | ((flags & VFS_OPEN_CREATE) ? O_CREAT : 0), 0644);
+	while (fd < 0 && errno == EINTR);
+	if (fd < 0)
+		return (errno == ENOENT) ? CHIDB_ENOTFOUND : CHIDB_EIO;
+
+	pf = calloc(1, size);
+	if (pf == NULL)
+	{
+		close(fd);
+		return CHIDB_ENOMEM;
+	}
+	pf->base.methods = methods;
+	pf->base.vfs = vfs;
+	pf->fd = fd;
+	*file = pf;
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_posixOpen(Vfs *vfs, const char *path, int flags, VfsFile **file)
+{
+	PosixFile *pf;
+	int rc = chidb_Vfs_posixOpenFile(vfs, path, flags, sizeof(PosixFile), &posix_methods, &pf);
+
+	if (rc == CHIDB_OK)
+		*file = &pf->base;
+
+	return rc;
+}
+
+
+static int chidb_Vfs_posixRemove(Vfs *vfs, const char *path)
+{
+	if (unlink(path) == 0)
+		return CHIDB_OK;
+
+	return (errno == ENOENT) ? CHIDB_ENOTFOUND : CHIDB_EIO;
+}
+
+
+static int chidb_Vfs_posixRename(Vfs *vfs, const char *from, const char *to)
+{
+	if (rename(from, to) == 0)
+		return CHIDB_OK;
+
+	return (errno == ENOENT) ? CHIDB_ENOTFOUND : CHIDB_EIO;
+}
+
+
+#ifdef HAVE_IO_URING
+
+/* An io_uring instance: the submission and completion queues shared
+ * with the kernel */
+struct Uring
+{
+	int fd;
+	unsigned entries;       /* Size of the submission queue */
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+	void *sq_ptr;           /* Memory mapped from the kernel */
+	size_t sq_len;
+	void *cq_ptr;
+	size_t cq_len;
+	size_t sqes_len;
+};
+typedef struct Uring Uring;
+
+/* Whether io_uring works here: 0 until checked, 1 if it does, -1 if not */
+static int uring_state = 0;
+
+
+static void chidb_Vfs_uringTeardown(Uring *ring)
+{
+	munmap(ring->sqes, ring->sqes_len);
+	if (ring->cq_ptr != ring->sq_ptr)
+		munmap(ring->cq_ptr, ring->cq_len);
+	munmap(ring->sq_ptr, ring->sq_len);
+	close(ring->fd);
+	free(ring);
+}
+
+
+static Uring *chidb_Vfs_uringSetup(unsigned entries)
+{
+	struct io_uring_params p;
+	Uring *ring;
+
+	ring = calloc(1, sizeof(Uring));
+	if (ring == NULL)
+		return NULL;
+	memset(&p, 0, sizeof(p));
+	ring->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd < 0)
+	{
+		free(ring);
+		return NULL;
+	}
+
+	ring->entries = p.sq_entries;
+	ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if ((p.features & IORING_FEAT_SINGLE_MMAP) && ring->cq_len > ring->sq_len)
+		ring->sq_len = ring->cq_len;
+	ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ptr == MAP_FAILED)
+	{
+		close(ring->fd);
+		free(ring);
+		return NULL;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		ring->cq_ptr = ring->sq_ptr;
+		ring->cq_len = ring->sq_len;
+	}
+	else
+	{
+		ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ptr == MAP_FAILED)
+		{
+			munmap(ring->sq_ptr, ring->sq_len);
+			close(ring->fd);
+			free(ring);
+			return NULL;
+		}
+	}
+	ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+	{
+		if (ring->cq_ptr != ring->sq_ptr)
+			munmap(ring->cq_ptr, ring->cq_len);
+		munmap(ring->sq_ptr, ring->sq_len);
+		close(ring->fd);
+		free(ring);
+		return NULL;
+	}
+
+	ring->sq_tail = (unsigned *) ((uint8_t *) ring->sq_ptr + p.sq_off.tail);
+	ring->sq_mask = (unsigned *) ((uint8_t *) ring->sq_ptr + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *) ((uint8_t *) ring->sq_ptr + p.sq_off.array);
+	ring->cq_head = (unsigned *) ((uint8_t *) ring->cq_ptr + p.cq_off.head);
+	ring->cq_tail = (unsigned *) ((uint8_t *) ring->cq_ptr + p.cq_off.tail);
+	ring->cq_mask = (unsigned *) ((uint8_t *) ring->cq_ptr + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) ((uint8_t *) ring->cq_ptr + p.cq_off.cqes);
+
+	return ring;
+}
+
+#endif /* HAVE_IO_URING */
+
+
+/* A file opened with the uring VFS */
+struct UringFile
+{
+	PosixFile posix;
+#ifdef HAVE_IO_URING
+	Uring *ring;            /* NULL if io_uring cannot be used */
+	pthread_mutex_t mutex;  /* Only one batch at a time uses the ring */
+#endif
+};
+typedef struct UringFile UringFile;
+
+
+static int chidb_Vfs_uringClose(VfsFile *file)
+{
+#ifdef HAVE_IO_URING
+	UringFile *uf = (UringFile *) file;
+
+	if (uf->ring != NULL)
+		chidb_Vfs_uringTeardown(uf->ring);
+	pthread_mutex_destroy(&uf->mutex);
+#endif
+
+	return chidb_Vfs_posixClose(file);
+}
+
+
+/* Carry out a batch of requests one at a time */
+static int chidb_Vfs_batchFallback(VfsFile *file, VfsIo *ios, int n, bool write)
+{
+	int rc = CHIDB_OK;
+
+	for (int i = 0; i < n; i++)
+	{
+		int rc2 = write ? file->methods->write(file, ios[i].buf, ios[i].len, ios[i].offset)
+		                : file->methods->read(file, ios[i].buf, ios[i].len, ios[i].offset);
+		if (rc2 != CHIDB_OK && rc2 != CHIDB_ESHORTREAD)
+			return rc2;
+		if (rc2 == CHIDB_ESHORTREAD)
+			rc = rc2;
+	}
+
+	return rc;
+}
+
+
+#ifdef HAVE_IO_URING
+
+/* Finish a request that the kernel only carried out in part (or that
+ * was interrupted) with pread/pwrite */
+static int chidb_Vfs_uringFinish(VfsFile *file, VfsIo *io, size_t done, bool write)
+{
+	uint8_t *buf = (uint8_t *) io->buf + done;
+
+	if (write)
+		return chidb_Vfs_posixWrite(file, buf, io->len - done, io->offset + done);
+	else
+		return chidb_Vfs_posixRead(file, buf, io->len - done, io->offset + done);
+}
+
+
+/* Submit a batch of requests through io_uring and wait for all of them
+ *
+ * The requests are submitted URING_ENTRIES at a time. If io_uring_enter
+ * fails, the ring is not used again for this file, and the requests
+ * are carried out with pread/pwrite instead (repeating a read or a
+ * write is harmless).
+ */
+static int chidb_Vfs_uringBatch(VfsFile *file, VfsIo *ios, int n, bool write)
+{
+	UringFile *uf = (UringFile *) file;
+	struct iovec *iov;
+	int rc = CHIDB_OK;
+
+	pthread_mutex_lock(&uf->mutex);
+	if (uf->ring == NULL || n == 1)
+	{
+		pthread_mutex_unlock(&uf->mutex);
+		return chidb_Vfs_batchFallback(file, ios, n, write);
+	}
+
+	Uring *ring = uf->ring;
+	iov = malloc(n * sizeof(struct iovec));
+	if (iov == NULL)
+	{
+		pthread_mutex_unlock(&uf->mutex);
+		return CHIDB_ENOMEM;
+	}
+
+	for (int first = 0; first < n; first += ring->entries)
+	{
+		unsigned count = (n - first < (int) ring->entries) ? n - first : ring->entries;
+		unsigned tail = *ring->sq_tail;
+		unsigned submitted = 0, reaped = 0;
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			unsigned idx = (tail + i) & *ring->sq_mask;
+			struct io_uring_sqe *sqe = &ring->sqes[idx];
+			VfsIo *io = &ios[first + i];
+
+			iov[first + i].iov_base = io->buf;
+			iov[first + i].iov_len = io->len;
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+			sqe->fd = uf->posix.fd;
+			sqe->addr = (uint64_t) (uintptr_t) &iov[first + i];
+			sqe->len = 1;
+			sqe->off = io->offset;
+			sqe->user_data = first + i;
+			ring->sq_array[idx] = idx;
+		}
+		__atomic_store_n(ring->sq_tail, tail + count, __ATOMIC_RELEASE);
+
+		while (reaped < count)
+		{
+			int ret = syscall(__NR_io_uring_enter, ring->fd, count - submitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret < 0)
+			{
+				/* Give up on io_uring for this file */
+				chidb_Vfs_uringTeardown(ring);
+				uf->ring = NULL;
+				free(iov);
+				pthread_mutex_unlock(&uf->mutex);
+				return chidb_Vfs_batchFallback(file, ios, n, write);
+			}
+			submitted += ret;
+
+			unsigned head = *ring->cq_head;
+			unsigned ctail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+			for (; head != ctail; head++, reaped++)
+			{
+				struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+				VfsIo *io = &ios[cqe->user_data];
+				int rc2 = CHIDB_OK;
+
+				if (cqe->res == -EINTR || cqe->res == -EAGAIN)
+					rc2 = chidb_Vfs_uringFinish(file, io, 0, write);
+				else if (cqe->res < 0)
+					rc2 = CHIDB_EIO;
+				else if ((size_t) cqe->res < io->len)
+					rc2 = chidb_Vfs_uringFinish(file, io, cqe->res, write);
+				if (rc2 == CHIDB_ESHORTREAD && rc == CHIDB_OK)
+					rc = rc2;
+				else if (rc2 != CHIDB_OK && rc2 != CHIDB_ESHORTREAD)
+					rc = rc2;
+			}
+			__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+		}
+	}
+	free(iov);
+	pthread_mutex_unlock(&uf->mutex);
+
+	return rc;
+}
+
+
+static int chidb_Vfs_uringReadBatch(VfsFile *file, VfsIo *ios, int n)
+{
+	return chidb_Vfs_uringBatch(file, ios, n, false);
+}
+
+
+static int chidb_Vfs_uringWriteBatch(VfsFile *file, VfsIo *ios, int n)
+{
+	return chidb_Vfs_uringBatch(file, ios, n, true);
+}
+
+#endif /* HAVE_IO_URING */
+
+
+static const VfsMethods uring_methods =
+{
+	chidb_Vfs_uringClose,
+	chidb_Vfs_posixRead,
+	chidb_Vfs_posixWrite,
+	chidb_Vfs_posixSync,
+	chidb_Vfs_posixTruncate,
+	chidb_Vfs_posixSize,
+	chidb_Vfs_posixLock,
+	chidb_Vfs_posixId,
+#ifdef HAVE_IO_URING
+	chidb_Vfs_uringReadBatch,
+	chidb_Vfs_uringWriteBatch,
+#else
+	NULL,
+	NULL,
+#endif
+	chidb_Vfs_posixPrefetch
+};
+
+
+static int chidb_Vfs_uringOpen(Vfs *vfs, const char *path, int flags, VfsFile **file)
+{
+	PosixFile *pf;
+	int rc = chidb_Vfs_posixOpenFile(vfs, path, flags, sizeof(UringFile), &uring_methods, &pf);
+
+	if (rc != CHIDB_OK)
+		return rc;
+#ifdef HAVE_IO_URING
+	UringFile *uf = (UringFile *) pf;
+	pthread_mutex_init(&uf->mutex, NULL);
+	if (uring_state >= 0)
+	{
+		uf->ring = chidb_Vfs_uringSetup(URING_ENTRIES);
+		uring_state = (uf->ring != NULL) ? 1 : -1;
+	}
+#endif
+	*file = &pf->base;
+
+	return CHIDB_OK;
+}
+
+
+/* A file opened with the direct VFS */
+struct DirectFile
+{
+	PosixFile posix;
+	size_t mem_align;       /* Alignment of buffers (0 without O_DIRECT) */
+	size_t offset_align;    /* Alignment of offsets and lengths */
+};
+typedef struct DirectFile DirectFile;
+
+
+/* pread until len bytes have been read or the end of the file. With
+ * O_DIRECT, a short read can only happen at the end of the file, and
+ * reading on from there would not be aligned. */
+static int chidb_Vfs_directPread(int fd, uint8_t *buf, size_t len, uint64_t offset, size_t *got)
+{
+	ssize_t n;
+
+	do
+		n = pread(fd, buf, len, (off_t) offset);
+	while (n < 0 && errno == EINTR);
+	if (n < 0)
+		return CHIDB_EIO;
+	memset(buf + n, 0, len - n);
+	*got = n;
+
+	return CHIDB_OK;
+}
+
+
+static bool chidb_Vfs_directAligned(DirectFile *df, const void *buf, size_t len, uint64_t offset)
+{
+	return (uintptr_t) buf % df->mem_align == 0 && offset % df->offset_align == 0 && len % df->offset_align == 0;
+}
+
+
+static int chidb_Vfs_directRead(VfsFile *file, void *buf, size_t len, uint64_t offset)
+{
+	DirectFile *df = (DirectFile *) file;
+	uint8_t *bounce;
+	size_t got;
+	int rc;
+
+	if (df->mem_align == 0)
+		return chidb_Vfs_posixRead(file, buf, len, offset);
+
+	if (chidb_Vfs_directAligned(df, buf, len, offset))
+	{
+		rc = chidb_Vfs_directPread(df->posix.fd, buf, len, offset, &got);
+		return (rc == CHIDB_OK && got < len) ? CHIDB_ESHORTREAD : rc;
+	}
+
+	uint64_t start = offset - offset % df->offset_align;
+	uint64_t end = (offset + len + df->offset_align - 1) / df->offset_align * df->offset_align;
+	if (posix_memalign((void **) &bounce, df->mem_align, end - start) != 0)
+		return CHIDB_ENOMEM;
+	rc = chidb_Vfs_directPread(df->posix.fd, bounce, end - start, start, &got);
+	memcpy(buf, bounce + (offset - start), len);
+	free(bounce);
+
+	return (rc == CHIDB_OK && start + got < offset + len) ? CHIDB_ESHORTREAD : rc;
+}
+
+
+static int chidb_Vfs_directWrite(VfsFile *file, const void *buf, size_t len, uint64_t offset)
+{
+	DirectFile *df = (DirectFile *) file;
+	uint8_t *bounce;
+	uint64_t size;
+	size_t got;
+	ssize_t n;
+	int rc;
+
+	if (df->mem_align == 0 || chidb_Vfs_directAligned(df, buf, len, offset))
+		return chidb_Vfs_posixWrite(file, buf, len, offset);
+
+	/* Whole blocks are read, patched and written back. Past the end of
+	 * the file, the padding is cut off again afterwards. */
+	uint64_t start = offset - offset % df->offset_align;
+	uint64_t end = (offset + len + df->offset_align - 1) / df->offset_align * df->offset_align;
+	if (chidb_Vfs_posixSize(file, &size) != CHIDB_OK)
+		return CHIDB_EIO;
+	if (posix_memalign((void **) &bounce, df->mem_align, end - start) != 0)
+		return CHIDB_ENOMEM;
+	rc = chidb_Vfs_directPread(df->posix.fd, bounce, end - start, start, &got);
+	if (rc == CHIDB_OK)
+	{
+		memcpy(bounce + (offset - start), buf, len);
+		do
+			n = pwrite(df->posix.fd, bounce, end - start, (off_t) start);
+		while (n < 0 && errno == EINTR);
+		if (n != (ssize_t) (end - start))
+			rc = CHIDB_EIO;
+	}
+	free(bounce);
+	if (rc == CHIDB_OK && end > size && ftruncate(df->posix.fd, (off_t) (offset + len > size ? offset + len : size)) != 0)
+		rc = CHIDB_EIO;
+
+	return rc;
+}
+
+
+static const VfsMethods direct_methods =
+{
+	chidb_Vfs_posixClose,
+	chidb_Vfs_directRead,
+	chidb_Vfs_directWrite,
+	chidb_Vfs_posixSync,
+	chidb_Vfs_posixTruncate,
+	chidb_Vfs_posixSize,
+	chidb_Vfs_posixLock,
+	chidb_Vfs_posixId,
+	NULL,
+	NULL,
+	NULL
+};
+
+
+static int chidb_Vfs_directOpen(Vfs *vfs, const char *path, int flags, VfsFile **file)
+{
+	PosixFile *pf;
+	size_t mem_align = 0, offset_align = 0;
+	int rc = chidb_Vfs_posixOpenFile(vfs, path, flags, sizeof(DirectFile), &direct_methods, &pf);
+
+	if (rc != CHIDB_OK)
+		return rc;
+	if (flags & VFS_OPEN_MAIN)
+	{
+#ifdef STATX_DIOALIGN
+		/* Alignments of 0 mean that the file system has no direct I/O */
+		struct statx stx;
+		if (statx(pf->fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 && (stx.stx_mask & STATX_DIOALIGN))
+		{
+			mem_align = stx.stx_dio_mem_align;
+			offset_align = stx.stx_dio_offset_align;
+		}
+#else
+		struct stat st;
+		if (fstat(pf->fd, &st) == 0)
+			mem_align = offset_align = st.st_blksize;
+#endif
+		int fl = fcntl(pf->fd, F_GETFL);
+		if (mem_align == 0 || offset_align == 0 || fl < 0 || fcntl(pf->fd, F_SETFL, fl | O_DIRECT) != 0)
+			mem_align = offset_align = 0;
+	}
+	((DirectFile *) pf)->mem_align = mem_align;
+	((DirectFile *) pf)->offset_align = offset_align;
+	*file = &pf->base;
+
+	return CHIDB_OK;
+}
+
+
+/* A part of a compressed file: a record, or free space */
+struct CompressExtent
+{
+	uint64_t offset;
+	uint64_t len;           /* 0 for a block without a record */
+};
+typedef struct CompressExtent CompressExtent;
+
+/* A database file opened with the compress VFS */
+struct CompressFile
+{
+	PosixFile posix;
+	uint32_t block_size;
+	uint64_t size;          /* Size of the file as seen by the pager */
+	uint64_t end;           /* End of the last record that is in use */
+	uint64_t seq;           /* Sequence number of the next record */
+	uint64_t generation;    /* Number of syncs after writes, as in the header */
+	bool written;           /* Records were written since the last sync */
+	int lock;
+	CompressExtent *blocks; /* Record of each block */
+	uint32_t nblocks;
+	CompressExtent size_rec; /* The newest record, if it only holds the size */
+	CompressExtent *free;   /* Free space, by offset */
+	int nfree;
+	CompressExtent *pending; /* Records that are no longer used, which can
+	                          * only be overwritten once the records that
+	                          * replaced them have been synced */
+	int npending;
+	uint8_t *block;         /* Buffer for a block */
+	uint8_t *record;        /* Buffer for a record */
+};
+typedef struct CompressFile CompressFile;
+
+
+static uint64_t chidb_Vfs_compressFootprint(uint64_t plen)
+{
+	return (COMPRESS_RECORD_HEADER_SIZE + plen + COMPRESS_ALIGN - 1) / COMPRESS_ALIGN * COMPRESS_ALIGN;
+}
+
+
+static int chidb_Vfs_compressExtentCmp(const void *a, const void *b)
+{
+	uint64_t x = ((const CompressExtent *) a)->offset, y = ((const CompressExtent *) b)->offset;
+
+	return (x > y) - (x < y);
+}
+
+
+/* Append an extent to an array that grows as needed */
+static int chidb_Vfs_compressAddExtent(CompressExtent **list, int *n, CompressExtent e)
+{
+	/* Capacities are the powers of two */
+	if ((*n & (*n - 1)) == 0)
+	{
+		CompressExtent *l = realloc(*list, (*n ? 2 * *n : 1) * sizeof(CompressExtent));
+		if (l == NULL)
+			return CHIDB_ENOMEM;
+		*list = l;
+	}
+	(*list)[(*n)++] = e;
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_compressGrow(CompressFile *cf, uint32_t nblocks)
+{
+	uint32_t n = cf->nblocks ? cf->nblocks : 64;
+	CompressExtent *blocks;
+
+	if (nblocks <= cf->nblocks)
+		return CHIDB_OK;
+	while (n < nblocks)
+		n *= 2;
+	blocks = realloc(cf->blocks, n * sizeof(CompressExtent));
+	if (blocks == NULL)
+		return CHIDB_ENOMEM;
+	memset(blocks + cf->nblocks, 0, (n - cf->nblocks) * sizeof(CompressExtent));
+	cf->blocks = blocks;
+	cf->nblocks = n;
+
+	return CHIDB_OK;
+}
+
+
+/* Sort and merge the free extents. Free space at the end of the file
+ * is cut off. */
+static void chidb_Vfs_compressCoalesce(CompressFile *cf)
+{
+	int n = 0;
+
+	if (cf->nfree > 0)
+		qsort(cf->free, cf->nfree, sizeof(CompressExtent), chidb_Vfs_compressExtentCmp);
+	for (int i = 0; i < cf->nfree; i++)
+		if (n > 0 && cf->free[n - 1].offset + cf->free[n - 1].len == cf->free[i].offset)
+			cf->free[n - 1].len += cf->free[i].len;
+		else
+			cf->free[n++] = cf->free[i];
+	cf->nfree = n;
+	if (n > 0 && cf->free[n - 1].offset + cf->free[n - 1].len >= cf->end)
+	{
+		cf->end = cf->free[n - 1].offset;
+		cf->nfree--;
+
+		/* This only gives the space back, so it does not matter if it fails */
+		if (ftruncate(cf->posix.fd, (off_t) cf->end) != 0)
+			return;
+	}
+}
+
+
+/* Find room for a record: the first free extent that is large enough,
+ * or else the end of the file */
+static uint64_t chidb_Vfs_compressAlloc(CompressFile *cf, uint64_t len)
+{
+	uint64_t offset;
+
+	for (int i = 0; i < cf->nfree; i++)
+		if (cf->free[i].len >= len)
+		{
+			offset = cf->free[i].offset;
+			cf->free[i].offset += len;
+			cf->free[i].len -= len;
+			if (cf->free[i].len == 0)
+				memmove(cf->free + i, cf->free + i + 1, (--cf->nfree - i) * sizeof(CompressExtent));
+			return offset;
+		}
+	offset = cf->end;
+	cf->end += len;
+
+	return offset;
+}
+
+
+/* Find the records of a file, and rebuild the map of its blocks and its
+ * free space. The newest record of a block (the one with the highest
+ * sequence number) is the one in use, and the newest record of the file
+ * holds its size. Records that were torn by a crash fail their checksum
+ * and are skipped, as are blocks past the end of the file. */
+static int chidb_Vfs_compressScan(CompressFile *cf)
+{
+	uint8_t header[COMPRESS_HEADER_SIZE];
+	uint64_t fsize, pos, wpos = 0, wlen = 0;
+	uint64_t *seqs = NULL, newest = 0;
+	CompressExtent last = {0, 0};
+	bool last_sizeonly = false;
+	uint8_t *window;
+	struct stat st;
+	int rc = CHIDB_OK;
+
+	if (fstat(cf->posix.fd, &st) != 0)
+		return CHIDB_EIO;
+	fsize = st.st_size;
+	if (chidb_Vfs_posixRead(&cf->posix.base, header, sizeof(header), 0) != CHIDB_OK)
+		return CHIDB_EIO;
+	cf->generation = get8byte(header + 24);
+
+	uint64_t maxrec = chidb_Vfs_compressFootprint(cf->block_size);
+	window = malloc(COMPRESS_SCAN_CHUNK + maxrec);
+	if (window == NULL)
+		return CHIDB_ENOMEM;
+	if (cf->nblocks > 0)
+		memset(cf->blocks, 0, cf->nblocks * sizeof(CompressExtent));
+	cf->nfree = cf->npending = 0;
+	cf->size_rec.len = 0;
+	cf->size = 0;
+	cf->seq = 1;
+
+	for (pos = COMPRESS_HEADER_SIZE; pos + COMPRESS_RECORD_HEADER_SIZE <= fsize && rc == CHIDB_OK; )
+	{
+		if (pos + COMPRESS_RECORD_HEADER_SIZE > wpos + wlen || pos >= wpos + COMPRESS_SCAN_CHUNK)
+		{
+			wpos = pos;
+			wlen = (fsize - pos < COMPRESS_SCAN_CHUNK + maxrec) ? fsize - pos : COMPRESS_SCAN_CHUNK + maxrec;
+			if (chidb_Vfs_posixRead(&cf->posix.base, window, wlen, wpos) != CHIDB_OK)
+			{
+				rc = CHIDB_EIO;
+				break;
+			}
+		}
+
+		uint8_t *r = window + (pos - wpos);
+		uint32_t block = get4byte(r + 24);
+		uint32_t plen = get2byte(r + 28);
+		bool raw = r[30] & COMPRESS_RAW;
+		if (get4byte(r) != COMPRESS_RECORD_MAGIC || pos + COMPRESS_RECORD_HEADER_SIZE + plen > wpos + wlen ||
+		    plen > cf->block_size || (raw && plen != cf->block_size) || (block == COMPRESS_NO_BLOCK && plen != 0) ||
+		    get4byte(r + 4) != chidb_Checksum_crc32c(r + 8, COMPRESS_RECORD_HEADER_SIZE - 8 + plen))
+		{
+			pos += COMPRESS_ALIGN;
+			continue;
+		}
+
+		CompressExtent e = {pos, chidb_Vfs_compressFootprint(plen)};
+		uint64_t seq = get8byte(r + 8);
+		if (block != COMPRESS_NO_BLOCK)
+		{
+			uint32_t n = cf->nblocks;
+			rc = chidb_Vfs_compressGrow(cf, block + 1);
+			if (rc == CHIDB_OK && cf->nblocks > n)
+			{
+				uint64_t *s = realloc(seqs, cf->nblocks * sizeof(uint64_t));
+				if (s == NULL)
+					rc = CHIDB_ENOMEM;
+				else
+				{
+					seqs = s;
+					memset(seqs + n, 0, (cf->nblocks - n) * sizeof(uint64_t));
+				}
+			}
+			if (rc == CHIDB_OK && seq > seqs[block])
+			{
+				seqs[block] = seq;
+				cf->blocks[block] = e;
+			}
+		}
+		if (seq > newest)
+		{
+			newest = seq;
+			last = e;
+			last_sizeonly = (block == COMPRESS_NO_BLOCK);
+			cf->size = get8byte(r + 16);
+		}
+		pos += e.len;
+	}
+	free(window);
+	free(seqs);
+	if (rc != CHIDB_OK)
+		return rc;
+
+	/* Everything that is not in use is free */
+	CompressExtent *used = NULL;
+	int nused = 0;
+	cf->seq = newest + 1;
+	if (last_sizeonly)
+	{
+		cf->size_rec = last;
+		rc = chidb_Vfs_compressAddExtent(&used, &nused, last);
+	}
+	for (uint32_t b = 0; b < cf->nblocks && rc == CHIDB_OK; b++)
+	{
+		if ((uint64_t) b * cf->block_size >= cf->size)
+			cf->blocks[b].len = 0;
+		if (cf->blocks[b].len > 0)
+			rc = chidb_Vfs_compressAddExtent(&used, &nused, cf->blocks[b]);
+	}
+	if (rc == CHIDB_OK && nused > 0)
+		qsort(used, nused, sizeof(CompressExtent), chidb_Vfs_compressExtentCmp);
+	cf->end = COMPRESS_HEADER_SIZE;
+	for (int i = 0; i < nused && rc == CHIDB_OK; i++)
+	{
+		if (used[i].offset > cf->end)
+			rc = chidb_Vfs_compressAddExtent(&cf->free, &cf->nfree, (CompressExtent) {cf->end, used[i].offset - cf->end});
+		cf->end = used[i].offset + used[i].len;
+	}
+	free(used);
+
+	return rc;
+}
+
+
+/* Forget a record that is no longer used. Its space is reused after the
+ * next sync. */
+static int chidb_Vfs_compressRelease(CompressFile *cf, CompressExtent e)
+{
+	if (e.len == 0)
+		return CHIDB_OK;
+
+	return chidb_Vfs_compressAddExtent(&cf->pending, &cf->npending, e);
+}
+
+
+/* Write a new record for a block (or, if data is NULL, a record that
+ * only holds the size of the file), which replaces the old one */
+static int chidb_Vfs_compressPut(CompressFile *cf, uint32_t block, const uint8_t *data)
+{
+	uint8_t *r = cf->record;
+	size_t plen = 0;
+	uint8_t flags = 0;
+	int rc;
+
+	if (data != NULL)
+	{
+		plen = chidb_Lz_compress(data, cf->block_size, r + COMPRESS_RECORD_HEADER_SIZE, cf->block_size - 1);
+		if (plen == 0)
+		{
+			memcpy(r + COMPRESS_RECORD_HEADER_SIZE, data, cf->block_size);
+			plen = cf->block_size;
+			flags = COMPRESS_RAW;
+		}
+	}
+	if (data != NULL && (rc = chidb_Vfs_compressGrow(cf, block + 1)) != CHIDB_OK)
+		return rc;
+	put4byte(r, COMPRESS_RECORD_MAGIC);
+	put8byte(r + 8, cf->seq);
+	put8byte(r + 16, cf->size);
+	put4byte(r + 24, data != NULL ? block : COMPRESS_NO_BLOCK);
+	put2byte(r + 28, plen);
+	r[30] = flags;
+	r[31] = 0;
+	put4byte(r + 4, chidb_Checksum_crc32c(r + 8, COMPRESS_RECORD_HEADER_SIZE - 8 + plen));
+
+	CompressExtent e = {0, chidb_Vfs_compressFootprint(plen)};
+	e.offset = chidb_Vfs_compressAlloc(cf, e.len);
+	rc = chidb_Vfs_posixWrite(&cf->posix.base, r, COMPRESS_RECORD_HEADER_SIZE + plen, e.offset);
+	if (rc != CHIDB_OK)
+	{
+		chidb_Vfs_compressRelease(cf, e);
+		return rc;
+	}
+	cf->seq++;
+	cf->written = true;
+
+	/* A size record is only needed until a newer record is written */
+	rc = chidb_Vfs_compressRelease(cf, cf->size_rec);
+	cf->size_rec.len = 0;
+	if (data == NULL)
+		cf->size_rec = e;
+	else
+	{
+		if (rc == CHIDB_OK)
+			rc = chidb_Vfs_compressRelease(cf, cf->blocks[block]);
+		cf->blocks[block] = e;
+	}
+
+	return rc;
+}
+
+
+/* Read and decompress a block (zeros if it has no record) */
+static int chidb_Vfs_compressGet(CompressFile *cf, uint32_t block, uint8_t *data)
+{
+	uint8_t *r = cf->record;
+	int rc;
+
+	if (block >= cf->nblocks || cf->blocks[block].len == 0)
+	{
+		memset(data, 0, cf->block_size);
+		return CHIDB_OK;
+	}
+
+	/* The padding of the last record may be past the end of the file */
+	rc = chidb_Vfs_posixRead(&cf->posix.base, r, cf->blocks[block].len, cf->blocks[block].offset);
+	if (rc != CHIDB_OK && rc != CHIDB_ESHORTREAD)
+		return rc;
+	uint32_t plen = get2byte(r + 28);
+	if (get4byte(r) != COMPRESS_RECORD_MAGIC || get4byte(r + 24) != block || plen > cf->block_size)
+		return CHIDB_EIO;
+	if (r[30] & COMPRESS_RAW)
+	{
+		memcpy(data, r + COMPRESS_RECORD_HEADER_SIZE, cf->block_size);
+		return CHIDB_OK;
+	}
+
+	return chidb_Lz_decompress(r + COMPRESS_RECORD_HEADER_SIZE, plen, data, cf->block_size) == CHIDB_OK ? CHIDB_OK : CHIDB_EIO;
+}
+
+
+/* Scan the file again if another connection has written to it (and
+ * synced it) since it was last scanned */
+static int chidb_Vfs_compressCheck(CompressFile *cf)
+{
+	uint8_t gen[8];
+
+	if (chidb_Vfs_posixRead(&cf->posix.base, gen, sizeof(gen), 24) != CHIDB_OK)
+		return CHIDB_EIO;
+	if (get8byte(gen) == cf->generation)
+		return CHIDB_OK;
+
+	return chidb_Vfs_compressScan(cf);
+}
+
+
+static int chidb_Vfs_compressClose(VfsFile *file)
+{
+	CompressFile *cf = (CompressFile *) file;
+
+	free(cf->blocks);
+	free(cf->free);
+	free(cf->pending);
+	free(cf->block);
+	free(cf->record);
+
+	return chidb_Vfs_posixClose(file);
+}
+
+
+static int chidb_Vfs_compressRead(VfsFile *file, void *buf, size_t len, uint64_t offset)
+{
+	CompressFile *cf = (CompressFile *) file;
+	uint8_t *p = buf;
+	int rc = CHIDB_OK;
+
+	/* The pager reads the chidb header whenever it looks for changes
+	 * made by other connections (see chidb_Pager_refresh) */
+	if (offset < cf->block_size && (rc = chidb_Vfs_compressCheck(cf)) != CHIDB_OK)
+		return rc;
+	if (offset + len > cf->size)
+	{
+		size_t avail = (offset < cf->size) ? cf->size - offset : 0;
+		memset(p + avail, 0, len - avail);
+		len = avail;
+		rc = CHIDB_ESHORTREAD;
+	}
+	while (len > 0)
+	{
+		uint32_t block = offset / cf->block_size;
+		size_t in = offset % cf->block_size;
+		size_t n = (cf->block_size - in < len) ? cf->block_size - in : len;
+		int err;
+
+		/* Whole blocks are decompressed straight into the buffer */
+		if (n == cf->block_size)
+			err = chidb_Vfs_compressGet(cf, block, p);
+		else if ((err = chidb_Vfs_compressGet(cf, block, cf->block)) == CHIDB_OK)
+			memcpy(p, cf->block + in, n);
+		if (err != CHIDB_OK)
+			return err;
+		p += n;
+		len -= n;
+		offset += n;
+	}
+
+	return rc;
+}
+
+
+static int chidb_Vfs_compressWrite(VfsFile *file, const void *buf, size_t len, uint64_t offset)
+{
+	CompressFile *cf = (CompressFile *) file;
+	const uint8_t *p = buf;
+	int rc;
+
+	if (len == 0)
+		return CHIDB_OK;
+	if (offset + len > cf->size)
+		cf->size = offset + len;
+	while (len > 0)
+	{
+		uint32_t block = offset / cf->block_size;
+		size_t in = offset % cf->block_size;
+		size_t n = (cf->block_size - in < len) ? cf->block_size - in : len;
+
+		if (n == cf->block_size)
+			rc = chidb_Vfs_compressPut(cf, block, p);
+		else if ((rc = chidb_Vfs_compressGet(cf, block, cf->block)) == CHIDB_OK)
+		{
+			memcpy(cf->block + in, p, n);
+			rc = chidb_Vfs_compressPut(cf, block, cf->block);
+		}
+		if (rc != CHIDB_OK)
+			return rc;
+		p += n;
+		len -= n;
+		offset += n;
+	}
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_compressSync(VfsFile *file)
+{
+	CompressFile *cf = (CompressFile *) file;
+	uint8_t gen[8];
+	int rc;
+
+	/* Other connections look at the generation to tell whether they
+	 * need to scan the file again (see chidb_Vfs_compressLock) */
+	if (cf->written)
+	{
+		put8byte(gen, cf->generation + 1);
+		if (chidb_Vfs_posixWrite(file, gen, sizeof(gen), 24) != CHIDB_OK)
+			return CHIDB_EIO;
+		cf->generation++;
+	}
+	rc = chidb_Vfs_posixSync(file);
+	if (rc != CHIDB_OK)
+		return rc;
+	cf->written = false;
+
+	/* The records that replaced the pending ones are now on disk */
+	for (int i = 0; i < cf->npending; i++)
+		if (chidb_Vfs_compressAddExtent(&cf->free, &cf->nfree, cf->pending[i]) != CHIDB_OK)
+			break;
+	cf->npending = 0;
+	chidb_Vfs_compressCoalesce(cf);
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_compressTruncate(VfsFile *file, uint64_t size)
+{
+	CompressFile *cf = (CompressFile *) file;
+	uint32_t first = (size + cf->block_size - 1) / cf->block_size;
+	static const uint8_t zero[4] = {0, 0, 0, 0};
+	int rc;
+
+	if (size == cf->size)
+		return CHIDB_OK;
+
+	/* Records of blocks past the end are erased, so that a scan of the
+	 * file cannot bring them back */
+	for (uint32_t b = first; b < cf->nblocks; b++)
+		if (cf->blocks[b].len > 0)
+		{
+			if (chidb_Vfs_posixWrite(file, zero, sizeof(zero), cf->blocks[b].offset) != CHIDB_OK)
+				return CHIDB_EIO;
+			rc = chidb_Vfs_compressRelease(cf, cf->blocks[b]);
+			cf->blocks[b].len = 0;
+			if (rc != CHIDB_OK)
+				return rc;
+		}
+
+	/* The new size is recorded with the block that the file now ends
+	 * in (with zeros after the end), or in a record of its own */
+	uint32_t last = size / cf->block_size;
+	cf->size = size;
+	if (size % cf->block_size != 0 && last < cf->nblocks && cf->blocks[last].len > 0)
+	{
+		rc = chidb_Vfs_compressGet(cf, last, cf->block);
+		if (rc != CHIDB_OK)
+			return rc;
+		memset(cf->block + size % cf->block_size, 0, cf->block_size - size % cf->block_size);
+		return chidb_Vfs_compressPut(cf, last, cf->block);
+	}
+
+	return chidb_Vfs_compressPut(cf, COMPRESS_NO_BLOCK, NULL);
+}
+
+
+static int chidb_Vfs_compressSize(VfsFile *file, uint64_t *size)
+{
+	*size = ((CompressFile *) file)->size;
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_compressLock(VfsFile *file, int level, bool wait)
+{
+	CompressFile *cf = (CompressFile *) file;
+	int rc = chidb_Vfs_posixLock(file, level, wait);
+
+	/* Another connection may have written to the file while this one
+	 * held no lock */
+	if (rc == CHIDB_OK && cf->lock == VFS_LOCK_NONE && level != VFS_LOCK_NONE)
+	{
+		rc = chidb_Vfs_compressCheck(cf);
+		if (rc != CHIDB_OK)
+		{
+			chidb_Vfs_posixLock(file, VFS_LOCK_NONE, false);
+			level = VFS_LOCK_NONE;
+		}
+	}
+	if (rc == CHIDB_OK || level == VFS_LOCK_NONE)
+		cf->lock = level;
+
+	return rc;
+}
+
+
+static const VfsMethods compress_methods =
+{
+	chidb_Vfs_compressClose,
+	chidb_Vfs_compressRead,
+	chidb_Vfs_compressWrite,
+	chidb_Vfs_compressSync,
+	chidb_Vfs_compressTruncate,
+	chidb_Vfs_compressSize,
+	chidb_Vfs_compressLock,
+	chidb_Vfs_posixId,
+	NULL,
+	NULL,
+	NULL
+};
+
+
+static int chidb_Vfs_compressOpen(Vfs *vfs, const char *path, int flags, VfsFile **file)
+{
+	PosixFile *pf;
+	CompressFile *cf;
+	uint8_t header[COMPRESS_HEADER_SIZE];
+	uint64_t size;
+	int rc;
+
+	if (!(flags & VFS_OPEN_MAIN))
+		return chidb_Vfs_posixOpen(vfs, path, flags, file);
+
+	rc = chidb_Vfs_posixOpenFile(vfs, path, flags, sizeof(CompressFile), &compress_methods, &pf);
+	if (rc != CHIDB_OK)
+		return rc;
+	cf = (CompressFile *) pf;
+
+	/* A new file starts with just the header */
+	memset(header, 0, sizeof(header));
+	rc = chidb_Vfs_posixSize(&pf->base, &size);
+	if (rc == CHIDB_OK && size == 0)
+	{
+		memcpy(header, COMPRESS_MAGIC, strlen(COMPRESS_MAGIC));
+		put4byte(header + 16, COMPRESS_BLOCK_SIZE);
+		rc = chidb_Vfs_posixWrite(&pf->base, header, sizeof(header), 0);
+	}
+	else if (rc == CHIDB_OK)
+		rc = chidb_Vfs_posixRead(&pf->base, header, sizeof(header), 0);
+	cf->block_size = get4byte(header + 16);
+	if (rc == CHIDB_OK && (memcmp(header, COMPRESS_MAGIC, strlen(COMPRESS_MAGIC)) != 0 ||
+	                       cf->block_size == 0 || cf->block_size > UINT16_MAX))
+		rc = CHIDB_EIO;
+
+	if (rc == CHIDB_OK)
+	{
+		cf->block = malloc(cf->block_size);
+		cf->record = malloc(COMPRESS_RECORD_HEADER_SIZE + cf->block_size + COMPRESS_ALIGN);
+		if (cf->block == NULL || cf->record == NULL)
+			rc = CHIDB_ENOMEM;
+	}
+	if (rc == CHIDB_OK)
+		rc = chidb_Vfs_compressScan(cf);
+	if (rc != CHIDB_OK)
+	{
+		chidb_Vfs_compressClose(&pf->base);
+		return rc;
+	}
+	*file = &pf->base;
+
+	return CHIDB_OK;
+}
+
+
+/* A file of the memory VFS */
+struct MemFile
+{
+	char *name;             /* NULL once the file has been removed */
+	uint8_t **chunks;       /* Contents (NULL for chunks never written) */
+	size_t n_chunks;        /* Number of entries in chunks */
+	uint64_t size;
+	int refs;               /* Number of VfsFiles open on it */
+	int n_shared;           /* Number of shared locks held on it */
+	bool exclusive;         /* An exclusive lock is held on it */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;    /* Signalled when a lock is released */
+	struct MemFile *next;
+};
+typedef struct MemFile MemFile;
+
+/* A VfsFile of the memory VFS */
+struct MemHandle
+{
+	VfsFile base;
+	MemFile *file;
+	int level;              /* Lock held through this handle */
+};
+typedef struct MemHandle MemHandle;
+
+/* Files of the memory VFS that have not been removed */
+static MemFile *mem_files = NULL;
+static pthread_mutex_t mem_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static MemFile **chidb_Vfs_memFind(const char *name)
+{
+	MemFile **p;
+
+	for (p = &mem_files; *p != NULL; p = &(*p)->next)
+		if (strcmp((*p)->name, name) == 0)
+			break;
+
+	return p;
+}
+
+
+static void chidb_Vfs_memUnlink(MemFile **p)
+{
+	MemFile *file = *p;
+
+	*p = file->next;
+	free(file->name);
+	file->name = NULL;
+}
+
+
+static void chidb_Vfs_memFree(MemFile *file)
+{
+	for (size_t i = 0; i < file->n_chunks; i++)
+		free(file->chunks[i]);
+	free(file->chunks);
+	pthread_mutex_destroy(&file->mutex);
+	pthread_cond_destroy(&file->cond);
+	free(file);
+}
+
+
+static int chidb_Vfs_memLock(VfsFile *vfile, int level, bool wait)
+{
+	MemHandle *h = (MemHandle *) vfile;
+	MemFile *file = h->file;
+
+	pthread_mutex_lock(&file->mutex);
+	for (;;)
+	{
+		bool others_shared = file->n_shared - (h->level == VFS_LOCK_SHARED) > 0;
+		bool others_exclusive = file->exclusive && h->level != VFS_LOCK_EXCLUSIVE;
+		if (level == VFS_LOCK_NONE ||
+		    (level == VFS_LOCK_SHARED && !others_exclusive) ||
+		    (level == VFS_LOCK_EXCLUSIVE && !others_exclusive && !others_shared))
+			break;
+		if (!wait)
+		{
+			pthread_mutex_unlock(&file->mutex);
+			return CHIDB_EBUSY;
+		}
+		pthread_cond_wait(&file->cond, &file->mutex);
+	}
+	if (h->level == VFS_LOCK_SHARED)
+		file->n_shared--;
+	else if (h->level == VFS_LOCK_EXCLUSIVE)
+		file->exclusive = false;
+	if (level == VFS_LOCK_SHARED)
+		file->n_shared++;
+	else if (level == VFS_LOCK_EXCLUSIVE)
+		file->exclusive = true;
+	h->level = level;
+	pthread_cond_broadcast(&file->cond);
+	pthread_mutex_unlock(&file->mutex);
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_memClose(VfsFile *vfile)
+{
+	MemFile *file = ((MemHandle *) vfile)->file;
+
+	chidb_Vfs_memLock(vfile, VFS_LOCK_NONE, true);
+	free(vfile);
+
+	pthread_mutex_lock(&mem_mutex);
+	if (--file->refs == 0)
+	{
+		if (file->name != NULL)
+			chidb_Vfs_memUnlink(chidb_Vfs_memFind(file->name));
+		chidb_Vfs_memFree(file);
+	}
+	pthread_mutex_unlock(&mem_mutex);
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_memRead(VfsFile *vfile, void *buf, size_t len, uint64_t offset)
+{
+	MemFile *file = ((MemHandle *) vfile)->file;
+	uint8_t *p = buf;
+	int rc = CHIDB_OK;
+
+	pthread_mutex_lock(&file->mutex);
+	if (offset + len > file->size)
+	{
+		size_t avail = offset < file->size ? file->size - offset : 0;
+		memset(p + avail, 0, len - avail);
+		len = avail;
+		rc = CHIDB_ESHORTREAD;
+	}
+	while (len > 0)
+	{
+		size_t chunk = offset / MEMVFS_CHUNK_SIZE, start = offset % MEMVFS_CHUNK_SIZE;
+		size_t n = MEMVFS_CHUNK_SIZE - start < len ? MEMVFS_CHUNK_SIZE - start : len;
+		if (chunk < file->n_chunks && file->chunks[chunk] != NULL)
+			memcpy(p, file->chunks[chunk] + start, n);
+		else
+			memset(p, 0, n);
+		p += n;
+		len -= n;
+		offset += n;
+	}
+	pthread_mutex_unlock(&file->mutex);
+
+	return rc;
+}
+
+
+static int chidb_Vfs_memWrite(VfsFile *vfile, const void *buf, size_t len, uint64_t offset)
+{
+	MemFile *file = ((MemHandle *) vfile)->file;
+	const uint8_t *p = buf;
+	uint64_t end = offset + len;
+
+	if (len == 0)
+		return CHIDB_OK;
+
+	pthread_mutex_lock(&file->mutex);
+	size_t need = (end + MEMVFS_CHUNK_SIZE - 1) / MEMVFS_CHUNK_SIZE;
+	if (need > file->n_chunks)
+	{
+		size_t n = file->n_chunks ? file->n_chunks : 16;
+		while (n < need)
+			n *= 2;
+		uint8_t **chunks = realloc(file->chunks, n * sizeof(uint8_t *));
+		if (chunks == NULL)
+		{
+			pthread_mutex_unlock(&file->mutex);
+			return CHIDB_ENOMEM;
+		}
+		memset(chunks + file->n_chunks, 0, (n - file->n_chunks) * sizeof(uint8_t *));
+		file->chunks = chunks;
+		file->n_chunks = n;
+	}
+	while (len > 0)
+	{
+		size_t chunk = offset / MEMVFS_CHUNK_SIZE, start = offset % MEMVFS_CHUNK_SIZE;
+		size_t n = MEMVFS_CHUNK_SIZE - start < len ? MEMVFS_CHUNK_SIZE - start : len;
+		if (file->chunks[chunk] == NULL && (file->chunks[chunk] = calloc(MEMVFS_CHUNK_SIZE, 1)) == NULL)
+		{
+			pthread_mutex_unlock(&file->mutex);
+			return CHIDB_ENOMEM;
+		}
+		memcpy(file->chunks[chunk] + start, p, n);
+		p += n;
+		len -= n;
+		offset += n;
+	}
+	if (end > file->size)
+		file->size = end;
+	pthread_mutex_unlock(&file->mutex);
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_memSync(VfsFile *vfile)
+{
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_memTruncate(VfsFile *vfile, uint64_t size)
+{
+	MemFile *file = ((MemHandle *) vfile)->file;
+
+	pthread_mutex_lock(&file->mutex);
+	if (size < file->size)
+	{
+		/* Whatever is past the new end must read as zeros if the file
+		 * grows again */
+		size_t first = (size + MEMVFS_CHUNK_SIZE - 1) / MEMVFS_CHUNK_SIZE;
+		for (size_t i = first; i < file->n_chunks; i++)
+		{
+			free(file->chunks[i]);
+			file->chunks[i] = NULL;
+		}
+		if (size % MEMVFS_CHUNK_SIZE != 0 && file->chunks[size / MEMVFS_CHUNK_SIZE] != NULL)
+			memset(file->chunks[size / MEMVFS_CHUNK_SIZE] + size % MEMVFS_CHUNK_SIZE, 0,
+			       MEMVFS_CHUNK_SIZE - size % MEMVFS_CHUNK_SIZE);
+	}
+	file->size = size;
+	pthread_mutex_unlock(&file->mutex);
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_memSize(VfsFile *vfile, uint64_t *size)
+{
+	MemFile *file = ((MemHandle *) vfile)->file;
+
+	pthread_mutex_lock(&file->mutex);
+	*size = file->size;
+	pthread_mutex_unlock(&file->mutex);
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_memId(VfsFile *vfile, uint64_t id[2])
+{
+	id[0] = (uint64_t) (uintptr_t) ((MemHandle *) vfile)->file;
+	id[1] = 0;
+
+	return CHIDB_OK;
+}
+
+
+static const VfsMethods mem_methods =
+{
+	chidb_Vfs_memClose,
+	chidb_Vfs_memRead,
+	chidb_Vfs_memWrite,
+	chidb_Vfs_memSync,
+	chidb_Vfs_memTruncate,
+	chidb_Vfs_memSize,
+	chidb_Vfs_memLock,
+	chidb_Vfs_memId,
+	NULL,
+	NULL,
+	NULL
+};
+
+
+static int chidb_Vfs_memOpen(Vfs *vfs, const char *path, int flags, VfsFile **vfile)
+{
+	MemHandle *h;
+	MemFile *file;
+
+	h = malloc(sizeof(MemHandle));
+	if (h == NULL)
+		return CHIDB_ENOMEM;
+
+	pthread_mutex_lock(&mem_mutex);
+	file = *chidb_Vfs_memFind(path);
+	if (file == NULL && !(flags & VFS_OPEN_CREATE))
+	{
+		pthread_mutex_unlock(&mem_mutex);
+		free(h);
+		return CHIDB_ENOTFOUND;
+	}
+	if (file == NULL)
+	{
+		file = calloc(1, sizeof(MemFile));
+		if (file == NULL || (file->name = strdup(path)) == NULL)
+		{
+			pthread_mutex_unlock(&mem_mutex);
+			free(file);
+			free(h);
+			return CHIDB_ENOMEM;
+		}
+		pthread_mutex_init(&file->mutex, NULL);
+		pthread_cond_init(&file->cond, NULL);
+		file->next = mem_files;
+		mem_files = file;
+	}
+	file->refs++;
+	pthread_mutex_unlock(&mem_mutex);
+
+	h->base.methods = &mem_methods;
+	h->base.vfs = vfs;
+	h->file = file;
+	h->level = VFS_LOCK_NONE;
+	*vfile = &h->base;
+
+	return CHIDB_OK;
+}
+
+
+static int chidb_Vfs_memRemove(Vfs *vfs, const char *path)
+{
+	MemFile **p;
+	bool found;
+
+	/* Open VfsFiles keep the contents until they are closed */
+	pthread_mutex_lock(&mem_mutex);
+	p = chidb_Vfs_memFind(path);
+	found = (*p != NULL);
+	if (found)
+		chidb_Vfs_memUnlink(p);
+	pthread_mutex_unlock(&mem_mutex);
+
+	return found ? CHIDB_OK : CHIDB_ENOTFOUND;
+}
+
+
+static int chidb_Vfs_memRename(Vfs *vfs, const char *from, const char *to)
+{
+	MemFile **p, *file;
+	char *name;
+
+	name = strdup(to);
+	if (name == NULL)
+		return CHIDB_ENOMEM;
+
+	pthread_mutex_lock(&mem_mutex);
+	file = *chidb_Vfs_memFind(from);
+	if (file == NULL)
+	{
+		pthread_mutex_unlock(&mem_mutex);
+		free(name);
+		return CHIDB_ENOTFOUND;
+	}
+	if (strcmp(from, to) != 0 && *(p = chidb_Vfs_memFind(to)) != NULL)
+		chidb_Vfs_memUnlink(p);
+	free(file->name);
+	file->name = name;
+	pthread_mutex_unlock(&mem_mutex);
+
+	return CHIDB_OK;
+}
+
+
+static Vfs compress_vfs = {"compress", chidb_Vfs_compressOpen, chidb_Vfs_posixRemove, chidb_Vfs_posixRename, NULL, NULL};
+static Vfs direct_vfs = {"direct", chidb_Vfs_directOpen, chidb_Vfs_posixRemove, chidb_Vfs_posixRename, NULL, &compress_vfs};
+static Vfs uring_vfs = {"uring", chidb_Vfs_uringOpen, chidb_Vfs_posixRemove, chidb_Vfs_posixRename, NULL, &direct_vfs};
+static Vfs memory_vfs = {"memory", chidb_Vfs_memOpen, chidb_Vfs_memRemove, chidb_Vfs_memRename, NULL, &uring_vfs};
+static Vfs posix_vfs = {"posix", chidb_Vfs_posixOpen, chidb_Vfs_posixRemove, chidb_Vfs_posixRename, NULL, &memory_vfs};
+
+/* Registered VFSs. The first one is the default */
+static Vfs *vfs_list = &posix_vfs;
+static pthread_mutex_t vfs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* Find a VFS
+ *
+ * Parameters
+ * - name: Name of the VFS, or NULL for the default VFS.
+ *
+ * Return
+ * - The VFS, or NULL if there is no VFS with that name
+ */
+Vfs *chidb_Vfs_find(const char *name)
+{
+	Vfs *vfs;
+
+	pthread_mutex_lock(&vfs_mutex);
+	for (vfs = vfs_list; vfs != NULL && name != NULL; vfs = vfs->next)
+		if (strcmp(vfs->name, name) == 0)
+			break;
+	pthread_mutex_unlock(&vfs_mutex);
+
+	return vfs;
+}
+
+
+/* Register a VFS
+ *
+ * Registering a VFS that is already registered only changes whether it
+ * is the default.
+ *
+ * Parameters
+ * - vfs: The VFS. It must stay valid for as long as the program runs.
+ * - make_default: Whether to use it when no VFS is named.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ */
+int chidb_Vfs_register(Vfs *vfs, bool make_default)
+{
+	Vfs **p;
+
+	pthread_mutex_lock(&vfs_mutex);
+	for (p = &vfs_list; *p != NULL; p = &(*p)->next)
+		if (*p == vfs)
+		{
+			*p = vfs->next;
+			break;
+		}
+	if (make_default || vfs_list == NULL)
+	{
+		vfs->next = vfs_list;
+		vfs_list = vfs;
+	}
+	else
+	{
+		vfs->next = vfs_list->next;
+		vfs_list->next = vfs;
+	}
+	pthread_mutex_unlock(&vfs_mutex);
+
+	return CHIDB_OK;
+}
+
+
+/* Open a file
+ *
+ * Parameters
+ * - vfs: A VFS.
+ * - path: Name of the file.
+ * - flags: VFS_OPEN_CREATE to create the file if it does not exist.
+ * - file: Out parameter. The open file.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOTFOUND: The file does not exist (and VFS_OPEN_CREATE
+ *                    was not given)
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when opening the file
+ */
+int chidb_Vfs_open(Vfs *vfs, const char *path, int flags, VfsFile **file)
+{
+	return vfs->open(vfs, path, flags, file);
+}
+
+
+/* Delete a file
+ *
+ * Parameters
+ * - vfs: A VFS.
+ * - path: Name of the file.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOTFOUND: The file does not exist
+ * - CHIDB_EIO: An I/O error has occurred when deleting the file
+ */
+int chidb_Vfs_remove(Vfs *vfs, const char *path)
+{
+	return vfs->remove(vfs, path);
+}
+
+
+/* Rename a file, replacing the file with the new name if there is one
+ *
+ * Parameters
+ * - vfs: A VFS.
+ * - from: Name of the file.
+ * - to: New name of the file.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOTFOUND: The file does not exist
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when renaming the file
+ */
+int chidb_Vfs_rename(Vfs *vfs, const char *from, const char *to)
+{
+	return vfs->rename(vfs, from, to);
+}
+
+
+/* Close a file, releasing any lock held on it
+ *
+ * Parameters
+ * - file: An open file.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EIO: An I/O error has occurred when closing the file
+ */
+int chidb_Vfs_close(VfsFile *file)
+{
+	return file->methods->close(file);
+}
+
+
+/* Read from a file
+ *
+ * Parameters
+ * - file: An open file.
+ * - buf: Buffer with room for len bytes.
+ * - len: Number of bytes to read.
+ * - offset: Position of the first byte in the file.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ESHORTREAD: The file ends before offset + len. The bytes
+ *                     past the end are set to zero.
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Vfs_read(VfsFile *file, void *buf, size_t len, uint64_t offset)
+{
+	return file->methods->read(file, buf, len, offset);
+}
+
+
+/* Write to a file, extending it if needed
+ *
+ * Parameters
+ * - file: An open file.
+ * - buf: Bytes to write.
+ * - len: Number of bytes to write.
+ * - offset: Position of the first byte in the file.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Vfs_write(VfsFile *file, const void *buf, size_t len, uint64_t offset)
+{
+	return file->methods->write(file, buf, len, offset);
+}
+
+
+/* Flush all writes to a file to stable storage
+ *
+ * Parameters
+ * - file: An open file.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Vfs_sync(VfsFile *file)
+{
+	return file->methods->sync(file);
+}
+
+
+/* Change the size of a file
+ *
+ * Parameters
+ * - file: An open file.
+ * - size: New size (in bytes).
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Vfs_truncate(VfsFile *file, uint64_t size)
+{
+	return file->methods->truncate(file, size);
+}
+
+
+/* Get the size of a file
+ *
+ * Parameters
+ * - file: An open file.
+ * - size: Out parameter. Size of the file (in bytes).
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Vfs_size(VfsFile *file, uint64_t *size)
+{
+	return file->methods->size(file, size);
+}
+
+
+/* Change the lock held on a file
+ *
+ * Parameters
+ * - file: An open file.
+ * - level: VFS_LOCK_NONE, VFS_LOCK_SHARED or VFS_LOCK_EXCLUSIVE.
+ * - wait: Whether to wait until the lock can be taken.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EBUSY: The lock is held elsewhere (only if wait is false).
+ *                Failing to upgrade a lock may release the old one.
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Vfs_lock(VfsFile *file, int level, bool wait)
+{
+	return file->methods->lock(file, level, wait);
+}
+
+
+/* Get the identity of a file
+ *
+ * Two open files have the same identity if and only if they are the
+ * same file, even if they were opened through different paths.
+ *
+ * Parameters
+ * - file: An open file.
+ * - id: Out parameter. Identity of the file.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Vfs_id(VfsFile *file, uint64_t id[2])
+{
+	return file->methods->id(file, id);
+}
+
+
+/* Read a batch of requests
+ *
+ * The requests may be carried out in any order, or all at once.
+ *
+ * Parameters
+ * - file: An open file.
+ * - ios: The requests (buffer, number of bytes and offset of each).
+ * - n: Number of requests.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ESHORTREAD: The file ends before the end of some request (see
+ *                     chidb_Vfs_read)
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Vfs_readBatch(VfsFile *file, VfsIo *ios, int n)
+{
+	if (file->methods->readBatch != NULL)
+		return file->methods->readBatch(file, ios, n);
+
+	return chidb_Vfs_batchFallback(file, ios, n, false);
+}
+
+
+/* Write a batch of requests
+ *
+ * The requests may be carried out in any order, or all at once, so
+ * they should not overlap.
+ *
+ * Parameters
+ * - file: An open file.
+ * - ios: The requests (buffer, number of bytes and offset of each).
+ * - n: Number of requests.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Vfs_writeBatch(VfsFile *file, VfsIo *ios, int n)
+{
+	if (file->methods->writeBatch != NULL)
+		return file->methods->writeBatch(file, ios, n);
+
+	return chidb_Vfs_batchFallback(file, ios, n, true);
+}
+
+
+/* Tell the VFS that part of a file will be read soon
+ *
+ * This is only a hint, which the VFS can use to start reading before
+ * the data is needed (with posix_fadvise, for instance).
+ *
+ * Parameters
+ * - file: An open file.
+ * - offset: Position of the first byte.
+ * - len: Number of bytes.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful (or the VFS ignores hints)
+ * - CHIDB_EIO: The hint could not be given
+ */
+int chidb_Vfs_prefetch(VfsFile *file, uint64_t offset, uint64_t len)
+{
+	if (file->methods->prefetch == NULL)
+		return CHIDB_OK;
+
+	return file->methods->prefetch(file, offset, len);
+}
+
+
+/* Check whether the uring VFS submits batches through io_uring
+ *
+ * Return
+ * - true if io_uring works here, false if batches fall back to
+ *   pread/pwrite (or no file has been opened with the uring VFS yet)
+ */
+bool chidb_Vfs_uringAvailable(void)
+{
+#ifdef HAVE_IO_URING
+	return uring_state > 0;
+#else
+	return false;
+#endif
+}
+
+
+/* Check whether a file bypasses the operating system's cache
+ *
+ * Parameters
+ * - file: An open file.
+ *
+ * Return
+ * - true if the file was opened with the direct VFS as a database
+ *   file, and the file system supports direct I/O
+ */
+bool chidb_Vfs_isDirect(VfsFile *file)
+{
+	return file->vfs == &direct_vfs && ((DirectFile *) file)->mem_align != 0;
+}
@@ -0,0 +1,109 @@
+#ifndef VFS_H_
+#define VFS_H_
+
+#include <chidbInt.h>
+
+/* Flags for chidb_Vfs_open */
+#define VFS_OPEN_CREATE (0x01)   /* Create the file if it does not exist */
+#define VFS_OPEN_MAIN (0x02)     /* The file is a database (not a journal or WAL) */
+
+/* Files of the memory VFS are kept in chunks of this size */
+#define MEMVFS_CHUNK_SIZE (4096)
+
+/* Lock levels for chidb_Vfs_lock. Any number of files can hold a shared
+ * lock on the same file, but an exclusive lock excludes every other one.
+ * Locks held through different VfsFiles conflict even within a process. */
+#define VFS_LOCK_NONE (0)
+#define VFS_LOCK_SHARED (1)
+#define VFS_LOCK_EXCLUSIVE (2)
+
+/* Number of requests the uring VFS submits to the kernel at a time */
+#define URING_ENTRIES (64)
+
+/* Layout of database files of the compress VFS (see vfs.c). Files are
+ * divided into blocks, each of which is compressed into a record of its
+ * own. Records start at multiples of COMPRESS_ALIGN bytes */
+#define COMPRESS_BLOCK_SIZE (DEFAULT_PAGE_SIZE)
+#define COMPRESS_HEADER_SIZE (32)
+#define COMPRESS_RECORD_HEADER_SIZE (32)
+#define COMPRESS_ALIGN (32)
+#define COMPRESS_MAGIC ("chidb compressed")
+#define COMPRESS_RECORD_MAGIC (0x7A636462)
+#define COMPRESS_NO_BLOCK (0xFFFFFFFF)   /* Block of a record that only holds the size of the file */
+#define COMPRESS_RAW (0x01)              /* Flag of a record whose block did not compress */
+
+/* Bytes of a compressed file that are read at a time when looking for
+ * its records */
+#define COMPRESS_SCAN_CHUNK (65536)
+
+typedef struct Vfs Vfs;
+typedef struct VfsFile VfsFile;
+
+/* One request of a batch (see chidb_Vfs_readBatch) */
+struct VfsIo
+{
+	void *buf;
+	size_t len;
+	uint64_t offset;
+};
+typedef struct VfsIo VfsIo;
+
+/* Operations on an open file. All of them return a CHIDB_* code.
+ * readBatch and writeBatch may be NULL, in which case the requests
+ * are carried out one at a time with read and write. prefetch may be
+ * NULL if the VFS cannot make use of hints */
+struct VfsMethods
+{
+	int (*close)(VfsFile *file);
+	int (*read)(VfsFile *file, void *buf, size_t len, uint64_t offset);
+	int (*write)(VfsFile *file, const void *buf, size_t len, uint64_t offset);
+	int (*sync)(VfsFile *file);
+	int (*truncate)(VfsFile *file, uint64_t size);
+	int (*size)(VfsFile *file, uint64_t *size);
+	int (*lock)(VfsFile *file, int level, bool wait);
+	int (*id)(VfsFile *file, uint64_t id[2]);
+	int (*readBatch)(VfsFile *file, VfsIo *ios, int n);
+	int (*writeBatch)(VfsFile *file, VfsIo *ios, int n);
+	int (*prefetch)(VfsFile *file, uint64_t offset, uint64_t len);
+};
+typedef struct VfsMethods VfsMethods;
+
+/* An open file. Implementations embed it at the start of their own
+ * file structure */
+struct VfsFile
+{
+	const VfsMethods *methods;
+	Vfs *vfs;             /* VFS the file was opened with */
+};
+
+/* A VFS: the storage that the pager and the WAL keep their files in */
+struct Vfs
+{
+	const char *name;
+	int (*open)(Vfs *vfs, const char *path, int flags, VfsFile **file);
+	int (*remove)(Vfs *vfs, const char *path);
+	int (*rename)(Vfs *vfs, const char *from, const char *to);
+	void *data;           /* Private data of the implementation */
+	Vfs *next;            /* Next registered VFS */
+};
+
+Vfs *chidb_Vfs_find(const char *name);
+int chidb_Vfs_register(Vfs *vfs, bool make_default);
+int chidb_Vfs_open(Vfs *vfs, const char *path, int flags, VfsFile **file);
+int chidb_Vfs_remove(Vfs *vfs, const char *path);
+int chidb_Vfs_rename(Vfs *vfs, const char *from, const char *to);
+int chidb_Vfs_close(VfsFile *file);
+int chidb_Vfs_read(VfsFile *file, void *buf, size_t len, uint64_t offset);
+int chidb_Vfs_write(VfsFile *file, const void *buf, size_t len, uint64_t offset);
+int chidb_Vfs_sync(VfsFile *file);
+int chidb_Vfs_truncate(VfsFile *file, uint64_t size);
+int chidb_Vfs_size(VfsFile *file, uint64_t *size);
+int chidb_Vfs_lock(VfsFile *file, int level, bool wait);
+int chidb_Vfs_id(VfsFile *file, uint64_t id[2]);
+int chidb_Vfs_readBatch(VfsFile *file, VfsIo *ios, int n);
+int chidb_Vfs_writeBatch(VfsFile *file, VfsIo *ios, int n);
+int chidb_Vfs_prefetch(VfsFile *file, uint64_t offset, uint64_t len);
+bool chidb_Vfs_uringAvailable(void);
+bool chidb_Vfs_isDirect(VfsFile *file);
+
+#endif /*VFS_H_*/
@@ -0,0 +1,817 @@
+/*****************************************************************************
+ *
+ *																 chidb
+ *
+ * This module contains the write-ahead log (WAL) used by the pager when
+ * the database is in WAL journal mode (see chidb_Pager_setJournalMode).
+ *
+ * Instead of overwriting pages in the database file, a commit appends
+ * the new version of every page it wrote to the end of the WAL, and the
+ * last frame of the commit records the size of the database. Pages are
+ * then read from the newest frame that contains them (found through an
+ * in-memory WAL index) or, if there is none, from the database file. A
+ * checkpoint copies the newest version of every page back into the
+ * database file, after which the WAL starts over with new salts.
+ *
+ * The WAL index is kept by each connection, and is brought up to date
+ * with the frames appended by other connections when chidb_Wal_refresh
+ * is called. Readers never wait for a writer: they keep reading from the
+ * snapshot that their index describes. A checkpoint must not overwrite
+ * a page in the database file that a reader of an older snapshot still
+ * reads from the file, nor restart the WAL under its feet, so readers
+ * hold a shared lock on a second file (the readers file) while they
+ * read a snapshot. A checkpoint only starts when it can lock that file
+ * exclusively, and then only restarts the WAL if it can lock it
+ * exclusively again once the pages are copied (see
+ * chidb_Wal_beginCheckpoint). Every connection also holds a shared lock
+ * on the WAL file, so that the WAL is only deleted by the last
+ * connection to close the database.
+ *
+ * Appending a commit and flushing it to stable storage are separate
+ * steps, so that commits made by several threads at about the same time
+ * can share a single fsync (group commit, see chidb_Wal_sync).
+ *
+\*****************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <chidbInt.h>
+
+#include "wal.h"
+#include "util.h"
+
+
+/* Group commit state of every WAL file open in this process */
+static WalShared *wal_shared = NULL;
+static pthread_mutex_t wal_shared_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* Add data to a WAL checksum
+ *
+ * This is the checksum used by SQLite, computed over big-endian 32-bit
+ * words (the length must be a multiple of 8 bytes).
+ *
+ * Parameters
+ * - data: Data to add.
+ * - len: Number of bytes.
+ * - cksum: In/out parameter. The checksum so far.
+ */
+static void chidb_Wal_checksum(const uint8_t *data, size_t len, uint32_t *cksum)
+{
+	uint32_t s1 = cksum[0], s2 = cksum[1];
+
+	for (size_t i = 0; i < len; i += 8)
+	{
+		s1 += get4byte(data + i) + s2;
+		s2 += get4byte(data + i + 4) + s1;
+	}
+	cksum[0] = s1;
+	cksum[1] = s2;
+}
+
+
+/* Record a frame as the newest version of a page
+ *
+ * Parameters
+ * - wal: A Wal.
+ * - npage: Page number.
+ * - frame: Frame number.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ */
+static int chidb_Wal_setFrame(Wal *wal, npage_t npage, uint32_t frame)
+{
+	if (npage >= wal->index_size)
+	{
+		npage_t size = wal->index_size ? wal->index_size : 64;
+		while (size <= npage)
+			size *= 2;
+		uint32_t *index = realloc(wal->index, size * sizeof(uint32_t));
+		if (index == NULL)
+			return CHIDB_ENOMEM;
+		memset(index + wal->index_size, 0, (size - wal->index_size) * sizeof(uint32_t));
+		wal->index = index;
+		wal->index_size = size;
+	}
+	wal->index[npage] = frame;
+
+	return CHIDB_OK;
+}
+
+
+/* Forget every frame
+ *
+ * Parameters
+ * - wal: A Wal.
+ */
+static void chidb_Wal_reset(Wal *wal)
+{
+	if (wal->index != NULL)
+		memset(wal->index, 0, wal->index_size * sizeof(uint32_t));
+	wal->n_frames = 0;
+	wal->db_size = 0;
+}
+
+
+/* Find (or create) the group commit state of a WAL file
+ *
+ * Parameters
+ * - wal: A Wal with an open file.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+static int chidb_Wal_share(Wal *wal)
+{
+	uint64_t id[2];
+	WalShared *shared;
+
+	if (chidb_Vfs_id(wal->f, id) != CHIDB_OK)
+		return CHIDB_EIO;
+
+	pthread_mutex_lock(&wal_shared_mutex);
+	for (shared = wal_shared; shared != NULL; shared = shared->next)
+		if (shared->vfs == wal->f->vfs && shared->id[0] == id[0] && shared->id[1] == id[1])
+			break;
+	if (shared == NULL)
+	{
+		shared = calloc(1, sizeof(WalShared));
+		if (shared == NULL)
+		{
+			pthread_mutex_unlock(&wal_shared_mutex);
+			return CHIDB_ENOMEM;
+		}
+		shared->vfs = wal->f->vfs;
+		shared->id[0] = id[0];
+		shared->id[1] = id[1];
+		pthread_mutex_init(&shared->mutex, NULL);
+		pthread_cond_init(&shared->cond, NULL);
+		shared->next = wal_shared;
+		wal_shared = shared;
+	}
+	shared->refs++;
+	pthread_mutex_unlock(&wal_shared_mutex);
+	wal->shared = shared;
+
+	return CHIDB_OK;
+}
+
+
+/* Release the group commit state of a WAL file
+ *
+ * Parameters
+ * - wal: A Wal.
+ */
+static void chidb_Wal_unshare(Wal *wal)
+{
+	WalShared **p;
+
+	if (wal->shared == NULL)
+		return;
+
+	pthread_mutex_lock(&wal_shared_mutex);
+	if (--wal->shared->refs == 0)
+	{
+		for (p = &wal_shared; *p != wal->shared; p = &(*p)->next)
+			;
+		*p = wal->shared->next;
+		pthread_mutex_destroy(&wal->shared->mutex);
+		pthread_cond_destroy(&wal->shared->cond);
+		free(wal->shared);
+	}
+	pthread_mutex_unlock(&wal_shared_mutex);
+	wal->shared = NULL;
+}
+
+
+/* Read the WAL header
+ *
+ * Parameters
+ * - wal: A Wal.
+ * - header: Out parameter. Buffer for the header.
+ *
+ * Return
+ * - true if the WAL has a valid header for this page size
+ */
+static bool chidb_Wal_readHeader(Wal *wal, uint8_t *header)
+{
+	uint32_t cksum[2] = {0, 0};
+
+	if (chidb_Vfs_read(wal->f, header, WAL_HEADER_SIZE, 0) != CHIDB_OK)
+		return false;
+	chidb_Wal_checksum(header, WAL_CKSUM1_OFFSET, cksum);
+
+	return get4byte(header + WAL_MAGIC_OFFSET) == WAL_MAGIC &&
+	       get4byte(header + WAL_PAGESIZE_OFFSET) == wal->page_size &&
+	       get4byte(header + WAL_CKSUM1_OFFSET) == cksum[0] &&
+	       get4byte(header + WAL_CKSUM2_OFFSET) == cksum[1];
+}
+
+
+/* Read the frames after the last known commit
+ *
+ * Frames are read until the end of the file or the first frame with
+ * the wrong salts or checksum. Only frames that belong to a complete
+ * commit are added to the WAL index.
+ *
+ * Parameters
+ * - wal: A Wal.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ */
+static int chidb_Wal_scan(Wal *wal)
+{
+	uint8_t *header, *data;
+	uint32_t cksum[2] = {wal->cksum[0], wal->cksum[1]};
+	npage_t *pending = NULL;
+	uint32_t n_pending = 0;
+	uint64_t offset = WAL_HEADER_SIZE + (uint64_t) wal->n_frames * WALFRAME_SIZE(wal->page_size);
+	int rc = CHIDB_OK;
+
+	header = malloc(WALFRAME_SIZE(wal->page_size));
+	if (header == NULL)
+		return CHIDB_ENOMEM;
+	data = header + WALFRAME_HEADER_SIZE;
+
+	/* Each frame (header and page) is read with a single call */
+	for (; chidb_Vfs_read(wal->f, header, WALFRAME_SIZE(wal->page_size), offset) == CHIDB_OK;
+	     offset += WALFRAME_SIZE(wal->page_size))
+	{
+		if (get4byte(header + WALFRAME_SALT1_OFFSET) != wal->salt1 ||
+		    get4byte(header + WALFRAME_SALT2_OFFSET) != wal->salt2)
+			break;
+		chidb_Wal_checksum(header, WALFRAME_SALT1_OFFSET, cksum);
+		chidb_Wal_checksum(data, wal->page_size, cksum);
+		if (get4byte(header + WALFRAME_CKSUM1_OFFSET) != cksum[0] ||
+		    get4byte(header + WALFRAME_CKSUM2_OFFSET) != cksum[1])
+			break;
+
+		npage_t *p = realloc(pending, (n_pending + 1) * sizeof(npage_t));
+		if (p == NULL)
+		{
+			rc = CHIDB_ENOMEM;
+			break;
+		}
+		pending = p;
+		pending[n_pending++] = get4byte(header + WALFRAME_PAGE_OFFSET);
+
+		npage_t db_size = get4byte(header + WALFRAME_DBSIZE_OFFSET);
+		if (db_size != 0)
+		{
+			/* A commit frame: the frames before it are now valid */
+			for (uint32_t i = 0; rc == CHIDB_OK && i < n_pending; i++)
+				rc = chidb_Wal_setFrame(wal, pending[i], wal->n_frames + 1 + i);
+			if (rc != CHIDB_OK)
+				break;
+			wal->n_frames += n_pending;
+			wal->cksum[0] = cksum[0];
+			wal->cksum[1] = cksum[1];
+			wal->db_size = db_size;
+			n_pending = 0;
+		}
+	}
+
+	free(pending);
+	free(header);
+
+	return rc;
+}
+
+
+/* Open the WAL of a database file
+ *
+ * The WAL is the database file name followed by "-wal". If it already
+ * exists, the frames of every complete commit in it are added to the
+ * WAL index.
+ *
+ * Parameters
+ * - wal: An out parameter. Used to return a pointer to the new Wal.
+ * - vfs: VFS of the database file (the WAL is kept in the same VFS).
+ * - dbfilename: Name of the database file.
+ * - page_size: Size of a page.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Wal_open(Wal **wal, Vfs *vfs, const char *dbfilename, uint16_t page_size)
+{
+	uint8_t header[WAL_HEADER_SIZE];
+
+	*wal = calloc(1, sizeof(Wal));
+	if (*wal == NULL)
+		return CHIDB_ENOMEM;
+	(*wal)->page_size = page_size;
+	(*wal)->filename = malloc(strlen(dbfilename) + strlen(WAL_SUFFIX) + 1);
+	if ((*wal)->filename == NULL)
+	{
+		free(*wal);
+		return CHIDB_ENOMEM;
+	}
+	sprintf((*wal)->filename, "%s%s", dbfilename, WAL_SUFFIX);
+	(*wal)->readers_name = malloc(strlen((*wal)->filename) + strlen(WAL_READERS_SUFFIX) + 1);
+	if ((*wal)->readers_name == NULL)
+	{
+		free((*wal)->filename);
+		free(*wal);
+		return CHIDB_ENOMEM;
+	}
+	sprintf((*wal)->readers_name, "%s%s", (*wal)->filename, WAL_READERS_SUFFIX);
+
+	int rc = chidb_Vfs_open(vfs, (*wal)->filename, VFS_OPEN_CREATE, &(*wal)->f);
+	if (rc != CHIDB_OK)
+	{
+		free((*wal)->readers_name);
+		free((*wal)->filename);
+		free(*wal);
+		return rc;
+	}
+	chidb_Vfs_lock((*wal)->f, VFS_LOCK_SHARED, true);
+	rc = chidb_Vfs_open(vfs, (*wal)->readers_name, VFS_OPEN_CREATE, &(*wal)->readers);
+	if (rc == CHIDB_OK)
+		rc = chidb_Wal_share(*wal);
+	if (rc != CHIDB_OK)
+	{
+		chidb_Wal_close(*wal, false);
+		return rc;
+	}
+
+	if (chidb_Wal_readHeader(*wal, header))
+	{
+		(*wal)->ckpt_seq = get4byte(header + WAL_CKPTSEQ_OFFSET);
+		(*wal)->salt1 = get4byte(header + WAL_SALT1_OFFSET);
+		(*wal)->salt2 = get4byte(header + WAL_SALT2_OFFSET);
+		(*wal)->cksum[0] = get4byte(header + WAL_CKSUM1_OFFSET);
+		(*wal)->cksum[1] = get4byte(header + WAL_CKSUM2_OFFSET);
+		return chidb_Wal_scan(*wal);
+	}
+
+	/* An empty (or unusable) WAL: the first commit writes a new header */
+	(*wal)->salt1 = (uint32_t) time(NULL);
+	(*wal)->salt2 = (uint32_t) rand() ^ ((uint32_t) getpid() << 16);
+
+	return CHIDB_OK;
+}
+
+
+/* Bring the WAL index up to date
+ *
+ * Adds the frames committed by other connections since the index was
+ * last updated. If another connection has restarted the WAL in the
+ * meantime (after a checkpoint), the index is built again from scratch.
+ *
+ * Parameters
+ * - wal: A Wal.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ */
+int chidb_Wal_refresh(Wal *wal)
+{
+	uint8_t header[WAL_HEADER_SIZE];
+
+	if (!chidb_Wal_readHeader(wal, header))
+	{
+		/* Nothing has been committed since the WAL was last restarted */
+		if (wal->n_frames > 0)
+		{
+			chidb_Wal_reset(wal);
+			wal->salt1++;
+		}
+		return CHIDB_OK;
+	}
+
+	if (get4byte(header + WAL_SALT1_OFFSET) != wal->salt1 ||
+	    get4byte(header + WAL_SALT2_OFFSET) != wal->salt2)
+	{
+		chidb_Wal_reset(wal);
+		wal->ckpt_seq = get4byte(header + WAL_CKPTSEQ_OFFSET);
+		wal->salt1 = get4byte(header + WAL_SALT1_OFFSET);
+		wal->salt2 = get4byte(header + WAL_SALT2_OFFSET);
+		wal->cksum[0] = get4byte(header + WAL_CKSUM1_OFFSET);
+		wal->cksum[1] = get4byte(header + WAL_CKSUM2_OFFSET);
+	}
+
+	return chidb_Wal_scan(wal);
+}
+
+
+/* Find the newest version of a page in the WAL
+ *
+ * Parameters
+ * - wal: A Wal.
+ * - npage: Page number.
+ *
+ * Return
+ * - The number of the newest frame for the page, or 0 if the page is
+ *   not in the WAL
+ */
+uint32_t chidb_Wal_findFrame(Wal *wal, npage_t npage)
+{
+	return npage < wal->index_size ? wal->index[npage] : 0;
+}
+
+
+/* Read the page stored in a frame
+ *
+ * Parameters
+ * - wal: A Wal.
+ * - frame: Frame number (starting at 1).
+ * - data: Buffer with room for a page.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Wal_readFrame(Wal *wal, uint32_t frame, uint8_t *data)
+{
+	uint64_t offset = WAL_HEADER_SIZE + (uint64_t) (frame - 1) * WALFRAME_SIZE(wal->page_size) + WALFRAME_HEADER_SIZE;
+
+	if (chidb_Vfs_read(wal->f, data, wal->page_size, offset) != CHIDB_OK)
+		return CHIDB_EIO;
+
+	return CHIDB_OK;
+}
+
+
+/* Read the pages stored in several frames
+ *
+ * The frames are read with a single batch (see chidb_Vfs_readBatch).
+ *
+ * Parameters
+ * - wal: A Wal.
+ * - frames: Frame numbers (starting at 1).
+ * - n: Number of frames.
+ * - data: Buffer with room for n pages, one after the other.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Wal_readFrames(Wal *wal, uint32_t *frames, uint32_t n, uint8_t *data)
+{
+	VfsIo *ios;
+	int rc;
+
+	ios = malloc(n * sizeof(VfsIo));
+	if (ios == NULL)
+		return CHIDB_ENOMEM;
+	for (uint32_t i = 0; i < n; i++)
+	{
+		ios[i].buf = data + (size_t) i * wal->page_size;
+		ios[i].len = wal->page_size;
+		ios[i].offset = WAL_HEADER_SIZE + (uint64_t) (frames[i] - 1) * WALFRAME_SIZE(wal->page_size) + WALFRAME_HEADER_SIZE;
+	}
+	rc = chidb_Vfs_readBatch(wal->f, ios, n);
+	free(ios);
+
+	return (rc == CHIDB_OK || rc == CHIDB_ENOMEM) ? rc : CHIDB_EIO;
+}
+
+
+/* Append a commit to the WAL
+ *
+ * Writes one frame for each page, the last of which is marked as a
+ * commit frame. The frames are only added to the WAL index once they
+ * have been written. They are not flushed to stable storage: the
+ * caller must use chidb_Wal_sync for that, once it no longer holds
+ * the write lock, so that other writers can append in the meantime.
+ *
+ * Parameters
+ * - wal: A Wal.
+ * - pages: Page numbers of the pages to write.
+ * - n: Number of pages (at least 1).
+ * - data: Contents of the pages, indexed by page number.
+ * - db_size: Size of the database (in pages) after this commit.
+ * - commit: Out parameter. Number of the commit (see chidb_Wal_sync).
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_ENOMEM: Could not allocate memory
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Wal_append(Wal *wal, npage_t *pages, npage_t n, uint8_t **data, npage_t db_size, uint64_t *commit)
+{
+	uint8_t *frames, *header;
+	uint64_t offset;
+	uint32_t cksum[2];
+	int rc = CHIDB_OK;
+
+	if (wal->n_frames == 0)
+	{
+		/* The first commit after the WAL was created or restarted */
+		uint8_t walheader[WAL_HEADER_SIZE];
+		put4byte(walheader + WAL_MAGIC_OFFSET, WAL_MAGIC);
+		put4byte(walheader + WAL_VERSION_OFFSET, WAL_VERSION);
+		put4byte(walheader + WAL_PAGESIZE_OFFSET, wal->page_size);
+		put4byte(walheader + WAL_CKPTSEQ_OFFSET, wal->ckpt_seq);
+		put4byte(walheader + WAL_SALT1_OFFSET, wal->salt1);
+		put4byte(walheader + WAL_SALT2_OFFSET, wal->salt2);
+		wal->cksum[0] = wal->cksum[1] = 0;
+		chidb_Wal_checksum(walheader, WAL_CKSUM1_OFFSET, wal->cksum);
+		put4byte(walheader + WAL_CKSUM1_OFFSET, wal->cksum[0]);
+		put4byte(walheader + WAL_CKSUM2_OFFSET, wal->cksum[1]);
+		if (chidb_Vfs_write(wal->f, walheader, WAL_HEADER_SIZE, 0) != CHIDB_OK)
+			return CHIDB_EIO;
+	}
+
+	/* The whole commit is written with a single call */
+	frames = malloc((size_t) n * WALFRAME_SIZE(wal->page_size));
+	if (frames == NULL)
+		return CHIDB_ENOMEM;
+	cksum[0] = wal->cksum[0];
+	cksum[1] = wal->cksum[1];
+	for (npage_t i = 0; i < n; i++)
+	{
+		header = frames + (size_t) i * WALFRAME_SIZE(wal->page_size);
+		put4byte(header + WALFRAME_PAGE_OFFSET, pages[i]);
+		put4byte(header + WALFRAME_DBSIZE_OFFSET, i == n - 1 ? db_size : 0);
+		put4byte(header + WALFRAME_SALT1_OFFSET, wal->salt1);
+		put4byte(header + WALFRAME_SALT2_OFFSET, wal->salt2);
+		chidb_Wal_checksum(header, WALFRAME_SALT1_OFFSET, cksum);
+		chidb_Wal_checksum(data[pages[i]], wal->page_size, cksum);
+		put4byte(header + WALFRAME_CKSUM1_OFFSET, cksum[0]);
+		put4byte(header + WALFRAME_CKSUM2_OFFSET, cksum[1]);
+		memcpy(header + WALFRAME_HEADER_SIZE, data[pages[i]], wal->page_size);
+	}
+	offset = WAL_HEADER_SIZE + (uint64_t) wal->n_frames * WALFRAME_SIZE(wal->page_size);
+	rc = chidb_Vfs_write(wal->f, frames, (size_t) n * WALFRAME_SIZE(wal->page_size), offset);
+	free(frames);
+	if (rc != CHIDB_OK)
+		return rc;
+
+	for (npage_t i = 0; rc == CHIDB_OK && i < n; i++)
+		rc = chidb_Wal_setFrame(wal, pages[i], wal->n_frames + 1 + i);
+	if (rc != CHIDB_OK)
+		return rc;
+	wal->n_frames += n;
+	wal->cksum[0] = cksum[0];
+	wal->cksum[1] = cksum[1];
+	wal->db_size = db_size;
+
+	pthread_mutex_lock(&wal->shared->mutex);
+	*commit = ++wal->shared->n_commits;
+	pthread_cond_broadcast(&wal->shared->cond);
+	pthread_mutex_unlock(&wal->shared->mutex);
+
+	return CHIDB_OK;
+}
+
+
+/* Flush a commit to stable storage
+ *
+ * Commits made at about the same time share a single fsync. The first
+ * thread that needs one becomes the leader: it waits up to max_wait
+ * microseconds for other commits to be appended (stopping early once
+ * batch_size commits are waiting), and then flushes the WAL on behalf
+ * of all of them. The other threads (the followers) wait for a leader
+ * to flush their commit, becoming leaders themselves if it fails.
+ *
+ * Parameters
+ * - wal: A Wal.
+ * - commit: Number of the commit, as returned by chidb_Wal_append.
+ * - max_wait: Time the leader waits for more commits (in microseconds).
+ * - batch_size: Number of commits the leader waits for.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Wal_sync(Wal *wal, uint64_t commit, uint32_t max_wait, uint32_t batch_size)
+{
+	WalShared *shared = wal->shared;
+	int rc = CHIDB_OK;
+
+	pthread_mutex_lock(&shared->mutex);
+	while (rc == CHIDB_OK && shared->n_synced < commit)
+	{
+		if (shared->syncing)
+		{
+			pthread_cond_wait(&shared->cond, &shared->mutex);
+			continue;
+		}
+		shared->syncing = true;
+
+		if (max_wait > 0)
+		{
+			struct timespec deadline;
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_nsec += (long) (max_wait % 1000000) * 1000;
+			deadline.tv_sec += max_wait / 1000000 + deadline.tv_nsec / 1000000000;
+			deadline.tv_nsec %= 1000000000;
+			while (shared->n_commits - shared->n_synced < batch_size &&
+			       pthread_cond_timedwait(&shared->cond, &shared->mutex, &deadline) != ETIMEDOUT)
+				;
+		}
+
+		uint64_t target = shared->n_commits;
+		pthread_mutex_unlock(&shared->mutex);
+		rc = chidb_Vfs_sync(wal->f);
+		pthread_mutex_lock(&shared->mutex);
+
+		shared->syncing = false;
+		if (rc == CHIDB_OK && target > shared->n_synced)
+			shared->n_synced = target;
+		shared->n_syncs++;
+		pthread_cond_broadcast(&shared->cond);
+	}
+	pthread_mutex_unlock(&shared->mutex);
+
+	return rc;
+}
+
+
+/* Flush every commit appended so far to stable storage
+ *
+ * Parameters
+ * - wal: A Wal.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Wal_flush(Wal *wal)
+{
+	pthread_mutex_lock(&wal->shared->mutex);
+	uint64_t target = wal->shared->n_commits;
+	pthread_mutex_unlock(&wal->shared->mutex);
+
+	if (chidb_Vfs_sync(wal->f) != CHIDB_OK)
+		return CHIDB_EIO;
+
+	pthread_mutex_lock(&wal->shared->mutex);
+	if (target > wal->shared->n_synced)
+		wal->shared->n_synced = target;
+	wal->shared->n_syncs++;
+	pthread_cond_broadcast(&wal->shared->cond);
+	pthread_mutex_unlock(&wal->shared->mutex);
+
+	return CHIDB_OK;
+}
+
+
+/* Start and stop reading a snapshot
+ *
+ * The caller holds a shared lock on the readers file from before it
+ * moves to the newest snapshot (see chidb_Wal_refresh) until it no
+ * longer reads from it, so that no checkpoint starts in the meantime.
+ * A reader only waits if a checkpoint is checking for readers, or
+ * restarting the WAL, which are both quick.
+ *
+ * Parameters
+ * - wal: A Wal.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Wal_beginRead(Wal *wal)
+{
+	if (chidb_Vfs_lock(wal->readers, VFS_LOCK_SHARED, true) != CHIDB_OK)
+		return CHIDB_EIO;
+
+	return CHIDB_OK;
+}
+
+void chidb_Wal_endRead(Wal *wal)
+{
+	chidb_Vfs_lock(wal->readers, VFS_LOCK_NONE, true);
+}
+
+
+/* Start and finish a checkpoint
+ *
+ * The caller must hold the write lock, and have the newest snapshot. A
+ * checkpoint can only start when no connection is reading a snapshot,
+ * since an older one may read from the database file the pages that
+ * the checkpoint overwrites. Once it has started, readers can start
+ * again: they read the newest snapshot, in which the pages that the
+ * checkpoint writes are in the WAL.
+ *
+ * Parameters
+ * - wal: A Wal.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EBUSY: Other connections are reading a snapshot
+ */
+int chidb_Wal_beginCheckpoint(Wal *wal)
+{
+	if (chidb_Vfs_lock(wal->readers, VFS_LOCK_EXCLUSIVE, false) != CHIDB_OK)
+		return CHIDB_EBUSY;
+	chidb_Vfs_lock(wal->readers, VFS_LOCK_SHARED, true);
+
+	return CHIDB_OK;
+}
+
+void chidb_Wal_endCheckpoint(Wal *wal)
+{
+	chidb_Vfs_lock(wal->readers, VFS_LOCK_NONE, true);
+}
+
+
+/* Start the WAL over
+ *
+ * Must only be called during a checkpoint (see chidb_Wal_beginCheckpoint),
+ * once every frame has been copied back into the database file. The WAL
+ * is truncated, and the next commit will write a new header with new
+ * salts, so that old frames are never mistaken for new ones. If other
+ * connections started reading during the checkpoint, the WAL is left
+ * as it is: its frames are still valid, and are the same as the pages
+ * in the file.
+ *
+ * Parameters
+ * - wal: A Wal.
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ * - CHIDB_EBUSY: Other connections are reading a snapshot
+ * - CHIDB_EIO: An I/O error has occurred when accessing the file
+ */
+int chidb_Wal_restart(Wal *wal)
+{
+	if (chidb_Vfs_lock(wal->readers, VFS_LOCK_EXCLUSIVE, false) != CHIDB_OK)
+		return CHIDB_EBUSY;
+
+	/* Every commit appended so far is in the database file now */
+	pthread_mutex_lock(&wal->shared->mutex);
+	wal->shared->n_synced = wal->shared->n_commits;
+	pthread_cond_broadcast(&wal->shared->cond);
+	pthread_mutex_unlock(&wal->shared->mutex);
+
+	chidb_Wal_reset(wal);
+	wal->ckpt_seq++;
+	wal->salt1++;
+	wal->salt2 = (uint32_t) rand() ^ ((uint32_t) getpid() << 16);
+
+	if (chidb_Vfs_truncate(wal->f, 0) != CHIDB_OK)
+		return CHIDB_EIO;
+
+	return CHIDB_OK;
+}
+
+
+/* Check whether this is the only connection using the WAL
+ *
+ * Parameters
+ * - wal: A Wal.
+ *
+ * Return
+ * - true if no other connection has the WAL open, false otherwise
+ */
+bool chidb_Wal_isExclusive(Wal *wal)
+{
+	if (chidb_Vfs_lock(wal->f, VFS_LOCK_EXCLUSIVE, false) == CHIDB_OK)
+		return true;
+
+	/* A failed upgrade may have dropped the shared lock */
+	chidb_Vfs_lock(wal->f, VFS_LOCK_SHARED, true);
+	return false;
+}
+
+
+/* Close a WAL
+ *
+ * Parameters
+ * - wal: A Wal.
+ * - remove: Whether to delete the WAL file (only safe after a checkpoint)
+ *
+ * Return
+ * - CHIDB_OK: Operation successful
+ */
+int chidb_Wal_close(Wal *wal, bool remove)
+{
+	Vfs *vfs = wal->f->vfs;
+
+	chidb_Wal_unshare(wal);
+	chidb_Vfs_close(wal->f);
+	if (wal->readers != NULL)
+		chidb_Vfs_close(wal->readers);
+	if (remove)
+	{
+		chidb_Vfs_remove(vfs, wal->filename);
+		chidb_Vfs_remove(vfs, wal->readers_name);
+	}
+	free(wal->filename);
+	free(wal->readers_name);
+	free(wal->index);
+	free(wal);
+
+	return CHIDB_OK;
+}
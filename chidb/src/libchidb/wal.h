@@ -0,0 +1,99 @@
+#ifndef WAL_H_
+#define WAL_H_
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <chidbInt.h>
+#include "vfs.h"
+
+/* Layout of the write-ahead log. It follows the format of SQLite's WAL:
+ * a header with a magic number, the page size, a checkpoint sequence
+ * number, two salts and a checksum of the header, followed by frames.
+ * Each frame is a header (page number, size of the database in pages
+ * if the frame is the last one of a commit and 0 otherwise, the salts
+ * and a cumulative checksum) followed by the contents of the page. */
+#define WAL_SUFFIX "-wal"
+
+/* File locked by connections while they read a snapshot (see
+ * chidb_Wal_beginRead). Its name is that of the WAL followed by this */
+#define WAL_READERS_SUFFIX "-readers"
+#define WAL_MAGIC (0x377f0682)
+#define WAL_VERSION (3007000)
+
+#define WAL_MAGIC_OFFSET (0)
+#define WAL_VERSION_OFFSET (4)
+#define WAL_PAGESIZE_OFFSET (8)
+#define WAL_CKPTSEQ_OFFSET (12)
+#define WAL_SALT1_OFFSET (16)
+#define WAL_SALT2_OFFSET (20)
+#define WAL_CKSUM1_OFFSET (24)
+#define WAL_CKSUM2_OFFSET (28)
+#define WAL_HEADER_SIZE (32)
+
+#define WALFRAME_PAGE_OFFSET (0)
+#define WALFRAME_DBSIZE_OFFSET (4)
+#define WALFRAME_SALT1_OFFSET (8)
+#define WALFRAME_SALT2_OFFSET (12)
+#define WALFRAME_CKSUM1_OFFSET (16)
+#define WALFRAME_CKSUM2_OFFSET (20)
+#define WALFRAME_HEADER_SIZE (24)
+#define WALFRAME_SIZE(page_size) (WALFRAME_HEADER_SIZE + (page_size))
+
+/* Number of frames after which a commit also runs a checkpoint */
+#define WAL_AUTOCHECKPOINT (1000)
+
+/* Group commit state, shared by all the connections of this process that
+ * use the same WAL file. Commits are numbered in the order they were
+ * appended, and a commit is durable once n_synced reaches its number. */
+struct WalShared
+{
+	Vfs *vfs;             /* Identity of the WAL file (see chidb_Vfs_id) */
+	uint64_t id[2];
+	int refs;             /* Number of connections using it */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;  /* Signalled when a commit is appended or synced */
+	uint64_t n_commits;   /* Number of commits appended */
+	uint64_t n_synced;    /* Number of commits flushed to stable storage */
+	bool syncing;         /* A leader is flushing the WAL */
+	uint64_t n_syncs;     /* Number of times the WAL has been flushed */
+	struct WalShared *next;
+};
+typedef struct WalShared WalShared;
+
+struct Wal
+{
+	VfsFile *f;
+	char *filename;       /* Name of the WAL file */
+	VfsFile *readers;     /* Lock held while reading a snapshot */
+	char *readers_name;
+	uint16_t page_size;
+	uint32_t ckpt_seq;    /* Number of times the WAL has been restarted */
+	uint32_t salt1;       /* Salts of the current generation of frames */
+	uint32_t salt2;
+	uint32_t n_frames;    /* Number of frames, up to the last commit */
+	uint32_t cksum[2];    /* Checksum at the end of the last commit */
+	npage_t db_size;      /* Size of the database (in pages) at the last commit (0 if there is none) */
+	uint32_t *index;      /* Newest committed frame of each page, indexed by page number (0 if none) */
+	npage_t index_size;   /* Number of entries in index */
+	WalShared *shared;    /* Group commit state */
+};
+typedef struct Wal Wal;
+
+int chidb_Wal_open(Wal **wal, Vfs *vfs, const char *dbfilename, uint16_t page_size);
+int chidb_Wal_refresh(Wal *wal);
+uint32_t chidb_Wal_findFrame(Wal *wal, npage_t npage);
+int chidb_Wal_readFrame(Wal *wal, uint32_t frame, uint8_t *data);
+int chidb_Wal_readFrames(Wal *wal, uint32_t *frames, uint32_t n, uint8_t *data);
+int chidb_Wal_append(Wal *wal, npage_t *pages, npage_t n, uint8_t **data, npage_t db_size, uint64_t *commit);
+int chidb_Wal_sync(Wal *wal, uint64_t commit, uint32_t max_wait, uint32_t batch_size);
+int chidb_Wal_flush(Wal *wal);
+int chidb_Wal_beginRead(Wal *wal);
+void chidb_Wal_endRead(Wal *wal);
+int chidb_Wal_beginCheckpoint(Wal *wal);
+void chidb_Wal_endCheckpoint(Wal *wal);
+int chidb_Wal_restart(Wal *wal);
+bool chidb_Wal_isExclusive(Wal *wal);
+int chidb_Wal_close(Wal *wal, bool remove);
+
+#endif /*WAL_H_*/
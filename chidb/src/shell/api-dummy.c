@@ -110,6 +110,11 @@ int chidb_column_int(chidb_stmt *stmt, int col)
 		return -1;
 }
 
+int64_t chidb_column_int64(chidb_stmt *stmt, int col)
+{
+	return chidb_column_int(stmt, col);
+}
+
 const char *chidb_column_text(chidb_stmt *stmt, int col)
 {
 	char *s;
@@ -96,6 +96,9 @@ int main(int argc, char *argv[])
     						case SQL_INTEGER_1BYTE: case SQL_INTEGER_2BYTE:	case SQL_INTEGER_4BYTE:
     							printf("%i", chidb_column_int(stmt,i));
     							break;
+    						case SQL_INTEGER_8BYTE:
+    							printf("%lld", (long long) chidb_column_int64(stmt,i));
+    							break;
     						case SQL_TEXT:
     							printf("%s", chidb_column_text(stmt,i));
     							break;
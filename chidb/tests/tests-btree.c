@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <sys/stat.h>
 #include "CUnit/Basic.h"
 #include "libchidb/btree.h"
 #include "libchidb/util.h"
@@ -713,7 +714,7 @@ void test_4_4(void)
 
 void test_values(BTree *bt, key_t *keys, char **values, key_t nkeys)
 {
-  uint16_t size;
+  uint32_t size;
   uint8_t *data;
   int rc;	
   
@@ -739,7 +740,7 @@ void test_5_1(void)
 void test_5_2(void)
 {
   chidb *db;
-  uint16_t size;
+  uint32_t size;
   uint8_t *data;
   key_t nokeys[] = {0,4,6,8,9,11,18,27,36,40,100,650,1500,2500,3500,4500,5500};
   int rc;
@@ -825,7 +826,7 @@ void test_bigfile(chidb *db)
   
   for (int i=0; i<bigfile_nvalues; i++) {
     uint8_t* buf;
-    uint16_t size;
+    uint32_t size;
     uint8_t data[192];
     int datalen = ((bigfile_pkeys[i] % 3) + 1) * 64;
     
@@ -833,7 +834,7 @@ void test_bigfile(chidb *db)
       put4byte(data + (4*j), bigfile_ikeys[i]);
     
     rc = chidb_Btree_find(db->bt, 1, bigfile_pkeys[i], &buf, &size);
-    if(rc) printf("Error at %i\n", bigfile_pkeys[i]);
+    if(rc) printf("Error at %llu\n", (unsigned long long) bigfile_pkeys[i]);
     CU_ASSERT(rc == CHIDB_OK);
     CU_ASSERT(size == datalen);
     CU_ASSERT(!memcmp(buf, data, datalen));
@@ -881,7 +882,7 @@ void test_index_bigfile(chidb *db, npage_t index_nroot)
   int rc;
   for (int i=0; i<bigfile_nvalues; i++) {
     uint8_t* buf;
-    uint16_t size;
+    uint32_t size;
     uint8_t data[192];
     key_t pkey;
     
@@ -894,7 +895,7 @@ void test_index_bigfile(chidb *db, npage_t index_nroot)
       put4byte(data + (4*j), bigfile_ikeys[i]);
     
     rc = chidb_Btree_find(db->bt, 1, pkey, &buf, &size);
-    if(rc) printf("Error at key %i\n", bigfile_ikeys[i]);
+    if(rc) printf("Error at key %llu\n", (unsigned long long) bigfile_ikeys[i]);
     CU_ASSERT(rc == CHIDB_OK);
     CU_ASSERT(size == datalen);
     CU_ASSERT(!memcmp(buf, data, datalen));
@@ -1037,6 +1038,1789 @@ void test_8_3(void)
   free(db);
 }
 
+void test_deleted_bigfile(chidb *db, bool *deleted)
+{
+  int rc;
+  uint8_t* buf;
+  uint32_t size;
+
+  for (int i=0; i<bigfile_nvalues; i++) {
+    rc = chidb_Btree_find(db->bt, 1, bigfile_pkeys[i], &buf, &size);
+    CU_ASSERT(rc == (deleted[i] ? CHIDB_ENOTFOUND : CHIDB_OK));
+  }
+}
+
+void test_12_1(void)
+{
+  chidb *db;
+  int rc;
+  bool *deleted;
+  npage_t npages;
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT(rc == CHIDB_OK);
+
+  for (int i=0; i<bigfile_nvalues; i++)
+    insert_bigfile(db, i);
+  npages = db->bt->pager->n_pages;
+
+  deleted = calloc(bigfile_nvalues, sizeof(bool));
+  for (int i=0; i<bigfile_nvalues; i+=2) {
+    rc = chidb_Btree_delete(db->bt, 1, bigfile_pkeys[i]);
+    CU_ASSERT(rc == CHIDB_OK);
+    deleted[i] = true;
+  }
+  test_deleted_bigfile(db, deleted);
+
+  rc = chidb_Btree_delete(db->bt, 1, bigfile_pkeys[0]);
+  CU_ASSERT(rc == CHIDB_ENOTFOUND);
+
+  for (int i=1; i<bigfile_nvalues; i+=2) {
+    rc = chidb_Btree_delete(db->bt, 1, bigfile_pkeys[i]);
+    CU_ASSERT(rc == CHIDB_OK);
+    deleted[i] = true;
+  }
+  test_deleted_bigfile(db, deleted);
+
+  /* The root is an empty leaf again, and all other pages are free */
+  BTreeNode *btn;
+  chidb_Btree_getNodeByPage(db->bt, 1, &btn);
+  CU_ASSERT(btn->type == PGTYPE_TABLE_LEAF);
+  CU_ASSERT(btn->n_cells == 0);
+  chidb_Btree_freeMemNode(db->bt, btn);
+  CU_ASSERT(db->bt->pager->n_free == db->bt->pager->n_pages - 1);
+
+  /* Freed pages are reused */
+  for (int i=0; i<bigfile_nvalues; i++)
+    insert_bigfile(db, i);
+  test_bigfile(db);
+  CU_ASSERT(db->bt->pager->n_pages == npages);
+
+  free(deleted);
+  chidb_Btree_close(db->bt);
+  free(db);
+}
+
+void test_12_2(void)
+{
+  chidb *db;
+  int rc;
+  bool *deleted;
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT(rc == CHIDB_OK);
+
+  for (int i=0; i<bigfile_nvalues; i++)
+    insert_bigfile(db, i);
+
+  deleted = calloc(bigfile_nvalues, sizeof(bool));
+  for (int i=bigfile_nvalues-1; i>=0; i--) {
+    rc = chidb_Btree_delete(db->bt, 1, bigfile_pkeys[i]);
+    CU_ASSERT(rc == CHIDB_OK);
+    deleted[i] = true;
+    if (i % 64 == 0)
+      test_deleted_bigfile(db, deleted);
+  }
+
+  free(deleted);
+  chidb_Btree_close(db->bt);
+  free(db);
+}
+
+void test_12_3(void)
+{
+  chidb *db;
+  int rc;
+  npage_t npage;
+  key_t pkey;
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT(rc == CHIDB_OK);
+
+  for (int i=0; i<bigfile_nvalues; i++)
+    insert_bigfile(db, i);
+
+  chidb_Btree_newNode(db->bt, &npage, PGTYPE_INDEX_LEAF);
+  for (int i=0; i<bigfile_nvalues; i++)
+    chidb_Btree_insertInIndex(db->bt, npage, bigfile_ikeys[i], bigfile_pkeys[i]);
+
+  for (int i=0; i<bigfile_nvalues; i+=2) {
+    rc = chidb_Btree_delete(db->bt, npage, bigfile_ikeys[i]);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+
+  for (int i=0; i<bigfile_nvalues; i++) {
+    rc = chidb_Btree_findInIndex(db->bt, npage, bigfile_ikeys[i], &pkey);
+    if (i % 2 == 0) {
+      CU_ASSERT(rc == CHIDB_ENOTFOUND);
+    } else {
+      CU_ASSERT(rc == CHIDB_OK);
+      CU_ASSERT(pkey == bigfile_pkeys[i]);
+    }
+  }
+
+  for (int i=1; i<bigfile_nvalues; i+=2) {
+    rc = chidb_Btree_delete(db->bt, npage, bigfile_ikeys[i]);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+
+  BTreeNode *btn;
+  chidb_Btree_getNodeByPage(db->bt, npage, &btn);
+  CU_ASSERT(btn->type == PGTYPE_INDEX_LEAF);
+  CU_ASSERT(btn->n_cells == 0);
+  chidb_Btree_freeMemNode(db->bt, btn);
+
+  /* The table is untouched */
+  test_bigfile(db);
+
+  chidb_Btree_close(db->bt);
+  free(db);
+}
+
+void test_13_1(void)
+{
+  chidb *db;
+  int rc;
+  npage_t npages;
+  uint8_t* buf;
+  uint32_t size;
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT(rc == CHIDB_OK);
+
+  for (int i=0; i<bigfile_nvalues; i++)
+    insert_bigfile(db, i);
+  npages = db->bt->pager->n_pages;
+
+  /* Same-size updates are done in place */
+  for (int i=0; i<bigfile_nvalues; i++) {
+    uint8_t data[192];
+    int datalen = ((bigfile_pkeys[i] % 3) + 1) * 64;
+    memset(data, i % 256, datalen);
+    rc = chidb_Btree_update(db->bt, 1, bigfile_pkeys[i], data, datalen);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+  CU_ASSERT(db->bt->pager->n_pages == npages);
+
+  for (int i=0; i<bigfile_nvalues; i++) {
+    rc = chidb_Btree_find(db->bt, 1, bigfile_pkeys[i], &buf, &size);
+    CU_ASSERT(rc == CHIDB_OK);
+    CU_ASSERT(size == ((bigfile_pkeys[i] % 3) + 1) * 64);
+    CU_ASSERT(buf[0] == i % 256 && buf[size-1] == i % 256);
+    free(buf);
+  }
+
+  uint8_t missing[64] = {0};
+  rc = chidb_Btree_update(db->bt, 1, 3, missing, 64);
+  CU_ASSERT(rc == CHIDB_ENOTFOUND);
+
+  chidb_Btree_close(db->bt);
+  free(db);
+}
+
+void test_13_2(void)
+{
+  chidb *db;
+  int rc;
+  uint8_t* buf;
+  uint32_t size;
+  uint8_t data[192];
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT(rc == CHIDB_OK);
+
+  for (int i=0; i<bigfile_nvalues; i++)
+    insert_bigfile(db, i);
+
+  /* Every record changes size, so some of them must move to another node */
+  for (int i=0; i<bigfile_nvalues; i++) {
+    int datalen = (((bigfile_pkeys[i] + 1) % 3) + 1) * 64;
+    memset(data, i % 256, datalen);
+    rc = chidb_Btree_update(db->bt, 1, bigfile_pkeys[i], data, datalen);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+
+  for (int i=0; i<bigfile_nvalues; i++) {
+    rc = chidb_Btree_find(db->bt, 1, bigfile_pkeys[i], &buf, &size);
+    CU_ASSERT(rc == CHIDB_OK);
+    CU_ASSERT(size == (((bigfile_pkeys[i] + 1) % 3) + 1) * 64);
+    CU_ASSERT(buf[0] == i % 256 && buf[size-1] == i % 256);
+    free(buf);
+  }
+
+  chidb_Btree_close(db->bt);
+  free(db);
+}
+
+/* Adds a row for a B-Tree to the schema table in page 1 */
+void insert_schema_row(chidb *db, key_t key, char *type, char *name, npage_t nroot)
+{
+  DBRecord *dbr;
+  uint8_t *buf;
+
+  chidb_DBRecord_create(&dbr, "|s|s|s|i4|s|", type, name, name, nroot, "");
+  chidb_DBRecord_pack(dbr, &buf);
+  CU_ASSERT(chidb_Btree_insertInTable(db->bt, 1, key, buf, dbr->packed_len) == CHIDB_OK);
+  free(buf);
+  chidb_DBRecord_destroy(dbr);
+}
+
+/* Reads the root page of a B-Tree from the schema table in page 1 */
+npage_t schema_root(chidb *db, ncell_t ncell)
+{
+  BTreeNode *btn;
+  BTreeCell btc;
+  DBRecord *dbr;
+  int32_t nroot;
+
+  chidb_Btree_getNodeByPage(db->bt, 1, &btn);
+  chidb_Btree_getCell(btn, ncell, &btc);
+  chidb_DBRecord_unpack(&dbr, btc.fields.tableLeaf.data);
+  chidb_DBRecord_getInt32(dbr, 3, &nroot);
+  chidb_DBRecord_destroy(dbr);
+  chidb_Btree_freeMemNode(db->bt, btn);
+
+  return nroot;
+}
+
+void test_14_1(void)
+{
+  chidb *db;
+  int rc;
+  npage_t ntable, nindex, npages;
+  uint8_t* buf;
+  uint32_t size;
+  key_t pkey;
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT(rc == CHIDB_OK);
+
+  chidb_Btree_newNode(db->bt, &ntable, PGTYPE_TABLE_LEAF);
+  chidb_Btree_newNode(db->bt, &nindex, PGTYPE_INDEX_LEAF);
+  insert_schema_row(db, 1, "table", "big", ntable);
+  insert_schema_row(db, 2, "index", "bigidx", nindex);
+
+  for (int i=0; i<bigfile_nvalues; i++) {
+    uint8_t data[192];
+    for (int j=0; j<48; j++)
+      put4byte(data + (4*j), bigfile_ikeys[i]);
+    rc = chidb_Btree_insertInTable(db->bt, ntable, bigfile_pkeys[i], data, ((bigfile_pkeys[i] % 3) + 1) * 64);
+    CU_ASSERT(rc == CHIDB_OK);
+    rc = chidb_Btree_insertInIndex(db->bt, nindex, bigfile_ikeys[i], bigfile_pkeys[i]);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+  /* Leave some free pages behind, too */
+  for (int i=0; i<bigfile_nvalues; i+=4)
+    chidb_Btree_delete(db->bt, ntable, bigfile_pkeys[i]);
+  npages = db->bt->pager->n_pages;
+
+  rc = chidb_Btree_vacuum(db->bt);
+  CU_ASSERT(rc == CHIDB_OK);
+  CU_ASSERT(db->bt->pager->n_free == 0);
+  CU_ASSERT(db->bt->pager->n_pages < npages * 2 / 3);
+
+  /* The file can be reopened, and the schema table has the new roots */
+  chidb_Btree_close(db->bt);
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT(rc == CHIDB_OK);
+  ntable = schema_root(db, 0);
+  nindex = schema_root(db, 1);
+
+  for (int i=0; i<bigfile_nvalues; i++) {
+    rc = chidb_Btree_find(db->bt, ntable, bigfile_pkeys[i], &buf, &size);
+    if (i % 4 == 0) {
+      CU_ASSERT(rc == CHIDB_ENOTFOUND);
+    } else {
+      CU_ASSERT(rc == CHIDB_OK);
+      CU_ASSERT(size == ((bigfile_pkeys[i] % 3) + 1) * 64);
+      CU_ASSERT(get4byte(buf) == bigfile_ikeys[i]);
+      free(buf);
+    }
+    rc = chidb_Btree_findInIndex(db->bt, nindex, bigfile_ikeys[i], &pkey);
+    CU_ASSERT(rc == CHIDB_OK);
+    CU_ASSERT(pkey == bigfile_pkeys[i]);
+  }
+
+  /* The rebuilt trees can still be modified */
+  for (int i=0; i<bigfile_nvalues; i+=4) {
+    uint8_t data[64] = {0};
+    rc = chidb_Btree_insertInTable(db->bt, ntable, bigfile_pkeys[i], data, 64);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+  for (int i=0; i<bigfile_nvalues; i++) {
+    rc = chidb_Btree_find(db->bt, ntable, bigfile_pkeys[i], &buf, &size);
+    CU_ASSERT(rc == CHIDB_OK);
+    if (rc == CHIDB_OK)
+      free(buf);
+  }
+
+  chidb_Btree_close(db->bt);
+  free(db);
+}
+
+void test_14_2(void)
+{
+  chidb *db;
+  chidb_stmt *stmt;
+  int rc, nrows;
+  npage_t npages;
+
+  create_temp_file(MULTIINDEXFILE);
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  npages = db->bt->pager->n_pages;
+
+  rc = chidb_prepare(db, "VACUUM;", &stmt);
+  CU_ASSERT(rc == CHIDB_OK);
+  rc = chidb_step(stmt);
+  CU_ASSERT(rc == CHIDB_DONE);
+  chidb_finalize(stmt);
+  CU_ASSERT(db->bt->pager->n_pages < npages);
+
+  rc = chidb_prepare(db, "SELECT * FROM numbers;", &stmt);
+  CU_ASSERT(rc == CHIDB_OK);
+  nrows = 0;
+  while ((rc = chidb_step(stmt)) == CHIDB_ROW)
+    nrows++;
+  CU_ASSERT(rc == CHIDB_DONE);
+  CU_ASSERT(nrows == 2048);
+  chidb_finalize(stmt);
+
+  chidb_close(db);
+}
+
+#define NBIGRECORDS (64)
+
+/* Size and contents of large records that need overflow pages */
+uint32_t bigrecord_size(int i)
+{
+  return 100 + i * 157;
+}
+
+void fill_bigrecord(uint8_t *data, int i, uint32_t size)
+{
+  for (uint32_t j=0; j<size; j++)
+    data[j] = (i + j) % 251;
+}
+
+void test_15_1(void)
+{
+  chidb *db;
+  int rc;
+  uint8_t *buf;
+  uint32_t size;
+  uint8_t data[NBIGRECORDS * 157 + 100];
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT(rc == CHIDB_OK);
+
+  for (int i=0; i<NBIGRECORDS; i++) {
+    fill_bigrecord(data, i, bigrecord_size(i));
+    rc = chidb_Btree_insertInTable(db->bt, 1, (i * 37) % NBIGRECORDS + 1, data, bigrecord_size(i));
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+
+  /* Duplicates do not leave their overflow pages behind */
+  npage_t npages = db->bt->pager->n_pages;
+  fill_bigrecord(data, 0, 5000);
+  rc = chidb_Btree_insertInTable(db->bt, 1, 1, data, 5000);
+  CU_ASSERT(rc == CHIDB_EDUPLICATE);
+  CU_ASSERT(db->bt->pager->n_pages - npages == db->bt->pager->n_free);
+
+  for (int i=0; i<NBIGRECORDS; i++) {
+    rc = chidb_Btree_find(db->bt, 1, (i * 37) % NBIGRECORDS + 1, &buf, &size);
+    CU_ASSERT(rc == CHIDB_OK);
+    CU_ASSERT(size == bigrecord_size(i));
+    fill_bigrecord(data, i, bigrecord_size(i));
+    CU_ASSERT(!memcmp(buf, data, size));
+    free(buf);
+  }
+
+  /* Deleting every record frees all its overflow pages */
+  for (int i=0; i<NBIGRECORDS; i++) {
+    rc = chidb_Btree_delete(db->bt, 1, i + 1);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+  CU_ASSERT(db->bt->pager->n_free == db->bt->pager->n_pages - 1);
+
+  chidb_Btree_close(db->bt);
+  free(db);
+}
+
+void test_15_2(void)
+{
+  chidb *db;
+  int rc;
+  uint8_t *buf;
+  uint32_t size;
+  uint8_t data[3000];
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT(rc == CHIDB_OK);
+
+  for (int i=0; i<NBIGRECORDS; i++) {
+    fill_bigrecord(data, i, 64);
+    rc = chidb_Btree_insertInTable(db->bt, 1, i + 1, data, 64);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+
+  /* Small records become large ones, and then small again */
+  for (int i=0; i<NBIGRECORDS; i++) {
+    fill_bigrecord(data, i + 1, 3000);
+    rc = chidb_Btree_update(db->bt, 1, i + 1, data, 3000);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+  for (int i=0; i<NBIGRECORDS; i++) {
+    rc = chidb_Btree_find(db->bt, 1, i + 1, &buf, &size);
+    CU_ASSERT(rc == CHIDB_OK);
+    CU_ASSERT(size == 3000);
+    fill_bigrecord(data, i + 1, 3000);
+    CU_ASSERT(!memcmp(buf, data, size));
+    free(buf);
+  }
+
+  npage_t nfree = db->bt->pager->n_free;
+  for (int i=0; i<NBIGRECORDS; i++) {
+    fill_bigrecord(data, i + 2, 64);
+    rc = chidb_Btree_update(db->bt, 1, i + 1, data, 64);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+  CU_ASSERT(db->bt->pager->n_free >= nfree + NBIGRECORDS * 2);
+  for (int i=0; i<NBIGRECORDS; i++) {
+    rc = chidb_Btree_find(db->bt, 1, i + 1, &buf, &size);
+    CU_ASSERT(rc == CHIDB_OK);
+    CU_ASSERT(size == 64);
+    fill_bigrecord(data, i + 2, 64);
+    CU_ASSERT(!memcmp(buf, data, size));
+    free(buf);
+  }
+
+  chidb_Btree_close(db->bt);
+  free(db);
+}
+
+void test_16_1(void)
+{
+  chidb *db;
+  int rc;
+  uint8_t *buf;
+  uint32_t size;
+  uint8_t data[3000];
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT(rc == CHIDB_OK);
+  rc = chidb_Btree_setJournalMode(db->bt, 42);
+  CU_ASSERT(rc == CHIDB_EMISUSE);
+  rc = chidb_Btree_setJournalMode(db->bt, CHIDB_JOURNAL_WAL);
+  CU_ASSERT(rc == CHIDB_OK);
+  CU_ASSERT(db->bt->pager->wal != NULL);
+
+  for (int i=0; i<NBIGRECORDS; i++) {
+    fill_bigrecord(data, i, bigrecord_size(i) % 3000);
+    rc = chidb_Btree_insertInTable(db->bt, 1, i + 1, data, bigrecord_size(i) % 3000);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+  chidb_Btree_close(db->bt);
+
+  /* The journal mode is stored in the file header */
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT(rc == CHIDB_OK);
+  CU_ASSERT(db->bt->pager->wal != NULL);
+  for (int i=0; i<NBIGRECORDS; i++) {
+    rc = chidb_Btree_find(db->bt, 1, i + 1, &buf, &size);
+    CU_ASSERT(rc == CHIDB_OK);
+    CU_ASSERT(size == bigrecord_size(i) % 3000);
+    fill_bigrecord(data, i, bigrecord_size(i) % 3000);
+    CU_ASSERT(!memcmp(buf, data, size));
+    free(buf);
+  }
+  rc = chidb_Btree_setJournalMode(db->bt, CHIDB_JOURNAL_DELETE);
+  CU_ASSERT(rc == CHIDB_OK);
+  CU_ASSERT(db->bt->pager->wal == NULL);
+  chidb_Btree_close(db->bt);
+
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT(rc == CHIDB_OK);
+  CU_ASSERT(db->bt->pager->wal == NULL);
+  rc = chidb_Btree_find(db->bt, 1, NBIGRECORDS, &buf, &size);
+  CU_ASSERT(rc == CHIDB_OK);
+  free(buf);
+  chidb_Btree_close(db->bt);
+  free(db);
+}
+
+/* Runs a statement that does not return any rows */
+int exec_sql(chidb *db, const char *sql)
+{
+  chidb_stmt *stmt;
+  int rc;
+
+  rc = chidb_prepare(db, sql, &stmt);
+  if (rc != CHIDB_OK)
+    return rc;
+  rc = chidb_step(stmt);
+  chidb_finalize(stmt);
+
+  return rc;
+}
+
+int count_rows(chidb *db, const char *sql)
+{
+  chidb_stmt *stmt;
+  int nrows = 0;
+
+  chidb_prepare(db, sql, &stmt);
+  while (chidb_step(stmt) == CHIDB_ROW)
+    nrows++;
+  chidb_finalize(stmt);
+
+  return nrows;
+}
+
+void test_16_2(void)
+{
+  chidb *db, *db2;
+  chidb_stmt *stmt;
+  int rc, nrows;
+  uint32_t ckpt_seq;
+  char sql[128];
+
+  create_temp_file(MULTIINDEXFILE);
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(exec_sql(db, "PRAGMA journal_mode = WAL;") == CHIDB_DONE);
+  CU_ASSERT(exec_sql(db, "PRAGMA synchronous = OFF;") == CHIDB_DONE);
+  CU_ASSERT(exec_sql(db, "INSERT INTO numbers VALUES(900000, \"x\", 0);") == CHIDB_DONE);
+
+  /* A reader in another connection takes its snapshot... */
+  rc = chidb_open(TEMPFILE, &db2);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT_FATAL(db2->bt->pager->wal != NULL);
+  CU_ASSERT_FATAL(chidb_prepare(db2, "SELECT * FROM numbers;", &stmt) == CHIDB_OK);
+  ckpt_seq = db->bt->pager->wal->ckpt_seq;
+
+  /* ... and keeps it while the writer goes past the automatic checkpoint,
+   * which neither overwrites the file nor restarts the WAL under it */
+  for (int i=1; db->bt->pager->wal->n_frames < WAL_AUTOCHECKPOINT + 10; i++) {
+    sprintf(sql, "INSERT INTO numbers VALUES(%i, \"x\", %i);", 900000 + i, i);
+    CU_ASSERT_FATAL(exec_sql(db, sql) == CHIDB_DONE);
+  }
+  CU_ASSERT(chidb_Pager_checkpoint(db->bt->pager) == CHIDB_EBUSY);
+  CU_ASSERT(db->bt->pager->wal->ckpt_seq == ckpt_seq);
+  nrows = 0;
+  while ((rc = chidb_step(stmt)) == CHIDB_ROW)
+    nrows++;
+  CU_ASSERT(rc == CHIDB_DONE);
+  CU_ASSERT(nrows == 2048 + 1);
+  chidb_finalize(stmt);
+
+  /* Once it is done, the next commit checkpoints */
+  nrows = count_rows(db, "SELECT * FROM numbers;");
+  CU_ASSERT(exec_sql(db, "INSERT INTO numbers VALUES(899999, \"x\", 0);") == CHIDB_DONE);
+  CU_ASSERT(db->bt->pager->wal->ckpt_seq == ckpt_seq + 1);
+  CU_ASSERT(db->bt->pager->wal->n_frames < WAL_AUTOCHECKPOINT);
+  CU_ASSERT(count_rows(db2, "SELECT * FROM numbers;") == nrows + 1);
+  CU_ASSERT(count_rows(db, "SELECT * FROM numbers;") == nrows + 1);
+  chidb_close(db2);
+  chidb_close(db);
+
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(count_rows(db, "SELECT * FROM numbers;") == nrows + 1);
+  chidb_close(db);
+}
+
+void test_17_1(void)
+{
+  chidb *db;
+  int rc;
+  char sql[128];
+
+  create_temp_file(MULTIINDEXFILE);
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+
+  CU_ASSERT(exec_sql(db, "COMMIT;") == CHIDB_EMISUSE);
+  CU_ASSERT(exec_sql(db, "ROLLBACK;") == CHIDB_EMISUSE);
+
+  /* Rolled back inserts are gone */
+  CU_ASSERT(exec_sql(db, "BEGIN;") == CHIDB_DONE);
+  CU_ASSERT(exec_sql(db, "BEGIN TRANSACTION;") == CHIDB_EMISUSE);
+  for (int i=0; i<100; i++) {
+    sprintf(sql, "INSERT INTO numbers VALUES(%i, \"x\", %i);", 900000 + i, i);
+    CU_ASSERT(exec_sql(db, sql) == CHIDB_DONE);
+  }
+  CU_ASSERT(count_rows(db, "SELECT * FROM numbers;") == 2048 + 100);
+  CU_ASSERT(exec_sql(db, "VACUUM;") == CHIDB_EMISUSE);
+  CU_ASSERT(exec_sql(db, "ROLLBACK;") == CHIDB_DONE);
+  CU_ASSERT(count_rows(db, "SELECT * FROM numbers;") == 2048);
+
+  /* Committed inserts are in the file */
+  CU_ASSERT(chidb_begin(db) == CHIDB_OK);
+  for (int i=0; i<100; i++) {
+    sprintf(sql, "INSERT INTO numbers VALUES(%i, \"x\", %i);", 900000 + i, i);
+    CU_ASSERT(exec_sql(db, sql) == CHIDB_DONE);
+  }
+  CU_ASSERT(exec_sql(db, "END TRANSACTION;") == CHIDB_DONE);
+  CU_ASSERT(chidb_commit(db) == CHIDB_EMISUSE);
+  chidb_close(db);
+
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(count_rows(db, "SELECT * FROM numbers;") == 2048 + 100);
+  CU_ASSERT(count_rows(db, "SELECT * FROM numbers WHERE code = 900042;") == 1);
+  chidb_close(db);
+}
+
+void test_17_2(void)
+{
+  chidb *db;
+  int rc, nrows;
+  uint32_t counter;
+
+  create_temp_file(MULTIINDEXFILE);
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  nrows = count_rows(db, "SELECT * FROM numbers WHERE code < 2000;");
+  CU_ASSERT(nrows > 100);
+
+  /* A statement is committed once (which bumps the change counter
+   * once), however many rows and index entries it changes */
+  counter = db->bt->pager->change_counter;
+  CU_ASSERT(exec_sql(db, "UPDATE numbers SET textcode = \"y\" WHERE code < 2000;") == CHIDB_DONE);
+  CU_ASSERT(db->bt->pager->change_counter == counter + 1);
+  CU_ASSERT(exec_sql(db, "DELETE FROM numbers WHERE code < 2000;") == CHIDB_DONE);
+  CU_ASSERT(db->bt->pager->change_counter == counter + 2);
+  CU_ASSERT(!db->bt->pager->in_txn);
+
+  /* Inside a transaction, statements are only committed with it */
+  CU_ASSERT(exec_sql(db, "BEGIN;") == CHIDB_DONE);
+  CU_ASSERT(exec_sql(db, "INSERT INTO numbers VALUES(900000, \"x\", 1);") == CHIDB_DONE);
+  CU_ASSERT(exec_sql(db, "INSERT INTO numbers VALUES(900000, \"x\", 1);") == CHIDB_ECONSTRAINT);
+  CU_ASSERT(db->bt->pager->in_txn);
+  CU_ASSERT(db->bt->pager->change_counter == counter + 2);
+  CU_ASSERT(exec_sql(db, "COMMIT;") == CHIDB_DONE);
+  CU_ASSERT(db->bt->pager->change_counter == counter + 3);
+  chidb_close(db);
+
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(count_rows(db, "SELECT * FROM numbers;") == 2048 - nrows + 1);
+  CU_ASSERT(count_rows(db, "SELECT * FROM numbers WHERE code < 2000;") == 0);
+  CU_ASSERT(count_rows(db, "SELECT * FROM numbers WHERE textcode = \"y\";") == 0);
+  chidb_close(db);
+}
+
+void test_18_1(void)
+{
+  chidb *db;
+  int rc;
+  char sql[128];
+
+  create_temp_file(MULTIINDEXFILE);
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(db->bt->pager->sync_mode == CHIDB_SYNC_FULL);
+
+  CU_ASSERT(chidb_synchronous(db, 3) == CHIDB_EMISUSE);
+  CU_ASSERT(exec_sql(db, "PRAGMA synchronous = off;") == CHIDB_DONE);
+  CU_ASSERT(db->bt->pager->sync_mode == CHIDB_SYNC_OFF);
+  CU_ASSERT(exec_sql(db, "PRAGMA synchronous = 2;") == CHIDB_DONE);
+  CU_ASSERT(db->bt->pager->sync_mode == CHIDB_SYNC_FULL);
+  CU_ASSERT(exec_sql(db, "PRAGMA synchronous = sometimes;") == CHIDB_EINVALIDSQL);
+  CU_ASSERT(exec_sql(db, "PRAGMA synchronicity = FULL;") == CHIDB_EINVALIDSQL);
+
+  /* In WAL mode with NORMAL, commits do not flush the WAL */
+  CU_ASSERT(exec_sql(db, "PRAGMA journal_mode = WAL;") == CHIDB_DONE);
+  CU_ASSERT(db->bt->pager->wal != NULL);
+  CU_ASSERT(exec_sql(db, "PRAGMA synchronous = NORMAL;") == CHIDB_DONE);
+  for (int i=0; i<10; i++) {
+    sprintf(sql, "INSERT INTO numbers VALUES(%i, \"x\", %i);", 900000 + i, i);
+    CU_ASSERT(exec_sql(db, sql) == CHIDB_DONE);
+  }
+  CU_ASSERT(db->bt->pager->wal->shared->n_syncs == 0);
+  CU_ASSERT(exec_sql(db, "PRAGMA journal_mode = DELETE;") == CHIDB_DONE);
+  CU_ASSERT(db->bt->pager->wal == NULL);
+  chidb_close(db);
+
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(count_rows(db, "SELECT * FROM numbers;") == 2048 + 10);
+  chidb_close(db);
+}
+
+void test_19_1(void)
+{
+  chidb *db, *db2;
+  int rc;
+  npage_t ntable, nindex;
+  uint8_t* buf;
+  uint32_t size;
+
+  rc = chidb_open(":memory:", &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  rc = chidb_open(":memory:", &db2);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(db->bt->pager->n_pages == 1);
+
+  chidb_Btree_newNode(db->bt, &ntable, PGTYPE_TABLE_LEAF);
+  chidb_Btree_newNode(db->bt, &nindex, PGTYPE_INDEX_LEAF);
+  insert_schema_row(db, 1, "table", "big", ntable);
+  insert_schema_row(db, 2, "index", "bigidx", nindex);
+  chidb_load_schema(db);
+  for (int i=0; i<bigfile_nvalues; i++) {
+    uint8_t data[64];
+    for (int j=0; j<16; j++)
+      put4byte(data + (4*j), bigfile_ikeys[i]);
+    CU_ASSERT(chidb_Btree_insertInTable(db->bt, ntable, bigfile_pkeys[i], data, 64) == CHIDB_OK);
+    CU_ASSERT(chidb_Btree_insertInIndex(db->bt, nindex, bigfile_ikeys[i], bigfile_pkeys[i]) == CHIDB_OK);
+  }
+  for (int i=0; i<bigfile_nvalues; i+=2)
+    chidb_Btree_delete(db->bt, ntable, bigfile_pkeys[i]);
+
+  /* The other in-memory database is unaffected */
+  CU_ASSERT(db2->bt->pager->n_pages == 1);
+
+  /* Vacuuming replaces the in-memory file */
+  CU_ASSERT(chidb_Btree_vacuum(db->bt) == CHIDB_OK);
+  CU_ASSERT(db->bt->pager->n_free == 0);
+  CU_ASSERT(db->bt->pager->vfs == chidb_Vfs_find("memory"));
+  for (int j=0; j<db->bt->schema_table_size; j++)
+    if (!strcmp(db->bt->schema_table[j]->item_name, "big"))
+      ntable = db->bt->schema_table[j]->root_page;
+  for (int i=0; i<bigfile_nvalues; i++) {
+    rc = chidb_Btree_find(db->bt, ntable, bigfile_pkeys[i], &buf, &size);
+    CU_ASSERT(rc == (i % 2 ? CHIDB_OK : CHIDB_ENOTFOUND));
+    if (rc == CHIDB_OK) {
+      CU_ASSERT(get4byte(buf) == bigfile_ikeys[i]);
+      free(buf);
+    }
+  }
+
+  chidb_close(db);
+  chidb_close(db2);
+}
+
+void test_20_1(void)
+{
+  chidb *db;
+  int rc;
+  npage_t ntable;
+  BTreeNode *btn;
+  void *decoded;
+  uint8_t* buf;
+  uint32_t size;
+
+  rc = chidb_open(":memory:", &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  chidb_Btree_newNode(db->bt, &ntable, PGTYPE_TABLE_LEAF);
+  for (int i=0; i<bigfile_nvalues; i++) {
+    uint8_t data[64];
+    for (int j=0; j<16; j++)
+      put4byte(data + (4*j), bigfile_ikeys[i]);
+    CU_ASSERT(chidb_Btree_insertInTable(db->bt, ntable, bigfile_pkeys[i], data, 64) == CHIDB_OK);
+  }
+
+  /* Nodes loaded once are decoded from the page cache afterwards */
+  for (int pass=0; pass<2; pass++)
+    for (int i=0; i<bigfile_nvalues; i++) {
+      CU_ASSERT(chidb_Btree_find(db->bt, ntable, bigfile_pkeys[i], &buf, &size) == CHIDB_OK);
+      CU_ASSERT(size == 64 && get4byte(buf) == bigfile_ikeys[i]);
+      free(buf);
+    }
+  CU_ASSERT(chidb_Pager_getDecoded(db->bt->pager, ntable, &decoded) == CHIDB_OK);
+  CU_ASSERT(decoded != NULL);
+  chidb_Btree_getNodeByPage(db->bt, ntable, &btn);
+  CU_ASSERT(btn->type == PGTYPE_TABLE_INTERNAL && btn->has_keys);
+  chidb_Btree_freeMemNode(db->bt, btn);
+
+  /* Writing a node drops its decoded form. Inside a transaction, the
+   * nodes it modifies are not decoded at all */
+  for (int i=0; i<bigfile_nvalues; i+=2)
+    CU_ASSERT(chidb_Btree_delete(db->bt, ntable, bigfile_pkeys[i]) == CHIDB_OK);
+  chidb_Pager_begin(db->bt->pager);
+  CU_ASSERT(chidb_Btree_delete(db->bt, ntable, bigfile_pkeys[1]) == CHIDB_OK);
+  chidb_Btree_getNodeByPage(db->bt, ntable, &btn);
+  chidb_Btree_writeNode(db->bt, btn);
+  chidb_Btree_freeMemNode(db->bt, btn);
+  CU_ASSERT(chidb_Pager_getDecoded(db->bt->pager, ntable, &decoded) == CHIDB_ENOTFOUND);
+  chidb_Btree_getNodeByPage(db->bt, ntable, &btn);
+  CU_ASSERT(!btn->has_keys);
+  chidb_Btree_freeMemNode(db->bt, btn);
+  CU_ASSERT(chidb_Btree_find(db->bt, ntable, bigfile_pkeys[1], &buf, &size) == CHIDB_ENOTFOUND);
+  chidb_Pager_rollback(db->bt->pager);
+  for (int i=0; i<bigfile_nvalues; i++) {
+    rc = chidb_Btree_find(db->bt, ntable, bigfile_pkeys[i], &buf, &size);
+    CU_ASSERT(rc == (i % 2 ? CHIDB_OK : CHIDB_ENOTFOUND));
+    if (rc == CHIDB_OK)
+      free(buf);
+  }
+
+  chidb_close(db);
+}
+
+int count_numbers(chidb *db)
+{
+  chidb_stmt *stmt;
+  int rc, nrows = 0;
+
+  rc = chidb_prepare(db, "SELECT * FROM numbers;", &stmt);
+  if (rc != CHIDB_OK)
+    return -1;
+  while ((rc = chidb_step(stmt)) == CHIDB_ROW)
+    nrows++;
+  chidb_finalize(stmt);
+
+  return (rc == CHIDB_DONE) ? nrows : -rc;
+}
+
+void test_21_1(void)
+{
+  chidb *db;
+  int rc;
+  FILE *f;
+
+  create_temp_file(MULTIINDEXFILE);
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(!db->bt->pager->checksums);
+
+  /* Turning checksums on rebuilds the file, and is remembered */
+  CU_ASSERT(chidb_checksums(db, 1) == CHIDB_OK);
+  CU_ASSERT(db->bt->pager->checksums);
+  CU_ASSERT(db->bt->pager->usable_size == DEFAULT_PAGE_SIZE - PAGE_CHECKSUM_SIZE);
+  CU_ASSERT(count_numbers(db) == 2048);
+  chidb_close(db);
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(db->bt->pager->checksums);
+  CU_ASSERT(count_numbers(db) == 2048);
+
+  /* And back */
+  CU_ASSERT(chidb_checksums(db, 0) == CHIDB_OK);
+  CU_ASSERT(!db->bt->pager->checksums);
+  CU_ASSERT(count_numbers(db) == 2048);
+  CU_ASSERT(chidb_checksums(db, 1) == CHIDB_OK);
+  npage_t npage = db->bt->schema_table[0]->root_page;
+  chidb_close(db);
+
+  /* A corrupted page makes queries fail instead of returning wrong rows */
+  f = fopen(TEMPFILE, "r+b");
+  fseek(f, (long) (npage - 1) * DEFAULT_PAGE_SIZE + 200, SEEK_SET);
+  fputc(fgetc(f) ^ 0x01, f);
+  fclose(f);
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(count_numbers(db) == -CHIDB_ECORRUPT);
+  chidb_close(db);
+}
+
+#define NTEXTRECORDS (500)
+
+void test_22_1(void)
+{
+  chidb *db;
+  int rc;
+  uint8_t *buf;
+  uint32_t size;
+  uint8_t data[200];
+  struct stat st;
+
+  /* Records of text, as in an archive table, loaded in one transaction */
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_openVfs(NEWFILE, chidb_Vfs_find("compress"), db, &db->bt);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(chidb_Pager_begin(db->bt->pager) == CHIDB_OK);
+  for (int i=0; i<NTEXTRECORDS; i++) {
+    snprintf((char *) data, sizeof(data), "Record %i of the archive, kept for the year %i in table %i of the archive", i, 1900 + i % 100, i % 7);
+    rc = chidb_Btree_insertInTable(db->bt, 1, i + 1, data, sizeof(data));
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+  CU_ASSERT(chidb_Pager_commit(db->bt->pager) == CHIDB_OK);
+  npage_t npages = db->bt->pager->n_pages;
+  chidb_Btree_close(db->bt);
+  free(db);
+  CU_ASSERT(stat(NEWFILE, &st) == 0);
+  CU_ASSERT(st.st_size < npages * DEFAULT_PAGE_SIZE / 2);
+
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_openVfs(NEWFILE, chidb_Vfs_find("compress"), db, &db->bt);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(db->bt->pager->n_pages == npages);
+  for (int i=0; i<NTEXTRECORDS; i++) {
+    rc = chidb_Btree_find(db->bt, 1, i + 1, &buf, &size);
+    CU_ASSERT(rc == CHIDB_OK);
+    if (rc != CHIDB_OK)
+      continue;
+    snprintf((char *) data, sizeof(data), "Record %i of the archive, kept for the year %i in table %i of the archive", i, 1900 + i % 100, i % 7);
+    CU_ASSERT(size == sizeof(data) && !strcmp((char *) buf, (char *) data));
+    free(buf);
+  }
+  chidb_Btree_close(db->bt);
+  free(db);
+  remove(NEWFILE);
+}
+
+#define NWIDEKEYS (1000)
+
+/* Keys of every width: 1000 spread over the whole 64-bit range, and
+ * those at the limits of the old 28- and 32-bit keys */
+key_t wide_key(int i)
+{
+  key_t limits[] = {1, 268435455, 268435456, 4294967295ULL, 4294967296ULL, UINT64_MAX};
+  int nlimits = sizeof(limits) / sizeof(key_t);
+
+  if (i < nlimits)
+    return limits[i];
+  return (key_t) i * 0x9E3779B97F4A7C15ULL;
+}
+
+void fill_wide_record(uint8_t *data, key_t key)
+{
+  for (int j=0; j<8; j++)
+    put8byte(data + 8 * j, key);
+}
+
+void test_wide_keys(chidb *db, npage_t nroot, npage_t nindex, bool *deleted)
+{
+  int rc;
+  uint8_t *buf;
+  uint32_t size;
+  uint8_t data[64];
+  key_t pkey;
+
+  for (int i=0; i<NWIDEKEYS; i++) {
+    rc = chidb_Btree_find(db->bt, nroot, wide_key(i), &buf, &size);
+    if (deleted != NULL && deleted[i]) {
+      CU_ASSERT(rc == CHIDB_ENOTFOUND);
+      continue;
+    }
+    CU_ASSERT(rc == CHIDB_OK);
+    if (rc != CHIDB_OK)
+      continue;
+    fill_wide_record(data, wide_key(i));
+    CU_ASSERT(size == sizeof(data) && !memcmp(buf, data, sizeof(data)));
+    free(buf);
+
+    rc = chidb_Btree_findInIndex(db->bt, nindex, wide_key(i), &pkey);
+    CU_ASSERT(rc == CHIDB_OK && pkey == wide_key(NWIDEKEYS - 1 - i));
+  }
+}
+
+void test_23_1(void)
+{
+  chidb *db;
+  int rc;
+  npage_t nroot, nindex;
+  uint8_t data[64];
+  bool deleted[NWIDEKEYS];
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  chidb_Btree_newNode(db->bt, &nroot, PGTYPE_TABLE_LEAF);
+  chidb_Btree_newNode(db->bt, &nindex, PGTYPE_INDEX_LEAF);
+  for (int i=0; i<NWIDEKEYS; i++) {
+    fill_wide_record(data, wide_key(i));
+    rc = chidb_Btree_insertInTable(db->bt, nroot, wide_key(i), data, sizeof(data));
+    CU_ASSERT(rc == CHIDB_OK);
+    rc = chidb_Btree_insertInIndex(db->bt, nindex, wide_key(i), wide_key(NWIDEKEYS - 1 - i));
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+  test_wide_keys(db, nroot, nindex, NULL);
+
+  /* Keys that only differ above bit 32 are not confused */
+  fill_wide_record(data, 0);
+  rc = chidb_Btree_insertInTable(db->bt, nroot, (1ULL << 32) + 1, data, sizeof(data));
+  CU_ASSERT(rc == CHIDB_OK);
+  test_wide_keys(db, nroot, nindex, NULL);
+  rc = chidb_Btree_delete(db->bt, nroot, (1ULL << 32) + 1);
+  CU_ASSERT(rc == CHIDB_OK);
+  chidb_Btree_close(db->bt);
+  free(db);
+
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  test_wide_keys(db, nroot, nindex, NULL);
+  for (int i=0; i<NWIDEKEYS; i++) {
+    deleted[i] = (i % 3 == 0);
+    if (deleted[i])
+      CU_ASSERT(chidb_Btree_delete(db->bt, nroot, wide_key(i)) == CHIDB_OK);
+  }
+  test_wide_keys(db, nroot, nindex, deleted);
+  chidb_Btree_close(db->bt);
+  free(db);
+  remove(NEWFILE);
+}
+
+void test_24_1(void)
+{
+  chidb *db;
+  BTreeNode *btn;
+  int rc;
+  uint8_t data[4] = {1,2,3,4};
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+
+  /* A small key and a small size take one byte each */
+  rc = chidb_Btree_insertInTable(db->bt, 1, 100, data, sizeof(data));
+  CU_ASSERT(rc == CHIDB_OK);
+  chidb_Btree_getNodeByPage(db->bt, 1, &btn);
+  CU_ASSERT(btn->cells_offset == db->bt->pager->page_size - 6);
+  chidb_Btree_freeMemNode(db->bt, btn);
+
+  /* And larger keys only take the bytes they need */
+  rc = chidb_Btree_insertInTable(db->bt, 1, 1000, data, sizeof(data));
+  CU_ASSERT(rc == CHIDB_OK);
+  rc = chidb_Btree_insertInTable(db->bt, 1, UINT64_MAX, data, sizeof(data));
+  CU_ASSERT(rc == CHIDB_OK);
+  chidb_Btree_getNodeByPage(db->bt, 1, &btn);
+  CU_ASSERT(btn->cells_offset == db->bt->pager->page_size - 6 - 7 - 14);
+  chidb_Btree_freeMemNode(db->bt, btn);
+
+  chidb_Btree_close(db->bt);
+  free(db);
+  remove(NEWFILE);
+}
+
+void test_24_2(void)
+{
+  chidb *db;
+  BTreeNode *btn;
+  int rc;
+  uint16_t cells_offset;
+  key_t keys[] = {4,9,6000};
+  char *values[] = {"foo4","foo9","foo6000"};
+  bool deleted[16] = {false};
+  uint32_t size;
+  uint8_t *data, buf[128];
+
+  /* The varints in test1.cdb are padded to four bytes. Its cells can
+   * still be removed and updated, and new cells are written compactly
+   * next to them. */
+  create_temp_file(TESTFILE_1);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(TEMPFILE, db, &db->bt);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+
+  chidb_Btree_getNodeByPage(db->bt, 4, &btn);
+  cells_offset = btn->cells_offset;
+  chidb_Btree_freeMemNode(db->bt, btn);
+  rc = chidb_Btree_delete(db->bt, 1, file1_keys[0]);
+  CU_ASSERT(rc == CHIDB_OK);
+  deleted[0] = true;
+  chidb_Btree_getNodeByPage(db->bt, 4, &btn);
+  CU_ASSERT(btn->cells_offset == cells_offset + 8 + 128);
+  chidb_Btree_freeMemNode(db->bt, btn);
+
+  for (int i=3; i<16; i+=3) {
+    rc = chidb_Btree_delete(db->bt, 1, file1_keys[i]);
+    CU_ASSERT(rc == CHIDB_OK);
+    deleted[i] = true;
+  }
+  rc = chidb_Btree_update(db->bt, 1, file1_keys[1], (uint8_t *) "bar2", 5);
+  CU_ASSERT(rc == CHIDB_OK);
+  for (int i=0; i<3; i++) {
+    memset(buf, 0, sizeof(buf));
+    strcpy((char *) buf, values[i]);
+    rc = chidb_Btree_insertInTable(db->bt, 1, keys[i], buf, sizeof(buf));
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+  chidb_Btree_close(db->bt);
+  free(db);
+
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(TEMPFILE, db, &db->bt);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  for (int i=0; i<16; i++) {
+    rc = chidb_Btree_find(db->bt, 1, file1_keys[i], &data, &size);
+    if (deleted[i]) {
+      CU_ASSERT(rc == CHIDB_ENOTFOUND);
+    } else if (i == 1) {
+      CU_ASSERT(rc == CHIDB_OK && size == 5 && !strcmp((char *) data, "bar2"));
+      free(data);
+    } else {
+      CU_ASSERT(rc == CHIDB_OK && size == 128 && !strcmp((char *) data, file1_values[i]));
+      free(data);
+    }
+  }
+  test_values(db->bt, keys, values, 3);
+  chidb_Btree_close(db->bt);
+  free(db);
+}
+
+void test_25_1(void)
+{
+  chidb *db;
+  BTreeNode *btn;
+  int rc;
+  npage_t nindex;
+  key_t pkey;
+  key_t keys[] = {7, 300, 70000, 5000000000ULL};
+  uint16_t sizes[] = {4 + 1 + 1, 4 + 2 + 2, 4 + 4 + 4, 4 + 8 + 8};
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  chidb_Btree_newNode(db->bt, &nindex, PGTYPE_INDEX_LEAF);
+
+  /* Keys only take the bytes they need */
+  for (int i=0; i<4; i++) {
+    uint16_t cells_offset;
+    chidb_Btree_getNodeByPage(db->bt, nindex, &btn);
+    cells_offset = btn->cells_offset;
+    chidb_Btree_freeMemNode(db->bt, btn);
+
+    rc = chidb_Btree_insertInIndex(db->bt, nindex, keys[i], keys[i]);
+    CU_ASSERT(rc == CHIDB_OK);
+    chidb_Btree_getNodeByPage(db->bt, nindex, &btn);
+    CU_ASSERT(btn->cells_offset == cells_offset - sizes[i]);
+    chidb_Btree_freeMemNode(db->bt, btn);
+  }
+  for (int i=0; i<4; i++) {
+    rc = chidb_Btree_findInIndex(db->bt, nindex, keys[i], &pkey);
+    CU_ASSERT(rc == CHIDB_OK && pkey == keys[i]);
+  }
+
+  chidb_Btree_close(db->bt);
+  free(db);
+  remove(NEWFILE);
+}
+
+#define MULTIINDEX_ROOT (163) // Root of idxNumbers in MULTIINDEXFILE
+#define MULTIINDEX_NROWS (2048)
+
+void test_25_2(void)
+{
+  chidb *db;
+  chidb_stmt *stmt;
+  int rc, n = 0;
+  key_t pkey;
+  key_t codes[MULTIINDEX_NROWS], altcodes[MULTIINDEX_NROWS];
+
+  /* The index cells of MULTIINDEXFILE always use 4-byte keys. Its index
+   * can still be modified, and new cells are written compactly next to
+   * the old ones. */
+  create_temp_file(MULTIINDEXFILE);
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  chidb_prepare(db, "SELECT * FROM numbers;", &stmt);
+  while (n < MULTIINDEX_NROWS && chidb_step(stmt) == CHIDB_ROW) {
+    codes[n] = chidb_column_int(stmt, 0);
+    altcodes[n] = chidb_column_int(stmt, 2);
+    n++;
+  }
+  chidb_finalize(stmt);
+  CU_ASSERT_FATAL(n == MULTIINDEX_NROWS);
+
+  /* Removing an old cell frees all of its 12 bytes */
+  BTreeNode *btn;
+  BTreeCell cell;
+  npage_t nleaf;
+  uint16_t cells_offset;
+  chidb_Btree_getNodeByPage(db->bt, MULTIINDEX_ROOT, &btn);
+  chidb_Btree_getCell(btn, 0, &cell);
+  nleaf = cell.fields.indexInternal.child_page;
+  chidb_Btree_freeMemNode(db->bt, btn);
+  chidb_Btree_getNodeByPage(db->bt, nleaf, &btn);
+  CU_ASSERT_FATAL(btn->type == PGTYPE_INDEX_LEAF);
+  cells_offset = btn->cells_offset;
+  chidb_Btree_getCell(btn, 1, &cell);
+  chidb_Btree_freeMemNode(db->bt, btn);
+  rc = chidb_Btree_delete(db->bt, MULTIINDEX_ROOT, cell.key);
+  CU_ASSERT(rc == CHIDB_OK);
+  chidb_Btree_getNodeByPage(db->bt, nleaf, &btn);
+  CU_ASSERT(btn->cells_offset == cells_offset + 12);
+  chidb_Btree_freeMemNode(db->bt, btn);
+  rc = chidb_Btree_insertInIndex(db->bt, MULTIINDEX_ROOT, cell.key, cell.fields.indexLeaf.keyPk);
+  CU_ASSERT(rc == CHIDB_OK);
+
+  for (int i=0; i<n; i+=2) {
+    rc = chidb_Btree_delete(db->bt, MULTIINDEX_ROOT, altcodes[i]);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+  for (int i=0; i<n; i+=4) {
+    rc = chidb_Btree_insertInIndex(db->bt, MULTIINDEX_ROOT, altcodes[i], codes[i]);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+  chidb_close(db);
+
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  for (int i=0; i<n; i++) {
+    rc = chidb_Btree_findInIndex(db->bt, MULTIINDEX_ROOT, altcodes[i], &pkey);
+    if (i % 4 == 2) {
+      CU_ASSERT(rc == CHIDB_ENOTFOUND);
+    } else {
+      CU_ASSERT(rc == CHIDB_OK && pkey == codes[i]);
+    }
+  }
+  chidb_close(db);
+}
+
+#define NTEXTKEYS (600)
+
+void test_26_1(void)
+{
+  chidb *db;
+  BTreeCell key, cell;
+  int rc, n;
+  npage_t nindex;
+  char str[80];
+  char longstr[] = "a string key that is much longer than the prefix that the index stores, and then some";
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  chidb_Btree_newNode(db->bt, &nindex, PGTYPE_INDEX_LEAF);
+
+  /* Insert the keys out of order, with a few duplicated values */
+  for (int i=0; i<NTEXTKEYS; i++) {
+    int k = (i * 7) % NTEXTKEYS;
+    sprintf(str, "key%05d", k / 2);
+    rc = chidb_Btree_insertInTextIndex(db->bt, nindex, str, k);
+    CU_ASSERT(rc == CHIDB_OK);
+  }
+  CU_ASSERT(chidb_Btree_insertInTextIndex(db->bt, nindex, "key00010", 20) == CHIDB_EDUPLICATE);
+  CU_ASSERT(chidb_Btree_insertInTextIndex(db->bt, nindex, longstr, 1000) == CHIDB_OK);
+  CU_ASSERT(chidb_Btree_insertInIndex(db->bt, nindex, 5, 2000) == CHIDB_OK);
+
+  /* Integers go first, and then strings in memcmp order, and then primary keys
+   * (keyPk is at the same place in internal and leaf cells) */
+  memset(&key, 0, sizeof(key));
+  key.type = PGTYPE_INDEX_LEAF;
+  rc = chidb_Btree_seekIndex(db->bt, nindex, &key, true, INDEXSEEK_GE, &cell);
+  CU_ASSERT(rc == CHIDB_OK && cell.key_cols[0].type == INDEXKEY_INT && cell.key == 5);
+  n = -1;
+  for (;;) {
+    key = cell;
+    rc = chidb_Btree_seekIndex(db->bt, nindex, &key, true, INDEXSEEK_GT, &cell);
+    if (rc != CHIDB_OK)
+      break;
+    if (n < 0) {
+      CU_ASSERT(cell.key_cols[0].type == INDEXKEY_TEXT && cell.fields.indexLeaf.keyPk == 1000);
+    } else {
+      sprintf(str, "key%05d", n / 2);
+      CU_ASSERT(cell.key_cols[0].type == INDEXKEY_TEXT && cell.key_cols[0].len == strlen(str) && !memcmp(cell.key_str, str, strlen(str)));
+      CU_ASSERT(cell.fields.indexLeaf.keyPk == n);
+    }
+    n++;
+  }
+  CU_ASSERT(rc == CHIDB_ENOTFOUND);
+  CU_ASSERT(n == NTEXTKEYS);
+
+  /* Only a prefix of long keys is stored */
+  chidb_Btree_setTextKey(&key, longstr);
+  CU_ASSERT(key.key_cols[0].len == INDEXCELL_MAXTEXT);
+  rc = chidb_Btree_seekIndex(db->bt, nindex, &key, false, INDEXSEEK_GE, &cell);
+  CU_ASSERT(rc == CHIDB_OK && chidb_Btree_compareIndex(&cell, &key, false) == 0);
+
+  /* Seek to the first and last entries with a value */
+  chidb_Btree_setTextKey(&key, "key00123");
+  rc = chidb_Btree_seekIndex(db->bt, nindex, &key, false, INDEXSEEK_GE, &cell);
+  CU_ASSERT(rc == CHIDB_OK && cell.fields.indexLeaf.keyPk == 246);
+  rc = chidb_Btree_seekIndex(db->bt, nindex, &key, false, INDEXSEEK_LE, &cell);
+  CU_ASSERT(rc == CHIDB_OK && cell.fields.indexLeaf.keyPk == 247);
+  rc = chidb_Btree_seekIndex(db->bt, nindex, &key, false, INDEXSEEK_GT, &cell);
+  CU_ASSERT(rc == CHIDB_OK && cell.key_cols[0].len == 8 && !memcmp(cell.key_str, "key00124", 8));
+  chidb_Btree_setTextKey(&key, "zzz");
+  CU_ASSERT(chidb_Btree_seekIndex(db->bt, nindex, &key, false, INDEXSEEK_GE, &cell) == CHIDB_ENOTFOUND);
+
+  /* Delete every entry with an even primary key */
+  for (int i=0; i<NTEXTKEYS; i+=2) {
+    sprintf(str, "key%05d", i / 2);
+    chidb_Btree_setTextKey(&cell, str);
+    cell.type = PGTYPE_INDEX_LEAF;
+    cell.fields.indexLeaf.keyPk = i;
+    CU_ASSERT(chidb_Btree_deleteFromIndex(db->bt, nindex, &cell) == CHIDB_OK);
+  }
+  CU_ASSERT(chidb_Btree_deleteFromIndex(db->bt, nindex, &cell) == CHIDB_ENOTFOUND);
+  chidb_Btree_close(db->bt);
+  free(db);
+
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  for (int i=0; i<NTEXTKEYS; i++) {
+    sprintf(str, "key%05d", i / 2);
+    chidb_Btree_setTextKey(&key, str);
+    rc = chidb_Btree_seekIndex(db->bt, nindex, &key, false, INDEXSEEK_GE, &cell);
+    CU_ASSERT(rc == CHIDB_OK && chidb_Btree_compareIndex(&cell, &key, false) == 0);
+    CU_ASSERT(cell.fields.indexLeaf.keyPk == (i | 1));
+  }
+  chidb_Btree_close(db->bt);
+  free(db);
+  remove(NEWFILE);
+}
+
+#define PREFIXKEY "customer/eu-west/account-"
+
+/* Number of leaves of an index B-Tree. Every leaf with more than one cell
+ * must have a prefix that starts with start. The bytes taken up by the
+ * cells and prefixes of the leaves are added to used. */
+int check_prefixed_leaves(BTree *bt, npage_t npage, const char *start, uint32_t *used)
+{
+  BTreeNode *btn;
+  BTreeCell cell;
+  int nleaves = 0;
+
+  chidb_Btree_getNodeByPage(bt, npage, &btn);
+  if (btn->type == PGTYPE_INDEX_LEAF) {
+    if (btn->n_cells > 1)
+      CU_ASSERT(btn->prefix_len >= strlen(start) && !memcmp(btn->prefix, start, strlen(start)));
+    *used += bt->pager->usable_size - btn->cells_offset;
+    nleaves = 1;
+  } else {
+    for (int i=0; i<=btn->n_cells; i++) {
+      npage_t child = btn->right_page;
+      if (i < btn->n_cells) {
+        chidb_Btree_getCell(btn, i, &cell);
+        child = cell.fields.indexInternal.child_page;
+      }
+      nleaves += check_prefixed_leaves(bt, child, start, used);
+    }
+  }
+  chidb_Btree_freeMemNode(bt, btn);
+
+  return nleaves;
+}
+
+/* Checks that an index holds the keys PREFIXKEY followed by k, with
+ * primary key k, for every k below NTEXTKEYS that is a multiple of step */
+void check_prefixed_keys(BTree *bt, npage_t nindex, int step)
+{
+  BTreeCell key, cell;
+  char str[80];
+  int rc, n = 0;
+
+  memset(&key, 0, sizeof(key));
+  key.type = PGTYPE_INDEX_LEAF;
+  rc = chidb_Btree_seekIndex(bt, nindex, &key, true, INDEXSEEK_GE, &cell);
+  while (rc == CHIDB_OK) {
+    sprintf(str, PREFIXKEY "%05d", n);
+    CU_ASSERT(cell.key_cols[0].len == strlen(str) && !memcmp(cell.key_str, str, strlen(str)));
+    CU_ASSERT(cell.fields.indexLeaf.keyPk == n);
+    n += step;
+    key = cell;
+    rc = chidb_Btree_seekIndex(bt, nindex, &key, true, INDEXSEEK_GT, &cell);
+  }
+  CU_ASSERT(rc == CHIDB_ENOTFOUND);
+  CU_ASSERT(n == (NTEXTKEYS + step - 1) / step * step);
+}
+
+void test_26_4(void)
+{
+  chidb *db;
+  BTreeCell cell;
+  npage_t nindex;
+  uint32_t used = 0, full = 0;
+  char str[80];
+  int rc;
+
+  rc = chidb_open(":memory:", &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  chidb_Btree_newNode(db->bt, &nindex, PGTYPE_INDEX_LEAF);
+  insert_schema_row(db, 1, "index", "prefixed", nindex);
+  chidb_load_schema(db);
+
+  for (int i=0; i<NTEXTKEYS; i++) {
+    int k = (i * 7) % NTEXTKEYS;
+    sprintf(str, PREFIXKEY "%05d", k);
+    CU_ASSERT(chidb_Btree_insertInTextIndex(db->bt, nindex, str, k) == CHIDB_OK);
+    chidb_Btree_setTextKey(&cell, str);
+    cell.type = PGTYPE_INDEX_LEAF;
+    cell.fields.indexLeaf.keyPk = k;
+    full += chidb_Btree_cellSize(&cell) + sizeof(uint16_t);
+  }
+
+  /* The leaves keep the start that their keys share only once */
+  CU_ASSERT(check_prefixed_leaves(db->bt, nindex, PREFIXKEY, &used) > 1);
+  CU_ASSERT(used < full / 2);
+  check_prefixed_keys(db->bt, nindex, 1);
+
+  /* Leaves that are merged or rebalanced get a prefix too */
+  for (int k=0; k<NTEXTKEYS; k++) {
+    if (k % 4 == 0)
+      continue;
+    sprintf(str, PREFIXKEY "%05d", k);
+    chidb_Btree_setTextKey(&cell, str);
+    cell.type = PGTYPE_INDEX_LEAF;
+    cell.fields.indexLeaf.keyPk = k;
+    CU_ASSERT(chidb_Btree_deleteFromIndex(db->bt, nindex, &cell) == CHIDB_OK);
+  }
+  used = 0;
+  check_prefixed_leaves(db->bt, nindex, PREFIXKEY, &used);
+  check_prefixed_keys(db->bt, nindex, 4);
+
+  /* And so do the leaves written by VACUUM, which fit more cells */
+  CU_ASSERT(chidb_Btree_vacuum(db->bt) == CHIDB_OK);
+  nindex = schema_root(db, 0);
+  used = 0;
+  CU_ASSERT(check_prefixed_leaves(db->bt, nindex, PREFIXKEY, &used) <= (full / 4) / 2 / (db->bt->pager->usable_size - LEAFPG_CELLSOFFSET_OFFSET) + 1);
+  check_prefixed_keys(db->bt, nindex, 4);
+
+  chidb_close(db);
+}
+
+/* Rows of the numbers table of MULTIINDEXFILE with some textcode, and
+ * whether the statement read the whole table to find them */
+int select_textcode(chidb *db, const char *textcode, int64_t *code, bool *scanned)
+{
+  chidb_stmt *stmt;
+  char sql[128];
+  int nrows = 0;
+
+  sprintf(sql, "SELECT code, textcode FROM numbers WHERE textcode = \"%s\";", textcode);
+  CU_ASSERT_FATAL(chidb_prepare(db, sql, &stmt) == CHIDB_OK);
+  while (chidb_step(stmt) == CHIDB_ROW) {
+    const char *text = chidb_column_text(stmt, 1);
+    CU_ASSERT(!strcmp(text, textcode));
+    *code = chidb_column_int64(stmt, 0);
+    nrows++;
+  }
+  *scanned = false;
+  for (int i = 0; i < stmt->input_dbm->num_lists; i++)
+    if (stmt->input_dbm->list_loaded[i])
+      *scanned = true;
+  chidb_finalize(stmt);
+
+  return nrows;
+}
+
+/* Rows returned by a query whose first column is between lo and hi,
+ * counted by hand rather than with a WHERE clause */
+int count_range(chidb *db, const char *sql, int64_t lo, int64_t hi)
+{
+  chidb_stmt *stmt;
+  int nrows = 0;
+
+  CU_ASSERT_FATAL(chidb_prepare(db, sql, &stmt) == CHIDB_OK);
+  while (chidb_step(stmt) == CHIDB_ROW)
+    if (chidb_column_type(stmt, 0) != SQL_NULL && chidb_column_int64(stmt, 0) >= lo && chidb_column_int64(stmt, 0) <= hi)
+      nrows++;
+  chidb_finalize(stmt);
+
+  return nrows;
+}
+
+void test_26_2(void)
+{
+  chidb *db;
+  chidb_stmt *stmt;
+  int rc, n = 0;
+  int64_t codes[MULTIINDEX_NROWS], code;
+  char *textcodes[MULTIINDEX_NROWS];
+  bool scanned;
+
+  create_temp_file(MULTIINDEXFILE);
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  chidb_prepare(db, "SELECT code, textcode FROM numbers;", &stmt);
+  while (n < MULTIINDEX_NROWS && chidb_step(stmt) == CHIDB_ROW) {
+    const char *text = chidb_column_text(stmt, 1);
+    codes[n] = chidb_column_int64(stmt, 0);
+    textcodes[n] = malloc(strlen(text) + 1);
+    memcpy(textcodes[n], text, strlen(text) + 1);
+    n++;
+  }
+  chidb_finalize(stmt);
+  CU_ASSERT_FATAL(n == MULTIINDEX_NROWS);
+
+  /* Without an index, the table is scanned */
+  CU_ASSERT(select_textcode(db, textcodes[100], &code, &scanned) == 1);
+  CU_ASSERT(code == codes[100] && scanned);
+
+  CU_ASSERT(exec_sql(db, "CREATE INDEX idxText ON numbers(nosuchcolumn);") == CHIDB_EINVALIDSQL);
+  CU_ASSERT(exec_sql(db, "CREATE INDEX idxText ON nosuchtable(textcode);") == CHIDB_EINVALIDSQL);
+  CU_ASSERT(exec_sql(db, "CREATE INDEX idxNumbers ON numbers(textcode);") == CHIDB_EINVALIDSQL);
+  CU_ASSERT(exec_sql(db, "CREATE INDEX idxText ON numbers(textcode);") == CHIDB_DONE);
+  CU_ASSERT(db->bt->schema_table_size == 3);
+  chidb_close(db);
+
+  /* With it, only the matching rows are read */
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(db->bt->schema_table_size == 3);
+  for (int i=0; i<n; i+=7) {
+    CU_ASSERT(select_textcode(db, textcodes[i], &code, &scanned) == 1);
+    CU_ASSERT(code == codes[i] && !scanned);
+  }
+  CU_ASSERT(select_textcode(db, "no such text", &code, &scanned) == 0);
+  CU_ASSERT(!scanned);
+
+  /* The other conditions still apply */
+  char sql[128];
+  sprintf(sql, "SELECT * FROM numbers WHERE textcode = \"%s\" AND code = %i;", textcodes[5], (int) codes[5]);
+  CU_ASSERT(count_rows(db, sql) == 1);
+  sprintf(sql, "SELECT * FROM numbers WHERE textcode = \"%s\" AND code = %i;", textcodes[5], (int) codes[6]);
+  CU_ASSERT(count_rows(db, sql) == 0);
+  chidb_close(db);
+
+  for (int i=0; i<n; i++)
+    free(textcodes[i]);
+}
+
+void test_26_3(void)
+{
+  chidb *db;
+  int rc;
+  int64_t code;
+  bool scanned;
+  char sql[128];
+
+  create_temp_file(MULTIINDEXFILE);
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(exec_sql(db, "CREATE INDEX idxText ON numbers(textcode);") == CHIDB_DONE);
+
+  /* INSERT, UPDATE and DELETE keep the index up to date */
+  for (int i=0; i<50; i++) {
+    sprintf(sql, "INSERT INTO numbers VALUES(%i, \"same text\", %i);", 900000 + i, i);
+    CU_ASSERT(exec_sql(db, sql) == CHIDB_DONE);
+  }
+  CU_ASSERT(select_textcode(db, "same text", &code, &scanned) == 50);
+  CU_ASSERT(!scanned);
+
+  CU_ASSERT(exec_sql(db, "UPDATE numbers SET textcode = \"other text\" WHERE code = 900007;") == CHIDB_DONE);
+  CU_ASSERT(select_textcode(db, "same text", &code, &scanned) == 49);
+  CU_ASSERT(select_textcode(db, "other text", &code, &scanned) == 1);
+  CU_ASSERT(code == 900007);
+
+  CU_ASSERT(exec_sql(db, "DELETE FROM numbers WHERE altcode < 10;") == CHIDB_DONE);
+  CU_ASSERT(select_textcode(db, "same text", &code, &scanned) == 40);
+  CU_ASSERT(select_textcode(db, "other text", &code, &scanned) == 0);
+  chidb_close(db);
+
+  /* The integer index is kept up to date too */
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  CU_ASSERT(count_rows(db, "SELECT * FROM numbers WHERE altcode = 42;") == count_range(db, "SELECT altcode FROM numbers;", 42, 42));
+  CU_ASSERT(count_rows(db, "SELECT * FROM numbers WHERE altcode = 5;") == count_range(db, "SELECT altcode FROM numbers;", 5, 5));
+  chidb_close(db);
+}
+
+#define NTENANTS (8)
+#define NTIMES (150)
+
+/* Key (tenant, name, time) of the i-th entry of a composite index */
+void composite_key(BTreeCell *cell, int i)
+{
+  char name[16];
+
+  memset(cell, 0, sizeof(BTreeCell));
+  cell->type = PGTYPE_INDEX_LEAF;
+  cell->fields.indexLeaf.keyPk = i;
+  chidb_Btree_appendIntKey(cell, i % NTENANTS);
+  sprintf(name, "name%d", (i / NTENANTS) % 3);
+  chidb_Btree_appendTextKey(cell, name);
+  chidb_Btree_appendIntKey(cell, i / NTENANTS);
+}
+
+void test_27_1(void)
+{
+  chidb *db;
+  BTreeCell key, cell;
+  int rc, n;
+  npage_t nindex;
+
+  remove(NEWFILE);
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+  chidb_Btree_newNode(db->bt, &nindex, PGTYPE_INDEX_LEAF);
+
+  for (int i=0; i<NTENANTS * NTIMES; i++) {
+    composite_key(&key, (i * 7) % (NTENANTS * NTIMES));
+    CU_ASSERT(chidb_Btree_insert(db->bt, nindex, &key) == CHIDB_OK);
+  }
+  composite_key(&key, 11);
+  CU_ASSERT(chidb_Btree_insert(db->bt, nindex, &key) == CHIDB_EDUPLICATE);
+  chidb_Btree_close(db->bt);
+  free(db);
+
+  db = malloc(sizeof(chidb));
+  rc = chidb_Btree_open(NEWFILE, db, &db->bt);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+
+  /* Entries are sorted column by column */
+  memset(&key, 0, sizeof(key));
+  rc = chidb_Btree_seekIndex(db->bt, nindex, &key, false, INDEXSEEK_GE, &cell);
+  CU_ASSERT(rc == CHIDB_OK && cell.key_ncols == 3);
+  n = 1;
+  for (;;) {
+    key = cell;
+    rc = chidb_Btree_seekIndex(db->bt, nindex, &key, true, INDEXSEEK_GT, &cell);
+    if (rc != CHIDB_OK)
+      break;
+    CU_ASSERT(chidb_Btree_compareIndex(&key, &cell, false) <= 0);
+    CU_ASSERT(cell.key_cols[0].value > key.key_cols[0].value ||
+              (cell.key_cols[0].value == key.key_cols[0].value && memcmp(cell.key_str + cell.key_cols[1].off, key.key_str + key.key_cols[1].off, 5) >= 0));
+    n++;
+  }
+  CU_ASSERT(rc == CHIDB_ENOTFOUND);
+  CU_ASSERT(n == NTENANTS * NTIMES);
+
+  /* A shorter key is a prefix: it matches all the entries that start with it */
+  memset(&key, 0, sizeof(key));
+  chidb_Btree_appendIntKey(&key, 3);
+  chidb_Btree_appendTextKey(&key, "name1");
+  rc = chidb_Btree_seekIndex(db->bt, nindex, &key, false, INDEXSEEK_GE, &cell);
+  CU_ASSERT(rc == CHIDB_OK && cell.key_cols[0].value == 3 && cell.key_cols[2].value == 1);
+  CU_ASSERT(cell.fields.indexLeaf.keyPk == 3 + NTENANTS);
+  rc = chidb_Btree_seekIndex(db->bt, nindex, &key, false, INDEXSEEK_LE, &cell);
+  CU_ASSERT(rc == CHIDB_OK && cell.key_cols[0].value == 3 && cell.key_cols[2].value == NTIMES - 2);
+
+  /* And then a range on the next column */
+  chidb_Btree_appendIntKey(&key, 40);
+  rc = chidb_Btree_seekIndex(db->bt, nindex, &key, false, INDEXSEEK_GE, &cell);
+  CU_ASSERT(rc == CHIDB_OK && cell.key_cols[2].value == 40);
+  key.key_cols[2].value = 41;
+  rc = chidb_Btree_seekIndex(db->bt, nindex, &key, false, INDEXSEEK_GE, &cell);
+  CU_ASSERT(rc == CHIDB_OK && cell.key_cols[2].value == 43);
+
+  /* NULL columns go first */
+  memset(&key, 0, sizeof(key));
+  key.type = PGTYPE_INDEX_LEAF;
+  key.fields.indexLeaf.keyPk = 100000;
+  chidb_Btree_appendNullKey(&key);
+  chidb_Btree_appendTextKey(&key, "zzz");
+  chidb_Btree_appendIntKey(&key, 0);
+  CU_ASSERT(chidb_Btree_insert(db->bt, nindex, &key) == CHIDB_OK);
+  memset(&cell, 0, sizeof(cell));
+  rc = chidb_Btree_seekIndex(db->bt, nindex, &cell, false, INDEXSEEK_GE, &key);
+  CU_ASSERT(rc == CHIDB_OK && key.key_cols[0].type == INDEXKEY_NULL && key.fields.indexLeaf.keyPk == 100000);
+
+  /* Every entry can be deleted */
+  for (int i=0; i<NTENANTS * NTIMES; i++) {
+    composite_key(&key, i);
+    CU_ASSERT(chidb_Btree_deleteFromIndex(db->bt, nindex, &key) == CHIDB_OK);
+  }
+  CU_ASSERT(chidb_Btree_deleteFromIndex(db->bt, nindex, &key) == CHIDB_ENOTFOUND);
+  chidb_Btree_close(db->bt);
+  free(db);
+  remove(NEWFILE);
+}
+
+/* Rows returned by a query, and whether it read the whole table and
+ * which index it opened (the number of columns it compares, or 0) */
+int count_indexed(chidb *db, const char *sql, bool *scanned, int *ncols)
+{
+  chidb_stmt *stmt;
+  int nrows = 0;
+
+  CU_ASSERT_FATAL(chidb_prepare(db, sql, &stmt) == CHIDB_OK);
+  *ncols = 0;
+  for (int i = 0; i < stmt->num_instructions; i++)
+    if (stmt->ins[i].instruction == DBM_OPENREAD && stmt->ins[i].P1 == 1)
+      *ncols = stmt->ins[i].P3;
+  while (chidb_step(stmt) == CHIDB_ROW)
+    nrows++;
+  *scanned = false;
+  for (int i = 0; i < stmt->input_dbm->num_lists; i++)
+    if (stmt->input_dbm->list_loaded[i])
+      *scanned = true;
+  chidb_finalize(stmt);
+
+  return nrows;
+}
+
+void test_27_2(void)
+{
+  chidb *db;
+  int rc, ncols;
+  bool scanned;
+  char sql[160];
+
+  create_temp_file(MULTIINDEXFILE);
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+
+  /* Rows of NTENANTS tenants (altcode) at NTIMES times (code) */
+  for (int i=0; i<NTENANTS * NTIMES; i++) {
+    sprintf(sql, "INSERT INTO numbers VALUES(%i, \"tenant%i\", %i);", 900000 + i, i % NTENANTS, 700000 + i % NTENANTS);
+    CU_ASSERT(exec_sql(db, sql) == CHIDB_DONE);
+  }
+
+  CU_ASSERT(exec_sql(db, "CREATE INDEX idxWide ON numbers(altcode, code, textcode, altcode, code);") == CHIDB_EINVALIDSQL);
+  CU_ASSERT(exec_sql(db, "CREATE INDEX idxPair ON numbers(altcode, nosuchcolumn);") == CHIDB_EINVALIDSQL);
+  CU_ASSERT(exec_sql(db, "CREATE INDEX idxPair ON numbers(altcode, code);") == CHIDB_DONE);
+  CU_ASSERT(exec_sql(db, "CREATE INDEX idxNames ON numbers(textcode, code);") == CHIDB_DONE);
+  CU_ASSERT(db->bt->schema_table_size == 4);
+  chidb_close(db);
+
+  rc = chidb_open(TEMPFILE, &db);
+  CU_ASSERT_FATAL(rc == CHIDB_OK);
+
+  /* An equality and a range use both columns of the index */
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE altcode = 700003 AND code >= 900100 AND code < 900500;", &scanned, &ncols) == 50);
+  CU_ASSERT(!scanned && ncols == 2);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE code > 900100 AND code <= 900500 AND altcode = 700004;", &scanned, &ncols) == 50);
+  CU_ASSERT(!scanned && ncols == 2);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE altcode = 700003 AND code > 901000;", &scanned, &ncols) == 25);
+  CU_ASSERT(!scanned && ncols == 2);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE altcode = 700003 AND code = 900011;", &scanned, &ncols) == 1);
+  CU_ASSERT(!scanned && ncols == 2);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE altcode = 700003 AND code = 900012;", &scanned, &ncols) == 0);
+  CU_ASSERT(!scanned);
+
+  /* Prefixes, ranges on the first column, and text columns */
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE altcode = 700003;", &scanned, &ncols) == NTIMES);
+  CU_ASSERT(!scanned && ncols == 1);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE altcode >= 700002 AND altcode < 700005;", &scanned, &ncols) == 3 * NTIMES);
+  CU_ASSERT(!scanned && ncols == 1);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE textcode = \"tenant5\" AND code < 900400;", &scanned, &ncols) == 50);
+  CU_ASSERT(!scanned && ncols == 2);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE textcode > \"tenant5\" AND textcode < \"tenant7\";", &scanned, &ncols) == NTIMES);
+  CU_ASSERT(!scanned && ncols == 1);
+
+  /* The other conditions still apply, and the rest of the table is unchanged */
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE altcode = 700003 AND code < 900500 AND textcode = \"tenant4\";", &scanned, &ncols) == 0);
+  CU_ASSERT(count_rows(db, "SELECT * FROM numbers WHERE altcode = 42;") == count_range(db, "SELECT altcode FROM numbers;", 42, 42));
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE code >= 900000;", &scanned, &ncols) == NTENANTS * NTIMES);
+  CU_ASSERT(ncols == 0);
+
+  /* INSERT, UPDATE and DELETE keep both indexes up to date */
+  CU_ASSERT(exec_sql(db, "UPDATE numbers SET altcode = 700005 WHERE code = 900011;") == CHIDB_DONE);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE altcode = 700003 AND code >= 900000 AND code < 900400;", &scanned, &ncols) == 49);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE altcode = 700005 AND code >= 900000 AND code < 900400;", &scanned, &ncols) == 51);
+  CU_ASSERT(exec_sql(db, "UPDATE numbers SET textcode = \"moved\" WHERE altcode = 700005 AND code < 900100;") == CHIDB_DONE);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE textcode = \"moved\" AND code > 0;", &scanned, &ncols) == 13);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE textcode = \"tenant5\" AND code < 900100;", &scanned, &ncols) == 0);
+  CU_ASSERT(exec_sql(db, "DELETE FROM numbers WHERE altcode = 700003 AND code < 900800;") == CHIDB_DONE);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE altcode = 700003;", &scanned, &ncols) == NTIMES - 100);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE textcode = \"tenant3\";", &scanned, &ncols) == NTIMES - 100);
+  CU_ASSERT(exec_sql(db, "INSERT INTO numbers VALUES(899999, \"tenant3\", 700003);") == CHIDB_DONE);
+  CU_ASSERT(count_indexed(db, "SELECT * FROM numbers WHERE altcode = 700003 AND code < 900000;", &scanned, &ncols) == 1);
+  CU_ASSERT(!scanned && ncols == 2);
+  chidb_close(db);
+}
+
 //STORES A STRING IN THE DBM AT SPECIFIED REGISTER
 void string_inst(dbm *input_dbm, uint32_t r_num, const char *str) {
 	chidb_instruction inst;
@@ -2155,7 +3939,7 @@ void test_11_5(void) {
 
 int init_tests_btree()
 {
-  CU_pSuite openexistingTests, loadnodeTests, createwriteTests, opennewTests, cellTests, findTests, insertnosplitTests, insertTests, indexTests, dbmTests, schemaLoadTests, apiTests;
+  CU_pSuite openexistingTests, loadnodeTests, createwriteTests, opennewTests, cellTests, findTests, insertnosplitTests, insertTests, indexTests, dbmTests, schemaLoadTests, apiTests, deleteTests, updateTests, vacuumTests, overflowTests, walTests, transactionTests, syncTests, memoryTests, nodeCacheTests, checksumTests, compressTests, wideKeyTests, varintTests, indexCellTests, textIndexTests, compositeIndexTests;
   
   /* add suites to the registry */
   if (
@@ -2170,7 +3954,23 @@ int init_tests_btree()
       NULL == (indexTests =         CU_add_suite("Step 8: Supporting index B-Trees", NULL, NULL)) ||
       NULL == (dbmTests = 					CU_add_suite("Step 9: Testing DBM commands", NULL, NULL)) ||
       NULL == (schemaLoadTests = 		CU_add_suite("Step 10: Schema loading tests", NULL, NULL)) || 
-      NULL == (apiTests = 					CU_add_suite("Step 11: API tests", NULL, NULL))
+      NULL == (apiTests = 					CU_add_suite("Step 11: API tests", NULL, NULL)) ||
+      NULL == (deleteTests =        CU_add_suite("Step 12: Deleting from a B-Tree", NULL, NULL)) ||
+      NULL == (updateTests =        CU_add_suite("Step 13: Updating a B-Tree", NULL, NULL)) ||
+      NULL == (vacuumTests =        CU_add_suite("Step 14: Compacting a chidb file", NULL, NULL)) ||
+      NULL == (overflowTests =      CU_add_suite("Step 15: Overflow pages", NULL, NULL)) ||
+      NULL == (walTests =           CU_add_suite("Step 16: Write-ahead log", NULL, NULL)) ||
+      NULL == (transactionTests =   CU_add_suite("Step 17: Transactions", NULL, NULL)) ||
+      NULL == (syncTests =          CU_add_suite("Step 18: Durability settings", NULL, NULL)) ||
+      NULL == (memoryTests =        CU_add_suite("Step 19: In-memory databases", NULL, NULL)) ||
+      NULL == (nodeCacheTests =     CU_add_suite("Step 20: Decoded nodes", NULL, NULL)) ||
+      NULL == (checksumTests =      CU_add_suite("Step 21: Page checksums", NULL, NULL)) ||
+      NULL == (compressTests =      CU_add_suite("Step 22: Compressed files", NULL, NULL)) ||
+      NULL == (wideKeyTests =       CU_add_suite("Step 23: 64-bit keys", NULL, NULL)) ||
+      NULL == (varintTests =        CU_add_suite("Step 24: Variable-length varints", NULL, NULL)) ||
+      NULL == (indexCellTests =     CU_add_suite("Step 25: Compact index cells", NULL, NULL)) ||
+      NULL == (textIndexTests =     CU_add_suite("Step 26: Text indexes", NULL, NULL)) ||
+      NULL == (compositeIndexTests = CU_add_suite("Step 27: Composite indexes", NULL, NULL))
       ) 
     {
       CU_cleanup_registry();
@@ -2254,7 +4054,70 @@ int init_tests_btree()
       (NULL == CU_add_test(apiTests, "11.2 - Print nrcols of select/insert", test_11_2)) ||
       (NULL == CU_add_test(apiTests, "11.3 - Print column type", test_11_3)) ||
       (NULL == CU_add_test(apiTests, "11.4 - Print int from col", test_11_4)) ||
-      (NULL == CU_add_test(apiTests, "11.5 - Print str from col", test_11_5))
+      (NULL == CU_add_test(apiTests, "11.5 - Print str from col", test_11_5)) ||
+
+      /* Deletion tests */
+
+      (NULL == CU_add_test(deleteTests, "12.1 - Delete all entries, then reuse the free pages", test_12_1)) ||
+      (NULL == CU_add_test(deleteTests, "12.2 - Delete in reverse order", test_12_2)) ||
+      (NULL == CU_add_test(deleteTests, "12.3 - Delete from an index B-Tree", test_12_3)) ||
+
+      /* Update tests */
+
+      (NULL == CU_add_test(updateTests, "13.1 - Same-size updates in place", test_13_1)) ||
+      (NULL == CU_add_test(updateTests, "13.2 - Updates that change the record size", test_13_2)) ||
+
+      /* Vacuum tests */
+
+      (NULL == CU_add_test(vacuumTests, "14.1 - Rebuild table and index B-Trees", test_14_1)) ||
+      (NULL == CU_add_test(vacuumTests, "14.2 - VACUUM statement", test_14_2)) ||
+
+      /* Overflow tests */
+
+      (NULL == CU_add_test(overflowTests, "15.1 - Insert, find, and delete large records", test_15_1)) ||
+      (NULL == CU_add_test(overflowTests, "15.2 - Updates that move data to and from overflow pages", test_15_2)) ||
+
+      /* WAL tests */
+
+      (NULL == CU_add_test(walTests, "16.1 - Switching to and from WAL mode", test_16_1)) ||
+      (NULL == CU_add_test(walTests, "16.2 - Readers keep their snapshot across checkpoints", test_16_2)) ||
+
+      /* Transaction tests */
+
+      (NULL == CU_add_test(transactionTests, "17.1 - BEGIN, COMMIT and ROLLBACK", test_17_1)) ||
+      (NULL == CU_add_test(transactionTests, "17.2 - Statements are committed as a whole", test_17_2)) ||
+
+      /* Durability tests */
+
+      (NULL == CU_add_test(syncTests, "18.1 - PRAGMA synchronous and journal_mode", test_18_1)) ||
+
+      /* In-memory database tests */
+
+      (NULL == CU_add_test(memoryTests, "19.1 - Independent in-memory databases", test_19_1)) ||
+
+      /* Decoded node tests */
+
+      (NULL == CU_add_test(nodeCacheTests, "20.1 - Reusing and dropping decoded nodes", test_20_1)) ||
+
+      /* Page checksum tests */
+
+      (NULL == CU_add_test(checksumTests, "21.1 - Converting and verifying a database", test_21_1)) ||
+
+      /* Compressed file tests */
+
+      (NULL == CU_add_test(compressTests, "22.1 - B-Trees in a compressed file", test_22_1)) ||
+      (NULL == CU_add_test(wideKeyTests, "23.1 - Tables and indexes with 64-bit keys", test_23_1)) ||
+      (NULL == CU_add_test(varintTests, "24.1 - Table cells take only the bytes they need", test_24_1)) ||
+      (NULL == CU_add_test(varintTests, "24.2 - Modify a file with padded varints", test_24_2)) ||
+      (NULL == CU_add_test(indexCellTests, "25.1 - Index cells take only the bytes they need", test_25_1)) ||
+      (NULL == CU_add_test(indexCellTests, "25.2 - Modify an index with 4-byte keys", test_25_2)) ||
+      (NULL == CU_add_test(textIndexTests, "26.1 - Index B-Trees with text keys", test_26_1)) ||
+      (NULL == CU_add_test(textIndexTests, "26.2 - CREATE INDEX and indexed lookups", test_26_2)) ||
+      (NULL == CU_add_test(textIndexTests, "26.3 - Indexes are kept up to date", test_26_3)) ||
+      (NULL == CU_add_test(textIndexTests, "26.4 - Index leaves share a prefix of their text keys", test_26_4)) ||
+
+      (NULL == CU_add_test(compositeIndexTests, "27.1 - Index B-Trees with composite keys", test_27_1)) ||
+      (NULL == CU_add_test(compositeIndexTests, "27.2 - Equality and range lookups on composite indexes", test_27_2))
       )
     {
       CU_cleanup_registry();
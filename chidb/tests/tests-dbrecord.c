@@ -8,6 +8,7 @@ char *str_values[] = {"foo", "bar", "foobar", "", "scrumptrulescent", "cromulent
 int8_t int8_values[] = {0,1,32,-32,64,-64,127,-128};
 int16_t int16_values[] = {0,1,1000,-1000,20000,-20000,32767,-32768};
 int32_t int32_values[] = {0,1,100000,-100000,2147483647,-2147483648};
+int64_t int64_values[] = {0,1,-1,2147483648LL,-2147483649LL,4294967296LL,9223372036854775807LL,-9223372036854775807LL-1};
 
 void test_string(void)
 {
@@ -71,6 +72,32 @@ void test_int32(void)
 	}
 }
 
+void test_int64(void)
+{
+	for(int i=0; i<NVALUES; i++)
+	{
+		DBRecord *dbr, *dbr2;
+		uint8_t *packed;
+		int64_t val;	
+		chidb_DBRecord_create(&dbr, "|i8|", int64_values[i]);
+		CU_ASSERT(dbr->nfields == 1);
+		CU_ASSERT_EQUAL(chidb_DBRecord_getType(dbr, 0), SQL_INTEGER_8BYTE);
+		chidb_DBRecord_getInt64(dbr, 0, &val);
+		CU_ASSERT_EQUAL(int64_values[i], val);
+
+		chidb_DBRecord_pack(dbr, &packed);
+		chidb_DBRecord_unpack(&dbr2, packed);
+		CU_ASSERT_EQUAL(dbr2->packed_len, 10);
+		CU_ASSERT_EQUAL(chidb_DBRecord_getType(dbr2, 0), SQL_INTEGER_8BYTE);
+		chidb_DBRecord_getInt64(dbr2, 0, &val);
+		CU_ASSERT_EQUAL(int64_values[i], val);
+
+		free(packed);
+		chidb_DBRecord_destroy(dbr2);
+		chidb_DBRecord_destroy(dbr);
+	}
+}
+
 void test_null(void)
 {
 	DBRecord *dbr;
@@ -173,6 +200,7 @@ int init_tests_dbrecord()
 		(NULL == CU_add_test(dbrecordTests, "Single-int8 record", test_int8)) ||
 		(NULL == CU_add_test(dbrecordTests, "Single-int16 record", test_int16)) ||
 		(NULL == CU_add_test(dbrecordTests, "Single-int32 record", test_int32)) ||
+		(NULL == CU_add_test(dbrecordTests, "Single-int64 record", test_int64)) ||
 		(NULL == CU_add_test(dbrecordTests, "Single-null record", test_null))||
 		(NULL == CU_add_test(dbrecordTests, "Multiple-field record", test_multiplefields))||
 		(NULL == CU_add_test(dbrecordTests, "Packing/unpacking a record", test_packunpack))
@@ -1,6 +1,13 @@
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include "CUnit/Basic.h"
 #include "libchidb/pager.h"
+#include "libchidb/checksum.h"
+#include "libchidb/lz.h"
+#include "libchidb/vfs.h"
 
 #define NVALUES (256)
 #define PAGE_SIZE (1024)
@@ -8,6 +15,8 @@
 #define TESTFILE ("32k.dat")
 
 #define TEMPFILE ("temp.dat")
+#define TEMPJOURNAL ("temp.dat-journal")
+#define TEMPWAL ("temp.dat-wal")
 #define MAXPAGES (8)
 
 #define NMULT (6)
@@ -128,6 +137,1201 @@ void test_readwrite(void)
 	}
 }
 
+#define FREEPAGES (600)
+
+void test_freelist(void)
+{
+	int rc;
+	npage_t npage;
+	Pager *pg;
+	bool *reused;
+	
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	
+	for(int j=1; j<=FREEPAGES; j++)
+	{
+		MemPage *page;
+		chidb_Pager_allocatePage(pg, &npage);
+		chidb_Pager_readPage(pg, npage, &page);
+		chidb_Pager_writePage(pg, page);
+		chidb_Pager_releaseMemPage(pg, page);
+	}
+	
+	/* Page 1 and pages past the end of the file cannot be freed */
+	CU_ASSERT(chidb_Pager_freePage(pg, 1) == CHIDB_EPAGENO);
+	CU_ASSERT(chidb_Pager_freePage(pg, FREEPAGES + 1) == CHIDB_EPAGENO);
+	
+	/* Enough pages to need several trunk pages */
+	for(int j=2; j<=FREEPAGES; j++)
+	{
+		rc = chidb_Pager_freePage(pg, j);
+		CU_ASSERT(rc == CHIDB_OK);
+	}
+	CU_ASSERT(pg->n_free == FREEPAGES - 1);
+	
+	/* Every free page is reused exactly once before the file grows */
+	reused = calloc(FREEPAGES + 1, sizeof(bool));
+	for(int j=2; j<=FREEPAGES; j++)
+	{
+		rc = chidb_Pager_allocatePage(pg, &npage);
+		CU_ASSERT(rc == CHIDB_OK);
+		CU_ASSERT(npage > 1 && npage <= FREEPAGES);
+		CU_ASSERT(!reused[npage]);
+		reused[npage] = true;
+	}
+	CU_ASSERT(pg->n_free == 0);
+	CU_ASSERT(pg->n_pages == FREEPAGES);
+	
+	chidb_Pager_allocatePage(pg, &npage);
+	CU_ASSERT(npage == FREEPAGES + 1);
+	
+	free(reused);
+	chidb_Pager_close(pg);
+	remove(TEMPFILE);
+}
+
+#define TXNPAGES (4)
+
+/* Fills a page with a value that depends on the page number */
+void fill_page(Pager *pg, npage_t npage, uint8_t v)
+{
+	MemPage *page;
+
+	chidb_Pager_readPage(pg, npage, &page);
+	memset(page->data, v + npage, pg->page_size);
+	chidb_Pager_writePage(pg, page);
+	chidb_Pager_releaseMemPage(pg, page);
+}
+
+bool check_page(Pager *pg, npage_t npage, uint8_t v)
+{
+	MemPage *page;
+	bool ok = true;
+
+	chidb_Pager_readPage(pg, npage, &page);
+	for(int i=0; i<pg->page_size; i++)
+		ok = ok && page->data[i] == (uint8_t) (v + npage);
+	chidb_Pager_releaseMemPage(pg, page);
+
+	return ok;
+}
+
+void test_transactions(void)
+{
+	int rc;
+	npage_t npage;
+	Pager *pg;
+
+	remove(TEMPFILE);
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	for(int j=1; j<=TXNPAGES; j++)
+	{
+		chidb_Pager_allocatePage(pg, &npage);
+		fill_page(pg, npage, 0);
+	}
+
+	CU_ASSERT(chidb_Pager_commit(pg) == CHIDB_EMISUSE);
+	CU_ASSERT(chidb_Pager_rollback(pg) == CHIDB_EMISUSE);
+
+	/* Changes are visible inside the transaction, and undone by a rollback */
+	rc = chidb_Pager_begin(pg);
+	CU_ASSERT(rc == CHIDB_OK);
+	CU_ASSERT(chidb_Pager_begin(pg) == CHIDB_EMISUSE);
+	fill_page(pg, 2, 1);
+	chidb_Pager_allocatePage(pg, &npage);
+	fill_page(pg, npage, 1);
+	CU_ASSERT(check_page(pg, 2, 1));
+	CU_ASSERT(check_page(pg, npage, 1));
+	CU_ASSERT(access(TEMPJOURNAL, F_OK) == 0);
+	rc = chidb_Pager_rollback(pg);
+	CU_ASSERT(rc == CHIDB_OK);
+	CU_ASSERT(pg->n_pages == TXNPAGES);
+	CU_ASSERT(check_page(pg, 2, 0));
+	CU_ASSERT(access(TEMPJOURNAL, F_OK) != 0);
+
+	/* Committed changes are in the file, and the journal is gone */
+	rc = chidb_Pager_begin(pg);
+	CU_ASSERT(rc == CHIDB_OK);
+	fill_page(pg, 2, 2);
+	fill_page(pg, 3, 2);
+	chidb_Pager_allocatePage(pg, &npage);
+	fill_page(pg, npage, 2);
+	rc = chidb_Pager_commit(pg);
+	CU_ASSERT(rc == CHIDB_OK);
+	CU_ASSERT(access(TEMPJOURNAL, F_OK) != 0);
+	chidb_Pager_close(pg);
+
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	CU_ASSERT(pg->n_pages == TXNPAGES + 1);
+	CU_ASSERT(check_page(pg, 1, 0));
+	CU_ASSERT(check_page(pg, 2, 2));
+	CU_ASSERT(check_page(pg, 3, 2));
+	CU_ASSERT(check_page(pg, TXNPAGES + 1, 2));
+	chidb_Pager_close(pg);
+	remove(TEMPFILE);
+}
+
+void test_hotjournal(void)
+{
+	int rc;
+	npage_t npage;
+	Pager *pg;
+	FILE *f;
+	uint8_t data[PAGE_SIZE];
+
+	remove(TEMPFILE);
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	for(int j=1; j<=TXNPAGES; j++)
+	{
+		chidb_Pager_allocatePage(pg, &npage);
+		fill_page(pg, npage, 0);
+	}
+
+	/* Simulate a crash halfway through a commit: the journal is on disk,
+	 * and only some of the new pages made it to the file */
+	chidb_Pager_begin(pg);
+	fill_page(pg, 2, 1);
+	fill_page(pg, 3, 1);
+	chidb_Pager_allocatePage(pg, &npage);
+	fill_page(pg, npage, 1);
+
+	f = fopen(TEMPFILE, "r+");
+	memset(data, 1 + 2, PAGE_SIZE);
+	fseek(f, PAGE_SIZE, SEEK_SET);
+	fwrite(data, 1, PAGE_SIZE, f);
+	memset(data, 1 + TXNPAGES + 1, PAGE_SIZE);
+	fseek(f, TXNPAGES * PAGE_SIZE, SEEK_SET);
+	fwrite(data, 1, PAGE_SIZE, f);
+	fclose(f);
+
+	/* The pager is abandoned without committing or rolling back */
+	chidb_Vfs_close(pg->journal);
+	chidb_Vfs_close(pg->f);
+
+	/* Opening the file again rolls back the half-written transaction */
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	CU_ASSERT(access(TEMPJOURNAL, F_OK) != 0);
+	CU_ASSERT(pg->n_pages == TXNPAGES);
+	for(int j=1; j<=TXNPAGES; j++)
+		CU_ASSERT(check_page(pg, j, 0));
+	chidb_Pager_close(pg);
+	remove(TEMPFILE);
+}
+
+void test_spill(void)
+{
+	int rc;
+	npage_t npage;
+	Pager *pg;
+
+	remove(TEMPFILE);
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	CU_ASSERT(chidb_Pager_setSpillSize(pg, 2) == CHIDB_OK);
+	for(int j=1; j<=TXNPAGES; j++)
+	{
+		chidb_Pager_allocatePage(pg, &npage);
+		fill_page(pg, npage, 0);
+	}
+
+	/* A large transaction writes its pages out early. Pages written
+	 * again afterwards, and new pages, are undone by a rollback too */
+	chidb_Pager_begin(pg);
+	for(int j=1; j<=TXNPAGES; j++)
+		fill_page(pg, j, 1);
+	CU_ASSERT(pg->n_spilled > 0);
+	CU_ASSERT(pg->n_dirty <= 2);
+	chidb_Pager_allocatePage(pg, &npage);
+	fill_page(pg, npage, 1);
+	for(int j=1; j<=TXNPAGES + 1; j++)
+		fill_page(pg, j, 2);
+	for(int j=1; j<=TXNPAGES + 1; j++)
+		CU_ASSERT(check_page(pg, j, 2));
+	CU_ASSERT(chidb_Pager_rollback(pg) == CHIDB_OK);
+	CU_ASSERT(pg->n_pages == TXNPAGES);
+	for(int j=1; j<=TXNPAGES; j++)
+		CU_ASSERT(check_page(pg, j, 0));
+
+	/* A crash after a spill is rolled back from the hot journal */
+	chidb_Pager_begin(pg);
+	for(int j=1; j<=TXNPAGES; j++)
+		fill_page(pg, j, 3);
+	CU_ASSERT(pg->n_spilled > 0);
+	chidb_Vfs_close(pg->journal);
+	chidb_Vfs_close(pg->f);
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	chidb_Pager_setSpillSize(pg, 2);
+	for(int j=1; j<=TXNPAGES; j++)
+		CU_ASSERT(check_page(pg, j, 0));
+
+	/* Committing writes whatever was not spilled */
+	chidb_Pager_begin(pg);
+	for(int j=TXNPAGES; j>=1; j--)
+		fill_page(pg, j, 4);
+	CU_ASSERT(chidb_Pager_commit(pg) == CHIDB_OK);
+	chidb_Pager_close(pg);
+
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	CU_ASSERT(access(TEMPJOURNAL, F_OK) != 0);
+	for(int j=1; j<=TXNPAGES; j++)
+		CU_ASSERT(check_page(pg, j, 4));
+	chidb_Pager_close(pg);
+	remove(TEMPFILE);
+}
+
+void test_livejournal(void)
+{
+	int rc;
+	npage_t npage;
+	Pager *pg, *pg2;
+
+	remove(TEMPFILE);
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	chidb_Pager_setSpillSize(pg, 2);
+	for(int j=1; j<=TXNPAGES; j++)
+	{
+		chidb_Pager_allocatePage(pg, &npage);
+		fill_page(pg, npage, 0);
+	}
+
+	/* Some pages of a transaction that is still running are already
+	 * in the file, and their original contents in the journal */
+	CU_ASSERT(chidb_Pager_begin(pg) == CHIDB_OK);
+	for(int j=1; j<=TXNPAGES; j++)
+		fill_page(pg, j, 1);
+	CU_ASSERT(pg->n_spilled > 0);
+	CU_ASSERT(access(TEMPJOURNAL, F_OK) == 0);
+
+	/* Another connection does not take that journal for a hot one */
+	rc = chidb_Pager_open(&pg2, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	CU_ASSERT(access(TEMPJOURNAL, F_OK) == 0);
+	chidb_Pager_close(pg2);
+
+	CU_ASSERT(chidb_Pager_commit(pg) == CHIDB_OK);
+	chidb_Pager_close(pg);
+
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	for(int j=1; j<=TXNPAGES; j++)
+		CU_ASSERT(check_page(pg, j, 1));
+	chidb_Pager_close(pg);
+	remove(TEMPFILE);
+}
+
+void test_wal(void)
+{
+	int rc;
+	npage_t npage;
+	Pager *pg, *pg2;
+	uint8_t data[PAGE_SIZE];
+	FILE *f;
+
+	remove(TEMPFILE);
+	remove(TEMPWAL);
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	for(int j=1; j<=TXNPAGES; j++)
+	{
+		chidb_Pager_allocatePage(pg, &npage);
+		fill_page(pg, npage, 0);
+	}
+	rc = chidb_Pager_setJournalMode(pg, CHIDB_JOURNAL_WAL);
+	CU_ASSERT(rc == CHIDB_OK);
+
+	/* Committed pages go to the WAL, and the file is left untouched */
+	rc = chidb_Pager_begin(pg);
+	CU_ASSERT(rc == CHIDB_OK);
+	fill_page(pg, 2, 1);
+	chidb_Pager_allocatePage(pg, &npage);
+	fill_page(pg, npage, 1);
+	rc = chidb_Pager_commit(pg);
+	CU_ASSERT(rc == CHIDB_OK);
+	CU_ASSERT(access(TEMPWAL, F_OK) == 0);
+	CU_ASSERT(access(TEMPJOURNAL, F_OK) != 0);
+	CU_ASSERT(pg->n_pages == TXNPAGES + 1);
+	CU_ASSERT(check_page(pg, 2, 1));
+	CU_ASSERT(check_page(pg, TXNPAGES + 1, 1));
+
+	f = fopen(TEMPFILE, "r");
+	fseek(f, PAGE_SIZE, SEEK_SET);
+	CU_ASSERT(fread(data, 1, PAGE_SIZE, f) == PAGE_SIZE);
+	CU_ASSERT(data[0] == 2);
+	fseek(f, 0, SEEK_END);
+	CU_ASSERT(ftell(f) == TXNPAGES * PAGE_SIZE);
+	fclose(f);
+
+	/* Another connection sees the commits made before its snapshot */
+	rc = chidb_Pager_open(&pg2, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg2, PAGE_SIZE);
+	CU_ASSERT(pg2->wal != NULL);
+	CU_ASSERT(pg2->n_pages == TXNPAGES + 1);
+	CU_ASSERT(check_page(pg2, 2, 1));
+
+	/* ... and the newer ones only once it refreshes its snapshot */
+	fill_page(pg, 3, 2);
+	CU_ASSERT(check_page(pg2, 3, 0));
+	rc = chidb_Pager_refresh(pg2);
+	CU_ASSERT(rc == CHIDB_OK);
+	CU_ASSERT(check_page(pg2, 3, 2));
+	rc = chidb_Pager_close(pg2);
+	CU_ASSERT(rc == CHIDB_OK);
+
+	/* A checkpoint copies the pages into the file */
+	rc = chidb_Pager_checkpoint(pg);
+	CU_ASSERT(rc == CHIDB_OK);
+	CU_ASSERT(pg->wal->n_frames == 0);
+	f = fopen(TEMPFILE, "r");
+	fseek(f, 2 * PAGE_SIZE, SEEK_SET);
+	CU_ASSERT(fread(data, 1, PAGE_SIZE, f) == PAGE_SIZE);
+	CU_ASSERT(data[0] == 2 + 3);
+	fclose(f);
+
+	fill_page(pg, 4, 3);
+	rc = chidb_Pager_close(pg);
+	CU_ASSERT(rc == CHIDB_OK);
+	CU_ASSERT(access(TEMPWAL, F_OK) != 0);
+
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	CU_ASSERT(pg->wal == NULL);
+	CU_ASSERT(pg->n_pages == TXNPAGES + 1);
+	CU_ASSERT(check_page(pg, 1, 0));
+	CU_ASSERT(check_page(pg, 2, 1));
+	CU_ASSERT(check_page(pg, 3, 2));
+	CU_ASSERT(check_page(pg, 4, 3));
+	CU_ASSERT(check_page(pg, TXNPAGES + 1, 1));
+	chidb_Pager_close(pg);
+	remove(TEMPFILE);
+}
+
+#define NTHREADS (4)
+#define NCOMMITS (25)
+
+/* Each thread commits NCOMMITS times to its own page, through its own pager */
+void *group_commit_thread(void *arg)
+{
+	long t = (long) arg;
+	Pager *pg;
+	int *failed = malloc(sizeof(int));
+
+	*failed = 0;
+	if (chidb_Pager_open(&pg, TEMPFILE) != CHIDB_OK)
+	{
+		*failed = 1;
+		return failed;
+	}
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	chidb_Pager_setGroupCommit(pg, 5000, NTHREADS);
+	for(int j=1; j<=NCOMMITS; j++)
+	{
+		*failed += chidb_Pager_begin(pg) != CHIDB_OK;
+		fill_page(pg, 2 + t, j);
+		*failed += chidb_Pager_commit(pg) != CHIDB_OK;
+	}
+	chidb_Pager_close(pg);
+
+	return failed;
+}
+
+void test_groupcommit(void)
+{
+	int rc;
+	npage_t npage;
+	Pager *pg;
+	pthread_t threads[NTHREADS];
+
+	remove(TEMPFILE);
+	remove(TEMPWAL);
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	for(int j=1; j<=NTHREADS + 1; j++)
+	{
+		chidb_Pager_allocatePage(pg, &npage);
+		fill_page(pg, npage, 0);
+	}
+	rc = chidb_Pager_setJournalMode(pg, CHIDB_JOURNAL_WAL);
+	CU_ASSERT(rc == CHIDB_OK);
+	fill_page(pg, 1, 1);
+	CU_ASSERT(chidb_Pager_setGroupCommit(pg, 0, 0) == CHIDB_EMISUSE);
+
+	for(long t=0; t<NTHREADS; t++)
+		pthread_create(&threads[t], NULL, group_commit_thread, (void *) t);
+	for(int t=0; t<NTHREADS; t++)
+	{
+		int *failed;
+		pthread_join(threads[t], (void **) &failed);
+		CU_ASSERT(*failed == 0);
+		free(failed);
+	}
+
+	/* Every commit is in the WAL, and commits shared their fsyncs */
+	rc = chidb_Pager_refresh(pg);
+	CU_ASSERT(rc == CHIDB_OK);
+	for(int t=0; t<NTHREADS; t++)
+		CU_ASSERT(check_page(pg, 2 + t, NCOMMITS));
+	CU_ASSERT(pg->wal->shared->n_synced == pg->wal->shared->n_commits);
+	CU_ASSERT(pg->wal->shared->n_syncs < NTHREADS * NCOMMITS);
+
+	chidb_Pager_close(pg);
+	CU_ASSERT(access(TEMPWAL, F_OK) != 0);
+	remove(TEMPFILE);
+}
+
+void test_vfs(void)
+{
+	int rc;
+	Vfs *vfs;
+	VfsFile *f, *f2;
+	uint64_t size, id[2], id2[2];
+	uint8_t data[PAGE_SIZE];
+
+	vfs = chidb_Vfs_find(NULL);
+	CU_ASSERT(vfs != NULL);
+	CU_ASSERT(chidb_Vfs_find("posix") == vfs);
+	CU_ASSERT(chidb_Vfs_find("nosuchvfs") == NULL);
+
+	remove(TEMPFILE);
+	rc = chidb_Vfs_open(vfs, TEMPFILE, 0, &f);
+	CU_ASSERT(rc == CHIDB_ENOTFOUND);
+	rc = chidb_Vfs_open(vfs, TEMPFILE, VFS_OPEN_CREATE, &f);
+	CU_ASSERT(rc == CHIDB_OK);
+
+	/* Writes at an offset extend the file */
+	memset(data, 7, PAGE_SIZE);
+	CU_ASSERT(chidb_Vfs_write(f, data, PAGE_SIZE, PAGE_SIZE) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_size(f, &size) == CHIDB_OK);
+	CU_ASSERT(size == 2 * PAGE_SIZE);
+	CU_ASSERT(chidb_Vfs_sync(f) == CHIDB_OK);
+
+	/* Reads past the end are zero-filled */
+	memset(data, 1, PAGE_SIZE);
+	CU_ASSERT(chidb_Vfs_read(f, data, PAGE_SIZE, PAGE_SIZE + PAGE_SIZE / 2) == CHIDB_ESHORTREAD);
+	CU_ASSERT(data[0] == 7 && data[PAGE_SIZE / 2 - 1] == 7);
+	CU_ASSERT(data[PAGE_SIZE / 2] == 0 && data[PAGE_SIZE - 1] == 0);
+	CU_ASSERT(chidb_Vfs_truncate(f, PAGE_SIZE) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_size(f, &size) == CHIDB_OK);
+	CU_ASSERT(size == PAGE_SIZE);
+
+	/* A second handle on the same file has the same identity, and its
+	 * locks conflict with the first one's */
+	rc = chidb_Vfs_open(vfs, TEMPFILE, 0, &f2);
+	CU_ASSERT(rc == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_id(f, id) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_id(f2, id2) == CHIDB_OK);
+	CU_ASSERT(id[0] == id2[0] && id[1] == id2[1]);
+	CU_ASSERT(chidb_Vfs_lock(f, VFS_LOCK_SHARED, true) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_lock(f2, VFS_LOCK_SHARED, false) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_lock(f2, VFS_LOCK_EXCLUSIVE, false) == CHIDB_EBUSY);
+	CU_ASSERT(chidb_Vfs_lock(f, VFS_LOCK_NONE, true) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_lock(f2, VFS_LOCK_EXCLUSIVE, false) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_lock(f, VFS_LOCK_SHARED, false) == CHIDB_EBUSY);
+
+	CU_ASSERT(chidb_Vfs_close(f2) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_close(f) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_remove(vfs, TEMPFILE) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_remove(vfs, TEMPFILE) == CHIDB_ENOTFOUND);
+}
+
+void test_memory(void)
+{
+	int rc;
+	npage_t npage;
+	Pager *pg, *pg2;
+	uint8_t data[PAGE_SIZE];
+	uint64_t size;
+
+	rc = chidb_Pager_open(&pg, ":memory:");
+	CU_ASSERT(rc == CHIDB_OK);
+	rc = chidb_Pager_open(&pg2, ":memory:");
+	CU_ASSERT(rc == CHIDB_OK);
+	CU_ASSERT(pg->vfs == chidb_Vfs_find("memory"));
+	CU_ASSERT(strcmp(pg->filename, pg2->filename) != 0);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	chidb_Pager_setPageSize(pg2, PAGE_SIZE);
+	CU_ASSERT(pg->n_pages == 0);
+
+	/* The two databases are independent */
+	for(int j=1; j<=TXNPAGES; j++)
+	{
+		chidb_Pager_allocatePage(pg, &npage);
+		fill_page(pg, npage, 0);
+	}
+	chidb_Pager_allocatePage(pg2, &npage);
+	fill_page(pg2, npage, 5);
+	CU_ASSERT(pg->n_pages == TXNPAGES);
+	CU_ASSERT(pg2->n_pages == 1);
+	for(int j=1; j<=TXNPAGES; j++)
+		CU_ASSERT(check_page(pg, j, 0));
+	CU_ASSERT(check_page(pg2, 1, 5));
+
+	/* Transactions work as they do on disk */
+	chidb_Pager_begin(pg);
+	fill_page(pg, 2, 1);
+	chidb_Pager_allocatePage(pg, &npage);
+	fill_page(pg, npage, 1);
+	chidb_Pager_rollback(pg);
+	CU_ASSERT(pg->n_pages == TXNPAGES);
+	CU_ASSERT(check_page(pg, 2, 0));
+	chidb_Pager_begin(pg);
+	fill_page(pg, 3, 1);
+	CU_ASSERT(chidb_Pager_commit(pg) == CHIDB_OK);
+	CU_ASSERT(check_page(pg, 3, 1));
+	CU_ASSERT(access(":memory:", F_OK) != 0);
+	CU_ASSERT(access(pg->filename, F_OK) != 0);
+	chidb_Pager_close(pg);
+	chidb_Pager_close(pg2);
+
+	/* Files of the memory VFS are sparse, and go away once closed */
+	VfsFile *f;
+	Vfs *vfs = chidb_Vfs_find("memory");
+	CU_ASSERT(chidb_Vfs_open(vfs, "scratch", VFS_OPEN_CREATE, &f) == CHIDB_OK);
+	memset(data, 9, PAGE_SIZE);
+	CU_ASSERT(chidb_Vfs_write(f, data, PAGE_SIZE, 3 * MEMVFS_CHUNK_SIZE - 10) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_size(f, &size) == CHIDB_OK);
+	CU_ASSERT(size == 3 * MEMVFS_CHUNK_SIZE - 10 + PAGE_SIZE);
+	CU_ASSERT(chidb_Vfs_read(f, data, PAGE_SIZE, 0) == CHIDB_OK);
+	CU_ASSERT(data[0] == 0 && data[PAGE_SIZE - 1] == 0);
+	CU_ASSERT(chidb_Vfs_read(f, data, PAGE_SIZE, 3 * MEMVFS_CHUNK_SIZE - 10) == CHIDB_OK);
+	CU_ASSERT(data[0] == 9 && data[PAGE_SIZE - 1] == 9);
+	CU_ASSERT(chidb_Vfs_truncate(f, 3 * MEMVFS_CHUNK_SIZE - 5) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_read(f, data, PAGE_SIZE, 3 * MEMVFS_CHUNK_SIZE - 10) == CHIDB_ESHORTREAD);
+	CU_ASSERT(data[4] == 9 && data[5] == 0);
+	CU_ASSERT(chidb_Vfs_truncate(f, 4 * MEMVFS_CHUNK_SIZE) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_read(f, data, PAGE_SIZE, 3 * MEMVFS_CHUNK_SIZE - 10) == CHIDB_OK);
+	CU_ASSERT(data[4] == 9 && data[5] == 0 && data[PAGE_SIZE - 1] == 0);
+	CU_ASSERT(chidb_Vfs_close(f) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_open(vfs, "scratch", 0, &f) == CHIDB_ENOTFOUND);
+}
+
+void test_uring(void)
+{
+	int rc;
+	npage_t npage;
+	Pager *pg;
+	Vfs *vfs = chidb_Vfs_find("uring");
+	VfsFile *f;
+	VfsIo ios[3];
+	uint8_t bufs[3][PAGE_SIZE];
+
+	/* Whether or not io_uring works here, batches must give the same
+	 * results as one read or write at a time */
+	CU_ASSERT(vfs != NULL);
+	remove(TEMPFILE);
+	CU_ASSERT(chidb_Vfs_open(vfs, TEMPFILE, VFS_OPEN_CREATE, &f) == CHIDB_OK);
+	for(int i=0; i<3; i++)
+	{
+		memset(bufs[i], i + 1, PAGE_SIZE);
+		ios[i].buf = bufs[i];
+		ios[i].len = PAGE_SIZE;
+		ios[i].offset = (2 - i) * PAGE_SIZE;
+	}
+	CU_ASSERT(chidb_Vfs_writeBatch(f, ios, 3) == CHIDB_OK);
+	memset(bufs, 0, sizeof(bufs));
+	ios[2].offset = 2 * PAGE_SIZE + PAGE_SIZE / 2;
+	CU_ASSERT(chidb_Vfs_readBatch(f, ios, 3) == CHIDB_ESHORTREAD);
+	CU_ASSERT(bufs[0][0] == 1 && bufs[0][PAGE_SIZE - 1] == 1);
+	CU_ASSERT(bufs[1][0] == 2 && bufs[1][PAGE_SIZE - 1] == 2);
+	CU_ASSERT(bufs[2][0] == 1 && bufs[2][PAGE_SIZE / 2] == 0);
+	ios[2].offset = 0;
+	CU_ASSERT(chidb_Vfs_readBatch(f, ios, 3) == CHIDB_OK);
+	CU_ASSERT(bufs[2][0] == 3 && bufs[2][PAGE_SIZE - 1] == 3);
+	chidb_Vfs_close(f);
+	remove(TEMPFILE);
+
+	/* Commits and checkpoints write their pages in batches */
+	remove(TEMPWAL);
+	rc = chidb_Pager_openVfs(&pg, vfs, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	chidb_Pager_begin(pg);
+	for(int j=1; j<=2 * CHECKPOINT_BATCH; j++)
+	{
+		chidb_Pager_allocatePage(pg, &npage);
+		fill_page(pg, npage, 0);
+	}
+	CU_ASSERT(chidb_Pager_commit(pg) == CHIDB_OK);
+	rc = chidb_Pager_setJournalMode(pg, CHIDB_JOURNAL_WAL);
+	CU_ASSERT(rc == CHIDB_OK);
+	for(int j=1; j<=2 * CHECKPOINT_BATCH; j+=2)
+		fill_page(pg, j, 1);
+	CU_ASSERT(chidb_Pager_checkpoint(pg) == CHIDB_OK);
+	chidb_Pager_close(pg);
+
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	CU_ASSERT(pg->n_pages == 2 * CHECKPOINT_BATCH);
+	for(int j=1; j<=2 * CHECKPOINT_BATCH; j++)
+		CU_ASSERT(check_page(pg, j, j % 2));
+	chidb_Pager_close(pg);
+	remove(TEMPFILE);
+}
+
+void test_readahead(void)
+{
+	int rc;
+	npage_t npage;
+	npage_t pages[2] = {5, 7};
+	Pager *pg;
+	const char *vfsnames[2] = {"posix", "uring"};
+
+	for(int v=0; v<2; v++)
+	{
+		Vfs *vfs = chidb_Vfs_find(vfsnames[v]);
+
+		remove(TEMPFILE);
+		rc = chidb_Pager_openVfs(&pg, vfs, TEMPFILE);
+		CU_ASSERT(rc == CHIDB_OK);
+		chidb_Pager_setPageSize(pg, PAGE_SIZE);
+		chidb_Pager_begin(pg);
+		for(int j=1; j<=4 * READAHEAD_PAGES; j++)
+		{
+			chidb_Pager_allocatePage(pg, &npage);
+			fill_page(pg, npage, 0);
+		}
+		CU_ASSERT(chidb_Pager_commit(pg) == CHIDB_OK);
+		chidb_Pager_close(pg);
+
+		/* A sequential scan reads the same pages as random reads. Only
+		 * VFSs that read in batches fill the read-ahead buffer; the
+		 * others are given hints */
+		rc = chidb_Pager_openVfs(&pg, vfs, TEMPFILE);
+		CU_ASSERT(rc == CHIDB_OK);
+		chidb_Pager_setPageSize(pg, PAGE_SIZE);
+		for(int j=1; j<=4 * READAHEAD_PAGES; j++)
+			CU_ASSERT(check_page(pg, j, 0));
+		if(pg->f->methods->readBatch != NULL)
+			CU_ASSERT(pg->ra_hits >= 3 * READAHEAD_PAGES);
+		else
+			CU_ASSERT(pg->ra_hits == 0);
+
+		/* Writes are never hidden by pages read ahead of them */
+		CU_ASSERT(chidb_Pager_prefetch(pg, pages, 2) == CHIDB_OK);
+		fill_page(pg, 5, 1);
+		CU_ASSERT(check_page(pg, 5, 1));
+		chidb_Pager_begin(pg);
+		fill_page(pg, 7, 2);
+		CU_ASSERT(check_page(pg, 7, 2));
+		chidb_Pager_rollback(pg);
+		CU_ASSERT(check_page(pg, 7, 0));
+		CU_ASSERT(chidb_Pager_prefetch(pg, pages, 2) == CHIDB_OK);
+		chidb_Pager_begin(pg);
+		fill_page(pg, 7, 3);
+		CU_ASSERT(chidb_Pager_commit(pg) == CHIDB_OK);
+		CU_ASSERT(check_page(pg, 7, 3));
+		chidb_Pager_close(pg);
+	}
+	remove(TEMPFILE);
+}
+
+void test_direct(void)
+{
+	int rc;
+	npage_t npage;
+	Pager *pg;
+	MemPage *page;
+	Vfs *vfs = chidb_Vfs_find("direct");
+	VfsFile *f;
+	uint64_t size;
+	uint8_t data[3 * PAGE_SIZE];
+
+	/* Whether or not the file system supports O_DIRECT, requests that
+	 * are not aligned to its blocks must work as usual */
+	CU_ASSERT(vfs != NULL);
+	remove(TEMPFILE);
+	CU_ASSERT(chidb_Vfs_open(vfs, TEMPFILE, VFS_OPEN_CREATE | VFS_OPEN_MAIN, &f) == CHIDB_OK);
+	memset(data, 5, sizeof(data));
+	CU_ASSERT(chidb_Vfs_write(f, data, 100, 0) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_size(f, &size) == CHIDB_OK);
+	CU_ASSERT(size == 100);
+	CU_ASSERT(chidb_Vfs_write(f, data + 1, 2 * PAGE_SIZE + 7, 3 * PAGE_SIZE - 3) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_size(f, &size) == CHIDB_OK);
+	CU_ASSERT(size == 5 * PAGE_SIZE + 4);
+	memset(data, 1, sizeof(data));
+	CU_ASSERT(chidb_Vfs_read(f, data, 2 * PAGE_SIZE, 0) == CHIDB_OK);
+	CU_ASSERT(data[0] == 5 && data[99] == 5 && data[100] == 0 && data[2 * PAGE_SIZE - 1] == 0);
+	CU_ASSERT(chidb_Vfs_read(f, data, 3 * PAGE_SIZE, 3 * PAGE_SIZE - 4) == CHIDB_ESHORTREAD);
+	CU_ASSERT(data[0] == 0 && data[1] == 5 && data[2 * PAGE_SIZE + 7] == 5);
+	CU_ASSERT(data[2 * PAGE_SIZE + 8] == 0 && data[3 * PAGE_SIZE - 1] == 0);
+	chidb_Vfs_close(f);
+	remove(TEMPFILE);
+
+	/* Pages are read into aligned buffers */
+	rc = chidb_Pager_openVfs(&pg, vfs, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	chidb_Pager_begin(pg);
+	for(int j=1; j<=2 * READAHEAD_PAGES; j++)
+	{
+		chidb_Pager_allocatePage(pg, &npage);
+		fill_page(pg, npage, 0);
+	}
+	CU_ASSERT(chidb_Pager_commit(pg) == CHIDB_OK);
+	fill_page(pg, 3, 1);
+	chidb_Pager_close(pg);
+
+	rc = chidb_Pager_openVfs(&pg, vfs, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	CU_ASSERT(pg->n_pages == 2 * READAHEAD_PAGES);
+	for(int j=1; j<=2 * READAHEAD_PAGES; j++)
+		CU_ASSERT(check_page(pg, j, j == 3));
+	chidb_Pager_readPage(pg, 1, &page);
+	CU_ASSERT((uintptr_t) page->data % PAGE_SIZE == 0);
+	chidb_Pager_releaseMemPage(pg, page);
+	chidb_Pager_close(pg);
+	remove(TEMPFILE);
+}
+
+#define CACHEPAGES (16)
+#define HOTPAGES (4)
+#define ROUNDS (10)
+
+/* Reads a page through a cache the way the pager does */
+void access_page(PageCache *cache, npage_t npage)
+{
+	uint8_t data[64];
+
+	if(chidb_PageCache_get(cache, npage, data) == CHIDB_OK)
+	{
+		CU_ASSERT(data[0] == (uint8_t) npage && data[63] == (uint8_t) npage);
+	}
+	else
+	{
+		memset(data, npage, sizeof(data));
+		CU_ASSERT(chidb_PageCache_put(cache, npage, data) == CHIDB_OK);
+	}
+}
+
+void test_cachepolicy(void)
+{
+	PageCache *cache;
+	uint8_t data[64];
+	npage_t scan = 1000;
+	int policies[2] = {CHIDB_CACHE_LRU, CHIDB_CACHE_2Q};
+	uint64_t hot_hits[2];
+
+	CU_ASSERT(chidb_PageCache_create(&cache, CHIDB_CACHE_NONE, CACHEPAGES, 64) == CHIDB_EMISUSE);
+	CU_ASSERT(chidb_PageCache_create(&cache, CHIDB_CACHE_LRU, 0, 64) == CHIDB_EMISUSE);
+
+	/* A few pages are read over and over, in between scans of pages
+	 * that are only read once. Each scan reads as many pages as the
+	 * cache holds */
+	for(int p=0; p<2; p++)
+	{
+		CU_ASSERT(chidb_PageCache_create(&cache, policies[p], CACHEPAGES, sizeof(data)) == CHIDB_OK);
+		for(int r=0; r<ROUNDS; r++)
+		{
+			for(npage_t j=1; j<=HOTPAGES; j++)
+				access_page(cache, j);
+			for(int j=0; j<CACHEPAGES; j++)
+				access_page(cache, scan++);
+		}
+		hot_hits[p] = cache->stats.hits;
+		CU_ASSERT(cache->stats.hits + cache->stats.misses == ROUNDS * (HOTPAGES + CACHEPAGES));
+		CU_ASSERT(cache->stats.evictions > 0);
+
+		/* Writes change the cached contents, without adding pages */
+		memset(data, 7, sizeof(data));
+		chidb_PageCache_update(cache, HOTPAGES, 0, data, sizeof(data));
+		chidb_PageCache_update(cache, 1, 0, data, sizeof(data));
+		if(chidb_PageCache_contains(cache, HOTPAGES))
+		{
+			CU_ASSERT(chidb_PageCache_get(cache, HOTPAGES, data) == CHIDB_OK);
+			CU_ASSERT(data[0] == 7);
+		}
+		chidb_PageCache_remove(cache, HOTPAGES);
+		CU_ASSERT(!chidb_PageCache_contains(cache, HOTPAGES));
+		chidb_PageCache_clear(cache);
+		CU_ASSERT(chidb_PageCache_get(cache, 1, data) == CHIDB_ENOTFOUND);
+		chidb_PageCache_destroy(cache);
+	}
+
+	/* The scans evict every page from the LRU cache, but 2Q keeps the
+	 * hot pages after they are read a second time */
+	CU_ASSERT(hot_hits[0] == 0);
+	CU_ASSERT(hot_hits[1] >= (ROUNDS - 2) * HOTPAGES);
+}
+
+void test_cache(void)
+{
+	int rc;
+	npage_t npage;
+	Pager *pg, *pg2;
+	CacheStats stats;
+
+	remove(TEMPFILE);
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	CU_ASSERT(chidb_Pager_setCache(pg, 5, 10) == CHIDB_EMISUSE);
+	CU_ASSERT(chidb_Pager_setCache(pg, CHIDB_CACHE_LRU, MAXPAGES) == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	CU_ASSERT(pg->cache != NULL);
+	for(int j=1; j<=MAXPAGES; j++)
+	{
+		chidb_Pager_allocatePage(pg, &npage);
+		fill_page(pg, npage, 0);
+	}
+
+	/* Pages read again come from the cache */
+	for(int j=1; j<=MAXPAGES; j++)
+		CU_ASSERT(check_page(pg, j, 0));
+	chidb_Pager_cacheStats(pg, &stats);
+	CU_ASSERT(stats.hits >= MAXPAGES);
+
+	/* Cached pages follow writes, commits and rollbacks */
+	fill_page(pg, 2, 1);
+	CU_ASSERT(check_page(pg, 2, 1));
+	chidb_Pager_begin(pg);
+	fill_page(pg, 3, 2);
+	CU_ASSERT(check_page(pg, 3, 2));
+	chidb_Pager_rollback(pg);
+	CU_ASSERT(check_page(pg, 3, 0));
+	chidb_Pager_begin(pg);
+	fill_page(pg, 3, 3);
+	CU_ASSERT(chidb_Pager_commit(pg) == CHIDB_OK);
+	CU_ASSERT(check_page(pg, 3, 3));
+
+	/* Another connection sees the changes once it refreshes. Page 1 is
+	 * left alone, since it holds the change counter of the header */
+	rc = chidb_Pager_open(&pg2, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg2, PAGE_SIZE);
+	pg->has_header = pg2->has_header = true;
+	CU_ASSERT(chidb_Pager_refresh(pg2) == CHIDB_OK);
+	CU_ASSERT(check_page(pg2, 4, 0));
+	CU_ASSERT(chidb_Pager_refresh(pg2) == CHIDB_OK);
+	CU_ASSERT(check_page(pg2, 4, 0));
+	chidb_Pager_cacheStats(pg2, &stats);
+	CU_ASSERT(stats.hits == 1);
+	chidb_Pager_begin(pg);
+	fill_page(pg, 4, 4);
+	CU_ASSERT(chidb_Pager_commit(pg) == CHIDB_OK);
+	CU_ASSERT(chidb_Pager_refresh(pg2) == CHIDB_OK);
+	CU_ASSERT(check_page(pg2, 4, 4));
+	CU_ASSERT(chidb_Pager_refresh(pg2) == CHIDB_OK);
+	fill_page(pg, 4, 5);
+	CU_ASSERT(chidb_Pager_refresh(pg2) == CHIDB_OK);
+	CU_ASSERT(check_page(pg2, 4, 5));
+
+	/* The cache can be turned off */
+	CU_ASSERT(chidb_Pager_setCache(pg2, CHIDB_CACHE_NONE, 0) == CHIDB_OK);
+	CU_ASSERT(pg2->cache == NULL);
+	CU_ASSERT(check_page(pg2, 4, 5));
+	chidb_Pager_cacheStats(pg2, &stats);
+	CU_ASSERT(stats.hits == 0 && stats.misses == 0);
+	chidb_Pager_close(pg2);
+	chidb_Pager_close(pg);
+	remove(TEMPFILE);
+}
+
+void fill_usable(Pager *pg, npage_t npage, uint8_t v)
+{
+	MemPage *page;
+
+	chidb_Pager_readPage(pg, npage, &page);
+	memset(page->data, v + npage, pg->usable_size);
+	chidb_Pager_writePage(pg, page);
+	chidb_Pager_releaseMemPage(pg, page);
+}
+
+bool check_usable(Pager *pg, npage_t npage, uint8_t v)
+{
+	MemPage *page;
+	bool ok;
+
+	if(chidb_Pager_readPage(pg, npage, &page) != CHIDB_OK)
+		return false;
+	ok = true;
+	for(int i=0; i<pg->usable_size; i++)
+		ok = ok && page->data[i] == (uint8_t) (v + npage);
+	chidb_Pager_releaseMemPage(pg, page);
+
+	return ok;
+}
+
+void test_checksums(void)
+{
+	int rc;
+	npage_t npage;
+	Pager *pg;
+	MemPage *page;
+	FILE *f;
+	uint8_t buf[1100];
+
+	/* CRC32C, with and without the crc32 instruction */
+	CU_ASSERT(chidb_Checksum_crc32c((const uint8_t *) "123456789", 9) == 0xE3069283);
+	CU_ASSERT(chidb_Checksum_crc32cSoftware((const uint8_t *) "123456789", 9) == 0xE3069283);
+	CU_ASSERT(chidb_Checksum_crc32c(buf, 0) == 0);
+	for(int i=0; i<sizeof(buf); i++)
+		buf[i] = values[i % NVALUES] ^ (i >> 8);
+	for(int start=0; start<8; start++)
+		for(int len=0; len<=sizeof(buf) - 8; len += 37)
+			CU_ASSERT(chidb_Checksum_crc32c(buf + start, len) == chidb_Checksum_crc32cSoftware(buf + start, len));
+
+	remove(TEMPFILE);
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	CU_ASSERT(chidb_Pager_setChecksums(pg, true) == CHIDB_OK);
+	CU_ASSERT(pg->usable_size == PAGE_SIZE - PAGE_CHECKSUM_SIZE);
+	for(int j=1; j<=MAXPAGES; j++)
+	{
+		chidb_Pager_allocatePage(pg, &npage);
+		fill_usable(pg, npage, 0);
+	}
+
+	/* Pages written in a transaction, and parts of pages written by the
+	 * freelist, also get a checksum */
+	chidb_Pager_begin(pg);
+	CU_ASSERT(chidb_Pager_setChecksums(pg, false) == CHIDB_EMISUSE);
+	fill_usable(pg, 2, 1);
+	fill_usable(pg, 3, 1);
+	CU_ASSERT(chidb_Pager_commit(pg) == CHIDB_OK);
+	CU_ASSERT(chidb_Pager_freePage(pg, 4) == CHIDB_OK);
+	CU_ASSERT(chidb_Pager_freePage(pg, 5) == CHIDB_OK);
+	chidb_Pager_close(pg);
+
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	chidb_Pager_setChecksums(pg, true);
+	CU_ASSERT(check_usable(pg, 1, 0));
+	CU_ASSERT(check_usable(pg, 2, 1));
+	CU_ASSERT(check_usable(pg, 3, 1));
+	for(int j=4; j<=MAXPAGES; j++)
+	{
+		CU_ASSERT(chidb_Pager_readPage(pg, j, &page) == CHIDB_OK);
+		chidb_Pager_releaseMemPage(pg, page);
+	}
+	chidb_Pager_close(pg);
+
+	/* A corrupted page cannot be read, but the others still can */
+	f = fopen(TEMPFILE, "r+b");
+	fseek(f, 2 * PAGE_SIZE + 100, SEEK_SET);
+	fputc(0xFF, f);
+	fclose(f);
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	chidb_Pager_setChecksums(pg, true);
+	CU_ASSERT(chidb_Pager_readPage(pg, 3, &page) == CHIDB_ECHECKSUM);
+	CU_ASSERT(page == NULL);
+	CU_ASSERT(check_usable(pg, 2, 1));
+	chidb_Pager_close(pg);
+
+	/* Without checksums, the page reads as it is in the file */
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	CU_ASSERT(chidb_Pager_readPage(pg, 3, &page) == CHIDB_OK);
+	CU_ASSERT(page->data[100] == 0xFF);
+	chidb_Pager_releaseMemPage(pg, page);
+	chidb_Pager_close(pg);
+	remove(TEMPFILE);
+}
+
+#define COMPRESSPAGES (64)
+
+/* Text that compresses well, different in every page */
+void fill_text(uint8_t *data, npage_t npage, uint8_t v)
+{
+	const char *words[] = {"archive ", "record ", "of ", "the ", "year ", "chidb ", "table "};
+
+	for(int i=0; i<PAGE_SIZE; )
+		for(const char *w = words[(i / 8 + npage + v) % 7]; *w && i<PAGE_SIZE; w++)
+			data[i++] = *w;
+	data[0] = npage;
+	data[1] = v;
+}
+
+void test_compress(void)
+{
+	int rc;
+	npage_t npage;
+	Pager *pg;
+	MemPage *page;
+	Vfs *vfs = chidb_Vfs_find("compress");
+	VfsFile *f;
+	uint64_t size;
+	struct stat st;
+	uint8_t data[3 * PAGE_SIZE], packed[3 * PAGE_SIZE], text[PAGE_SIZE];
+
+	/* Blocks come back as they were. Data that does not compress does
+	 * not fit, and broken data is rejected */
+	fill_text(text, 1, 0);
+	size_t n = chidb_Lz_compress(text, PAGE_SIZE, packed, PAGE_SIZE);
+	CU_ASSERT(n > 0 && n < PAGE_SIZE / 2);
+	CU_ASSERT(chidb_Lz_decompress(packed, n, data, PAGE_SIZE) == CHIDB_OK);
+	CU_ASSERT(!memcmp(data, text, PAGE_SIZE));
+	CU_ASSERT(chidb_Lz_decompress(packed, n - 1, data, PAGE_SIZE) == CHIDB_ECORRUPT);
+	CU_ASSERT(chidb_Lz_decompress(packed, n, data, PAGE_SIZE - 1) == CHIDB_ECORRUPT);
+	CU_ASSERT(chidb_Lz_compress(values, NVALUES, packed, NVALUES - 1) == 0);
+	for(int len=0; len<=40; len++)
+	{
+		memset(data, 7, len);
+		n = chidb_Lz_compress(data, len, packed, sizeof(packed));
+		CU_ASSERT(n > 0);
+		memset(data, 0, len);
+		CU_ASSERT(chidb_Lz_decompress(packed, n, data, len) == CHIDB_OK);
+		CU_ASSERT(len == 0 || (data[0] == 7 && data[len - 1] == 7));
+	}
+
+	/* Reads and writes do not need to be whole blocks */
+	CU_ASSERT(vfs != NULL);
+	remove(TEMPFILE);
+	CU_ASSERT(chidb_Vfs_open(vfs, TEMPFILE, VFS_OPEN_CREATE | VFS_OPEN_MAIN, &f) == CHIDB_OK);
+	memset(data, 5, sizeof(data));
+	CU_ASSERT(chidb_Vfs_write(f, data, 100, 0) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_size(f, &size) == CHIDB_OK);
+	CU_ASSERT(size == 100);
+	CU_ASSERT(chidb_Vfs_write(f, values, NVALUES, 2 * PAGE_SIZE - 10) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_size(f, &size) == CHIDB_OK);
+	CU_ASSERT(size == 2 * PAGE_SIZE - 10 + NVALUES);
+	CU_ASSERT(chidb_Vfs_read(f, data, 3 * PAGE_SIZE, 0) == CHIDB_ESHORTREAD);
+	CU_ASSERT(data[0] == 5 && data[99] == 5 && data[100] == 0 && data[2 * PAGE_SIZE - 11] == 0);
+	CU_ASSERT(!memcmp(data + 2 * PAGE_SIZE - 10, values, NVALUES));
+	CU_ASSERT(data[2 * PAGE_SIZE - 10 + NVALUES] == 0);
+	CU_ASSERT(chidb_Vfs_truncate(f, 2 * PAGE_SIZE) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_sync(f) == CHIDB_OK);
+	chidb_Vfs_close(f);
+	CU_ASSERT(chidb_Vfs_open(vfs, TEMPFILE, VFS_OPEN_MAIN, &f) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_size(f, &size) == CHIDB_OK);
+	CU_ASSERT(size == 2 * PAGE_SIZE);
+	CU_ASSERT(chidb_Vfs_truncate(f, 2 * PAGE_SIZE + 20) == CHIDB_OK);
+	CU_ASSERT(chidb_Vfs_read(f, data, 2 * PAGE_SIZE + 20, 0) == CHIDB_OK);
+	CU_ASSERT(data[99] == 5 && !memcmp(data + 2 * PAGE_SIZE - 10, values, 10) && data[2 * PAGE_SIZE] == 0);
+	chidb_Vfs_close(f);
+	remove(TEMPFILE);
+
+	/* Text pages take a fraction of their size on disk */
+	rc = chidb_Pager_openVfs(&pg, vfs, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	chidb_Pager_begin(pg);
+	for(int j=1; j<=COMPRESSPAGES; j++)
+	{
+		chidb_Pager_allocatePage(pg, &npage);
+		chidb_Pager_readPage(pg, npage, &page);
+		fill_text(page->data, npage, 0);
+		chidb_Pager_writePage(pg, page);
+		chidb_Pager_releaseMemPage(pg, page);
+	}
+	CU_ASSERT(chidb_Pager_commit(pg) == CHIDB_OK);
+	chidb_Pager_close(pg);
+	CU_ASSERT(stat(TEMPFILE, &st) == 0);
+	CU_ASSERT(st.st_size < COMPRESSPAGES * PAGE_SIZE / 2);
+
+	/* Rewriting pages reuses the space of their old records */
+	rc = chidb_Pager_openVfs(&pg, vfs, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	CU_ASSERT(pg->n_pages == COMPRESSPAGES);
+	for(int v=1; v<=4; v++)
+	{
+		chidb_Pager_begin(pg);
+		for(int j=1; j<=COMPRESSPAGES; j++)
+		{
+			chidb_Pager_readPage(pg, j, &page);
+			fill_text(text, j, v - 1);
+			if(memcmp(page->data, text, PAGE_SIZE))
+				CU_FAIL("Incorrect page read from compressed file");
+			fill_text(page->data, j, v);
+			chidb_Pager_writePage(pg, page);
+			chidb_Pager_releaseMemPage(pg, page);
+		}
+		CU_ASSERT(chidb_Pager_commit(pg) == CHIDB_OK);
+	}
+	chidb_Pager_close(pg);
+	CU_ASSERT(stat(TEMPFILE, &st) == 0);
+	CU_ASSERT(st.st_size < COMPRESSPAGES * PAGE_SIZE);
+
+	rc = chidb_Pager_openVfs(&pg, vfs, TEMPFILE);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	for(int j=1; j<=COMPRESSPAGES; j++)
+	{
+		chidb_Pager_readPage(pg, j, &page);
+		fill_text(text, j, 4);
+		if(memcmp(page->data, text, PAGE_SIZE))
+			CU_FAIL("Incorrect page read from compressed file");
+		chidb_Pager_releaseMemPage(pg, page);
+	}
+	chidb_Pager_close(pg);
+
+	/* Files of other VFSs cannot be opened with it */
+	CU_ASSERT(chidb_Vfs_open(vfs, TESTFILE, VFS_OPEN_MAIN, &f) == CHIDB_EIO);
+	remove(TEMPFILE);
+}
+
+/* A sparse file with one page past the first 4 GB */
+#define BIGPAGES ((npage_t) ((1ULL << 32) / PAGE_SIZE) + 2)
+
+void test_largefile(void)
+{
+	int rc;
+	Pager *pg;
+	MemPage *page;
+	Vfs *vfs = chidb_Vfs_find("posix");
+	VfsFile *f;
+	uint64_t size;
+	uint8_t buf[PAGE_SIZE];
+	uint64_t last = (uint64_t) (BIGPAGES - 1) * PAGE_SIZE;
+
+	remove(TEMPFILE);
+	CU_ASSERT_FATAL(chidb_Vfs_open(vfs, TEMPFILE, VFS_OPEN_CREATE, &f) == CHIDB_OK);
+	CU_ASSERT_FATAL(chidb_Vfs_truncate(f, last + PAGE_SIZE) == CHIDB_OK);
+
+	rc = chidb_Pager_open(&pg, TEMPFILE);
+	CU_ASSERT(rc == CHIDB_OK);
+	chidb_Pager_setPageSize(pg, PAGE_SIZE);
+	CU_ASSERT_EQUAL(pg->n_pages, BIGPAGES);
+
+	rc = chidb_Pager_readPage(pg, BIGPAGES, &page);
+	CU_ASSERT(rc == CHIDB_OK);
+	for(int k=0; k<NVALUES; k++)
+		page->data[pagepos[k]] = values[k];
+	CU_ASSERT(chidb_Pager_writePage(pg, page) == CHIDB_OK);
+	chidb_Pager_releaseMemPage(pg, page);
+	chidb_Pager_close(pg);
+
+	/* The page is past 4 GB, and did not wrap around onto page 2 */
+	CU_ASSERT(chidb_Vfs_size(f, &size) == CHIDB_OK);
+	CU_ASSERT_EQUAL(size, last + PAGE_SIZE);
+	CU_ASSERT(chidb_Vfs_read(f, buf, PAGE_SIZE, last) == CHIDB_OK);
+	for(int k=0; k<NVALUES; k++)
+		CU_ASSERT_EQUAL(buf[pagepos[k]], values[k]);
+	CU_ASSERT(chidb_Vfs_read(f, buf, PAGE_SIZE, PAGE_SIZE) == CHIDB_OK);
+	for(int k=0; k<PAGE_SIZE; k++)
+		if(buf[k] != 0)
+		{
+			CU_FAIL("Page 2 was overwritten");
+			break;
+		}
+
+	chidb_Vfs_close(f);
+	remove(TEMPFILE);
+}
+
 int init_tests_pager()
 {
 	CU_pSuite pagerTests = NULL;
@@ -143,7 +1347,24 @@ int init_tests_pager()
 	if (
 		(NULL == CU_add_test(pagerTests, "Opening an existing file", test_open)) ||
 		(NULL == CU_add_test(pagerTests, "Reading pages", test_read)) ||
-		(NULL == CU_add_test(pagerTests, "Allocating/writing/reading a page", test_readwrite))
+		(NULL == CU_add_test(pagerTests, "Allocating/writing/reading a page", test_readwrite)) ||
+		(NULL == CU_add_test(pagerTests, "Freeing and reusing pages", test_freelist)) ||
+		(NULL == CU_add_test(pagerTests, "Committing and rolling back transactions", test_transactions)) ||
+		(NULL == CU_add_test(pagerTests, "Recovering from a hot journal", test_hotjournal)) ||
+		(NULL == CU_add_test(pagerTests, "Spilling dirty pages", test_spill)) ||
+		(NULL == CU_add_test(pagerTests, "Leaving the journal of a running transaction alone", test_livejournal)) ||
+		(NULL == CU_add_test(pagerTests, "Write-ahead log", test_wal)) ||
+		(NULL == CU_add_test(pagerTests, "Group commit", test_groupcommit)) ||
+		(NULL == CU_add_test(pagerTests, "Default VFS", test_vfs)) ||
+		(NULL == CU_add_test(pagerTests, "In-memory database", test_memory)) ||
+		(NULL == CU_add_test(pagerTests, "Batched I/O with io_uring", test_uring)) ||
+		(NULL == CU_add_test(pagerTests, "Sequential read-ahead", test_readahead)) ||
+		(NULL == CU_add_test(pagerTests, "Direct I/O", test_direct)) ||
+		(NULL == CU_add_test(pagerTests, "Page cache replacement policies", test_cachepolicy)) ||
+		(NULL == CU_add_test(pagerTests, "Page cache", test_cache)) ||
+		(NULL == CU_add_test(pagerTests, "Page checksums", test_checksums)) ||
+		(NULL == CU_add_test(pagerTests, "Compressed files", test_compress)) ||
+		(NULL == CU_add_test(pagerTests, "Files larger than 4 GB", test_largefile))
 	   )
    	{
       CU_cleanup_registry();
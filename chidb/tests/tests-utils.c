@@ -7,6 +7,9 @@
 uint16_t uint16_values[] = {0,1,128,255,256,32767,32768,65535};
 uint32_t uint32_values[] = {0,255,256,32767,32768,65535,65536,4294967295};
 uint32_t varint32_values[] = {0,255,256,32767,32768,65535,65536,268435455};
+uint64_t uint64_values[] = {0,255,65536,4294967295ULL,4294967296ULL,72057594037927935ULL,72057594037927936ULL,18446744073709551615ULL};
+uint64_t varint64_values[] = {0,127,128,16383,16384,268435456ULL,72057594037927935ULL,18446744073709551615ULL};
+int varint64_lengths[] = {1,1,2,2,3,5,8,9};
 
 void test_getput2byte(void)
 {
@@ -38,13 +41,76 @@ void test_getput4byte(void)
 
 void test_varint32(void)
 {
-	uint8_t buf[4];
+	uint8_t buf[VARINT_MAXSIZE];
 	
 	for(int i=0; i<NVALUES; i++)
 	{
 		uint32_t val;
-		putVarint32(buf, varint32_values[i]);
-		getVarint32(buf, &val);
+		int len = putVarint32(buf, varint32_values[i]);
+		CU_ASSERT_EQUAL(len, varintLen64(varint32_values[i]));
+		CU_ASSERT_EQUAL(getVarint32(buf, &val), len);
+		
+		CU_ASSERT_EQUAL(val, varint32_values[i]);
+
+		CU_ASSERT_EQUAL(GETVARINT32(buf, val), len);
+		CU_ASSERT_EQUAL(val, varint32_values[i]);
+	}
+}
+
+void test_varint32_padded(void)
+{
+	/* Varints padded to four bytes, as they were always written in
+	 * files from before varints were variable-length */
+	uint8_t padded[][4] = {{0x80,0x80,0x80,0x05}, {0x80,0x80,0x81,0x00}, {0xFF,0xFF,0xFF,0x7F}};
+	uint32_t values[] = {5, 128, 268435455};
+	
+	for(int i=0; i<3; i++)
+	{
+		uint32_t val;
+		uint64_t val64;
+		CU_ASSERT_EQUAL(getVarint32(padded[i], &val), 4);
+		CU_ASSERT_EQUAL(val, values[i]);
+		CU_ASSERT_EQUAL(GETVARINT32(padded[i], val), 4);
+		CU_ASSERT_EQUAL(val, values[i]);
+		CU_ASSERT_EQUAL(getVarint64(padded[i], &val64), 4);
+		CU_ASSERT_EQUAL(val64, values[i]);
+	}
+}
+
+void test_getput8byte(void)
+{
+	uint8_t buf[8];
+	
+	for(int i=0; i<NVALUES; i++)
+	{
+		uint64_t val;
+		put8byte(buf, uint64_values[i]);
+		val = get8byte(buf);
+		
+		CU_ASSERT_EQUAL(val, uint64_values[i]);
+	}
+}
+
+void test_varint64(void)
+{
+	uint8_t buf[VARINT_MAXSIZE];
+	
+	for(int i=0; i<NVALUES; i++)
+	{
+		uint64_t val;
+		CU_ASSERT_EQUAL(putVarint64(buf, varint64_values[i]), varint64_lengths[i]);
+		CU_ASSERT_EQUAL(varintLen64(varint64_values[i]), varint64_lengths[i]);
+		CU_ASSERT_EQUAL(getVarint64(buf, &val), varint64_lengths[i]);
+		
+		CU_ASSERT_EQUAL(val, varint64_values[i]);
+	}
+
+	/* Varints written by putVarint32 are also valid 64-bit varints */
+	for(int i=0; i<NVALUES; i++)
+	{
+		uint64_t val;
+		int len = putVarint32(buf, varint32_values[i]);
+		CU_ASSERT_EQUAL(getVarint64(buf, &val), len);
 		
 		CU_ASSERT_EQUAL(val, varint32_values[i]);
 	}
@@ -65,7 +131,10 @@ int init_tests_utils()
 	if (
 		(NULL == CU_add_test(utilsTests, "Get/put uint16", test_getput2byte)) ||
 		(NULL == CU_add_test(utilsTests, "Get/put uint32", test_getput4byte)) ||
-		(NULL == CU_add_test(utilsTests, "Get/put varint32", test_varint32))
+		(NULL == CU_add_test(utilsTests, "Get/put varint32", test_varint32)) ||
+		(NULL == CU_add_test(utilsTests, "Padded varint32", test_varint32_padded)) ||
+		(NULL == CU_add_test(utilsTests, "Get/put uint64", test_getput8byte)) ||
+		(NULL == CU_add_test(utilsTests, "Get/put varint64", test_varint64))
 	   )
    	{
       CU_cleanup_registry();